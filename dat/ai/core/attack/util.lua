@@ -63,7 +63,7 @@ function atk.decide_zz( target, dist )
    local dir    = ai.idir(target)
 
    local _m1, d1 = vec2.polar( pilot:vel() )
-   local _m2, d2 = vec2.polar( target:pos() - pilot:pos() )
+   local _m2, d2 = vec2.polar( target:pos():sub_( pilot:pos() ) )
    local d = d1-d2
 
    return ( (dist > range) and (ai.hasprojectile())
@@ -320,7 +320,7 @@ local function ___atk_g_ranged_strafe( target, dist )
    range = math.min ( range - dist * radial_vel / ( ai.getweapspeed( 4 ) - radial_vel ), range )
 
    local goal = ai.follow_accurate(target, range * 0.8, 0, 10, 20, "keepangle")
-   local mod = vec2.mod(goal - p:pos())
+   local mod = vec2.mod(p:pos():sub_(goal))
 
    local shoot4 = false -- Flag to see if we shoot with all seekers
 
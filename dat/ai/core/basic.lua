@@ -259,7 +259,7 @@ function follow_accurate( target )
    local goal = ai.follow_accurate(target, mem.radius,
          mem.angle, mem.Kp, mem.Kd)
 
-   local mod = vec2.mod(goal - p:pos())
+   local mod = vec2.mod(p:pos():sub_(goal))
 
    --  Always face the goal
    local dir   = ai.face(goal)
@@ -326,7 +326,7 @@ function follow_fleet ()
          if dist > 300 then   -- Must approach
             mem.app = 1
          else   -- Face forward
-            goal = plt:pos() + leader:vel()
+            goal = plt:pos():add_( leader:vel() )
             ai.face(goal)
          end
       end
@@ -414,7 +414,7 @@ function _landgo( planet )
 end
 
 function __landgo ( planet )
-   local pl_pos = planet:pos() + mem.target_bias
+   local pl_pos = planet:pos():add_( mem.target_bias )
 
    local dist     = ai.dist( pl_pos )
    local bdist    = ai.minbrakedist()
@@ -490,8 +490,8 @@ function runaway( target )
    else
       -- find which one is the closest
       local pilpos = ai.pilot():pos()
-      local modt = vec2.mod(t:pos()-pilpos)
-      local modp = vec2.mod(p:pos()-pilpos)
+      local modt = vec2.mod(t:pos():sub_(pilpos))
+      local modp = vec2.mod(p:pos():sub_(pilpos))
       if modt < modp then
          mem.target_bias = vec2.newP( rnd.rnd()*t:radius()/2, rnd.angle() )
          ai.pushsubtask( "_run_hyp", {target, t} )
@@ -583,7 +583,7 @@ end
 function _run_hyp( data )
    local enemy  = data[1]
    local jump   = data[2]
-   local jp_pos = jump:pos() + mem.target_bias
+   local jp_pos = jump:pos():add_( mem.target_bias )
 
    -- Shoot the target
    __shoot_turret( enemy )
@@ -648,7 +648,7 @@ end
 function _run_landgo( data )
    local enemy  = data[1]
    local planet = data[2]
-   local pl_pos = planet:pos() + mem.target_bias
+   local pl_pos = planet:pos():add_( mem.target_bias )
 
    -- Shoot the target
    __shoot_turret( enemy )
@@ -761,7 +761,7 @@ function _hyp_approach_follow( target )
 end
 function __hyp_approach( target, jumptsk )
    local dir
-   local pos      = target:pos() + mem.target_bias
+   local pos      = target:pos():add_( mem.target_bias )
    local dist     = ai.dist( pos )
    local bdist    = ai.minbrakedist()
    jumptsk  = jumptsk or "_hyp_jump"
@@ -981,7 +981,7 @@ function mine_drill( ast )
 
    local target = ast:pos()
    local vel = ast:vel()
-   local _dist, angle = vec2.polar( p:pos() - target )
+   local _dist, angle = vec2.polar( p:pos():sub_( target ) )
 
    -- First task : place the ship close to the asteroid
    local goal = ai.face_accurate( target, vel, 0, angle, mem.Kp, mem.Kd )
@@ -1031,7 +1031,7 @@ function mine_shoot( ast )
 
    local target = ast:pos()
    local vel = ast:vel()
-   local _dist, angle = vec2.polar( p:pos() - target )
+   local _dist, angle = vec2.polar( p:pos():sub_( target ) )
 
    -- First task : place the ship close to the asteroid
    local goal = ai.face_accurate( target, vel, trange, angle, mem.Kp, mem.Kd )
@@ -1043,8 +1043,8 @@ function mine_shoot( ast )
       ai.accel()
    end
 
-   local relpos = vec2.add( p:pos(), vec2.mul(target,-1) ):mod()
-   local relvel = vec2.add( p:vel(), vec2.mul(vel,-1) ):mod()
+   local relpos = p:pos():sub_( target ):mod()
+   local relvel = p:vel():sub_( vel ):mod()
 
    if relpos < wrange and relvel < 10 then
       ai.pushsubtask("_killasteroid", ast )
@@ -22,7 +22,7 @@ function mine_bite( ast )
 
    local target = ast:pos()
    local vel = ast:vel()
-   local _dist, angle = vec2.polar( p:pos() - target )
+   local _dist, angle = vec2.polar( p:pos():sub_( target ) )
 
    -- First task : place the ship close to the asteroid
    local goal = ai.face_accurate( target, vel, 0, angle, mem.Kp, mem.Kd )
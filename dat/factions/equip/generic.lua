@@ -28,6 +28,7 @@ function equip_generic( p )
    local params = {
       rnd = 0.3,
       max_mass = 0.9 + 0.2*rnd.rnd(),
+      async = equipopt.params.spawn_async,
    }
 
    -- Do equipment
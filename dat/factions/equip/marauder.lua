@@ -12,6 +12,7 @@ function equip( p )
    local params = {
       max_util = rnd.rnd( math.floor(nu*0.5), nu ),
       max_stru = rnd.rnd( math.floor(ns*0.5), ns ),
+      async = equipopt.params.spawn_async,
    }
 
    return equipopt.pirate( p, params )
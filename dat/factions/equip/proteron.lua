@@ -5,5 +5,5 @@ local equipopt = require 'equipopt'
 --    @param p Pilot to equip
 --]]
 function equip( p )
-   return equipopt.proteron( p )
+   return equipopt.proteron( p, { async=equipopt.params.spawn_async } )
 end
@@ -31,6 +31,7 @@ function equip( p )
    local params = equipopt.params.choose( p )
    params.rnd = params.rnd * 1.5
    params.max_mass = 0.8 + 0.2*rnd.rnd() -- want space for cargo!
+   params.async = equipopt.params.spawn_async
 
    -- See cores
    local cores = ecores.get( p, { all="standard" } )
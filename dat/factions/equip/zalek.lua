@@ -16,7 +16,7 @@ local cargo_chance = {
 --    @param p Pilot to equip
 --]]
 function equip( p )
-   local ret = equipopt.zalek( p )
+   local ret = equipopt.zalek( p, { async=equipopt.params.spawn_async } )
    -- Add cargo
    local cc = cargo_chance[ p:ship():class() ]
    if cc and rnd.rnd() < cc then
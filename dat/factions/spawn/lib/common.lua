@@ -164,6 +164,10 @@ function scom.spawn( pilots )
       if params.ai==nil and pilots.__ai then
          params.ai = pilots.__ai
       end
+      -- Natural spawns don't need to wait for their equipment
+      if params.async_equip==nil then
+         params.async_equip = true
+      end
       local pfact = params.faction or fct
       local p = pilot.add( v.ship, pfact, origin, params.name, params )
       local mem = p:memory()
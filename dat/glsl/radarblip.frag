@@ -0,0 +1,26 @@
+#include "lib/sdf.glsl"
+
+in vec4 colour;
+in vec2 pos;
+in vec2 param; // Size in pixels and shape (0 is a pilot, 1 an asteroid)
+out vec4 colour_out;
+
+void main(void) {
+   float d, m;
+   if (param.y < 0.5) {
+      // Same as pilotmarker.frag
+      vec2 uv = vec2( pos.y, pos.x );
+      m = 1.0 / param.x;
+      d = sdTriangleEquilateral( uv*1.15  ) / 1.15;
+      d = abs(d+2.0*m);
+   }
+   else {
+      // Same as asteroidmarker.frag
+      vec2 uv = pos * param.x;
+      m = 1.0;
+      d = sdBox( uv, vec2(param.x-2.0) );
+   }
+   float alpha = smoothstep(    -m, 0.0, -d);
+   float beta  = smoothstep(-2.0*m,  -m, -d);
+   colour_out   = colour * vec4( vec3(alpha), beta );
+}
@@ -0,0 +1,15 @@
+uniform mat4 projection;
+in vec4 vertex;         // Radar position
+in vec4 vertex_colour;  // Colour of the blip
+in vec2 vertex_tex;     // Position within the blip in [-1,1]
+in vec2 vertex_param;   // Size in pixels and shape
+out vec4 colour;
+out vec2 pos;
+out vec2 param;
+
+void main(void) {
+   colour = vertex_colour;
+   pos    = vertex_tex;
+   param  = vertex_param;
+   gl_Position = projection * vertex;
+}
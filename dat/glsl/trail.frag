@@ -20,19 +20,16 @@ subroutine uniform trail_func_prototype trail_func;
 
 // For ideas: https://thebookofshaders.com/05/
 
-uniform vec4 c1;  // Start colour
-uniform vec4 c2;  // End colour
-uniform float t1; // Start time [0,1]
-uniform float t2; // End time [0,1]
-uniform float dt; // Current time (in seconds)
-uniform vec2 pos1;// Start position
-uniform vec2 pos2;// End position
-uniform float r;  // Unique value per trail [0,1]
 uniform vec3 nebu_col; // Base colour of the nebula, only changes when entering new system
 
-in vec2 pos;
+in vec4 colour;   // Interpolated colour
+in vec4 pos;      // Time [0,1], side [-1,1], distance along and across the trail
+in vec2 param;    // Trail timer and unique value
 out vec4 colour_out;
 
+float dt; // Current time (in seconds)
+float r;  // Unique value per trail [0,1]
+
 /* Has a peak at 1/k */
 float impulse( float x, float k )
 {
@@ -267,12 +264,12 @@ vec4 trail_split( vec4 colour, vec2 pos_tex, vec2 pos_px )
 void main(void) {
    vec2 pos_tex, pos_px;
 
-   // Interpolate
-   colour_out = mix( c1, c2, pos.x );
-   pos_px    = mix( pos1, pos2, pos );
-   pos_px.y *= pos.y;
-   pos_tex.x = mix( t1, t2, pos.x );
-   pos_tex.y = 2. * pos.y - 1.;
+   // Already interpolated by the mesh
+   colour_out = colour;
+   pos_tex    = pos.xy;
+   pos_px     = pos.zw;
+   dt         = param.x;
+   r          = param.y;
 
 #ifdef HAS_GL_ARB_shader_subroutine
    // Use subroutines
@@ -0,0 +1,15 @@
+uniform mat4 projection;
+in vec4 vertex;         // Screen position
+in vec4 vertex_colour;  // Colour of the trail point
+in vec4 vertex_tex;     // Normalized time, side, distance along and across
+in vec2 vertex_param;   // Trail timer and unique value
+out vec4 colour;
+out vec4 pos;
+out vec2 param;
+
+void main(void) {
+   colour = vertex_colour;
+   pos    = vertex_tex;
+   param  = vertex_param;
+   gl_Position = projection * vertex;
+}
@@ -239,6 +239,14 @@ function optimize.optimize( p, cores, outfit_list, params )
    params = params or eparams.default()
    params.goodness = params.goodness or optimize.goodness_default
    local sparams = optimize.sparams
+   -- Solutions of natural spawns get memoized, with the random noise applied
+   -- when generating the cached variants. Other pilots get the noise applied
+   -- to the objective here and a fresh solve, so they don't all look the same
+   local cache = params.cache
+   if cache==nil then
+      cache = p:flags("async_equip")
+   end
+   local cparams = cache and { rnd=params.rnd } or nil
    local pm = p:memory()
    pm.equipopt_params = params
 
@@ -595,7 +603,10 @@ function optimize.optimize( p, cores, outfit_list, params )
          local stats = outfit_cache[o]
          local name = string.format("s%d-%s", i, stats.name)
          local slotmod = ((slots.size==stats.size) and 1) or params.mismatch
-         local objf = (1+params.rnd*rnd.sigma()) * stats.goodness * slotmod -- contribution to objective function
+         local objf = stats.goodness * slotmod -- contribution to objective function
+         if not cache then
+            objf = (1+params.rnd*rnd.sigma()) * objf
+         end
          lp:set_col( c, name, objf, "binary" ) -- constraints set automatically
          -- CPU constraint
          table.insert( ia, 1 )
@@ -689,106 +700,144 @@ function optimize.optimize( p, cores, outfit_list, params )
    lp:load_matrix( ia, ja, ar )
 
    -- Try to optimize
-   local try = 0
-   local emod = 1
-   local mmod = 1
-   local smod = 1
-   local done
-   local z, x, constraints
-   repeat
-      try = try + 1
-      done = true
-      -- All the magic is done here
-      --lp:write_problem( "test.mps" )
-      z, x, constraints = lp:solve( sparams )
-      if not z then
-         -- Try to relax constraints
-         -- Mass constraint
-         mmod = mmod * 2
-         massgoal = mmod * params.max_mass * ss.engine_limit - st.mass
-         lp:set_row( 3, "mass", nil, massgoal )
-         -- Energy constraint
-         energygoal = energygoal / 1.5
-         lp:set_row( 2, "energy_regen", nil, st.energy_regen - emod*energygoal )
-
-         -- Re-solve
-         z, x, constraints = lp:solve( sparams )
-
-         -- Likely nebula shield damage constraint if not resolved
-         -- TODO this should probably just ignore the constraint and change it so that
-         -- the pilot tries to optimize for maximum shield regen instead
-         if not z and nebu_vol > 0 then
-            smod = smod / 1.5
-            lp:set_row( nebu_row, "shield_regen", smod*nebu_dmg-st.shield_regen, nil )
+   local function finish( presolved, z, x, constraints )
+      local try = 0
+      local emod = 1
+      local mmod = 1
+      local smod = 1
+      local done
+      repeat
+         try = try + 1
+         done = true
+         -- All the magic is done here, the first solve may already be done
+         --lp:write_problem( "test.mps" )
+         if try > 1 or not presolved then
+            z, x, constraints = lp:solve( sparams, cparams )
+         end
+         if not z then
+            -- Try to relax constraints
+            -- Mass constraint
+            mmod = mmod * 2
+            massgoal = mmod * params.max_mass * ss.engine_limit - st.mass
+            lp:set_row( 3, "mass", nil, massgoal )
+            -- Energy constraint
+            energygoal = energygoal / 1.5
+            lp:set_row( 2, "energy_regen", nil, st.energy_regen - emod*energygoal )
 
             -- Re-solve
-            z, x, constraints = lp:solve( sparams )
+            z, x, constraints = lp:solve( sparams, cparams )
 
-            -- Check to see if that worked, and if not remove the constraint
-            if not z then
-               smod = 0
-               lp:set_row( nebu_row, "shield_regen", nil, nil )
+            -- Likely nebula shield damage constraint if not resolved
+            -- TODO this should probably just ignore the constraint and change it so that
+            -- the pilot tries to optimize for maximum shield regen instead
+            if not z and nebu_vol > 0 then
+               smod = smod / 1.5
+               lp:set_row( nebu_row, "shield_regen", smod*nebu_dmg-st.shield_regen, nil )
 
                -- Re-solve
-               z, x, constraints = lp:solve( sparams )
+               z, x, constraints = lp:solve( sparams, cparams )
+
+               -- Check to see if that worked, and if not remove the constraint
+               if not z then
+                  smod = 0
+                  lp:set_row( nebu_row, "shield_regen", nil, nil )
+
+                  -- Re-solve
+                  z, x, constraints = lp:solve( sparams, cparams )
+               end
             end
          end
-      end
 
-      if not z then
-         -- Maybe should be error instead?
-         warn(string.format(_("Failed to solve equipopt linear program for pilot '%s': %s"), p:name(), x))
-         print_debug( p, st, ss, outfit_list, params, constraints, energygoal, emod, mmod, nebu_row, budget_row )
-         return false
-      end
+         if not z then
+            -- Maybe should be error instead?
+            warn(string.format(_("Failed to solve equipopt linear program for pilot '%s': %s"), p:name(), x))
+            print_debug( p, st, ss, outfit_list, params, constraints, energygoal, emod, mmod, nebu_row, budget_row )
+            return false
+         end
 
-      -- Interpret results
-      c = 1
-      for i,s in ipairs(slots) do
-         for j,o in ipairs(s.outfits) do
-            if x[c] == 1 then
-               local q = p:outfitAdd( o, 1, true )
-               if q < 1 then
-                  warn(string.format(_("Unable to equip outfit '%s' on '%s'!"), o,  p:name()))
+         -- Interpret results
+         c = 1
+         for i,s in ipairs(slots) do
+            for j,o in ipairs(s.outfits) do
+               if x[c] == 1 then
+                  local q = p:outfitAdd( o, 1, true )
+                  if q < 1 then
+                     warn(string.format(_("Unable to equip outfit '%s' on '%s'!"), o,  p:name()))
+                  end
                end
+               c = c + 1
             end
-            c = c + 1
          end
+
+         -- Due to the approximation, sometimes they end up with not enough
+         -- energy, we'll try again with larger energy constraints
+         local stn = p:stats()
+         if stn.energy_regen < energygoal and try < 5 then
+            p:outfitRm( "all" )
+            emod = emod * 1.5
+            --print(string.format("Pilot %s: optimization attempt %d of %d: emod=%.3f", p:name(), try, 3, emod ))
+            lp:set_row( 2, "energy_regen", nil, st.energy_regen - emod*energygoal )
+            done = false
+         end
+      until done or try >= 5 -- attempts should be fairly fast since we just do optimization step
+      if not done then
+         warn(string.format(_("Failed to equip pilot '%s'!"), p:name()))
+         print_debug( p, st, ss, outfit_list, params, constraints, energygoal, emod, mmod, nebu_row, budget_row )
+         return false
       end
 
-      -- Due to the approximation, sometimes they end up with not enough
-      -- energy, we'll try again with larger energy constraints
-      local stn = p:stats()
-      if stn.energy_regen < energygoal and try < 5 then
-         p:outfitRm( "all" )
-         emod = emod * 1.5
-         --print(string.format("Pilot %s: optimization attempt %d of %d: emod=%.3f", p:name(), try, 3, emod ))
-         lp:set_row( 2, "energy_regen", nil, st.energy_regen - emod*energygoal )
-         done = false
+      -- Fill ammo
+      p:fillAmmo()
+
+      -- Set up useful outfits
+      ai_setup.setup(p)
+
+      -- Check
+      if __debugging then
+         local b, s = p:spaceworthy()
+         if not b then
+            warn(string.format(_("Pilot '%s' is not space worthy after equip script is run! Reason: %s"),p:name(),s))
+            print_debug( p, st, ss, outfit_list, params, constraints, energygoal, emod, mmod, nebu_row, budget_row )
+            return false
+         end
       end
-   until done or try >= 5 -- attempts should be fairly fast since we just do optimization step
-   if not done then
-      warn(string.format(_("Failed to equip pilot '%s'!"), p:name()))
-      print_debug( p, st, ss, outfit_list, params, constraints, energygoal, emod, mmod, nebu_row, budget_row )
-      return false
+      return true
    end
 
-   -- Fill ammo
-   p:fillAmmo()
-
-   -- Set up useful outfits
-   ai_setup.setup(p)
+   -- Scripts expect pilots to be equipped when pilot.add() returns, so only
+   -- pilots that opted in are equipped off the main thread
+   if not params.async or not p:flags("async_equip") then
+      return finish( false )
+   end
 
-   -- Check
-   if __debugging then
-      local b, s = p:spaceworthy()
-      if not b then
-         warn(string.format(_("Pilot '%s' is not space worthy after equip script is run! Reason: %s"),p:name(),s))
-         print_debug( p, st, ss, outfit_list, params, constraints, energygoal, emod, mmod, nebu_row, budget_row )
-         return false
+   -- Solve off the main thread. If it is not done in time, the pilot is left
+   -- with only the cores and gets equipped once the solve finishes, unless
+   -- something else changed its outfits in the meantime.
+   local spawned = p:outfitsList("all")
+   lp:solve_async( sparams, cparams, function ( z, x, constraints )
+      if not p:exists() then
+         return
       end
+      local cur = p:outfitsList("all")
+      if #cur ~= #spawned then
+         return
+      end
+      for i,o in ipairs(cur) do
+         if o ~= spawned[i] then
+            return
+         end
+      end
+      local a, s = p:health()
+      local e = p:energy()
+      finish( true, z, x, constraints )
+      p:setHealth( a, s )
+      p:setEnergy( e )
+   end )
+   local z, x, constraints = lp:wait( params.async )
+   if z == false then
+      return true
    end
-   return true
+   return finish( true, z, x, constraints )
 end
 
 return optimize
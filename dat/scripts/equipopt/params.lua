@@ -1,5 +1,9 @@
 local params = {}
 
+-- Seconds the faction equip scripts wait for the solve when spawning pilots
+-- added with async_equip, such as natural spawns
+params.spawn_async = 0.005
+
 function params.default( overwrite )
    return tmerge_r( {
       -- Global stuff
@@ -17,6 +21,8 @@ function params.default( overwrite )
       max_mass    = 1.2, -- maximum amount to go over engine limit (relative)
       min_mass_margin = 0.15, -- minimum mass margin to consider when equipping
       budget      = nil, -- total cost budget
+      async       = nil, -- seconds to wait for an off-thread solve before spawning with only cores (nil solves on the main thread, only used for pilots added with async_equip)
+      cache       = nil, -- whether to memoize the solutions and reuse a few random variants of them (nil only caches for pilots added with async_equip)
       -- Range of type, this is dangerous as minimum values could lead to the
       -- optimization problem not having a solution with high minimums
       type_range  = {
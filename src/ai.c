@@ -89,6 +89,7 @@
 #include "ntracing.h"
 #include "physics.h"
 #include "pilot.h"
+#include "player.h"
 #include "rng.h"
 #include "space.h"
 
@@ -105,6 +106,9 @@
 #define AI_SECONDARY ( 1 << 1 ) /**< Firing secondary weapon */
 #define AI_DISTRESS ( 1 << 2 )  /**< Sent distress signal. */
 
+#define AI_PRIORITY_RANGE                                                      \
+   5000. /**< Control ticks this close to the player are never deferred. */
+
 /*
  * all the AI profiles
  */
@@ -113,11 +117,19 @@ static nlua_env    equip_env = LUA_NOREF; /**< Equipment enviornment. */
 static IntList     ai_qtquery;            /**< Quadtree query. */
 static double ai_dt = 0.; /**< Current update tick, useful in some cases. **/
 
+/*
+ * Control tick budget.
+ */
+static double ai_budget_used     = 0.; /**< Milliseconds used this frame. */
+static int    ai_budget_ticks    = 0;  /**< Control ticks run this frame. */
+static int    ai_budget_deferred = 0;  /**< Control ticks deferred. */
+
 /*
  * prototypes
  */
 /* Internal C routines */
 static void ai_run( nlua_env env, int nargs );
+static int  ai_deferControl( Pilot *p, const Task *t );
 static int  ai_loadProfile( AI_Profile *prof, const char *filename );
 static int  ai_setMemory( void );
 static void ai_create( Pilot *pilot );
@@ -470,6 +482,19 @@ void ai_thinkApply( Pilot *p )
       pilot_distress( p, NULL, aiL_distressmsg );
 }
 
+#if HAVE_TRACY
+/**
+ * @brief Gets the amount of memory in use by Lua, to track allocations.
+ *
+ *    @return Kilobytes in use by the Lua state.
+ */
+static double ai_gcKBytes( void )
+{
+   return (double)lua_gc( naevL, LUA_GCCOUNT, 0 ) +
+          (double)lua_gc( naevL, LUA_GCCOUNTB, 0 ) / 1024.;
+}
+#endif /* HAVE_TRACY */
+
 /**
  * @brief Attempts to run a function.
  *
@@ -485,6 +510,86 @@ static void ai_run( nlua_env env, int nargs )
    }
 }
 
+/**
+ * @brief Starts a new frame of AI control ticks, resetting the budget.
+ *
+ * Control ticks that don't fit into conf.ai_budget get pushed to later
+ * frames, so a lot of them landing on the same frame doesn't cause a spike.
+ */
+void ai_budgetReset( void )
+{
+   NTracingPlotI( "AI control ticks", ai_budget_ticks );
+   NTracingPlotI( "AI deferred ticks", ai_budget_deferred );
+   NTracingPlotF( "AI control ms", ai_budget_used );
+
+   ai_budget_used     = 0.;
+   ai_budget_ticks    = 0;
+   ai_budget_deferred = 0;
+}
+
+/**
+ * @brief Checks to see if a pilot's control ticks should never be deferred.
+ *
+ * Such pilots also think first, before the budget is used up.
+ *
+ *    @param p Pilot to check.
+ *    @return 1 if the pilot is near the player or in combat.
+ */
+int ai_isPriority( Pilot *p )
+{
+   const Pilot *target;
+
+   /* Directly controlled pilots have to respond. */
+   if ( pilot_isPlayer( p ) || pilot_isFlag( p, PILOT_MANUAL_CONTROL ) )
+      return 1;
+
+   /* The player would notice. */
+   if ( ( player.p != NULL ) &&
+        ( vec2_dist2( &p->solid.pos, &player.p->solid.pos ) <
+          pow2( AI_PRIORITY_RANGE ) ) )
+      return 1;
+
+   /* Recently hit. */
+   if ( p->stimer > 0. )
+      return 1;
+
+   /* Fighting an enemy. */
+   target = pilot_getTarget( p );
+   if ( ( target != NULL ) && pilot_areEnemies( p, target ) )
+      return 1;
+
+   return 0;
+}
+
+/**
+ * @brief Checks to see if a pilot's control tick should be deferred to a
+ * later frame.
+ *
+ *    @param p Pilot whose control tick is due.
+ *    @param t Current task of the pilot.
+ *    @return 1 if the control tick should be skipped this frame.
+ */
+static int ai_deferControl( Pilot *p, const Task *t )
+{
+   /* Budget not used up yet. */
+   if ( ( conf.ai_budget <= 0. ) || ( ai_budget_used < conf.ai_budget ) )
+      return 0;
+
+   /* Idle pilots have to figure out what to do. */
+   if ( t == NULL )
+      return 0;
+
+   /* Don't let pilots fall behind more than one tick. */
+   if ( p->tcontrol < -p->ai->control_rate )
+      return 0;
+
+   if ( ai_isPriority( p ) )
+      return 0;
+
+   ai_budget_deferred++;
+   return 1;
+}
+
 /**
  * @brief Initializes the pilot in the ai.
  *
@@ -823,6 +928,9 @@ void ai_think( Pilot *pilot, double dt, int dotask )
       return;
 
    NTracingZone( _ctx, 1 );
+#if HAVE_TRACY
+   double gc_start = ai_gcKBytes();
+#endif /* HAVE_TRACY */
 
    oldmem = ai_setPilot( pilot );
    env    = cur_pilot->ai->env; /* set the AI profile to the current pilot's */
@@ -842,9 +950,11 @@ void ai_think( Pilot *pilot, double dt, int dotask )
    t = ai_curTask( cur_pilot );
 
    /* control function if pilot is idle or tick is up */
-   if ( ( cur_pilot->tcontrol < 0. ) || ( t == NULL ) ) {
+   if ( ( ( cur_pilot->tcontrol < 0. ) || ( t == NULL ) ) &&
+        !ai_deferControl( cur_pilot, t ) ) {
       NTracingZoneName( _ctx_control, "ai_think[control]", 1 );
 
+      Uint64 start = SDL_GetPerformanceCounter();
       double crate = cur_pilot->ai->control_rate;
       if ( pilot_isFlag( pilot, PILOT_PLAYER ) ||
            pilot_isFlag( cur_pilot, PILOT_MANUAL_CONTROL ) ) {
@@ -863,11 +973,20 @@ void ai_think( Pilot *pilot, double dt, int dotask )
       /* Task may have changed due to control tick. */
       t = ai_curTask( cur_pilot );
 
+      /* Count it towards the frame budget. */
+      ai_budget_used += 1000. *
+                        (double)( SDL_GetPerformanceCounter() - start ) /
+                        (double)SDL_GetPerformanceFrequency();
+      ai_budget_ticks++;
+
       NTracingZoneEnd( _ctx_control );
    }
 
    if ( !dotask ) {
       ai_unsetPilot( oldmem );
+#if HAVE_TRACY
+      NTracingPlotF( "AI GC KiB", MAX( 0., ai_gcKBytes() - gc_start ) );
+#endif /* HAVE_TRACY */
       NTracingZoneEnd( _ctx );
       return;
    }
@@ -919,6 +1038,9 @@ void ai_think( Pilot *pilot, double dt, int dotask )
    /* Clean up if necessary. */
    ai_taskGC( cur_pilot );
 
+#if HAVE_TRACY
+   NTracingPlotF( "AI GC KiB", MAX( 0., ai_gcKBytes() - gc_start ) );
+#endif /* HAVE_TRACY */
    NTracingZoneEnd( _ctx );
 }
 
@@ -1936,11 +2058,12 @@ static int aiL_face( lua_State *L )
  */
 static int aiL_careful_face( lua_State *L )
 {
-   vec2         *tv, F, F1;
-   Pilot        *p;
-   double        d, diff, dist;
-   Pilot *const *pilot_stack;
-   int           x, y, r;
+   vec2           *tv, F, F1;
+   Pilot          *p;
+   double          d, diff, dist;
+   Pilot *const   *pilot_stack;
+   int             x, y, r;
+   const uint64_t *enemies;
 
    /* Default gains. */
    const double k_diff  = 1. / ( cur_pilot->turn * ai_dt );
@@ -1980,7 +2103,8 @@ static int aiL_careful_face( lua_State *L )
    /* It's modulated by k_enemy * k_mult / dist^2, where k_mult<1 and
     * k_enemy=6e6 A distance of 5000 should give a maximum factor of 0.24, but
     * it should be far away enough to not matter (hopefully).. */
-   r = 5000;
+   r       = 5000;
+   enemies = faction_enemyMask( cur_pilot->faction );
    pilot_collideQueryIL( &ai_qtquery, x - r, y - r, x + r, y + r );
    for ( int i = 0; i < il_size( &ai_qtquery ); i++ ) {
       const Pilot *p_i = pilot_stack[il_get( &ai_qtquery, i, 0 )];
@@ -2002,7 +2126,7 @@ static int aiL_careful_face( lua_State *L )
       dist = sqrt( dist ); /* Have to undo the square. */
 
       /* Check if friendly or not */
-      if ( areEnemies( cur_pilot->faction, p_i->faction ) ) {
+      if ( faction_maskHas( enemies, p_i->faction ) ) {
          double k_mult =
             pilot_relhp( p_i, cur_pilot ) * pilot_reldps( p_i, cur_pilot );
          double factor = k_enemy * k_mult / ( dist * dist * dist );
@@ -101,5 +101,7 @@ void ai_think( Pilot *pilot, double dt, int dotask );
 AIMemory ai_setPilot( Pilot *p );
 void     ai_unsetPilot( AIMemory oldmem );
 void     ai_thinkSetup( double dt );
+void     ai_budgetReset( void );
+int      ai_isPriority( Pilot *p );
 void     ai_thinkApply( Pilot *p );
 void     ai_init( Pilot *p );
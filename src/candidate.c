@@ -0,0 +1,248 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+/**
+ * @file candidate.c
+ *
+ * @brief Indexes missions and events by where they can appear.
+ *
+ * Candidates are bucketed by trigger (or availability location) and by the
+ * most specific of their spob, system or factions, so that landing or entering
+ * a system only looks at the candidates that can possibly appear there. The
+ * index only narrows down the search, all the requirements still have to be
+ * checked on the candidates it returns.
+ */
+/** @cond */
+#include <stdlib.h>
+
+#include "naev.h"
+/** @endcond */
+
+#include "candidate.h"
+
+#include "array.h"
+
+/**
+ * @brief An entry of the index.
+ */
+typedef struct CandidateEntry_s {
+   int          trigger; /**< Trigger or location of the candidate. */
+   CandidateKey key;     /**< What the candidate is bucketed by. */
+   const char  *name;    /**< Spob or system name, not owned. */
+   int          faction; /**< Faction ID. */
+   int          item;    /**< Index of the candidate. */
+} CandidateEntry;
+
+/**
+ * @brief The candidate index, entries sorted by trigger, key and item.
+ */
+struct CandidateIndex_s {
+   CandidateEntry *entries; /**< Array (array.h): Sorted entries. */
+};
+
+/*
+ * Prototypes.
+ */
+static int candidate_cmpKey( const CandidateEntry *a, const CandidateEntry *b );
+static int candidate_cmp( const void *p1, const void *p2 );
+static int candidate_cmpInt( const void *p1, const void *p2 );
+static void candidate_push( const CandidateIndex *ci, int **list,
+                            const CandidateEntry *key, int any );
+
+/**
+ * @brief Creates an empty candidate index.
+ */
+CandidateIndex *candidate_create( void )
+{
+   CandidateIndex *ci = calloc( 1, sizeof( CandidateIndex ) );
+   ci->entries        = array_create( CandidateEntry );
+   return ci;
+}
+
+/**
+ * @brief Frees a candidate index.
+ */
+void candidate_free( CandidateIndex *ci )
+{
+   if ( ci == NULL )
+      return;
+   array_free( ci->entries );
+   free( ci );
+}
+
+/**
+ * @brief Adds a candidate only available at a spob or in a system.
+ *
+ *    @param ci Index to add to.
+ *    @param trigger Trigger or location of the candidate.
+ *    @param key Either CANDIDATE_SPOB or CANDIDATE_SYSTEM.
+ *    @param name Name of the spob or system, must outlive the index.
+ *    @param item Index of the candidate.
+ */
+void candidate_addName( CandidateIndex *ci, int trigger, CandidateKey key,
+                        const char *name, int item )
+{
+   CandidateEntry e = {
+      .trigger = trigger, .key = key, .name = name, .item = item };
+   array_push_back( &ci->entries, e );
+}
+
+/**
+ * @brief Adds a candidate only available for a faction.
+ */
+void candidate_addFaction( CandidateIndex *ci, int trigger, int faction,
+                           int item )
+{
+   CandidateEntry e = { .trigger = trigger,
+                        .key     = CANDIDATE_FACTION,
+                        .faction = faction,
+                        .item    = item };
+   array_push_back( &ci->entries, e );
+}
+
+/**
+ * @brief Adds a candidate available anywhere.
+ */
+void candidate_addAny( CandidateIndex *ci, int trigger, int item )
+{
+   CandidateEntry e = {
+      .trigger = trigger, .key = CANDIDATE_ANY, .item = item };
+   array_push_back( &ci->entries, e );
+}
+
+/**
+ * @brief Sorts the index once all the candidates are added.
+ */
+void candidate_finalize( CandidateIndex *ci )
+{
+   qsort( ci->entries, array_size( ci->entries ), sizeof( CandidateEntry ),
+          candidate_cmp );
+}
+
+/**
+ * @brief Compares the bucket of two entries.
+ */
+static int candidate_cmpKey( const CandidateEntry *a, const CandidateEntry *b )
+{
+   if ( a->trigger != b->trigger )
+      return ( a->trigger < b->trigger ) ? -1 : 1;
+   if ( a->key != b->key )
+      return ( a->key < b->key ) ? -1 : 1;
+   switch ( a->key ) {
+   case CANDIDATE_SPOB:
+   case CANDIDATE_SYSTEM:
+      return strcmp( a->name, b->name );
+   case CANDIDATE_FACTION:
+      if ( a->faction != b->faction )
+         return ( a->faction < b->faction ) ? -1 : 1;
+      return 0;
+   default:
+      return 0;
+   }
+}
+
+/**
+ * @brief Compares two entries for sorting.
+ */
+static int candidate_cmp( const void *p1, const void *p2 )
+{
+   const CandidateEntry *a = p1;
+   const CandidateEntry *b = p2;
+   int                   c = candidate_cmpKey( a, b );
+   if ( c != 0 )
+      return c;
+   return a->item - b->item;
+}
+
+/**
+ * @brief Compares two integers for sorting.
+ */
+static int candidate_cmpInt( const void *p1, const void *p2 )
+{
+   return *(const int *)p1 - *(const int *)p2;
+}
+
+/**
+ * @brief Pushes the items of a bucket to a list.
+ *
+ *    @param ci Index to look in.
+ *    @param[in,out] list List to append to.
+ *    @param key Entry with the bucket to look for.
+ *    @param any Whether to match any faction for faction buckets.
+ */
+static void candidate_push( const CandidateIndex *ci, int **list,
+                            const CandidateEntry *key, int any )
+{
+   int lo = 0, hi = array_size( ci->entries );
+
+   /* Find the first entry not before the bucket. */
+   while ( lo < hi ) {
+      int                   mid = ( lo + hi ) / 2;
+      const CandidateEntry *e   = &ci->entries[mid];
+      int                   c;
+      if ( any && ( e->trigger == key->trigger ) && ( e->key == key->key ) )
+         c = 0;
+      else
+         c = candidate_cmpKey( e, key );
+      if ( c < 0 )
+         lo = mid + 1;
+      else
+         hi = mid;
+   }
+
+   for ( int i = lo; i < array_size( ci->entries ); i++ ) {
+      const CandidateEntry *e = &ci->entries[i];
+      if ( any ) {
+         if ( ( e->trigger != key->trigger ) || ( e->key != key->key ) )
+            break;
+      } else if ( candidate_cmpKey( e, key ) != 0 )
+         break;
+      array_push_back( list, e->item );
+   }
+}
+
+/**
+ * @brief Gets the candidates that can appear at a location.
+ *
+ *    @param ci Index to look in.
+ *    @param[in,out] list Array (array.h) to store the candidates in, sorted
+ * in increasing order and without duplicates.
+ *    @param trigger Trigger or location to get candidates for.
+ *    @param spob Name of the spob or NULL if not at a spob.
+ *    @param sys Name of the system or NULL to skip system candidates.
+ *    @param faction Faction to get candidates for, or -1 for all of them.
+ */
+void candidate_query( const CandidateIndex *ci, int **list, int trigger,
+                      const char *spob, const char *sys, int faction )
+{
+   CandidateEntry key = { .trigger = trigger };
+   int            n;
+
+   array_resize( list, 0 );
+   if ( ci == NULL )
+      return;
+
+   if ( spob != NULL ) {
+      key.key  = CANDIDATE_SPOB;
+      key.name = spob;
+      candidate_push( ci, list, &key, 0 );
+   }
+   if ( sys != NULL ) {
+      key.key  = CANDIDATE_SYSTEM;
+      key.name = sys;
+      candidate_push( ci, list, &key, 0 );
+   }
+   key.key     = CANDIDATE_FACTION;
+   key.faction = faction;
+   candidate_push( ci, list, &key, faction < 0 );
+   key.key = CANDIDATE_ANY;
+   candidate_push( ci, list, &key, 0 );
+
+   /* Keep the original order and drop duplicate faction matches. */
+   qsort( *list, array_size( *list ), sizeof( int ), candidate_cmpInt );
+   n = 0;
+   for ( int i = 0; i < array_size( *list ); i++ )
+      if ( ( n == 0 ) || ( ( *list )[n - 1] != ( *list )[i] ) )
+         ( *list )[n++] = ( *list )[i];
+   array_resize( list, n );
+}
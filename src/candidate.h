@@ -0,0 +1,36 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+#pragma once
+
+/**
+ * @brief What a candidate is bucketed by.
+ */
+typedef enum CandidateKey_ {
+   CANDIDATE_SPOB,    /**< Only available at a specific spob. */
+   CANDIDATE_SYSTEM,  /**< Only available in a specific system. */
+   CANDIDATE_FACTION, /**< Only available for some factions. */
+   CANDIDATE_ANY,     /**< Available anywhere. */
+} CandidateKey;
+
+/* Forward declaration. */
+struct CandidateIndex_s;
+typedef struct CandidateIndex_s CandidateIndex;
+
+/*
+ * Building.
+ */
+CandidateIndex *candidate_create( void );
+void            candidate_free( CandidateIndex *ci );
+void candidate_addName( CandidateIndex *ci, int trigger, CandidateKey key,
+                        const char *name, int item );
+void candidate_addFaction( CandidateIndex *ci, int trigger, int faction,
+                           int item );
+void candidate_addAny( CandidateIndex *ci, int trigger, int item );
+void candidate_finalize( CandidateIndex *ci );
+
+/*
+ * Querying.
+ */
+void candidate_query( const CandidateIndex *ci, int **list, int trigger,
+                      const char *spob, const char *sys, int faction );
@@ -20,6 +20,7 @@
 #include "conf.h"
 #include "gatherable.h"
 #include "log.h"
+#include "nameidx.h"
 #include "ndata.h"
 #include "nxml.h"
 #include "threadpool.h"
@@ -33,6 +34,8 @@
 Commodity         *commodity_stack = NULL; /**< Contains all the commodities. */
 static Commodity **commodity_temp =
    NULL; /**< Contains all the temporary commodities. */
+static NameIdx commodity_idx;      /**< Commodities indexed by name. */
+static NameIdx commodity_temp_idx; /**< Temporary commodities by name. */
 
 /* @TODO remove externs. */
 extern int *econ_comm;
@@ -163,14 +166,12 @@ Commodity *commodity_get( const char *name )
  */
 Commodity *commodity_getW( const char *name )
 {
-   const Commodity q = { .name = (char *)name };
-   Commodity *r = bsearch( &q, commodity_stack, array_size( commodity_stack ),
-                           sizeof( Commodity ), commodity_cmp );
-   if ( r != NULL )
-      return r;
-   for ( int i = 0; i < array_size( commodity_temp ); i++ )
-      if ( strcmp( commodity_temp[i]->name, name ) == 0 )
-         return commodity_temp[i];
+   int i = nameidx_get( &commodity_idx, name );
+   if ( i >= 0 )
+      return &commodity_stack[i];
+   i = nameidx_get( &commodity_temp_idx, name );
+   if ( i >= 0 )
+      return commodity_temp[i];
    return NULL;
 }
 
@@ -434,12 +435,10 @@ int commodity_checkIllegal( const Commodity *com, int faction )
  */
 int commodity_isTemp( const char *name )
 {
-   for ( int i = 0; i < array_size( commodity_temp ); i++ )
-      if ( strcmp( commodity_temp[i]->name, name ) == 0 )
-         return 1;
-   for ( int i = 0; i < array_size( commodity_stack ); i++ )
-      if ( strcmp( commodity_stack[i].name, name ) == 0 )
-         return 0;
+   if ( nameidx_get( &commodity_temp_idx, name ) >= 0 )
+      return 1;
+   if ( nameidx_get( &commodity_idx, name ) >= 0 )
+      return 0;
 
    WARN( _( "Commodity '%s' not found in stack" ), name );
    return 0;
@@ -463,6 +462,8 @@ Commodity *commodity_newTemp( const char *name, const char *desc )
    ( *c )->istemp      = 1;
    ( *c )->name        = strdup( name );
    ( *c )->description = strdup( desc );
+   nameidx_add( &commodity_temp_idx, ( *c )->name,
+                array_size( commodity_temp ) - 1 );
    return *c;
 }
 
@@ -555,8 +556,10 @@ int commodity_load( void )
           commodity_cmp );
 
    /* Load into commodity stack. */
+   nameidx_init( &commodity_idx, array_size( commodity_stack ) );
    for ( int i = 0; i < array_size( commodity_stack ); i++ ) {
       const Commodity *com = &commodity_stack[i];
+      nameidx_add( &commodity_idx, com->name, i );
       /* See if should get added to commodity list. */
       if ( com->price > 0. )
          array_push_back( &econ_comm, i );
@@ -587,6 +590,7 @@ void commodity_free( void )
       commodity_freeOne( &commodity_stack[i] );
    array_free( commodity_stack );
    commodity_stack = NULL;
+   nameidx_free( &commodity_idx );
 
    for ( int i = 0; i < array_size( commodity_temp ); i++ ) {
       commodity_freeOne( commodity_temp[i] );
@@ -594,6 +598,7 @@ void commodity_free( void )
    }
    array_free( commodity_temp );
    commodity_temp = NULL;
+   nameidx_free( &commodity_temp_idx );
 
    /* More clean up. */
    array_free( econ_comm );
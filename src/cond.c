@@ -64,7 +64,7 @@ int cond_compile( const char *cond )
       lua_pushstring( naevL, cond );
       lua_concat( naevL, 2 );
    }
-   ret = luaL_loadbuffer( naevL, lua_tostring( naevL, -1 ),
+   ret = nlua_loadbuffer( naevL, lua_tostring( naevL, -1 ),
                           lua_strlen( naevL, -1 ), "Lua Conditional" );
    switch ( ret ) {
    case LUA_ERRSYNTAX:
@@ -92,6 +92,25 @@ cond_err:
    return LUA_NOREF;
 }
 
+/**
+ * @brief Compiles a conditional statement into the bytecode cache, so that
+ * cond_compile() only has to load it. Safe to call from any thread.
+ *
+ *    @param cond Conditional string to compile.
+ */
+void cond_precompile( const char *cond )
+{
+   char *buf;
+
+   /* Must match the chunk built by cond_compile(). */
+   if ( strstr( cond, "return" ) != NULL )
+      buf = strdup( cond );
+   else
+      SDL_asprintf( &buf, "return %s", cond );
+   nlua_precompile( buf, strlen( buf ), "Lua Conditional" );
+   free( buf );
+}
+
 /**
  * @brief Checks to see if a condition is true.
  *
@@ -6,5 +6,6 @@
 int  cond_init( void );
 void cond_exit( void );
 int  cond_compile( const char *cond );
+void cond_precompile( const char *cond );
 int  cond_check( const char *cond );
 int  cond_checkChunk( int chunk, const char *cond );
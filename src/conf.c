@@ -190,6 +190,8 @@ void conf_setGameplayDefaults( void )
    conf.mouse_doubleclick = MOUSE_DOUBLECLICK_TIME;
    conf.mouse_fly         = MOUSE_FLY_DEFAULT;
    conf.zoom_manual       = MANUAL_ZOOM_DEFAULT;
+   conf.ai_budget         = AI_BUDGET_DEFAULT;
+   conf.sim_lod_range     = SIM_LOD_RANGE_DEFAULT;
 }
 
 /**
@@ -260,8 +262,9 @@ void conf_setVideoDefaults( void )
       background_load( cur_system->background );
 
    /* FPS. */
-   conf.fps_show = SHOW_FPS_DEFAULT;
-   conf.fps_max  = FPS_MAX_DEFAULT;
+   conf.fps_show     = SHOW_FPS_DEFAULT;
+   conf.fps_max      = FPS_MAX_DEFAULT;
+   conf.metrics_show = SHOW_METRICS_DEFAULT;
 
    /* Pause. */
    conf.pause_show = SHOW_PAUSE_DEFAULT;
@@ -372,6 +375,8 @@ int conf_loadConfig( const char *file )
       /* FPS */
       conf_loadBool( lEnv, "showfps", conf.fps_show );
       conf_loadInt( lEnv, "maxfps", conf.fps_max );
+      conf_loadBool( lEnv, "showmetrics", conf.metrics_show );
+      conf_loadString( lEnv, "metrics_csv", conf.metrics_csv );
 
       /*  Pause */
       conf_loadBool( lEnv, "showpause", conf.pause_show );
@@ -429,6 +434,8 @@ int conf_loadConfig( const char *file )
       conf_loadFloat( lEnv, "mouse_doubleclick", conf.mouse_doubleclick );
       conf_loadFloat( lEnv, "autonav_reset_dist", conf.autonav_reset_dist );
       conf_loadFloat( lEnv, "autonav_reset_shield", conf.autonav_reset_shield );
+      conf_loadFloat( lEnv, "ai_budget", conf.ai_budget );
+      conf_loadFloat( lEnv, "sim_lod_range", conf.sim_lod_range );
       conf_loadBool( lEnv, "devmode", conf.devmode );
       conf_loadBool( lEnv, "devautosave", conf.devautosave );
       conf_loadBool( lEnv, "lua_enet", conf.lua_enet );
@@ -1026,6 +1033,20 @@ int conf_saveConfig( const char *file )
    conf_saveInt( "maxfps", conf.fps_max );
    conf_saveEmptyLine();
 
+   conf_saveComment(
+      _( "Display per-frame timings and counters below the frame rate" ) );
+   conf_saveBool( "showmetrics", conf.metrics_show );
+   conf_saveEmptyLine();
+
+   conf_saveComment( _( "File in the write directory to stream per-frame "
+                        "metrics to as CSV, nil disables" ) );
+   if ( conf.metrics_csv == NULL ) {
+      conf_saveComment( "metrics_csv = nil" );
+   } else {
+      conf_saveString( "metrics_csv", conf.metrics_csv );
+   }
+   conf_saveEmptyLine();
+
    /* Pause */
    conf_saveComment( _( "Show 'PAUSED' on screen while paused" ) );
    conf_saveBool( "showpause", conf.pause_show );
@@ -1149,6 +1170,18 @@ int conf_saveConfig( const char *file )
    conf_saveFloat( "mouse_doubleclick", conf.mouse_doubleclick );
    conf_saveEmptyLine();
 
+   conf_saveComment( _( "Milliseconds per frame that AI control ticks can "
+                        "use before being spread over later frames (0 "
+                        "disables)." ) );
+   conf_saveFloat( "ai_budget", conf.ai_budget );
+   conf_saveEmptyLine();
+
+   conf_saveComment( _( "Distance from the player and from combat past which "
+                        "pilots are simulated at a reduced rate (0 "
+                        "disables)." ) );
+   conf_saveFloat( "sim_lod_range", conf.sim_lod_range );
+   conf_saveEmptyLine();
+
    conf_saveComment(
       _( "Enables developer mode (universe editor and the likes)" ) );
    conf_saveBool( "devmode", conf.devmode );
@@ -1345,6 +1378,7 @@ void conf_copy( PlayerConf_t *dest, const PlayerConf_t *src )
    STRDUP( dev_save_spob );
    if ( src->difficulty != NULL )
       STRDUP( difficulty );
+   STRDUP( metrics_csv );
 #undef STRDUP
 }
 
@@ -1362,6 +1396,7 @@ void conf_free( PlayerConf_t *config )
    free( config->dev_save_map );
    free( config->dev_save_spob );
    free( config->difficulty );
+   free( config->metrics_csv );
 
    /* Clear memory. */
    memset( config, 0, sizeof( PlayerConf_t ) );
@@ -27,6 +27,10 @@
    0.5 /**< How long to consider double-clicks for. */
 #define MANUAL_ZOOM_DEFAULT                                                    \
    0 /**< Whether or not to enable manual zoom controls. */
+#define AI_BUDGET_DEFAULT                                                      \
+   2. /**< Milliseconds per frame AI control ticks can use (0 disables). */
+#define SIM_LOD_RANGE_DEFAULT                                                  \
+   10e3 /**< Distance past which pilots are simulated at a reduced rate. */
 #define ZOOM_FAR_DEFAULT 0.5  /**< Far zoom distance (smaller is further) */
 #define ZOOM_NEAR_DEFAULT 1.0 /**< Close zoom distance (bigger is larger) */
 #define ZOOM_SPEED_DEFAULT                                                     \
@@ -50,10 +54,11 @@
 #define SCALE_FACTOR_DEFAULT 1. /**< Default scale factor. */
 #define NEBULA_SCALE_FACTOR_DEFAULT                                            \
    4.                        /**< Default scale factor for nebula rendering. */
-#define SHOW_FPS_DEFAULT 0   /**< Whether to display FPS on screen. */
-#define FPS_MAX_DEFAULT 60   /**< Maximum FPS. */
-#define SHOW_PAUSE_DEFAULT 1 /**< Whether to display pause status. */
-#define MINIMIZE_DEFAULT 1   /**< Whether to minimize on focus loss. */
+#define SHOW_FPS_DEFAULT 0     /**< Whether to display FPS on screen. */
+#define SHOW_METRICS_DEFAULT 0 /**< Whether to display metrics on screen. */
+#define FPS_MAX_DEFAULT 60     /**< Maximum FPS. */
+#define SHOW_PAUSE_DEFAULT 1   /**< Whether to display pause status. */
+#define MINIMIZE_DEFAULT 1     /**< Whether to minimize on focus loss. */
 #define COLOURBLIND_SIM_DEFAULT                                                \
    0. /**< Whether to enable colourblindness simulation. */
 #define COLOURBLIND_TYPE_DEFAULT                                               \
@@ -142,8 +147,10 @@ typedef struct PlayerConf_s {
    double engine_vol; /**< Sound level for engines (relative). */
 
    /* FPS. */
-   int fps_show; /**< Whether or not FPS should be shown */
-   int fps_max;  /**< Maximum FPS to limit to. */
+   int   fps_show;     /**< Whether or not FPS should be shown */
+   int   fps_max;      /**< Maximum FPS to limit to. */
+   int   metrics_show; /**< Whether or not metrics should be shown. */
+   char *metrics_csv;  /**< File to stream metrics to every frame. */
 
    /* Pause. */
    int pause_show; /**< Whether pause status should be shown. */
@@ -192,6 +199,8 @@ typedef struct PlayerConf_s {
                                    autonav. */
    double autonav_reset_shield; /**< Shield condition for resetting autonav
                                    speed. */
+   double ai_budget;            /**< AI control budget per frame in ms. */
+   double sim_lod_range;        /**< Distance for reduced rate simulation. */
    int   devmode;               /**< Developer mode. */
    int   devautosave;           /**< Developer mode autosave. */
    int   lua_enet;              /**< Enable the lua-enet library. */
@@ -471,9 +471,15 @@ static int cli_initLua( void )
    lua_settop( naevL, 0 );
 
    if ( conf.lua_repl ) {
+      /* Plain luaL_loadbuffer, the console stays out of the bytecode cache. */
       char *buf = ndata_read( "rep.lua", &blen );
-      status    = nlua_dobufenv( cli_env, buf, blen, "@rep.lua" );
+      status    = luaL_loadbuffer( naevL, buf, blen, "@rep.lua" );
       free( buf );
+      if ( status == 0 ) {
+         nlua_pushenv( naevL, cli_env );
+         lua_setfenv( naevL, -2 );
+         status = nlua_pcall( cli_env, 0, LUA_MULTRET );
+      }
       if ( status ) {
          WARN( _( "Lua console '%s' Lua error:\n%s" ), "rep.lua",
                lua_tostring( naevL, -1 ) );
@@ -34,126 +34,419 @@ policies, either expressed or implied, of the freetype-gl project.
  * @file distance_field.c
  *
  * @brief Code for generating our distance fields (\see font.c).
- * Based on the corresponding file in https://github.com/rougier/freetype-gl
+ *
+ * Originally based on the corresponding file in
+ * https://github.com/rougier/freetype-gl, which ran the anti-aliased edtaa3
+ * transform by Stefan Gustavson in double precision. This uses an exact
+ * linear-time transform in single precision instead (Felzenszwalb and
+ * Huttenlocher, "Distance Transforms of Sampled Functions"), with the
+ * sub-pixel edge estimate of edtaa3 for the high quality mode.
  */
 
 /** @cond */
-#include <float.h>
 #include <math.h>
 #include <stdlib.h>
 #include <string.h>
+
+#include "SDL_atomic.h"
+#include "SDL_thread.h"
 /** @endcond */
 
-#include "edtaa3func.h"
+#include "distance_field.h"
+
+#define SDF_INF 1e20f /**< Squared distance of pixels without a seed. */
+#define SDF_FAR                                                                \
+   1e6f /**< Distance when there are no seeds at all, like edtaa3. */
+#define SDF_SCRATCH_KEEP                                                       \
+   ( 512 * 512 ) /**< Largest scratch space kept around between calls. */
+
+/**
+ * @brief Scratch space for the transforms, one per thread.
+ */
+typedef struct SDFScratch_ {
+   unsigned int npix;  /**< Pixels the buffers can hold. */
+   unsigned int nline; /**< Length of the longest line the buffers can hold. */
+   float       *a;     /**< Normalized coverage. */
+   float       *grid;  /**< Squared distances being transformed. */
+   float       *grid2; /**< Second grid for the fast mode. */
+   int         *src;   /**< Row of the closest seed after the column pass. */
+   int         *near;  /**< Index of the closest seed. */
+   float       *f;     /**< Line being transformed. */
+   float       *z;     /**< Parabola boundaries. */
+   int         *v;     /**< Parabola locations. */
+} SDFScratch;
+static SDL_TLSID    sdf_scratch_tls  = 0; /**< Per thread scratch space. */
+static SDL_SpinLock sdf_scratch_lock = 0; /**< Protects creating the TLS. */
 
 /**
- * @brief Like the original: perform a Euclidean Distance Transform on the input
- * and normalize to [0,1], with a value of 0.5 on the boundary.
- * @param data width*height values, row-major order. Positive values are object
- * pixels. Negative/zero values are background pixels.
- * @param width Number of columns.
- * @param height Number of rows.
- * @param[out] vmax The underlying distance value corresponding to +1.0.
- * @return Allocated distance field, values ranging from 0 (farthest inside) to
- * 1 (greatest distance).
+ * @brief Frees the buffers of a scratch space.
  */
-double *make_distance_mapd( double *data, unsigned int width,
-                            unsigned int height, double *vmax )
+static void sdf_scratchClear( SDFScratch *s )
 {
-   unsigned int wh      = width * height;
-   short       *xdist   = (short *)malloc( wh * sizeof( short ) );
-   short       *ydist   = (short *)malloc( wh * sizeof( short ) );
-   double      *gx      = (double *)calloc( wh, sizeof( double ) );
-   double      *gy      = (double *)calloc( wh, sizeof( double ) );
-   double      *outside = (double *)calloc( wh, sizeof( double ) );
-   double      *inside  = (double *)calloc( wh, sizeof( double ) );
-
-   // Compute outside = edtaa3(bitmap); % Transform background (0's)
-   computegradient( data, width, height, gx, gy );
-   edtaa3( data, gx, gy, width, height, xdist, ydist, outside );
-   for ( unsigned int i = 0; i < wh; i++ )
-      if ( outside[i] < 0.0 )
-         outside[i] = 0.0;
+   free( s->a );
+   free( s->grid );
+   free( s->grid2 );
+   free( s->src );
+   free( s->near );
+   free( s->f );
+   free( s->z );
+   free( s->v );
+   memset( s, 0, sizeof( SDFScratch ) );
+}
 
-   // Compute inside = edtaa3(1-bitmap); % Transform foreground (1's)
-   memset( gx, 0, sizeof( double ) * width * height );
-   memset( gy, 0, sizeof( double ) * width * height );
-   for ( unsigned int i = 0; i < wh; i++ )
-      data[i] = 1. - data[i];
-   computegradient( data, width, height, gx, gy );
-   edtaa3( data, gx, gy, width, height, xdist, ydist, inside );
-   for ( unsigned int i = 0; i < wh; i++ )
-      if ( inside[i] < 0. )
-         inside[i] = 0.;
+/**
+ * @brief Frees the scratch space of a thread, called by SDL when it exits.
+ */
+static void sdf_scratchFree( void *data )
+{
+   sdf_scratchClear( data );
+   free( data );
+}
 
-   // distmap = outside - inside; % Bipolar distance field
-   *vmax = 0.;
-   for ( unsigned int i = 0; i < wh; i++ ) {
-      outside[i] -= inside[i];
-      if ( *vmax < fabs( outside[i] ) )
-         *vmax = fabs( outside[i] );
+/**
+ * @brief Makes sure the scratch space of the current thread is big enough.
+ */
+static SDFScratch *sdf_scratchGet( unsigned int width, unsigned int height )
+{
+   SDFScratch  *s;
+   unsigned int npix  = width * height;
+   unsigned int nline = ( width > height ) ? width : height;
+
+   /* Thread local storage, freed by SDL when the thread exits. */
+   SDL_AtomicLock( &sdf_scratch_lock );
+   if ( sdf_scratch_tls == 0 )
+      sdf_scratch_tls = SDL_TLSCreate();
+   SDL_AtomicUnlock( &sdf_scratch_lock );
+   s = SDL_TLSGet( sdf_scratch_tls );
+   if ( s == NULL ) {
+      s = calloc( 1, sizeof( SDFScratch ) );
+      SDL_TLSSet( sdf_scratch_tls, s, sdf_scratchFree );
    }
 
-   for ( unsigned int i = 0; i < wh; i++ ) {
-      double v = outside[i];
-      if ( v < -*vmax )
-         outside[i] = -*vmax;
-      else if ( v > +*vmax )
-         outside[i] = +*vmax;
-      data[i] = ( outside[i] + *vmax ) / ( 2. * *vmax );
+   if ( npix > s->npix ) {
+      free( s->a );
+      free( s->grid );
+      free( s->grid2 );
+      free( s->src );
+      free( s->near );
+      s->a     = malloc( npix * sizeof( float ) );
+      s->grid  = malloc( npix * sizeof( float ) );
+      s->grid2 = malloc( npix * sizeof( float ) );
+      s->src   = malloc( npix * sizeof( int ) );
+      s->near  = malloc( npix * sizeof( int ) );
+      s->npix  = npix;
+   }
+   if ( nline > s->nline ) {
+      free( s->f );
+      free( s->z );
+      free( s->v );
+      s->f     = malloc( nline * sizeof( float ) );
+      s->z     = malloc( ( nline + 1 ) * sizeof( float ) );
+      s->v     = malloc( nline * sizeof( int ) );
+      s->nline = nline;
+   }
+   return s;
+}
+
+/**
+ * @brief Transforms a single line of squared distances.
+ *
+ *    @param s Scratch space.
+ *    @param grid Grid to transform in place.
+ *    @param offset Index of the first element of the line.
+ *    @param stride Distance between elements of the line.
+ *    @param n Number of elements in the line.
+ *    @param[out] idx If not NULL, gets the position in the line of the closest
+ * element.
+ */
+static void sdf_edt1d( SDFScratch *s, float *grid, int offset, int stride,
+                       int n, int *idx )
+{
+   float *f = s->f;
+   float *z = s->z;
+   int   *v = s->v;
+   int    k = 0;
+
+   for ( int q = 0; q < n; q++ )
+      f[q] = grid[offset + q * stride];
+
+   /* Compute the lower envelope of the parabolas. */
+   v[0] = 0;
+   z[0] = -SDF_INF;
+   z[1] = SDF_INF;
+   for ( int q = 1; q < n; q++ ) {
+      float fq = f[q] + (float)q * (float)q;
+      float sv;
+      do {
+         int r = v[k];
+         sv    = ( fq - f[r] - (float)r * (float)r ) / (float)( 2 * ( q - r ) );
+      } while ( ( sv <= z[k] ) && ( --k > -1 ) );
+      k++;
+      v[k]     = q;
+      z[k]     = sv;
+      z[k + 1] = SDF_INF;
+   }
+
+   /* Sample it. */
+   k = 0;
+   for ( int q = 0; q < n; q++ ) {
+      int   r;
+      float qr;
+      while ( z[k + 1] < (float)q )
+         k++;
+      r                          = v[k];
+      qr                         = (float)( q - r );
+      grid[offset + q * stride] = f[r] + qr * qr;
+      if ( idx != NULL )
+         idx[offset + q * stride] = r;
+   }
+}
+
+/**
+ * @brief Transforms a grid of squared distances with separable passes.
+ *
+ *    @param s Scratch space.
+ *    @param grid Grid to transform in place.
+ *    @param width Number of columns.
+ *    @param height Number of rows.
+ *    @param near If not NULL, gets the index of the closest seed of each
+ * pixel.
+ */
+static void sdf_edt( SDFScratch *s, float *grid, int width, int height,
+                     int *near )
+{
+   for ( int x = 0; x < width; x++ )
+      sdf_edt1d( s, grid, x, width, height, ( near != NULL ) ? s->src : NULL );
+   for ( int y = 0; y < height; y++ )
+      sdf_edt1d( s, grid, y * width, 1, width, near );
+
+   /* Turn the column positions into seed indices. */
+   if ( near != NULL ) {
+      for ( int y = 0; y < height; y++ ) {
+         int *row = &near[y * width];
+         for ( int x = 0; x < width; x++ ) {
+            int sx = row[x];
+            row[x] = s->src[y * width + sx] * width + sx;
+         }
+      }
+   }
+}
+
+/**
+ * @brief Estimates the distance from the centre of an edge pixel to the edge.
+ *
+ * From edtaa3 by Stefan Gustavson, assumes the edge is a straight line
+ * with normal (gx,gy) that cuts the pixel to give it coverage a.
+ */
+static float sdf_edgedf( float gx, float gy, float a )
+{
+   float glength, a1;
+
+   /* Either one or both are zero, the linear approximation is then correct or
+    * a fair guess. */
+   if ( ( gx == 0.f ) || ( gy == 0.f ) )
+      return 0.5f - a;
+
+   glength = sqrtf( gx * gx + gy * gy );
+   gx      = fabsf( gx / glength );
+   gy      = fabsf( gy / glength );
+   /* Symmetric wrt sign and transposition, so move to the first octant. */
+   if ( gx < gy ) {
+      float temp = gx;
+      gx         = gy;
+      gy         = temp;
+   }
+   a1 = 0.5f * gy / gx;
+   if ( a < a1 )
+      return 0.5f * ( gx + gy ) - sqrtf( 2.f * gx * gy * a );
+   else if ( a < ( 1.f - a1 ) )
+      return ( 0.5f - a ) * gx;
+   return -0.5f * ( gx + gy ) + sqrtf( 2.f * gx * gy * ( 1.f - a ) );
+}
+
+/**
+ * @brief Gets the gradient at an edge pixel, zero elsewhere and at the image
+ * border like edtaa3.
+ */
+static void sdf_gradient( const float *a, int width, int height, int k,
+                          float *gx, float *gy )
+{
+   const float sqrt2 = 1.4142136f;
+   int         x     = k % width;
+   int         y     = k / width;
+
+   *gx = 0.f;
+   *gy = 0.f;
+   if ( ( x < 1 ) || ( y < 1 ) || ( x >= width - 1 ) || ( y >= height - 1 ) ||
+        ( a[k] <= 0.f ) || ( a[k] >= 1.f ) )
+      return;
+
+   *gx = -a[k - width - 1] - sqrt2 * a[k - 1] - a[k + width - 1] +
+         a[k - width + 1] + sqrt2 * a[k + 1] + a[k + width + 1];
+   *gy = -a[k - width - 1] - sqrt2 * a[k - width] - a[k - width + 1] +
+         a[k + width - 1] + sqrt2 * a[k + width] + a[k + width + 1];
+}
+
+/**
+ * @brief Gets the anti-aliased distance from a pixel to the edge at a seed.
+ */
+static float sdf_seeddist( const SDFScratch *s, int width, int height,
+                           int inside, int x, int y, int n )
+{
+   float as = inside ? 1.f - s->a[n] : s->a[n];
+   float dx, dy;
+
+   /* Use the local gradient at the edges. */
+   if ( n == y * width + x ) {
+      float gx, gy;
+      sdf_gradient( s->a, width, height, n, &gx, &gy );
+      return sdf_edgedf( gx, gy, as );
    }
 
-   free( xdist );
-   free( ydist );
-   free( gx );
-   free( gy );
-   free( outside );
-   free( inside );
-   return data;
+   /* Otherwise use the direction to the edge. */
+   dx = (float)( x - n % width );
+   dy = (float)( y - n / width );
+   return sqrtf( dx * dx + dy * dy ) + sdf_edgedf( dx, dy, as );
+}
+
+/**
+ * @brief Turns the closest seeds into anti-aliased distances, like edtaa3.
+ *
+ * The closest seed by whole pixels is not always the closest edge once the
+ * sub-pixel estimate is added, so the seeds of the neighbours are also tried
+ * like edtaa3 does while propagating.
+ *
+ *    @param s Scratch space with the coverage and the transformed grid.
+ *    @param width Number of columns.
+ *    @param height Number of rows.
+ *    @param inside Whether the seeds are the background instead of the object.
+ *    @param[out] dist Where to write the distances, clamped to be positive.
+ */
+static void sdf_aadist( const SDFScratch *s, int width, int height,
+                        int inside, float *dist )
+{
+   for ( int y = 0; y < height; y++ ) {
+      for ( int x = 0; x < width; x++ ) {
+         int   k = y * width + x;
+         float d;
+
+         /* No seeds anywhere. */
+         if ( s->grid[k] >= 0.5f * SDF_INF ) {
+            dist[k] = SDF_FAR;
+            continue;
+         }
+
+         d = sdf_seeddist( s, width, height, inside, x, y, s->near[k] );
+         if ( d <= 0.f ) {
+            dist[k] = 0.f;
+            continue;
+         }
+         for ( int v = -1; v <= 1; v++ ) {
+            for ( int u = -1; u <= 1; u++ ) {
+               int   nx = x + u, ny = y + v, n;
+               float dn;
+               if ( ( nx < 0 ) || ( ny < 0 ) || ( nx >= width ) ||
+                    ( ny >= height ) )
+                  continue;
+               n = s->near[ny * width + nx];
+               if ( n == s->near[k] )
+                  continue;
+               dn = sdf_seeddist( s, width, height, inside, x, y, n );
+               d  = ( dn < d ) ? dn : d;
+            }
+         }
+         dist[k] = ( d > 0.f ) ? d : 0.f;
+      }
+   }
 }
 
 /**
  * @brief Perform a Euclidean Distance Transform on the input and normalize to
  * [0,1], with a value of 0.5 on the boundary.
- * @param img Pixel values, row-major order.
- * @param width Number of columns.
- * @param height Number of rows.
- * @param[out] vmax The underlying distance value corresponding to +1.0.
- * @return Allocated distance field, values ranging from 0 (innermost) to 1
- * (outermost). The reason for the inversion (relative to make_distance_mapd and
- * the "signed distance" concept) is so that these can be pasted together in a
- * texture atlas with a buffer of 0.0 values representing "completely outside".
+ *
+ * The fast mode places anti-aliased edges only based on their coverage,
+ * while the high quality mode also uses the local gradient and the direction
+ * to the edge like edtaa3, which the output matches closely.
+ *
+ *    @param img Pixel values, row-major order.
+ *    @param width Number of columns.
+ *    @param height Number of rows.
+ *    @param quality Quality of the edge estimation.
+ *    @param[out] vmax The underlying distance value corresponding to +1.0.
+ *    @return Allocated distance field, values ranging from 0 (outermost) to 1
+ * (innermost). The reason for the inversion (relative to the "signed
+ * distance" concept) is so that these can be pasted together in a texture
+ * atlas with a buffer of 0.0 values representing "completely outside".
  */
-float *make_distance_mapbf( unsigned char *img, unsigned int width,
-                            unsigned int height, double *vmax )
+float *make_distance_mapbf( const unsigned char *img, unsigned int width,
+                            unsigned int height, SDFQuality quality,
+                            double *vmax )
 {
-   unsigned int wh   = width * height;
-   double      *data = (double *)calloc( wh, sizeof( double ) );
-   float       *out  = (float *)malloc( wh * sizeof( float ) );
-
-   // find minimum and maximum values
-   double img_min = DBL_MAX;
-   double img_max = DBL_MIN;
+   unsigned int wh  = width * height;
+   SDFScratch  *s   = sdf_scratchGet( width, height );
+   float       *out = malloc( wh * sizeof( float ) );
+   float       *a   = s->a;
+   float        img_min, img_max, scale, m;
 
+   /* Find minimum and maximum values. */
+   img_min = 255.f;
+   img_max = 0.f;
    for ( unsigned int i = 0; i < wh; i++ ) {
-      double v = img[i];
-      if ( v > img_max )
-         img_max = v;
-      if ( v < img_min )
-         img_min = v;
+      float v = img[i];
+      img_max = ( v > img_max ) ? v : img_max;
+      img_min = ( v < img_min ) ? v : img_min;
    }
 
-   // Map values from 0 - 255 to 0.0 - 1.0
+   /* Map values from 0 - 255 to 0.0 - 1.0. */
+   scale = ( img_max > 0.f ) ? 1.f / img_max : 0.f;
    for ( unsigned int i = 0; i < wh; i++ )
-      data[i] = ( img[i] - img_min ) / img_max;
+      a[i] = ( (float)img[i] - img_min ) * scale;
+
+   if ( quality == SDF_QUALITY_FAST ) {
+      float *outer = s->grid;
+      float *inner = s->grid2;
+      for ( unsigned int i = 0; i < wh; i++ ) {
+         float d  = 0.5f - a[i];
+         outer[i] = ( a[i] <= 0.f ) ? SDF_INF : ( d > 0.f ) ? d * d : 0.f;
+         inner[i] = ( a[i] >= 1.f ) ? SDF_INF : ( d < 0.f ) ? d * d : 0.f;
+      }
+      sdf_edt( s, outer, width, height, NULL );
+      sdf_edt( s, inner, width, height, NULL );
+      for ( unsigned int i = 0; i < wh; i++ )
+         out[i] = sqrtf( outer[i] ) - sqrtf( inner[i] );
+   } else {
+      float *inside = s->grid2;
+
+      /* Distance from the object. */
+      for ( unsigned int i = 0; i < wh; i++ )
+         s->grid[i] = ( a[i] > 0.f ) ? 0.f : SDF_INF;
+      sdf_edt( s, s->grid, width, height, s->near );
+      sdf_aadist( s, width, height, 0, out );
 
-   data = make_distance_mapd( data, width, height, vmax );
+      /* Distance from the background. */
+      for ( unsigned int i = 0; i < wh; i++ )
+         s->grid[i] = ( a[i] < 1.f ) ? 0.f : SDF_INF;
+      sdf_edt( s, s->grid, width, height, s->near );
+      sdf_aadist( s, width, height, 1, inside );
 
-   // lower to float
+      for ( unsigned int i = 0; i < wh; i++ )
+         out[i] -= inside[i];
+   }
+
+   /* Normalize the bipolar distance field. */
+   m = 0.f;
+   for ( unsigned int i = 0; i < wh; i++ ) {
+      float v = fabsf( out[i] );
+      m       = ( v > m ) ? v : m;
+   }
+   scale = ( m > 0.f ) ? 0.5f / m : 0.f;
    for ( unsigned int i = 0; i < wh; i++ )
-      out[i] = (float)( 1 - data[i] );
+      out[i] = 0.5f - out[i] * scale;
+   *vmax = m;
 
-   free( data );
+   /* Don't hog memory after large images. */
+   if ( s->npix > SDF_SCRATCH_KEEP )
+      sdf_scratchClear( s );
 
    return out;
 }
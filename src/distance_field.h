@@ -1,7 +1,13 @@
 #pragma once
 
-double *make_distance_mapd( double *data, unsigned int width,
-                            unsigned int height, double *vmax );
+/**
+ * @brief Quality of the distance field edges.
+ */
+typedef enum SDFQuality_ {
+   SDF_QUALITY_FAST, /**< Edges from the coverage alone. */
+   SDF_QUALITY_HIGH, /**< Edges from the gradient too, like edtaa3. */
+} SDFQuality;
 
-float *make_distance_mapbf( unsigned char *img, unsigned int width,
-                            unsigned int height, double *vmax );
+float *make_distance_mapbf( const unsigned char *img, unsigned int width,
+                            unsigned int height, SDFQuality quality,
+                            double *vmax );
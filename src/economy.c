@@ -9,16 +9,26 @@
  * Economy is handled with Nodal Analysis.  Systems are modelled as nodes,
  *  jump routes are resistances and production is modelled as node intensity.
  *  This is then solved with linear algebra after each time increment.
+ *
+ * The admittance matrix is symmetric positive definite, so it is Cholesky
+ *  factorized with CHOLMOD and the factorization is kept around until the
+ *  jumps change. All the commodities are then solved together on a worker
+ *  thread, and the prices are picked up on the next update.
+ *
+ * The solution is used as a per system modifier on top of the sinusoidal
+ *  price model of each spob.
  */
 /** @cond */
 #include <stdint.h>
 #include <stdio.h>
 
-#if HAVE_SUITESPARSE_CS_H
-#include <suitesparse/cs.h>
-#else /* HAVE_SUITESPARSE_CS_H */
-#include <cs.h>
-#endif /* HAVE_SUITESPARSE_CS_H */
+#if HAVE_SUITESPARSE_CHOLMOD_H
+#include <suitesparse/cholmod.h>
+#else /* HAVE_SUITESPARSE_CHOLMOD_H */
+#include <cholmod.h>
+#endif /* HAVE_SUITESPARSE_CHOLMOD_H */
+
+#include "SDL_mutex.h"
 
 #include "naev.h"
 /** @endcond */
@@ -36,6 +46,7 @@
 #include "rng.h"
 #include "space.h"
 #include "spfx.h"
+#include "threadpool.h"
 
 /*
  * Economy Nodal Analysis parameters.
@@ -46,6 +57,21 @@
 #define ECON_PROD_MODIFIER                                                     \
    500000. /**< Production modifier, divide production by this amount. */
 #define ECON_PROD_VAR 0.01 /**< Defines the variability of production. */
+#define ECON_PRICE_MIN 0.5 /**< Lowest price modifier from the solution. */
+#define ECON_PRICE_MAX 2.  /**< Highest price modifier from the solution. */
+
+/**
+ * @brief Work for the economy solver, built on the main thread.
+ */
+typedef struct EconJob_ {
+   int     nsys;  /**< Number of systems. */
+   int     ncomm; /**< Number of commodities. */
+   int    *G_i; /**< Array (array.h): Rows of the lower triangle of G, or NULL
+                   if it didn't change. */
+   int    *G_j; /**< Array (array.h): Columns of the lower triangle of G. */
+   double *G_x; /**< Array (array.h): Values of the lower triangle of G. */
+   double *I; /**< Intensities, one column of nsys per commodity. */
+} EconJob;
 
 /* systems stack. */
 extern StarSystem *systems_stack; /**< Star system stack. */
@@ -58,16 +84,51 @@ extern Commodity *commodity_stack;
  */
 static int econ_initialized = 0; /**< Is economy system initialized? */
 static int econ_queued      = 0; /**< Whether there are any queued updates. */
-static cs *econ_G           = NULL; /**< Admittance matrix. */
 int       *econ_comm        = NULL; /**< Commodities to calculate. */
+static double *econ_prod =
+   NULL; /**< Array (array.h): Production factor of each system. */
+
+/*
+ * Solver, the factorization is only touched by the worker.
+ */
+static cholmod_common  econ_C;           /**< CHOLMOD parameter set. */
+static cholmod_factor *econ_fact = NULL; /**< Factorization of G. */
+static int             econ_fact_nsys = 0; /**< Size of the factorization. */
+static int    *econ_fact_i = NULL; /**< Array (array.h): Factorized G rows. */
+static int    *econ_fact_j = NULL; /**< Array (array.h): Factorized G cols. */
+static double *econ_fact_x = NULL; /**< Array (array.h): Factorized G vals. */
+static cholmod_dense *econ_X = NULL; /**< Solution workspace. */
+static cholmod_dense *econ_Y = NULL; /**< Solve workspace. */
+static cholmod_dense *econ_E = NULL; /**< Solve workspace. */
+
+/*
+ * Worker state, guarded by econ_lock.
+ */
+static SDL_mutex *econ_lock = NULL; /**< Guards the worker state. */
+static SDL_cond  *econ_cond = NULL; /**< Signalled when the worker stops. */
+static EconJob   *econ_pending = NULL; /**< Job waiting to be solved. */
+static int        econ_working = 0;    /**< Whether the worker is running. */
+static int        econ_quit    = 0;    /**< Whether the worker should stop. */
+static double    *econ_prices  = NULL; /**< Solved prices not applied yet. */
+static int econ_prices_nsys  = 0; /**< Number of systems in econ_prices. */
+static int econ_prices_ncomm = 0; /**< Number of commodities in econ_prices. */
 
 /*
  * Prototypes.
  */
 /* Economy. */
-// static double econ_calcJumpR( StarSystem *A, StarSystem *B );
-// static double econ_calcSysI( unsigned int dt, StarSystem *sys, int price );
-// static int econ_createGMatrix (void);
+static int    econ_hasJump( const StarSystem *sys, const StarSystem *target );
+static double econ_calcJumpR( const StarSystem *A, const StarSystem *B );
+static void   econ_calcSysI( ntime_t dt, const StarSystem *sys, double *I );
+static void   econ_createGMatrix( EconJob *job );
+static void   econ_freeJob( EconJob *job );
+static int    econ_factorize( EconJob *job );
+static void   econ_solve( EconJob *job );
+static int    econ_thread( void *data );
+static void   econ_submit( EconJob *job );
+static void   econ_wait( void );
+static void   econ_applyPrices( void );
+static int    econ_update( ntime_t dt, int matrix );
 
 /*
  * Externed prototypes.
@@ -102,8 +163,7 @@ credits_t economy_getPrice( const Commodity *com, const StarSystem *sys,
 credits_t economy_getPriceAtTime( const Commodity *com, const StarSystem *sys,
                                   const Spob *p, ntime_t tme )
 {
-   (void)sys;
-   int             i, k;
+   int             i, k, ci;
    double          price;
    double          t;
    CommodityPrice *commPrice;
@@ -140,6 +200,7 @@ credits_t economy_getPriceAtTime( const Commodity *com, const StarSystem *sys,
       WARN( _( "Price for commodity '%s' not known." ), com->name );
       return 0;
    }
+   ci = i;
 
    /* and get the index on this spob */
    for ( i = 0; i < array_size( p->commodities ); i++ ) {
@@ -153,13 +214,14 @@ credits_t economy_getPriceAtTime( const Commodity *com, const StarSystem *sys,
    }
    commPrice = &p->commodityPrice[i];
    /* Calculate price. */
-   /* price  = (double) com->price; */
-   /* price *= sys->prices[i]; */
    price =
       ( commPrice->price +
         commPrice->sysVariation * sin( 2. * M_PI * t / commPrice->sysPeriod ) +
         commPrice->spobVariation *
            sin( 2. * M_PI * t / commPrice->spobPeriod ) );
+   /* Modify by the nodal analysis of the system. */
+   if ( ( sys != NULL ) && ( sys->prices != NULL ) )
+      price *= sys->prices[ci];
    return (credits_t)( price + 0.5 ); /* +0.5 to round */
 }
 
@@ -319,7 +381,22 @@ int economy_getAveragePrice( const Commodity *com, credits_t *mean,
    return 0;
 }
 
-#if 0
+/**
+ * @brief Checks whether a system has a jump to another, without the warning
+ * of jump_getTarget since one-way jumps are expected here.
+ *
+ *    @param sys System to look in.
+ *    @param target Target system the jump leads to.
+ *    @return 1 if there is such a jump.
+ */
+static int econ_hasJump( const StarSystem *sys, const StarSystem *target )
+{
+   for ( int i = 0; i < array_size( sys->jumps ); i++ )
+      if ( sys->jumps[i].target == target )
+         return 1;
+   return 0;
+}
+
 /**
  * @brief Calculates the resistance between two star systems.
  *
@@ -327,7 +404,7 @@ int economy_getAveragePrice( const Commodity *com, credits_t *mean,
  *    @param B Star system to calculate the resistance between.
  *    @return Resistance between A and B.
  */
-static double econ_calcJumpR( StarSystem *A, StarSystem *B )
+static double econ_calcJumpR( const StarSystem *A, const StarSystem *B )
 {
    double R;
 
@@ -335,14 +412,16 @@ static double econ_calcJumpR( StarSystem *A, StarSystem *B )
    R = ECON_BASE_RES;
 
    /* Modify based on system conditions. */
-   R += (A->nebu_density + B->nebu_density) / 1000.; /* Density shouldn't affect much. */
-   R += (A->nebu_volatility + B->nebu_volatility) / 100.; /* Volatility should. */
+   R += ( A->nebu_density + B->nebu_density ) /
+        1000.; /* Density shouldn't affect much. */
+   R += ( A->nebu_volatility + B->nebu_volatility ) /
+        100.; /* Volatility should. */
 
    /* Modify based on global faction. */
-   if ((A->faction != -1) && (B->faction != -1)) {
-      if (areEnemies(A->faction, B->faction))
+   if ( ( A->faction != -1 ) && ( B->faction != -1 ) ) {
+      if ( areEnemies( A->faction, B->faction ) )
          R += ECON_FACTION_MOD * ECON_BASE_RES;
-      else if (areAllies(A->faction, B->faction))
+      else if ( areAllies( A->faction, B->faction ) )
          R -= ECON_FACTION_MOD * ECON_BASE_RES;
    }
 
@@ -352,105 +431,311 @@ static double econ_calcJumpR( StarSystem *A, StarSystem *B )
 }
 
 /**
- * @brief Calculates the intensity in a system node.
+ * @brief Calculates the intensity in a system node for every commodity.
  *
- * @todo Make it time/item dependent.
+ *    @param dt Deltatick in NTIME.
+ *    @param sys System to calculate intensities of.
+ *    @param[out] I Where to write the intensity of each commodity, with a
+ * stride of the number of systems.
  */
-static double econ_calcSysI( unsigned int dt, StarSystem *sys, int price )
+static void econ_calcSysI( ntime_t dt, const StarSystem *sys, double *I )
 {
-   int i;
-   double I;
-   double prodfactor, p;
-   double ddt;
-   Spob *spob;
+   double  ddt, prodfactor;
+   double *prod = &econ_prod[sys->id];
+   int     nsys = array_size( systems_stack );
+
+   ddt = ntime_convertSeconds( dt ) / NT_PERIOD_SECONDS;
+
+   /* We base off the current production. */
+   prodfactor = *prod;
+   /* Add a variability factor based on the Gaussian distribution. */
+   prodfactor += ECON_PROD_VAR * RNG_2SIGMA() * ddt;
+   /* Add a tendency to return to the base production. */
+   prodfactor -= ECON_PROD_VAR * ( *prod - 1. ) * ddt;
+   /* Save for next iteration. */
+   *prod = prodfactor;
+
+   for ( int j = 0; j < array_size( econ_comm ); j++ ) {
+      const Commodity *com = &commodity_stack[econ_comm[j]];
+      double           p   = 0.;
+      for ( int k = 0; k < array_size( sys->spobs ); k++ ) {
+         const Spob *spob = sys->spobs[k];
+         if ( !spob_hasService( spob, SPOB_SERVICE_INHABITED ) )
+            continue;
+         for ( int l = 0; l < array_size( spob->commodities ); l++ ) {
+            if ( spob->commodities[l] != com )
+               continue;
+            /* We base off the sqrt of the population otherwise it changes too
+             * fast. */
+            p += sqrt( spob->population );
+            break;
+         }
+      }
+      /* The intensity is basically the modified production. */
+      I[j * nsys] = prodfactor * p / ECON_PROD_MODIFIER;
+   }
+}
 
-   ddt = (double)(dt / NTIME_UNIT_LENGTH);
+/**
+ * @brief Frees an economy job.
+ */
+static void econ_freeJob( EconJob *job )
+{
+   if ( job == NULL )
+      return;
+   array_free( job->G_i );
+   array_free( job->G_j );
+   array_free( job->G_x );
+   free( job->I );
+   free( job );
+}
 
-   /* Calculate production level. */
-   p = 0.;
-   for (i=0; i<sys->nspobs; i++) {
-      spob = sys->spobs[i];
-      if (spob_hasService(spob, SPOB_SERVICE_INHABITED)) {
-         /*
-          * Calculate production.
-          */
-         /* We base off the current production. */
-         prodfactor  = spob->cur_prodfactor;
-         /* Add a variability factor based on the Gaussian distribution. */
-         prodfactor += ECON_PROD_VAR * RNG_2SIGMA() * ddt;
-         /* Add a tendency to return to the spob's base production. */
-         prodfactor -= ECON_PROD_VAR *
-               (spob->cur_prodfactor - prodfactor)*ddt;
-         /* Save for next iteration. */
-         spob->cur_prodfactor = prodfactor;
-         /* We base off the sqrt of the population otherwise it changes too fast. */
-         p += prodfactor * sqrt(spob->population);
+/**
+ * @brief Creates the admittance matrix.
+ *
+ * Only the lower triangle is stored, as the matrix is symmetric positive
+ * definite and gets factorized with a Cholesky decomposition.
+ *
+ *    @param job Job to write the matrix to.
+ */
+static void econ_createGMatrix( EconJob *job )
+{
+   int     nsys = array_size( systems_stack );
+   double *diag = calloc( nsys, sizeof( double ) );
+
+   job->G_i = array_create( int );
+   job->G_j = array_create( int );
+   job->G_x = array_create( double );
+
+   /* Fill the off-diagonal. */
+   for ( int i = 0; i < nsys; i++ ) {
+      const StarSystem *sys = &systems_stack[i];
+      for ( int j = 0; j < array_size( sys->jumps ); j++ ) {
+         const StarSystem *target = sys->jumps[j].target;
+         double            R;
+         int               t = target->id;
+
+         /* Each connection only gets added once, even if both sides have the
+          * jump. */
+         if ( t == i )
+            continue;
+         if ( ( t < i ) && econ_hasJump( target, sys ) )
+            continue;
+
+         /* Get the resistances, must be inverted. */
+         R = 1. / econ_calcJumpR( sys, target );
+         diag[i] += R;
+         diag[t] += R;
+
+         /* Matrix is symmetrical and non-diagonal is negative. */
+         array_push_back( &job->G_i, MAX( i, t ) );
+         array_push_back( &job->G_j, MIN( i, t ) );
+         array_push_back( &job->G_x, -R );
       }
    }
 
-   /* The intensity is basically the modified production. */
-   I = p / ECON_PROD_MODIFIER;
+   /* Set the diagonal, we add a resistance for dampening. */
+   for ( int i = 0; i < nsys; i++ ) {
+      array_push_back( &job->G_i, i );
+      array_push_back( &job->G_j, i );
+      array_push_back( &job->G_x, diag[i] + 1. / ECON_SELF_RES );
+   }
 
-   return I;
+   free( diag );
 }
 
 /**
- * @brief Creates the admittance matrix.
+ * @brief Updates the factorization of the admittance matrix.
  *
+ * The symbolic analysis is only redone when the connectivity changes, and the
+ * numeric factorization only when the matrix changes at all.
+ *
+ *    @param job Job with the new admittance matrix.
  *    @return 0 on success.
  */
-static int econ_createGMatrix (void)
+static int econ_factorize( EconJob *job )
 {
-   int ret;
-   int i, j;
-   double R, Rsum;
-   cs *M;
-   StarSystem *sys;
-
-   /* Create the matrix. */
-   M = cs_spalloc( array_size(systems_stack), array_size(systems_stack), 1, 1, 1 );
-   if (M == NULL)
-      ERR(_("Unable to create CSparse Matrix."));
-
-   /* Fill the matrix. */
-   for (i=0; i < array_size(systems_stack); i++) {
-      sys   = &systems_stack[i];
-      Rsum = 0.;
-
-      /* Set some values. */
-      for (j=0; j < array_size(sys->jumps); j++) {
-
-         /* Get the resistances. */
-         R     = econ_calcJumpR( sys, sys->jumps[j].target );
-         R     = 1./R; /* Must be inverted. */
-         Rsum += R;
+   cholmod_triplet *T;
+   cholmod_sparse  *S;
+   int              n       = array_size( job->G_x );
+   int              pattern = 0;
+
+   /* See what changed. */
+   if ( ( econ_fact != NULL ) && ( econ_fact_nsys == job->nsys ) &&
+        ( array_size( econ_fact_i ) == n ) )
+      pattern =
+         ( memcmp( econ_fact_i, job->G_i, n * sizeof( int ) ) == 0 ) &&
+         ( memcmp( econ_fact_j, job->G_j, n * sizeof( int ) ) == 0 );
+   if ( pattern &&
+        ( memcmp( econ_fact_x, job->G_x, n * sizeof( double ) ) == 0 ) )
+      return 0;
 
-         /* Matrix is symmetrical and non-diagonal is negative. */
-         ret = cs_entry( M, i, sys->jumps[j].target->id, -R );
-         if (ret != 1)
-            WARN(_("Unable to enter CSparse Matrix Cell."));
-         ret = cs_entry( M, sys->jumps[j].target->id, i, -R );
-         if (ret != 1)
-            WARN(_("Unable to enter CSparse Matrix Cell."));
-      }
+   /* Assemble the matrix. */
+   T = cholmod_allocate_triplet( job->nsys, job->nsys, n, -1, CHOLMOD_REAL,
+                                 &econ_C );
+   memcpy( T->i, job->G_i, n * sizeof( int ) );
+   memcpy( T->j, job->G_j, n * sizeof( int ) );
+   memcpy( T->x, job->G_x, n * sizeof( double ) );
+   T->nnz = n;
+   S      = cholmod_triplet_to_sparse( T, 0, &econ_C );
+   cholmod_free_triplet( &T, &econ_C );
+
+   /* Connectivity changed, so redo the symbolic analysis. */
+   if ( !pattern ) {
+      cholmod_free_factor( &econ_fact, &econ_C );
+      econ_fact = cholmod_analyze( S, &econ_C );
+   }
+   cholmod_factorize( S, econ_fact, &econ_C );
+   cholmod_free_sparse( &S, &econ_C );
+   if ( econ_C.status != CHOLMOD_OK ) {
+      WARN( _( "Unable to factorize the Economy G Matrix." ) );
+      cholmod_free_factor( &econ_fact, &econ_C );
+      return -1;
+   }
 
-      /* Set the diagonal. */
-      Rsum += 1./ECON_SELF_RES; /* We add a resistance for dampening. */
-      cs_entry( M, i, i, Rsum );
+   /* Remember what we factorized. */
+   econ_fact_nsys = job->nsys;
+   array_free( econ_fact_i );
+   array_free( econ_fact_j );
+   array_free( econ_fact_x );
+   econ_fact_i = array_copy( int, job->G_i );
+   econ_fact_j = array_copy( int, job->G_j );
+   econ_fact_x = array_copy( double, job->G_x );
+   return 0;
+}
+
+/**
+ * @brief Solves an economy job and publishes the resulting prices.
+ *
+ * All the commodities are solved at once as a multiple right-hand side
+ * system.
+ */
+static void econ_solve( EconJob *job )
+{
+   cholmod_dense *B;
+   double        *prices;
+
+   if ( ( job->G_x != NULL ) && econ_factorize( job ) )
+      return;
+   if ( ( econ_fact == NULL ) || ( econ_fact_nsys != job->nsys ) ||
+        ( job->nsys == 0 ) || ( job->ncomm == 0 ) )
+      return;
+
+   /* Solve the system. */
+   B = cholmod_allocate_dense( job->nsys, job->ncomm, job->nsys, CHOLMOD_REAL,
+                               &econ_C );
+   memcpy( B->x, job->I, job->nsys * job->ncomm * sizeof( double ) );
+   if ( !cholmod_solve2( CHOLMOD_A, econ_fact, B, NULL, &econ_X, NULL, &econ_Y,
+                         &econ_E, &econ_C ) ) {
+      WARN( _( "Failed to solve the Economy System." ) );
+      cholmod_free_dense( &B, &econ_C );
+      return;
    }
+   cholmod_free_dense( &B, &econ_C );
+
+   /*
+    * I'm not sure I like the filtering of the results, but it would take
+    * much more work to get a good system working without the need of post
+    * filtering.
+    */
+   prices = malloc( job->nsys * job->ncomm * sizeof( double ) );
+   for ( int i = 0; i < job->nsys * job->ncomm; i++ )
+      prices[i] = CLAMP( ECON_PRICE_MIN, ECON_PRICE_MAX,
+                         1. + ( (double *)econ_X->x )[i] );
+
+   /* Publish, the main thread picks them up. */
+   SDL_mutexP( econ_lock );
+   free( econ_prices );
+   econ_prices       = prices;
+   econ_prices_nsys  = job->nsys;
+   econ_prices_ncomm = job->ncomm;
+   SDL_mutexV( econ_lock );
+}
 
-   /* Compress M matrix and put into G. */
-   cs_spfree( econ_G );
-   econ_G = cs_compress( M );
-   if (econ_G == NULL)
-      ERR(_("Unable to create economy G Matrix."));
+/**
+ * @brief Worker that solves pending economy jobs until there are none left.
+ */
+static int econ_thread( void *data )
+{
+   (void)data;
+   SDL_mutexP( econ_lock );
+   while ( !econ_quit && ( econ_pending != NULL ) ) {
+      EconJob *job = econ_pending;
+      econ_pending = NULL;
+      SDL_mutexV( econ_lock );
 
-   /* Clean up. */
-   cs_spfree(M);
+      econ_solve( job );
+      econ_freeJob( job );
 
+      SDL_mutexP( econ_lock );
+   }
+   econ_working = 0;
+   SDL_CondBroadcast( econ_cond );
+   SDL_mutexV( econ_lock );
    return 0;
 }
-#endif
+
+/**
+ * @brief Hands a job to the economy worker, replacing any job that has not
+ * been started yet.
+ */
+static void econ_submit( EconJob *job )
+{
+   SDL_mutexP( econ_lock );
+   if ( econ_pending != NULL ) {
+      /* Don't lose a matrix that hasn't been factorized yet. */
+      if ( job->G_x == NULL ) {
+         job->G_i          = econ_pending->G_i;
+         job->G_j          = econ_pending->G_j;
+         job->G_x          = econ_pending->G_x;
+         econ_pending->G_i = NULL;
+         econ_pending->G_j = NULL;
+         econ_pending->G_x = NULL;
+      }
+      econ_freeJob( econ_pending );
+   }
+   econ_pending = job;
+   if ( !econ_working ) {
+      econ_working = 1;
+      threadpool_newJob( econ_thread, NULL );
+   }
+   SDL_mutexV( econ_lock );
+}
+
+/**
+ * @brief Waits for the economy worker to be done.
+ */
+static void econ_wait( void )
+{
+   SDL_mutexP( econ_lock );
+   while ( econ_working )
+      SDL_CondWait( econ_cond, econ_lock );
+   SDL_mutexV( econ_lock );
+}
+
+/**
+ * @brief Copies the latest prices from the economy worker into the systems.
+ */
+static void econ_applyPrices( void )
+{
+   int nsys = array_size( systems_stack );
+   int ncom = array_size( econ_comm );
+
+   SDL_mutexP( econ_lock );
+   /* Results from before the universe changed size are stale. */
+   if ( ( econ_prices != NULL ) && ( econ_prices_nsys == nsys ) &&
+        ( econ_prices_ncomm == ncom ) ) {
+      for ( int i = 0; i < nsys; i++ ) {
+         if ( systems_stack[i].prices == NULL )
+            continue;
+         for ( int j = 0; j < ncom; j++ )
+            systems_stack[i].prices[j] = econ_prices[j * nsys + i];
+      }
+   }
+   free( econ_prices );
+   econ_prices = NULL;
+   SDL_mutexV( econ_lock );
+}
 
 /**
  * @brief Initializes the economy.
@@ -463,13 +748,26 @@ int economy_init( void )
    if ( econ_initialized )
       return 0;
 
-   /* Allocate price space. */
+   /* Allocate price space, prices are left alone until the first solve. */
    for ( int i = 0; i < array_size( systems_stack ); i++ ) {
       free( systems_stack[i].prices );
       systems_stack[i].prices =
-         calloc( array_size( econ_comm ), sizeof( double ) );
+         malloc( array_size( econ_comm ) * sizeof( double ) );
+      for ( int j = 0; j < array_size( econ_comm ); j++ )
+         systems_stack[i].prices[j] = 1.;
    }
 
+   /* Production starts out at the base level. */
+   array_free( econ_prod );
+   econ_prod = array_create( double );
+
+   /* Set up the solver. */
+   cholmod_start( &econ_C );
+   econ_lock    = SDL_CreateMutex();
+   econ_cond    = SDL_CreateCond();
+   econ_quit    = 0;
+   econ_working = 0;
+
    /* Mark economy as initialized. */
    econ_initialized = 1;
 
@@ -503,6 +801,9 @@ int economy_execQueued( void )
 /**
  * @brief Regenerates the economy matrix.  Should be used if the universe
  *  changes in any permanent way.
+ *
+ * The matrix is factorized and solved in the background, the prices get
+ * updated once the solution is available.
  */
 int economy_refresh( void )
 {
@@ -510,14 +811,9 @@ int economy_refresh( void )
    if ( econ_initialized == 0 )
       return 0;
 
-   /* Create the resistance matrix. */
-   // if (econ_createGMatrix())
-   //    return -1;
-
-   /* Initialize the prices. */
-   economy_update( 0 );
-
-   return 0;
+   /* Create the resistance matrix and initialize the prices. */
+   econ_queued = 0;
+   return econ_update( 0, 1 );
 }
 
 /**
@@ -527,75 +823,48 @@ int economy_refresh( void )
  */
 int economy_update( unsigned int dt )
 {
-   (void)dt;
-#if 0
-   int i, j;
-   double *X;
-   double scale, offset;
-   /*double min, max;*/
-
    /* Economy must be initialized. */
-   if (econ_initialized == 0)
+   if ( econ_initialized == 0 )
       return 0;
 
-   /* Create the vector to solve the system. */
-   X = malloc(sizeof(double)*array_size(systems_stack));
-   if (X == NULL) {
-      WARN(_("Out of Memory"));
-      return -1;
-   }
+   return econ_update( dt, 0 );
+}
 
-   /* Calculate the results for each price set. */
-   for (j=0; j<array_size(econ_comm); j++) {
-
-      /* First we must load the vector with intensities. */
-      for (i=0; i<array_size(systems_stack); i++)
-         X[i] = econ_calcSysI( dt, &systems_stack[i], j );
-
-      /* Solve the system. */
-      /** @TODO This should be improved to try to use better factorizations (LU/Cholesky)
-       * if possible or just outright try to use some other library that does fancy stuff
-       * like UMFPACK. Would be also interesting to see if it could be optimized so we
-       * store the factorization or update that instead of handling it individually. Another
-       * point of interest would be to split loops out to make the solving faster, however,
-       * this may be trickier to do (although it would surely let us use cholesky always if we
-       * enforce that condition). */
-      ret = cs_qrsol( 3, econ_G, X );
-      if (ret != 1)
-         WARN(_("Failed to solve the Economy System."));
-
-      /*
-       * Get the minimum and maximum to scale.
-       */
-      /*
-      min = +HUGE_VALF;
-      max = -HUGE_VALF;
-      for (i=0; i<array_size(systems_stack); i++) {
-         if (X[i] < min)
-            min = X[i];
-         if (X[i] > max)
-            max = X[i];
-      }
-      scale = 1. / (max - min);
-      offset = 0.5 - min * scale;
-      */
-
-      /*
-       * I'm not sure I like the filtering of the results, but it would take
-       * much more work to get a good system working without the need of post
-       * filtering.
-       */
-      scale    = 1.;
-      offset   = 1.;
-      for (i=0; i<array_size(systems_stack); i++)
-         systems_stack[i].prices[j] = X[i] * scale + offset;
+/**
+ * @brief Updates the economy, handing the work off to the worker.
+ *
+ *    @param dt Deltatick in NTIME.
+ *    @param matrix Whether or not the admittance matrix has to be recreated.
+ *    @return 0 on success.
+ */
+static int econ_update( ntime_t dt, int matrix )
+{
+   EconJob *job;
+   int      nsys = array_size( systems_stack );
+
+   /* Pick up whatever was solved since the last update. */
+   econ_applyPrices();
+
+   /* The universe may have grown since initialization. */
+   if ( array_size( econ_prod ) != nsys ) {
+      int n = array_size( econ_prod );
+      array_resize( &econ_prod, nsys );
+      for ( int i = n; i < nsys; i++ )
+         econ_prod[i] = 1.;
    }
 
-   /* Clean up. */
-   free(X);
+   job        = calloc( 1, sizeof( EconJob ) );
+   job->nsys  = nsys;
+   job->ncomm = array_size( econ_comm );
+   if ( matrix )
+      econ_createGMatrix( job );
 
-#endif
-   econ_queued = 0;
+   /* First we must load the vectors with intensities. */
+   job->I = malloc( MAX( 1, nsys * job->ncomm ) * sizeof( double ) );
+   for ( int i = 0; i < nsys; i++ )
+      econ_calcSysI( dt, &systems_stack[i], &job->I[i] );
+
+   econ_submit( job );
    return 0;
 }
 
@@ -608,15 +877,38 @@ void economy_destroy( void )
    if ( !econ_initialized )
       return;
 
+   /* Stop the worker, it bails out on the next job. */
+   SDL_mutexP( econ_lock );
+   econ_quit = 1;
+   econ_freeJob( econ_pending );
+   econ_pending = NULL;
+   SDL_mutexV( econ_lock );
+   econ_wait();
+
    /* Clean up the prices in the systems stack. */
    for ( int i = 0; i < array_size( systems_stack ); i++ ) {
       free( systems_stack[i].prices );
       systems_stack[i].prices = NULL;
    }
+   free( econ_prices );
+   econ_prices = NULL;
+   array_free( econ_prod );
+   econ_prod = NULL;
 
    /* Destroy the economy matrix. */
-   cs_spfree( econ_G );
-   econ_G = NULL;
+   cholmod_free_factor( &econ_fact, &econ_C );
+   cholmod_free_dense( &econ_X, &econ_C );
+   cholmod_free_dense( &econ_Y, &econ_C );
+   cholmod_free_dense( &econ_E, &econ_C );
+   array_free( econ_fact_i );
+   array_free( econ_fact_j );
+   array_free( econ_fact_x );
+   econ_fact_i = NULL;
+   econ_fact_j = NULL;
+   econ_fact_x = NULL;
+   cholmod_finish( &econ_C );
+   SDL_DestroyCond( econ_cond );
+   SDL_DestroyMutex( econ_lock );
 
    /* Economy is now deinitialized. */
    econ_initialized = 0;
@@ -974,7 +1266,7 @@ void economy_averageSeenPrices( const Spob *p )
          cp->updateTime = t;
          /* Calculate values for mean and std */
          cp->cnt++;
-         price = economy_getPrice( c, NULL, p );
+         price = spob_commodityPrice( p, c );
          cp->sum += price;
          cp->sum2 += price * price;
       }
@@ -992,7 +1284,7 @@ void economy_averageSeenPricesAtTime( const Spob *p, const ntime_t tupdate )
          credits_t price;
          cp->updateTime = t;
          cp->cnt++;
-         price = economy_getPriceAtTime( c, NULL, p, tupdate );
+         price = spob_commodityPriceAtTime( p, c, tupdate );
          cp->sum += price;
          cp->sum2 += price * price;
       }
@@ -521,8 +521,9 @@ static void equipment_renderColumn( double x, double y, double w, double h,
       toolkit_drawRect( x, y, w, h, &bc, NULL );
 
       if ( lst[i].outfit != NULL ) {
-         /* Draw bugger. */
-         gl_renderScale( lst[i].outfit->gfx_store, x, y, w, h, NULL );
+         /* Draw bugger, unless it is still streaming in. */
+         if ( !gl_texIsStreaming( lst[i].outfit->gfx_store ) )
+            gl_renderScale( lst[i].outfit->gfx_store, x, y, w, h, NULL );
       } else if ( ( o != NULL ) &&
                   ( lst[i].sslot->slot.type == o->slot.type ) ) {
          /* Render a thick frame with a yes/no colour, and geometric cue. */
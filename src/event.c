@@ -22,6 +22,7 @@
 #include "event.h"
 
 #include "array.h"
+#include "candidate.h"
 #include "cond.h"
 #include "conf.h"
 #include "hook.h"
@@ -39,8 +40,10 @@
 #include "npc.h"
 #include "nxml.h"
 #include "nxml_lua.h"
+#include "opengl_tex.h"
 #include "player.h"
 #include "rng.h"
+#include "threadpool.h"
 
 #define XML_EVENT_ID "Events" /**< XML document identifier */
 #define XML_EVENT_TAG "event" /**< XML event tag. */
@@ -58,11 +61,12 @@ typedef struct EventData_ {
    unsigned int flags;      /**< Bit flags. */
 
    /* For specific cases. */
-   char       *spob;       /**< Spob name. */
-   char       *system;     /**< System name. */
-   char       *chapter;    /**< Chapter name. */
-   int        *factions;   /**< Faction checks. */
-   pcre2_code *chapter_re; /**< Compiled regex chapter if applicable. */
+   char       *spob;          /**< Spob name. */
+   char       *system;        /**< System name. */
+   char       *chapter;       /**< Chapter name. */
+   int        *factions;      /**< Faction checks. */
+   pcre2_code *chapter_re;    /**< Compiled regex chapter if applicable. */
+   int         chapter_match; /**< Whether the current chapter matches. */
 
    EventTrigger_t trigger;    /**< What triggers the event. */
    char          *cond;       /**< Conditional Lua code to execute. */
@@ -74,10 +78,21 @@ typedef struct EventData_ {
    char **tags; /**< Tags. */
 } EventData;
 
+/**
+ * @brief For threaded loading of events.
+ */
+typedef struct EventThreadData_ {
+   char     *filename;
+   EventData ev;
+   int       ret;
+} EventThreadData;
+
 /*
  * Event data.
  */
-static EventData *event_data = NULL; /**< Allocated event data. */
+static EventData      *event_data    = NULL; /**< Allocated event data. */
+static CandidateIndex *event_index   = NULL; /**< Events by location. */
+static char           *event_chapter = NULL; /**< Chapter of the matches. */
 
 /*
  * Active events.
@@ -91,8 +106,13 @@ static Event_t     *event_active = NULL; /**< Active events. */
 static unsigned int event_genID( void );
 static int          event_cmp( const void *a, const void *b );
 static int          event_parseFile( const char *file, EventData *temp );
+static int          event_parseFileData( const char *file, EventData *temp );
+static void         event_parseFileLua( EventData *temp, const char *file );
+static int          event_parseThread( void *ptr );
 static int          event_parseXML( EventData *temp, const xmlNodePtr parent );
 static void         event_freeData( EventData *event );
+static void         events_buildIndex( void );
+static void         events_updateChapter( void );
 static int          event_create( int dataid, unsigned int *id );
 int                 events_saveActive( xmlTextWriterPtr writer );
 int                 events_loadActive( xmlNodePtr parent );
@@ -318,12 +338,31 @@ int event_alreadyRunning( int data )
  */
 void events_trigger( EventTrigger_t trigger )
 {
-   int created = 0;
-   for ( int i = 0; i < array_size( event_data ); i++ ) {
+   int         created    = 0;
+   int        *candidates = array_create( int );
+   const char *spob       = NULL;
+   int         faction    = -1;
+
+   /* Only look at the events that can trigger here. */
+   if ( trigger == EVENT_TRIGGER_ENTER )
+      faction = cur_system->faction;
+   else if ( ( trigger == EVENT_TRIGGER_LOAD ||
+               trigger == EVENT_TRIGGER_LAND ) &&
+             ( land_spob != NULL ) ) {
+      spob    = land_spob->name;
+      faction = land_spob->presence.faction;
+   }
+   candidate_query( event_index, &candidates, trigger, spob,
+                    ( cur_system != NULL ) ? cur_system->name : NULL,
+                    faction );
+   events_updateChapter();
+
+   for ( int n = 0; n < array_size( candidates ); n++ ) {
+      int        i  = candidates[n];
       EventData *ed = &event_data[i];
 
       if ( naev_isQuit() )
-         return;
+         break;
 
       /* Make sure trigger matches. */
       if ( ed->trigger != trigger )
@@ -375,25 +414,8 @@ void events_trigger( EventTrigger_t trigger )
       }
 
       /* If chapter, must match chapter regex. */
-      if ( ed->chapter_re != NULL ) {
-         pcre2_match_data *match_data =
-            pcre2_match_data_create_from_pattern( ed->chapter_re, NULL );
-         int rc =
-            pcre2_match( ed->chapter_re, (PCRE2_SPTR)player.chapter,
-                         strlen( player.chapter ), 0, 0, match_data, NULL );
-         pcre2_match_data_free( match_data );
-         if ( rc < 0 ) {
-            switch ( rc ) {
-            case PCRE2_ERROR_NOMATCH:
-               continue;
-            default:
-               WARN( _( "Matching error %d" ), rc );
-               break;
-            }
-            continue;
-         } else if ( rc == 0 )
-            continue;
-      }
+      if ( ( ed->chapter_re != NULL ) && !ed->chapter_match )
+         continue;
 
       /* Test conditional. */
       if ( ed->cond != NULL ) {
@@ -409,12 +431,81 @@ void events_trigger( EventTrigger_t trigger )
       event_create( i, NULL );
       created++;
    }
+   array_free( candidates );
 
    /* Run claims if necessary. */
    if ( created )
       claim_activateAll();
 }
 
+/**
+ * @brief Builds the index of events by location.
+ *
+ * Events are bucketed by the most specific of their spob, system or factions
+ * that events_trigger() would check for their trigger.
+ */
+static void events_buildIndex( void )
+{
+   candidate_free( event_index );
+   event_index = candidate_create();
+   for ( int i = 0; i < array_size( event_data ); i++ ) {
+      const EventData *ed = &event_data[i];
+      int              onspob;
+
+      onspob = ( ed->trigger == EVENT_TRIGGER_LAND ||
+                 ed->trigger == EVENT_TRIGGER_LOAD );
+      if ( onspob && ( ed->spob != NULL ) )
+         candidate_addName( event_index, ed->trigger, CANDIDATE_SPOB, ed->spob,
+                            i );
+      else if ( ed->system != NULL )
+         candidate_addName( event_index, ed->trigger, CANDIDATE_SYSTEM,
+                            ed->system, i );
+      else if ( ( ed->factions != NULL ) &&
+                ( onspob || ed->trigger == EVENT_TRIGGER_ENTER ) ) {
+         for ( int j = 0; j < array_size( ed->factions ); j++ )
+            candidate_addFaction( event_index, ed->trigger, ed->factions[j],
+                                  i );
+      } else
+         candidate_addAny( event_index, ed->trigger, i );
+   }
+   candidate_finalize( event_index );
+
+   /* Chapter matches have to be redone. */
+   free( event_chapter );
+   event_chapter = NULL;
+}
+
+/**
+ * @brief Matches the chapter regexes of all the events against the current
+ * chapter, only doing work when the chapter changed.
+ */
+static void events_updateChapter( void )
+{
+   if ( ( event_chapter != NULL ) &&
+        ( strcmp( event_chapter, player.chapter ) == 0 ) )
+      return;
+   free( event_chapter );
+   event_chapter = strdup( player.chapter );
+
+   for ( int i = 0; i < array_size( event_data ); i++ ) {
+      EventData        *ed = &event_data[i];
+      pcre2_match_data *match_data;
+      int               rc;
+
+      ed->chapter_match = 0;
+      if ( ed->chapter_re == NULL )
+         continue;
+
+      match_data = pcre2_match_data_create_from_pattern( ed->chapter_re, NULL );
+      rc = pcre2_match( ed->chapter_re, (PCRE2_SPTR)event_chapter,
+                        strlen( event_chapter ), 0, 0, match_data, NULL );
+      pcre2_match_data_free( match_data );
+      if ( ( rc < 0 ) && ( rc != PCRE2_ERROR_NOMATCH ) )
+         WARN( _( "Matching error %d" ), rc );
+      ed->chapter_match = ( rc > 0 );
+   }
+}
+
 /**
  * @brief Loads up an event from an XML node.
  *
@@ -512,14 +603,6 @@ static int event_parseXML( EventData *temp, const xmlNodePtr parent )
    /* Process. */
    temp->chance /= 100.;
 
-   /* Compile conditional chunk. */
-   if ( temp->cond != NULL ) {
-      temp->cond_chunk = cond_compile( temp->cond );
-      if ( temp->cond_chunk == LUA_NOREF || temp->cond_chunk == LUA_REFNIL )
-         WARN( _( "Event '%s' failed to compile Lua conditional!" ),
-               temp->name );
-   }
-
    /* Compile regex for chapter matching. */
    if ( temp->chapter != NULL ) {
       int        errornumber;
@@ -569,15 +652,38 @@ int events_load( void )
 #if DEBUGGING
    Uint32 time = SDL_GetTicks();
 #endif /* DEBUGGING */
-   char **event_files = ndata_listRecursive( EVENT_DATA_PATH );
+   ThreadQueue     *tq          = vpool_create();
+   char           **event_files = ndata_listRecursive( EVENT_DATA_PATH );
+   EventThreadData *edata =
+      array_create_size( EventThreadData, array_size( event_files ) );
 
-   /* Run over events. */
-   event_data = array_create_size( EventData, array_size( event_files ) );
    for ( int i = 0; i < array_size( event_files ); i++ ) {
-      event_parseFile( event_files[i], NULL );
-      free( event_files[i] );
+      EventThreadData *ed = &array_grow( &edata );
+      ed->filename        = event_files[i];
    }
    array_free( event_files );
+
+   /* Read and parse the files in parallel, this also compiles the Lua into
+    * the bytecode cache. Enqueue the jobs after the data array is done. */
+   SDL_GL_MakeCurrent( gl_screen.window, NULL );
+   for ( int i = 0; i < array_size( edata ); i++ )
+      vpool_enqueue( tq, event_parseThread, &edata[i] );
+   vpool_wait( tq );
+   vpool_cleanup( tq );
+   SDL_GL_MakeCurrent( gl_screen.window, gl_screen.context );
+
+   /* Loading into naevL has to be done serially. */
+   event_data = array_create_size( EventData, array_size( edata ) );
+   for ( int i = 0; i < array_size( edata ); i++ ) {
+      EventThreadData *ed = &edata[i];
+      if ( !ed->ret ) {
+         EventData *ev = &array_grow( &event_data );
+         *ev           = ed->ev;
+         event_parseFileLua( ev, ed->filename );
+      }
+      free( ed->filename );
+   }
+   array_free( edata );
    array_shrink( &event_data );
 
 #ifdef DEBUGGING
@@ -593,6 +699,7 @@ int events_load( void )
     * first. */
    qsort( event_data, array_size( event_data ), sizeof( EventData ),
           event_cmp );
+   events_buildIndex();
 
 #if DEBUGGING
    if ( conf.devmode ) {
@@ -613,16 +720,50 @@ int events_load( void )
  * @brief Parses an event file.
  *
  *    @param file Source file path.
- *    @param temp Data to load into, or NULL for initial load.
+ *    @param temp Data to load into.
+ *    @return 0 on success.
  */
 static int event_parseFile( const char *file, EventData *temp )
+{
+   int ret = event_parseFileData( file, temp );
+   if ( ret == 0 )
+      event_parseFileLua( temp, file );
+   return ret;
+}
+
+/**
+ * @brief Parses an event file in a thread.
+ */
+static int event_parseThread( void *ptr )
+{
+   EventThreadData *data = ptr;
+   data->ret             = event_parseFileData( data->filename, &data->ev );
+   /* Render if necessary. */
+   if ( naev_shouldRenderLoadscreen() ) {
+      gl_contextSet();
+      naev_renderLoadscreen();
+      gl_contextUnset();
+   }
+   return data->ret;
+}
+
+/**
+ * @brief Reads and parses the header of an event, without touching naevL.
+ *
+ * The Lua is only compiled into the bytecode cache, event_parseFileLua() has
+ * to be called afterwards from the main thread to load it.
+ *
+ *    @param file Source file path.
+ *    @param temp Data to load into, only modified on success.
+ *    @return 0 on success.
+ */
+static int event_parseFileData( const char *file, EventData *temp )
 {
    size_t      bufsize;
    xmlNodePtr  node;
    xmlDocPtr   doc;
    char       *filebuf;
    const char *pos, *start_pos;
-   int         ret;
 
    /* Load string. */
    filebuf = ndata_read( file, &bufsize );
@@ -642,7 +783,7 @@ static int event_parseFile( const char *file, EventData *temp )
       if ( ( pos != NULL ) && !strncmp( pos, "--common", bufsize ) )
          WARN( _( "Event '%s' has create function but no XML header!" ), file );
       free( filebuf );
-      return 0;
+      return -1;
    }
 
    /* Separate XML header and Lua. */
@@ -668,31 +809,47 @@ static int event_parseFile( const char *file, EventData *temp )
       return -1;
    }
 
-   if ( temp == NULL )
-      temp = &array_grow( &event_data );
    event_parseXML( temp, node );
    temp->lua        = strdup( filebuf );
    temp->sourcefile = strdup( file );
 
-   /* Clear chunk if already loaded. */
-   if ( temp->chunk != LUA_NOREF ) {
-      luaL_unref( naevL, LUA_REGISTRYINDEX, temp->chunk );
-      temp->chunk = LUA_NOREF;
+   /* Clean up. */
+   xmlFreeDoc( doc );
+   free( filebuf );
+
+   /* Warm up the bytecode cache, errors get reported when loading. */
+   nlua_precompile( temp->lua, strlen( temp->lua ), temp->name );
+   if ( temp->cond != NULL )
+      cond_precompile( temp->cond );
+
+   return 0;
+}
+
+/**
+ * @brief Compiles the conditional and loads the Lua of a parsed event.
+ *
+ *    @param temp Event to load the Lua of.
+ *    @param file Source file path.
+ */
+static void event_parseFileLua( EventData *temp, const char *file )
+{
+   int ret;
+
+   /* Compile conditional chunk. */
+   if ( temp->cond != NULL ) {
+      temp->cond_chunk = cond_compile( temp->cond );
+      if ( temp->cond_chunk == LUA_NOREF || temp->cond_chunk == LUA_REFNIL )
+         WARN( _( "Event '%s' failed to compile Lua conditional!" ),
+               temp->name );
    }
 
    /* Check to see if syntax is valid. */
-   ret = luaL_loadbuffer( naevL, temp->lua, strlen( temp->lua ), temp->name );
+   ret = nlua_loadbuffer( naevL, temp->lua, strlen( temp->lua ), temp->name );
    if ( ret == LUA_ERRSYNTAX )
       WARN( _( "Event Lua '%s' syntax error: %s" ), file,
             lua_tostring( naevL, -1 ) );
    else
       temp->chunk = luaL_ref( naevL, LUA_REGISTRYINDEX );
-
-   /* Clean up. */
-   xmlFreeDoc( doc );
-   free( filebuf );
-
-   return 0;
 }
 
 /**
@@ -755,6 +912,10 @@ void events_exit( void )
       event_freeData( &event_data[i] );
    array_free( event_data );
    event_data = NULL;
+   candidate_free( event_index );
+   event_index = NULL;
+   free( event_chapter );
+   event_chapter = NULL;
 }
 
 /**
@@ -974,9 +1135,10 @@ int event_reload( const char *name )
       return -1;
    save = *temp;
    res  = event_parseFile( save.sourcefile, temp );
-   if ( res == 0 )
+   if ( res == 0 ) {
       event_freeData( &save );
-   else
+      events_buildIndex();
+   } else
       *temp = save;
    return res;
 }
@@ -22,6 +22,7 @@
 #include "conf.h"
 #include "hook.h"
 #include "log.h"
+#include "nameidx.h"
 #include "ndata.h"
 #include "nlua.h"
 #include "nxml.h"
@@ -107,15 +108,20 @@ typedef struct Faction_ {
    char **tags; /**< array.h: List of tags the faction has. */
 } Faction;
 
-static Faction *faction_stack = NULL; /**< Faction stack. */
-static int     *faction_grid  = NULL; /**< Grid of faction status. */
-static size_t   faction_mgrid = 0;    /**< Allocated memory. */
+static Faction *faction_stack    = NULL; /**< Faction stack. */
+int             faction_ngrid    = 0; /**< Factions in the relation grid. */
+int             faction_gridw    = 0; /**< Words per faction in the grid. */
+uint64_t       *faction_genemies = NULL; /**< Enemy bits of each faction. */
+uint64_t       *faction_gallies  = NULL; /**< Ally bits of each faction. */
+static size_t   faction_mgrid    = 0;    /**< Allocated words per grid. */
+static NameIdx  faction_idx;             /**< Factions indexed by name. */
 
 /*
  * Prototypes
  */
 /* static */
 static int  faction_getRaw( const char *name );
+static void faction_buildIndex( void );
 static void faction_freeOne( Faction *f );
 static void faction_sanitizePlayer( Faction *faction );
 static void faction_modPlayerLua( int f, double mod, const char *source,
@@ -124,6 +130,9 @@ static int  faction_parse( Faction *temp, const char *file );
 static int  faction_parseSocial( const char *file );
 static void faction_addStandingScript( Faction *temp, const char *scriptname );
 static void faction_computeGrid( void );
+static void faction_gridSet( uint64_t *grid, int a, int b, int val );
+static void faction_computePlayer( int f );
+static void faction_computePlayerAll( void );
 /* externed */
 int pfaction_save( xmlTextWriterPtr writer );
 int pfaction_load( xmlNodePtr parent );
@@ -151,23 +160,18 @@ static int faction_getRaw( const char *name )
    if ( strcmp( name, "Escort" ) == 0 )
       return FACTION_PLAYER;
 
-   if ( name != NULL ) {
-      int i;
-      for ( i = 0; i < array_size( faction_stack ); i++ )
-         if ( strcmp( faction_stack[i].name, name ) == 0 )
-            break;
-
-      if ( i != array_size( faction_stack ) )
-         return i;
-
-      /* Dynamic factions are why we can't have nice things.
-      const Faction f = { .name = (char*)name };
-      Faction *found = bsearch( &f, faction_stack, array_size(faction_stack),
-      sizeof(Faction), faction_cmp ); if (found != NULL) return found -
-      faction_stack;
-      */
-   }
-   return -1;
+   return nameidx_get( &faction_idx, name );
+}
+
+/**
+ * @brief Rebuilds the index of factions by name.
+ */
+static void faction_buildIndex( void )
+{
+   nameidx_free( &faction_idx );
+   nameidx_init( &faction_idx, array_size( faction_stack ) );
+   for ( int i = 0; i < array_size( faction_stack ); i++ )
+      nameidx_add( &faction_idx, faction_stack[i].name, i );
 }
 
 /**
@@ -768,6 +772,7 @@ nlua_env faction_getEquipper( int f )
 static void faction_sanitizePlayer( Faction *faction )
 {
    faction->player = CLAMP( -100., 100., faction->player );
+   faction_computePlayer( faction - faction_stack );
 }
 
 /**
@@ -934,6 +939,7 @@ void faction_modPlayerRaw( int f, double mod )
 
    faction = &faction_stack[f];
    faction->player += mod;
+   faction_computePlayer( f );
    /* Run hook if necessary. */
    hparam[0].type  = HOOK_PARAM_FACTION;
    hparam[0].u.lf  = f;
@@ -972,6 +978,7 @@ void faction_setPlayer( int f, double value )
    faction         = &faction_stack[f];
    mod             = value - faction->player;
    faction->player = value;
+   faction_computePlayer( f );
    /* Run hook if necessary. */
    if ( !faction_isFlag( faction, FACTION_DYNAMIC ) ) {
       HookParam hparam[3];
@@ -1245,58 +1252,6 @@ double faction_reputationMax( int f )
    return r;
 }
 
-/**
- * @brief Checks whether two factions are enemies.
- *
- *    @param a Faction A.
- *    @param b Faction B.
- *    @return 1 if A and B are enemies, 0 otherwise.
- */
-int areEnemies( int a, int b )
-{
-   /* luckily our factions aren't masochistic */
-   if ( a == b )
-      return 0;
-
-   /* Make sure they're valid. */
-   if ( !faction_isFaction( a ) || !faction_isFaction( b ) )
-      return 0;
-
-   /* player handled separately */
-   if ( a == FACTION_PLAYER )
-      return faction_isPlayerEnemy( b );
-   else if ( b == FACTION_PLAYER )
-      return faction_isPlayerEnemy( a );
-
-   return faction_grid[a * faction_mgrid + b] < 0;
-}
-
-/**
- * @brief Checks whether two factions are allies or not.
- *
- *    @param a Faction A.
- *    @param b Faction B.
- *    @return 1 if A and B are allies, 0 otherwise.
- */
-int areAllies( int a, int b )
-{
-   /* If they are the same they must be allies. */
-   if ( a == b )
-      return 1;
-
-   /* Make sure they're valid. */
-   if ( !faction_isFaction( a ) || !faction_isFaction( b ) )
-      return 0;
-
-   /* we assume player becomes allies with high rating */
-   if ( a == FACTION_PLAYER )
-      return faction_isPlayerFriend( b );
-   else if ( b == FACTION_PLAYER )
-      return faction_isPlayerFriend( a );
-
-   return faction_grid[a * faction_mgrid + b] > 0;
-}
-
 /**
  * @brief Checks whether or not a faction is valid.
  *
@@ -1647,6 +1602,7 @@ void factions_reset( void )
       faction_stack[i].player = faction_stack[i].player_def;
       faction_stack[i].flags  = faction_stack[i].oflags;
    }
+   faction_computePlayerAll();
 }
 
 /**
@@ -1696,6 +1652,7 @@ int factions_load( void )
    /* Sort by name. */
    qsort( faction_stack, array_size( faction_stack ), sizeof( Faction ),
           faction_cmp );
+   faction_buildIndex();
    faction_player = faction_get( "Player" );
 
    /* Second pass - sets allies and enemies */
@@ -1795,11 +1752,16 @@ void factions_free( void )
       faction_freeOne( &faction_stack[i] );
    array_free( faction_stack );
    faction_stack = NULL;
+   nameidx_free( &faction_idx );
 
    /* Clean up faction grid. */
-   free( faction_grid );
-   faction_grid  = NULL;
-   faction_mgrid = 0;
+   free( faction_genemies );
+   free( faction_gallies );
+   faction_genemies = NULL;
+   faction_gallies  = NULL;
+   faction_mgrid    = 0;
+   faction_ngrid    = 0;
+   faction_gridw    = 0;
 }
 
 /**
@@ -1878,6 +1840,7 @@ int pfaction_load( xmlNodePtr parent )
       }
    } while ( xml_nextNode( node ) );
 
+   faction_computePlayerAll();
    return 0;
 }
 
@@ -1955,6 +1918,7 @@ void factions_clearDynamic( void )
       faction_freeOne( f );
       array_erase( &faction_stack, f, f + 1 );
    }
+   faction_buildIndex();
    faction_computeGrid();
 }
 
@@ -2012,50 +1976,115 @@ int faction_dynAdd( int base, const char *name, const char *display,
    if ( colour != NULL )
       f->colour = *colour;
 
+   /* Existing factions take precedence if the name is already in use. */
+   nameidx_add( &faction_idx, f->name, f - faction_stack );
+
    /* TODO make this incremental. */
    faction_computeGrid();
 
    return f - faction_stack;
 }
 
+/**
+ * @brief Sets or clears the bit of faction b in the row of faction a.
+ */
+static void faction_gridSet( uint64_t *grid, int a, int b, int val )
+{
+   uint64_t *w = &grid[a * faction_gridw + ( b >> 6 )];
+   uint64_t  m = UINT64_C( 1 ) << ( b & 63 );
+   if ( val )
+      *w |= m;
+   else
+      *w &= ~m;
+}
+
 /**
  * @brief Computes the faction relationship grid.
+ *
+ * Each faction has a row of enemy and ally bits so that areEnemies() and
+ * areAllies() are a single bit test, and callers can test a whole row against
+ * many factions with faction_enemyMask() and faction_allyMask().
  */
 static void faction_computeGrid( void )
 {
-   size_t n = array_size( faction_stack );
-   if ( faction_mgrid < n ) {
-      free( faction_grid );
-      faction_grid  = malloc( n * n * sizeof( int ) );
-      faction_mgrid = n;
+   int    n = array_size( faction_stack );
+   int    w = ( n + 63 ) / 64;
+   size_t s = (size_t)n * w;
+   if ( faction_mgrid < s ) {
+      free( faction_genemies );
+      free( faction_gallies );
+      faction_genemies = malloc( s * sizeof( uint64_t ) );
+      faction_gallies  = malloc( s * sizeof( uint64_t ) );
+      faction_mgrid    = s;
    }
-   n = faction_mgrid;
-   memset( faction_grid, 0, n * n * sizeof( int ) );
-   for ( int i = 0; i < array_size( faction_stack ); i++ ) {
+   faction_ngrid = n;
+   faction_gridw = w;
+   memset( faction_genemies, 0, s * sizeof( uint64_t ) );
+   memset( faction_gallies, 0, s * sizeof( uint64_t ) );
+   for ( int i = 0; i < n; i++ ) {
       Faction *fa = &faction_stack[i];
+      faction_gridSet( faction_gallies, i, i, 1 );
       for ( int k = 0; k < array_size( fa->allies ); k++ ) {
          int j = fa->allies[k];
 #if DEBUGGING
-         if ( ( faction_grid[i * n + j] < 0 ) ||
-              ( faction_grid[j * n + i] ) < 0 )
+         if ( areEnemies( i, j ) || areEnemies( j, i ) )
             WARN( "Incoherent faction grid! '%s' and '%s' are already enemies, "
                   "but trying to set to allies!",
                   faction_stack[i].name, faction_stack[j].name );
 #endif /* DEBUGGING */
-         faction_grid[i * n + j] = 1;
-         faction_grid[j * n + i] = 1;
+         faction_gridSet( faction_gallies, i, j, 1 );
+         faction_gridSet( faction_gallies, j, i, 1 );
+         faction_gridSet( faction_genemies, i, j, 0 );
+         faction_gridSet( faction_genemies, j, i, 0 );
       }
       for ( int k = 0; k < array_size( fa->enemies ); k++ ) {
          int j = fa->enemies[k];
 #if DEBUGGING
-         if ( ( faction_grid[i * n + j] > 0 ) ||
-              ( faction_grid[j * n + i] > 0 ) )
+         if ( ( ( i != j ) && areAllies( i, j ) ) ||
+              ( ( i != j ) && areAllies( j, i ) ) )
             WARN( "Incoherent faction grid! '%s' and '%s' are already allies, "
                   "but trying to set to enemies!",
                   faction_stack[i].name, faction_stack[j].name );
 #endif /* DEBUGGING */
-         faction_grid[i * n + j] = -1;
-         faction_grid[j * n + i] = -1;
+         faction_gridSet( faction_genemies, i, j, 1 );
+         faction_gridSet( faction_genemies, j, i, 1 );
+         faction_gridSet( faction_gallies, i, j, 0 );
+         faction_gridSet( faction_gallies, j, i, 0 );
       }
    }
+
+   /* Player relations depend on standing instead. */
+   faction_computePlayerAll();
+}
+
+/**
+ * @brief Updates the relation bits between a faction and the player from the
+ * player's standing.
+ *
+ *    @param f Faction whose standing changed.
+ */
+static void faction_computePlayer( int f )
+{
+   int p = FACTION_PLAYER;
+   int enemy, ally;
+
+   if ( ( f == p ) || ( f < 0 ) || ( f >= faction_ngrid ) || ( p < 0 ) ||
+        ( p >= faction_ngrid ) )
+      return;
+
+   enemy = faction_isPlayerEnemy( f );
+   ally  = faction_isPlayerFriend( f );
+   faction_gridSet( faction_genemies, f, p, enemy );
+   faction_gridSet( faction_genemies, p, f, enemy );
+   faction_gridSet( faction_gallies, f, p, ally );
+   faction_gridSet( faction_gallies, p, f, ally );
+}
+
+/**
+ * @brief Updates the relation bits between all factions and the player.
+ */
+static void faction_computePlayerAll( void )
+{
+   for ( int i = 0; i < faction_ngrid; i++ )
+      faction_computePlayer( i );
 }
@@ -3,11 +3,17 @@
  */
 #pragma once
 
+#include <stdint.h>
+
 #include "colour.h"
 #include "nlua.h"
 #include "opengl_tex.h"
 
-extern int faction_player;
+extern int       faction_player;
+extern int       faction_ngrid;
+extern int       faction_gridw;
+extern uint64_t *faction_genemies;
+extern uint64_t *faction_gallies;
 
 #define FACTION_PLAYER                                                         \
    faction_player          /**< Hardcoded player faction identifier. */
@@ -75,8 +81,61 @@ const glColour *faction_getColour( int f );
 char            faction_getColourChar( int f );
 
 /* Works with only factions */
-int areEnemies( int a, int b );
-int areAllies( int a, int b );
+/**
+ * @brief Gets the enemy bits of a faction, test them with faction_maskHas().
+ */
+static inline const uint64_t *faction_enemyMask( int f )
+{
+   return &faction_genemies[f * faction_gridw];
+}
+/**
+ * @brief Gets the ally bits of a faction, test them with faction_maskHas().
+ */
+static inline const uint64_t *faction_allyMask( int f )
+{
+   return &faction_gallies[f * faction_gridw];
+}
+/**
+ * @brief Checks to see if a faction is set in a faction mask.
+ */
+static inline int faction_maskHas( const uint64_t *mask, int f )
+{
+   return ( mask[f >> 6] >> ( f & 63 ) ) & 1;
+}
+/**
+ * @brief Checks whether two factions are enemies.
+ *
+ *    @param a Faction A.
+ *    @param b Faction B.
+ *    @return 1 if A and B are enemies, 0 otherwise.
+ */
+static inline int areEnemies( int a, int b )
+{
+   /* luckily our factions aren't masochistic */
+   if ( a == b )
+      return 0;
+   if ( ( (unsigned)a >= (unsigned)faction_ngrid ) ||
+        ( (unsigned)b >= (unsigned)faction_ngrid ) )
+      return 0;
+   return faction_maskHas( faction_enemyMask( a ), b );
+}
+/**
+ * @brief Checks whether two factions are allies or not.
+ *
+ *    @param a Faction A.
+ *    @param b Faction B.
+ *    @return 1 if A and B are allies, 0 otherwise.
+ */
+static inline int areAllies( int a, int b )
+{
+   /* If they are the same they must be allies. */
+   if ( a == b )
+      return 1;
+   if ( ( (unsigned)a >= (unsigned)faction_ngrid ) ||
+        ( (unsigned)b >= (unsigned)faction_ngrid ) )
+      return 0;
+   return faction_maskHas( faction_allyMask( a ), b );
+}
 
 /* load/free */
 int  factions_load( void );
@@ -8,11 +8,14 @@
  *
  * We use distance fields [1] to render high quality fonts with the help of
  * some shaders. Characters are generated on demand using a texture atlas.
+ * Generated distance fields are kept in a persistent per-font glyph cache, and
+ * can be generated ahead of time for the active language by a background job.
  *
  * [1]:
  * https://steamcdn-a.akamaihd.net/apps/valve/2007/SIGGRAPH2007_AlphaTestedMagnification.pdf
  */
 /** @cond */
+#include <errno.h>
 #include <ft2build.h>
 #include FT_FREETYPE_H
 #include FT_GLYPH_H
@@ -29,10 +32,13 @@
 #include "array.h"
 #include "conf.h"
 #include "distance_field.h"
+#include "gettext.h"
 #include "log.h"
+#include "md5.h"
 #include "ndata.h"
 #include "nfile.h"
 #include "ntracing.h"
+#include "threadpool.h"
 #include "utf8.h"
 
 #define MAX_EFFECT_RADIUS                                                      \
@@ -42,6 +48,8 @@
 #define DEFAULT_TEXTURE_SIZE                                                   \
    1024             /**< Default size of texture caches for glyphs. */
 #define MAX_ROWS 64 /**< Max number of rows per texture cache. */
+#define FONT_CACHE_MAGIC                                                       \
+   "NFGLYPH1" /**< Glyph cache file identifier, change with the format. */
 
 /**
  * OpenGL rendering stuff. Since we can't actually render with multiple threads
@@ -102,15 +110,61 @@ typedef struct font_char_s {
    int      th; /**< Texture height. */
 } font_char_t;
 
+/**
+ * @brief Glyph as stored in the persistent glyph cache.
+ */
+typedef struct glFontCacheRecord_s {
+   uint32_t codepoint; /**< Real character. */
+   int16_t  w;         /**< Width. */
+   int16_t  h;         /**< Height. */
+   int16_t  off_x;     /**< X offset when rendering. */
+   int16_t  off_y;     /**< Y offset when rendering. */
+   int32_t  ft_index;  /**< Index into the array of fallback fonts. */
+   float    adv_x;     /**< X advancement on the screen. */
+   float    m;         /**< Number of distance units per "pixel". */
+   uint32_t offset;    /**< Offset of the distance field in the data. */
+} glFontCacheRecord;
+
+/**
+ * @brief Header of a glyph cache file. Followed by the glyph records and then
+ * the distance field data.
+ */
+typedef struct glFontCacheHeader_s {
+   char     magic[8]; /**< Should be FONT_CACHE_MAGIC. */
+   uint32_t nglyphs;  /**< Number of glyph records. */
+   uint32_t datasize; /**< Size of the distance field data. */
+} glFontCacheHeader;
+
+/**
+ * @brief Persistent glyph cache of a font stash.
+ *
+ * Distance fields are stored quantized to bytes, which is what the GL_RED
+ * atlas textures hold anyway. The cache is shared with the prewarm jobs, so
+ * the glyph data is only accessed with the lock held.
+ */
+typedef struct glFontCache_s {
+   char              *path;   /**< Path of the cache file. */
+   SDL_mutex         *lock;   /**< Protects the glyph data and jobs. */
+   SDL_cond          *idle;   /**< Signalled when the last job finishes. */
+   glFontCacheRecord *glyphs; /**< Cached glyphs (array.h). */
+   int               *next;   /**< Hash chains, parallel to glyphs (array.h). */
+   uint8_t           *data;   /**< Quantized distance fields (array.h). */
+   int                lut[HASH_LUT_SIZE]; /**< Look up table. */
+   int                nsaved; /**< Number of glyphs already on disk. */
+   SDL_atomic_t       cancel; /**< Tells the prewarm jobs to stop. */
+   int                jobs;   /**< Number of running prewarm jobs. */
+} glFontCache;
+
 /**
  * @brief Stores a font file. May be referenced by multiple glFonts for size or
  * fallback reasons.
  */
 typedef struct glFontFile_s {
-   char    *name;     /**< Font file name. */
-   int      refcount; /**< Reference counting. */
-   FT_Byte *data;     /**< Font data buffer. */
-   size_t   datasize; /**< Font data size. */
+   char      *name;     /**< Font file name. */
+   int        refcount; /**< Reference counting. */
+   FT_Byte   *data;     /**< Font data buffer. */
+   size_t     datasize; /**< Font data size. */
+   md5_byte_t md5[16];  /**< Digest of the font data, for the glyph cache. */
 } glFontFile;
 
 /**
@@ -147,9 +201,28 @@ typedef struct glFontStash_s {
    /* Freetype stuff. */
    glFontStashFreetype *ft;
 
+   glFontCache *cache; /**< Persistent glyph cache. */
+
    int refcount; /**< Reference counting. */
 } glFontStash;
 
+/**
+ * @brief Font to generate the glyphs of in the background.
+ */
+typedef struct glFontPrewarmFont_s {
+   glFontCache         *cache; /**< Cache to fill. */
+   glFontStashFreetype *ft; /**< Fallback chain with job-owned faces. */
+   int                  h;  /**< Font height. */
+} glFontPrewarmFont;
+
+/**
+ * @brief Background job generating the glyphs of the active language.
+ */
+typedef struct glFontPrewarm_s {
+   glFontPrewarmFont *fonts;   /**< Fonts to prewarm (array.h). */
+   uint32_t          *charset; /**< Characters to generate (array.h). */
+} glFontPrewarm;
+
 /**
  * Available fonts stashes.
  */
@@ -195,6 +268,21 @@ static void gl_fontKernStart( void );
 static int  gl_fontKernGlyph( glFontStash *stsh, uint32_t ch,
                               glFontGlyph *glyph );
 static void gl_fontstashftDestroy( glFontStashFreetype *ft );
+static int  font_newFace( FT_Library library, const glFontFile *file,
+                          unsigned int h, FT_Face *face );
+static int  font_makeChar( const glFontStashFreetype *ft, int h, font_char_t *c,
+                           uint32_t ch );
+/* Glyph cache. */
+static glFontCache *font_cacheOpen( const glFontStash *stsh );
+static void         font_cacheClose( glFontCache *cache );
+static void         font_cacheSave( glFontCache *cache );
+static int          font_cacheGet( glFontCache *cache, font_char_t *c,
+                                   uint32_t ch );
+static void font_cacheAdd( glFontCache *cache, const font_char_t *c,
+                           uint32_t ch );
+static int  font_prewarmThread( void *data );
+static void font_prewarmFont( FT_Library library, glFontPrewarmFont *pf,
+                              const uint32_t *charset );
 
 /**
  * @brief Gets the font stash corresponding to a font.
@@ -1156,17 +1244,27 @@ int gl_printLines( const glFont *ft_font, const int width, const char *fmt,
  *
  */
 /**
+ * @brief Renders a character with FreeType and computes its distance field.
+ *
+ * Only touches the faces passed, so worker threads can use it with their own.
+ *
+ *    @param fts Fallback chain to render with (array.h).
+ *    @param fh Font height.
+ *    @param[out] c Character to fill.
+ *    @param ch Codepoint to render.
+ *    @return 0 on success.
  */
-static int font_makeChar( glFontStash *stsh, font_char_t *c, uint32_t ch )
+static int font_makeChar( const glFontStashFreetype *fts, int fh,
+                          font_char_t *c, uint32_t ch )
 {
-   int len = array_size( stsh->ft );
+   int len = array_size( fts );
    for ( int i = 0; i < len; i++ ) {
-      FT_UInt              glyph_index;
-      int                  w, h, rw, rh, b;
-      double               vmax;
-      FT_Bitmap            bitmap;
-      FT_GlyphSlot         slot;
-      glFontStashFreetype *ft = &stsh->ft[i];
+      FT_UInt                    glyph_index;
+      int                        w, h, rw, rh, b;
+      double                     vmax;
+      FT_Bitmap                  bitmap;
+      FT_GlyphSlot               slot;
+      const glFontStashFreetype *ft = &fts[i];
 
       /* Get glyph index. */
       glyph_index = FT_Get_Char_Index( ft->face, ch );
@@ -1178,7 +1276,7 @@ static int font_makeChar( glFontStash *stsh, font_char_t *c, uint32_t ch )
             WARN( _( "Font '%s' unicode character '%#x' not found in font! "
                      "Using missing glyph." ),
                   ft->file->name, ch );
-            ft = &stsh->ft[0]; /* Fallback to first font. */
+            ft = &fts[0]; /* Fallback to first font. */
          }
       }
 
@@ -1213,7 +1311,7 @@ static int font_makeChar( glFontStash *stsh, font_char_t *c, uint32_t ch )
          GLubyte *buffer;
          /* Create a larger image using an extra border and center glyph. */
          b = 1 + ( ( MAX_EFFECT_RADIUS + 1 ) * FONT_DISTANCE_FIELD_SIZE - 1 ) /
-                    stsh->h;
+                    fh;
          rw     = w + b * 2;
          rh     = h + b * 2;
          buffer = calloc( rw * rh, sizeof( GLubyte ) );
@@ -1221,12 +1319,13 @@ static int font_makeChar( glFontStash *stsh, font_char_t *c, uint32_t ch )
             for ( int u = 0; u < w; u++ )
                buffer[( b + v ) * rw + ( b + u )] = bitmap.buffer[v * w + u];
          /* Compute signed fdistance field with buffered glyph. */
-         c->dataf = make_distance_mapbf( buffer, rw, rh, &vmax );
+         c->dataf =
+            make_distance_mapbf( buffer, rw, rh, SDF_QUALITY_HIGH, &vmax );
          free( buffer );
       }
       c->w        = rw;
       c->h        = rh;
-      c->m        = ( 2. * vmax * stsh->h ) / FONT_DISTANCE_FIELD_SIZE;
+      c->m        = ( 2. * vmax * fh ) / FONT_DISTANCE_FIELD_SIZE;
       c->off_x    = slot->bitmap_left - b;
       c->off_y    = slot->bitmap_top + b;
       c->adv_x    = (GLfloat)slot->metrics.horiAdvance / 64.;
@@ -1402,9 +1501,12 @@ static glFontGlyph *gl_fontGetGlyph( glFontStash *stsh, uint32_t ch )
    font_char_t  ft_char;
    int          idx;
 
-   /* Load data from freetype. */
-   if ( font_makeChar( stsh, &ft_char, ch ) )
-      return NULL;
+   /* Load data from the glyph cache, or render it with freetype. */
+   if ( font_cacheGet( stsh->cache, &ft_char, ch ) ) {
+      if ( font_makeChar( stsh->ft, stsh->h, &ft_char, ch ) )
+         return NULL;
+      font_cacheAdd( stsh->cache, &ft_char, ch );
+   }
 
    /* Create new character. */
    glyph            = &array_grow( &stsh->glyphs );
@@ -1438,6 +1540,269 @@ static glFontGlyph *gl_fontGetGlyph( glFontStash *stsh, uint32_t ch )
    return glyph;
 }
 
+/**
+ * @brief Finds a glyph in the glyph cache. The lock must be held.
+ *
+ *    @return Index of the glyph or -1 if not cached.
+ */
+static int font_cacheFind( const glFontCache *cache, uint32_t ch )
+{
+   int i = cache->lut[hashint( ch ) & ( HASH_LUT_SIZE - 1 )];
+   while ( i != -1 ) {
+      if ( cache->glyphs[i].codepoint == ch )
+         return i;
+      i = cache->next[i];
+   }
+   return -1;
+}
+
+/**
+ * @brief Adds a glyph record to the glyph cache. The lock must be held.
+ */
+static void font_cacheInsert( glFontCache *cache,
+                              const glFontCacheRecord *rec )
+{
+   unsigned int h = hashint( rec->codepoint ) & ( HASH_LUT_SIZE - 1 );
+   array_push_back( &cache->glyphs, *rec );
+   array_push_back( &cache->next, cache->lut[h] );
+   cache->lut[h] = array_size( cache->glyphs ) - 1;
+}
+
+/**
+ * @brief Loads glyphs from a glyph cache file.
+ *
+ *    @param cache Cache to load into.
+ *    @param buf Contents of the cache file.
+ *    @param size Size of buf.
+ *    @param nft Number of fonts in the fallback chain.
+ *    @return 0 on success.
+ */
+static int font_cacheLoad( glFontCache *cache, const char *buf, size_t size,
+                           int nft )
+{
+   glFontCacheHeader  hdr;
+   const char        *recs, *data;
+   size_t             datasize;
+   glFontCacheRecord *glyphs = array_create( glFontCacheRecord );
+
+   if ( size < sizeof( hdr ) )
+      return -1;
+   memcpy( &hdr, buf, sizeof( hdr ) );
+   if ( memcmp( hdr.magic, FONT_CACHE_MAGIC, sizeof( hdr.magic ) ) != 0 )
+      return -1;
+   recs     = &buf[sizeof( hdr )];
+   data     = &recs[(size_t)hdr.nglyphs * sizeof( glFontCacheRecord )];
+   datasize = hdr.datasize;
+   if ( size != sizeof( hdr ) +
+                   (size_t)hdr.nglyphs * sizeof( glFontCacheRecord ) +
+                   datasize )
+      return -1;
+
+   for ( uint32_t i = 0; i < hdr.nglyphs; i++ ) {
+      glFontCacheRecord rec;
+      memcpy( &rec, &recs[i * sizeof( rec )], sizeof( rec ) );
+      if ( ( rec.w < 0 ) || ( rec.h < 0 ) ||
+           ( rec.offset + (size_t)rec.w * rec.h > datasize ) ||
+           ( rec.ft_index < 0 ) || ( rec.ft_index >= nft ) ) {
+         array_free( glyphs );
+         return -1;
+      }
+      array_push_back( &glyphs, rec );
+   }
+
+   /* Everything checks out. */
+   for ( int i = 0; i < array_size( glyphs ); i++ )
+      font_cacheInsert( cache, &glyphs[i] );
+   array_resize( &cache->data, datasize );
+   memcpy( cache->data, data, datasize );
+   cache->nsaved = array_size( cache->glyphs );
+   array_free( glyphs );
+   return 0;
+}
+
+/**
+ * @brief Opens the glyph cache of a font stash.
+ *
+ * The cache is keyed by the contents of the font files in the fallback chain,
+ * the font size and the distance field parameters.
+ */
+static glFontCache *font_cacheOpen( const glFontStash *stsh )
+{
+   md5_state_t  md5;
+   md5_byte_t   md5val[16];
+   char         digest[33], dirpath[PATH_MAX];
+   glFontCache *cache;
+   const int32_t params[] = { stsh->h, FONT_DISTANCE_FIELD_SIZE,
+                              MAX_EFFECT_RADIUS, SDF_QUALITY_HIGH };
+
+   md5_init( &md5 );
+   md5_append( &md5, (const md5_byte_t *)params, sizeof( params ) );
+   for ( int i = 0; i < array_size( stsh->ft ); i++ )
+      md5_append( &md5, stsh->ft[i].file->md5,
+                  sizeof( stsh->ft[i].file->md5 ) );
+   md5_finish( &md5, md5val );
+   for ( int i = 0; i < 16; i++ )
+      snprintf( &digest[i * 2], 3, "%02x", md5val[i] );
+
+   cache         = calloc( 1, sizeof( glFontCache ) );
+   cache->lock   = SDL_CreateMutex();
+   cache->idle   = SDL_CreateCond();
+   cache->glyphs = array_create( glFontCacheRecord );
+   cache->next   = array_create( int );
+   cache->data   = array_create( uint8_t );
+   for ( int i = 0; i < HASH_LUT_SIZE; i++ )
+      cache->lut[i] = -1;
+   snprintf( dirpath, sizeof( dirpath ), "%sfonts/", nfile_cachePath() );
+   SDL_asprintf( &cache->path, "%s%s", dirpath, digest );
+
+   /* Load previously generated glyphs. */
+   if ( nfile_fileExists( cache->path ) ) {
+      size_t size;
+      char  *buf = nfile_readFile( &size, cache->path );
+      if ( ( buf != NULL ) &&
+           font_cacheLoad( cache, buf, size, array_size( stsh->ft ) ) )
+         WARN( _( "Ignoring invalid glyph cache '%s'." ), cache->path );
+      free( buf );
+   } else
+      nfile_dirMakeExist( dirpath );
+
+   return cache;
+}
+
+/**
+ * @brief Writes the new glyphs of a glyph cache to disk.
+ */
+static void font_cacheSave( glFontCache *cache )
+{
+   glFontCacheHeader hdr;
+   char             *buf;
+   size_t            size, recsize;
+
+   /* Snapshot the cache so the file can be written without the lock. */
+   SDL_LockMutex( cache->lock );
+   if ( array_size( cache->glyphs ) == cache->nsaved ) {
+      SDL_UnlockMutex( cache->lock );
+      return;
+   }
+   memcpy( hdr.magic, FONT_CACHE_MAGIC, sizeof( hdr.magic ) );
+   hdr.nglyphs  = array_size( cache->glyphs );
+   hdr.datasize = array_size( cache->data );
+   recsize      = hdr.nglyphs * sizeof( glFontCacheRecord );
+   size         = sizeof( hdr ) + recsize + hdr.datasize;
+   buf          = malloc( size );
+   memcpy( buf, &hdr, sizeof( hdr ) );
+   memcpy( &buf[sizeof( hdr )], cache->glyphs, recsize );
+   memcpy( &buf[sizeof( hdr ) + recsize], cache->data, hdr.datasize );
+   cache->nsaved = hdr.nglyphs;
+   SDL_UnlockMutex( cache->lock );
+
+   nfile_writeFileAtomic( buf, size, cache->path );
+   free( buf );
+}
+
+/**
+ * @brief Stops the prewarm jobs of a glyph cache, saves it and frees it.
+ */
+static void font_cacheClose( glFontCache *cache )
+{
+   if ( cache == NULL )
+      return;
+
+   SDL_AtomicSet( &cache->cancel, 1 );
+   SDL_LockMutex( cache->lock );
+   while ( cache->jobs > 0 )
+      SDL_CondWait( cache->idle, cache->lock );
+   SDL_UnlockMutex( cache->lock );
+
+   font_cacheSave( cache );
+
+   SDL_DestroyCond( cache->idle );
+   SDL_DestroyMutex( cache->lock );
+   array_free( cache->glyphs );
+   array_free( cache->next );
+   array_free( cache->data );
+   free( cache->path );
+   free( cache );
+}
+
+/**
+ * @brief Gets a character from the glyph cache.
+ *
+ *    @param cache Cache to look in.
+ *    @param[out] c Character to fill, with a newly allocated distance field.
+ *    @param ch Codepoint to get.
+ *    @return 0 on success, -1 if the character is not cached.
+ */
+static int font_cacheGet( glFontCache *cache, font_char_t *c, uint32_t ch )
+{
+   const glFontCacheRecord *rec;
+   int                      i;
+
+   if ( cache == NULL )
+      return -1;
+
+   SDL_LockMutex( cache->lock );
+   i = font_cacheFind( cache, ch );
+   if ( i < 0 ) {
+      SDL_UnlockMutex( cache->lock );
+      return -1;
+   }
+   rec         = &cache->glyphs[i];
+   c->w        = rec->w;
+   c->h        = rec->h;
+   c->off_x    = rec->off_x;
+   c->off_y    = rec->off_y;
+   c->adv_x    = rec->adv_x;
+   c->m        = rec->m;
+   c->ft_index = rec->ft_index;
+   c->dataf    = NULL;
+   c->data     = malloc( (size_t)rec->w * rec->h );
+   memcpy( c->data, &cache->data[rec->offset], (size_t)rec->w * rec->h );
+   SDL_UnlockMutex( cache->lock );
+
+   return 0;
+}
+
+/**
+ * @brief Adds a freshly rendered character to the glyph cache.
+ */
+static void font_cacheAdd( glFontCache *cache, const font_char_t *c,
+                           uint32_t ch )
+{
+   glFontCacheRecord rec;
+   size_t            n = (size_t)c->w * c->h;
+
+   if ( cache == NULL )
+      return;
+
+   SDL_LockMutex( cache->lock );
+   /* Someone else may have beaten us to it. */
+   if ( font_cacheFind( cache, ch ) >= 0 ) {
+      SDL_UnlockMutex( cache->lock );
+      return;
+   }
+   rec.codepoint = ch;
+   rec.w         = c->w;
+   rec.h         = c->h;
+   rec.off_x     = c->off_x;
+   rec.off_y     = c->off_y;
+   rec.ft_index  = c->ft_index;
+   rec.adv_x     = c->adv_x;
+   rec.m         = c->m;
+   rec.offset    = array_size( cache->data );
+   array_resize( &cache->data, rec.offset + n );
+   /* Quantize the same way the GL_RED textures do. */
+   for ( size_t i = 0; i < n; i++ ) {
+      if ( c->dataf != NULL )
+         cache->data[rec.offset + i] =
+            (uint8_t)( CLAMP( 0.f, 1.f, c->dataf[i] ) * 255.f + 0.5f );
+      else
+         cache->data[rec.offset + i] = c->data[i];
+   }
+   font_cacheInsert( cache, &rec );
+   SDL_UnlockMutex( cache->lock );
+}
+
 /**
  * @brief Call at the start of a string/line.
  */
@@ -1658,6 +2023,7 @@ int gl_fontInit( glFont *font, const char *fname, const unsigned int h,
       stsh->lut[i] = -1;
    stsh->glyphs = array_create( glFontGlyph );
    stsh->tex    = array_create( glFontTex );
+   stsh->cache  = font_cacheOpen( stsh );
 
    /* Set up VBOs. */
    stsh->mvbo          = 256;
@@ -1702,9 +2068,171 @@ int gl_fontAddFallback( glFont *font, const char *fname, const char *prefix )
       }
    }
 
+   /* The fallback chain is part of the glyph cache key. */
+   font_cacheClose( stsh->cache );
+   stsh->cache = font_cacheOpen( stsh );
+
    return ret;
 }
 
+/**
+ * @brief Generates the glyphs of the active language for the default fonts in
+ * the background.
+ *
+ * Glyphs end up in the glyph caches of the fonts, from where they are uploaded
+ * to the atlas the first time they are drawn.
+ */
+void gl_fontPrewarm( void )
+{
+   const glFont *fonts[] = { &gl_defFont, &gl_smallFont, &gl_defFontMono };
+   glFontPrewarm *job;
+
+   /* A single job works through all the fonts, so they share the FreeType
+    * library and the character set. */
+   job        = calloc( 1, sizeof( glFontPrewarm ) );
+   job->fonts = array_create( glFontPrewarmFont );
+   for ( size_t i = 0; i < sizeof( fonts ) / sizeof( fonts[0] ); i++ ) {
+      glFontStash      *stsh = gl_fontGetStash( fonts[i] );
+      glFontPrewarmFont pf;
+      int               dup = 0;
+
+      if ( ( stsh->cache == NULL ) || ( array_size( stsh->ft ) == 0 ) )
+         continue;
+      for ( int j = 0; j < array_size( job->fonts ); j++ )
+         if ( job->fonts[j].cache == stsh->cache )
+            dup = 1;
+      if ( dup )
+         continue;
+
+      /* The job uses its own faces, as FreeType faces are not thread-safe.
+       * The font files stay alive until the cache is closed, which waits for
+       * us. */
+      pf.cache = stsh->cache;
+      pf.h     = stsh->h;
+      pf.ft = array_create_size( glFontStashFreetype, array_size( stsh->ft ) );
+      for ( int j = 0; j < array_size( stsh->ft ); j++ ) {
+         glFontStashFreetype ft = { .file = stsh->ft[j].file, .face = NULL };
+         array_push_back( &pf.ft, ft );
+      }
+      SDL_LockMutex( stsh->cache->lock );
+      stsh->cache->jobs++;
+      SDL_UnlockMutex( stsh->cache->lock );
+      array_push_back( &job->fonts, pf );
+   }
+   if ( array_size( job->fonts ) == 0 ) {
+      array_free( job->fonts );
+      free( job );
+      return;
+   }
+
+   /* The active translation can change under the job, so get the characters
+    * now. */
+   job->charset = gettext_charset();
+   threadpool_newJob( font_prewarmThread, job );
+}
+
+/**
+ * @brief Renders the character set of the active language into the glyph
+ * caches of the fonts.
+ */
+static int font_prewarmThread( void *data )
+{
+   glFontPrewarm *job = data;
+   FT_Library     library;
+   int            init;
+
+   NTracingZone( _ctx, 1 );
+
+   init = !FT_Init_FreeType( &library );
+   if ( !init )
+      WARN( _( "FT_Init_FreeType failed prewarming glyphs." ) );
+   for ( int i = 0; i < array_size( job->fonts ); i++ ) {
+      glFontPrewarmFont *pf    = &job->fonts[i];
+      glFontCache       *cache = pf->cache;
+      if ( init )
+         font_prewarmFont( library, pf, job->charset );
+      array_free( pf->ft );
+      /* The cache may be freed as soon as we let go of the lock. */
+      SDL_LockMutex( cache->lock );
+      if ( --cache->jobs == 0 )
+         SDL_CondSignal( cache->idle );
+      SDL_UnlockMutex( cache->lock );
+   }
+   if ( init )
+      FT_Done_FreeType( library );
+
+   array_free( job->charset );
+   array_free( job->fonts );
+   free( job );
+   NTracingZoneEnd( _ctx );
+   return 0;
+}
+
+/**
+ * @brief Renders a character set into the glyph cache of a font.
+ *
+ *    @param library FreeType library to create the faces with.
+ *    @param pf Font to prewarm.
+ *    @param charset Characters to render (array.h).
+ */
+static void font_prewarmFont( FT_Library library, glFontPrewarmFont *pf,
+                              const uint32_t *charset )
+{
+   glFontCache *cache = pf->cache;
+   int          n     = 0;
+
+   if ( SDL_AtomicGet( &cache->cancel ) )
+      return;
+
+   for ( int i = 0; i < array_size( pf->ft ); i++ )
+      if ( font_newFace( library, pf->ft[i].file, pf->h, &pf->ft[i].face ) )
+         goto cleanup;
+
+   for ( int i = 0; i < array_size( charset ); i++ ) {
+      font_char_t c;
+      int         found, cached;
+
+      if ( SDL_AtomicGet( &cache->cancel ) )
+         break;
+
+      SDL_LockMutex( cache->lock );
+      cached = ( font_cacheFind( cache, charset[i] ) >= 0 );
+      SDL_UnlockMutex( cache->lock );
+      if ( cached )
+         continue;
+
+      /* Characters no font has would only warn and use the missing glyph. */
+      found = 0;
+      for ( int j = 0; j < array_size( pf->ft ); j++ )
+         if ( FT_Get_Char_Index( pf->ft[j].face, charset[i] ) != 0 ) {
+            found = 1;
+            break;
+         }
+      if ( !found )
+         continue;
+
+      if ( font_makeChar( pf->ft, pf->h, &c, charset[i] ) )
+         continue;
+      font_cacheAdd( cache, &c, charset[i] );
+      free( c.data );
+      free( c.dataf );
+      n++;
+   }
+
+   /* Save right away instead of waiting for the font to be freed. */
+   if ( ( n > 0 ) && !SDL_AtomicGet( &cache->cancel ) ) {
+      font_cacheSave( cache );
+      DEBUG( _( "Prewarmed %d glyphs at size %d" ), n, pf->h );
+   }
+
+cleanup:
+   for ( int i = 0; i < array_size( pf->ft ); i++ )
+      if ( pf->ft[i].face != NULL ) {
+         FT_Done_Face( pf->ft[i].face );
+         pf->ft[i].face = NULL;
+      }
+}
+
 /**
  * @brief Adds a fallback font to a stash.
  *
@@ -1742,37 +2270,63 @@ static int gl_fontstashAddFallback( glFontStash *stsh, const char *fname,
          gl_fontstashftDestroy( &ft );
          return -1;
       }
+
+      /* Digest used to key the glyph cache. */
+      md5_state_t md5;
+      md5_init( &md5 );
+      md5_append( &md5, ft.file->data, ft.file->datasize );
+      md5_finish( &md5, ft.file->md5 );
    }
 
    /* Object which freetype uses to store font info. */
-   if ( FT_New_Memory_Face( font_library, ft.file->data, ft.file->datasize, 0,
-                            &ft.face ) ) {
-      WARN( _( "FT_New_Memory_Face failed loading library from %s" ), fname );
+   if ( font_newFace( font_library, ft.file, h, &ft.face ) ) {
       gl_fontstashftDestroy( &ft );
       return -1;
    }
 
+   /* Save stuff. */
+   array_push_back( &stsh->ft, ft );
+
+   /* Success. */
+   return 0;
+}
+
+/**
+ * @brief Creates a FreeType face set up for distance field rendering.
+ *
+ *    @param library FreeType library to create the face with.
+ *    @param file Font file to use.
+ *    @param h Height to use for the font.
+ *    @param[out] face Newly created face.
+ *    @return 0 on success.
+ */
+static int font_newFace( FT_Library library, const glFontFile *file,
+                         unsigned int h, FT_Face *face )
+{
+   /* Object which freetype uses to store font info. */
+   if ( FT_New_Memory_Face( library, file->data, file->datasize, 0, face ) ) {
+      WARN( _( "FT_New_Memory_Face failed loading library from %s" ),
+            file->name );
+      return -1;
+   }
+
    /* Try to resize. */
-   if ( FT_IS_SCALABLE( ft.face ) ) {
+   if ( FT_IS_SCALABLE( *face ) ) {
       FT_Matrix scale;
-      if ( FT_Set_Char_Size( ft.face, 0, /* Same as width. */
+      if ( FT_Set_Char_Size( *face, 0,   /* Same as width. */
                              h * 64, 96, /* Create at 96 DPI */
                              96 ) )      /* Create at 96 DPI */
          WARN( _( "FT_Set_Char_Size failed." ) );
       scale.xx = scale.yy = (FT_Fixed)FONT_DISTANCE_FIELD_SIZE * 0x10000 / h;
       scale.xy = scale.yx = 0;
-      FT_Set_Transform( ft.face, &scale, NULL );
+      FT_Set_Transform( *face, &scale, NULL );
    } else
       WARN( _( "Font isn't resizable!" ) );
 
    /* Select the character map. */
-   if ( FT_Select_Charmap( ft.face, FT_ENCODING_UNICODE ) )
+   if ( FT_Select_Charmap( *face, FT_ENCODING_UNICODE ) )
       WARN( _( "FT_Select_Charmap failed to change character mapping." ) );
 
-   /* Save stuff. */
-   array_push_back( &stsh->ft, ft );
-
-   /* Success. */
    return 0;
 }
 
@@ -1796,6 +2350,9 @@ void gl_freeFont( glFont *font )
       return;
    /* Not references and must eliminate. */
 
+   /* Has to go first, as prewarm jobs use the font files. */
+   font_cacheClose( stsh->cache );
+
    for ( int i = 0; i < array_size( stsh->ft ); i++ )
       gl_fontstashftDestroy( &stsh->ft[i] );
    array_free( stsh->ft );
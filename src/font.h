@@ -64,6 +64,7 @@ int  gl_fontInit( glFont *font, const char *fname, const unsigned int h,
                   const char *prefix, unsigned int flags );
 int  gl_fontAddFallback( glFont *font, const char *fname, const char *prefix );
 int  gl_fontAddFallbackFont( glFont *font, const glFont *f );
+void gl_fontPrewarm( void );
 void gl_freeFont( glFont *font );
 void gl_fontExit( void );
 
@@ -21,6 +21,7 @@
 #include "log.h"
 #include "msgcat.h"
 #include "ndata.h"
+#include "utf8.h"
 
 typedef struct translation {
    char     *language;   /**< Language code (allocated string). */
@@ -251,6 +252,55 @@ const char *gettext_ngettext( const char *msgid, const char *msgid_plural,
    return n > 1 && msgid_plural != NULL ? msgid_plural : msgid;
 }
 
+/**
+ * @brief Gets the set of characters used by the active translation.
+ *
+ * Only the immutable message catalogs are read, so this may be called from
+ * worker threads as long as gettext_exit() isn't.
+ *
+ *    @return Sorted array (array.h) of unique codepoints, always including
+ * printable ASCII.
+ */
+uint32_t *gettext_charset( void )
+{
+   const translation_t *trans = gettext_activeTranslation;
+   uint32_t            *charset, *used;
+   const uint32_t       maxcp = 0x110000;
+
+   used = calloc( maxcp / 32, sizeof( uint32_t ) );
+   for ( uint32_t c = 0x20; c < 0x7F; c++ )
+      used[c / 32] |= 1U << ( c % 32 );
+
+   for ( int i = 0; trans != NULL && i < array_size( trans->chain ); i++ ) {
+      const msgcat_t *cat = &trans->chain[i];
+      uint32_t        n   = msgcat_nstrings( cat );
+      for ( uint32_t j = 0; j < n; j++ ) {
+         size_t      len;
+         const char *str = msgcat_translation( cat, j, &len );
+         if ( str == NULL )
+            continue;
+         /* Plural forms are NUL-separated, so step over the separators. */
+         for ( size_t k = 0; k < len; ) {
+            uint32_t c;
+            if ( str[k] == '\0' ) {
+               k++;
+               continue;
+            }
+            c = u8_nextchar( str, &k );
+            if ( c >= 0x20 && ( c < 0x7F || c >= 0xA0 ) && c < maxcp )
+               used[c / 32] |= 1U << ( c % 32 );
+         }
+      }
+   }
+
+   charset = array_create( uint32_t );
+   for ( uint32_t c = 0; c < maxcp; c++ )
+      if ( used[c / 32] & ( 1U << ( c % 32 ) ) )
+         array_push_back( &charset, c );
+   free( used );
+   return charset;
+}
+
 /**
  * @brief Helper function for p_(): Return _(lookup) with a fallback of msgid
  * rather than lookup.
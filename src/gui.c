@@ -50,6 +50,11 @@
 
 #define RADAR_BLINK_PILOT 0.5 /**< Blink rate of the pilot target on radar. */
 #define RADAR_BLINK_SPOB 1.   /**< Blink rate of the spob target on radar. */
+#define RADAR_BLIP_VERTEX_SIZE                                                 \
+   10 /**< Floats per radar blip vertex: position, local position, colour,    \
+         size and shape. */
+#define RADAR_BLIP_MARGIN                                                      \
+   20. /**< Pixels past the radar edge to look for pilots, for large blips. */
 
 /* some blinking stuff. */
 static double blink_pilot  = 0.; /**< Timer on target blinking on radar. */
@@ -59,6 +64,19 @@ static double animation_dt = 0.; /**< Used for animations. */
 /* for VBO. */
 static gl_vbo *gui_radar_select_vbo = NULL;
 
+/**
+ * @brief Shapes of the batched radar blips, as understood by radarblip.frag.
+ */
+typedef enum RadarBlipShape_ {
+   RADAR_BLIP_PILOT    = 0, /**< Pilot triangle. */
+   RADAR_BLIP_ASTEROID = 1, /**< Asteroid square. */
+} RadarBlipShape;
+
+static int      gui_blip_batch = 0; /**< Whether blips are being batched. */
+static GLfloat *gui_blip_data =
+   NULL; /**< Array (array.h): Vertices of the batched blips. */
+static gl_vbo *gui_blip_vbo = NULL; /**< Streaming VBO for the blips. */
+
 static int gui_getMessage =
    1; /**< Whether or not the player should receive messages. */
 static char   *gui_name = NULL; /**< Name of the GUI (for errors and such). */
@@ -185,6 +203,11 @@ static void gui_renderRadarOutOfRange( RadarShape sh, int w, int h, int cx,
 static void gui_blink( double cx, double cy, double vr, const glColour *col,
                        double blinkInterval, double blinkVar );
 static const glColour *gui_getPilotColour( const Pilot *p );
+static int  gui_pilotRadarPos( const Pilot *p, RadarShape shape, double w,
+                               double h, double res, int overlay, double *x,
+                               double *y, double *scale );
+static void gui_blipAdd( double x, double y, double r, double dir,
+                         const glColour *col, RadarBlipShape shape );
 static void            gui_calcBorders( void );
 /* Lua GUI. */
 static int gui_doFunc( int func_ref, const char *func_name );
@@ -921,10 +944,11 @@ int gui_radarInit( int circle, int w, int h )
  */
 void gui_radarRender( double x, double y )
 {
-   int           f;
    Radar        *radar;
    mat4          view_matrix_prev;
    Pilot *const *pilot_stack;
+   const Pilot  *target;
+   double        rx, ry, px, py;
 
    if ( !conf.always_radar && ovr_isOpen() )
       return;
@@ -975,22 +999,41 @@ void gui_radarRender( double x, double y )
     */
    weapon_minimap( radar->res, radar->w, radar->h, radar->shape, 1. );
 
-   /* render the pilot */
+   /* Render the pilots within the radar's extent, all at once. */
+   if ( radar->shape == RADAR_RECT ) {
+      rx = ( radar->w / 2. + RADAR_BLIP_MARGIN ) * radar->res;
+      ry = ( radar->h / 2. + RADAR_BLIP_MARGIN ) * radar->res;
+   } else {
+      rx = ( radar->w + RADAR_BLIP_MARGIN ) * radar->res;
+      ry = rx;
+   }
+   px = player.p->solid.pos.x;
+   py = player.p->solid.pos.y;
+   pilot_collideQueryIL( &gui_qtquery, floor( px - rx ), floor( py - ry ),
+                         ceil( px + rx ), ceil( py + ry ) );
    pilot_stack = pilot_getAll();
-   f           = 0;
-   for ( int i = 1; i < array_size( pilot_stack ); i++ ) { /* skip the player */
-      if ( pilot_stack[i]->id == player.p->target )
-         f = i;
-      else
-         gui_renderPilot( pilot_stack[i], radar->shape, radar->w, radar->h,
-                          radar->res, 0 );
+   gui_blipsBegin();
+   for ( int i = 0; i < il_size( &gui_qtquery ); i++ ) {
+      int          k = il_get( &gui_qtquery, i, 0 );
+      const Pilot *p;
+      /* Quadtree is from the last update, pilots can only get appended. */
+      if ( k >= array_size( pilot_stack ) )
+         continue;
+      p = pilot_stack[k];
+      if ( pilot_isPlayer( p ) || ( p->id == player.p->target ) )
+         continue;
+      gui_renderPilot( p, radar->shape, radar->w, radar->h, radar->res, 0 );
    }
+   gui_blipsEnd();
+
    /* render the targeted pilot */
-   if ( f != 0 )
-      gui_renderPilot( pilot_stack[f], radar->shape, radar->w, radar->h,
-                       radar->res, 0 );
+   target = pilot_get( player.p->target );
+   if ( ( target != NULL ) && !pilot_isPlayer( target ) )
+      gui_renderPilot( target, radar->shape, radar->w, radar->h, radar->res,
+                       0 );
 
    /* Render the asteroids */
+   gui_blipsBegin();
    for ( int i = 0; i < array_size( cur_system->asteroids ); i++ ) {
       AsteroidAnchor *ast   = &cur_system->asteroids[i];
       double          range = EW_ASTEROID_DIST *
@@ -1006,6 +1049,7 @@ void gui_radarRender( double x, double y )
          gui_renderAsteroid( a, radar->w, radar->h, radar->res, 0 );
       }
    }
+   gui_blipsEnd();
 
    /* Render the player. */
    gui_renderPlayer( radar->res, 0 );
@@ -1158,6 +1202,161 @@ static const glColour *gui_getPilotColour( const Pilot *p )
    return col;
 }
 
+/**
+ * @brief Starts batching the pilot and asteroid radar blips.
+ *
+ * Until gui_blipsEnd() is called, gui_renderPilot() and gui_renderAsteroid()
+ * only queue their markers, which then get drawn with a single call.
+ * Everything else they draw (highlights, names, etc.) is still drawn
+ * immediately, so it ends up below the markers.
+ */
+void gui_blipsBegin( void )
+{
+   if ( gui_blip_data == NULL )
+      gui_blip_data = array_create( GLfloat );
+   array_resize( &gui_blip_data, 0 );
+   gui_blip_batch = 1;
+}
+
+/**
+ * @brief Draws all the radar blips batched since gui_blipsBegin().
+ */
+void gui_blipsEnd( void )
+{
+   GLsizei n      = array_size( gui_blip_data ) / RADAR_BLIP_VERTEX_SIZE;
+   GLsizei stride = RADAR_BLIP_VERTEX_SIZE * sizeof( GLfloat );
+   GLsizei size   = array_size( gui_blip_data ) * sizeof( GLfloat );
+
+   gui_blip_batch = 0;
+   if ( n == 0 )
+      return;
+
+   /* Orphan and refill the streaming buffer. */
+   if ( gui_blip_vbo == NULL )
+      gui_blip_vbo = gl_vboCreateStream( size, gui_blip_data );
+   else
+      gl_vboData( gui_blip_vbo, size, gui_blip_data );
+
+   glUseProgram( shaders.radarblip.program );
+   gl_uniformMat4( shaders.radarblip.projection, &gl_view_matrix );
+   glEnableVertexAttribArray( shaders.radarblip.vertex );
+   glEnableVertexAttribArray( shaders.radarblip.vertex_tex );
+   glEnableVertexAttribArray( shaders.radarblip.vertex_colour );
+   glEnableVertexAttribArray( shaders.radarblip.vertex_param );
+   gl_vboActivateAttribOffset( gui_blip_vbo, shaders.radarblip.vertex, 0, 2,
+                               GL_FLOAT, stride );
+   gl_vboActivateAttribOffset( gui_blip_vbo, shaders.radarblip.vertex_tex,
+                               2 * sizeof( GLfloat ), 2, GL_FLOAT, stride );
+   gl_vboActivateAttribOffset( gui_blip_vbo, shaders.radarblip.vertex_colour,
+                               4 * sizeof( GLfloat ), 4, GL_FLOAT, stride );
+   gl_vboActivateAttribOffset( gui_blip_vbo, shaders.radarblip.vertex_param,
+                               8 * sizeof( GLfloat ), 2, GL_FLOAT, stride );
+
+   glDrawArrays( GL_TRIANGLES, 0, n );
+
+   /* Clear state. */
+   glDisableVertexAttribArray( shaders.radarblip.vertex );
+   glDisableVertexAttribArray( shaders.radarblip.vertex_tex );
+   glDisableVertexAttribArray( shaders.radarblip.vertex_colour );
+   glDisableVertexAttribArray( shaders.radarblip.vertex_param );
+   glUseProgram( 0 );
+
+   /* Check errors. */
+   gl_checkErr();
+}
+
+/**
+ * @brief Queues a radar blip as two triangles.
+ *
+ *    @param x X position of the blip center.
+ *    @param y Y position of the blip center.
+ *    @param r Half size of the blip.
+ *    @param dir Rotation of the blip.
+ *    @param col Colour of the blip.
+ *    @param shape Shape of the blip.
+ */
+static void gui_blipAdd( double x, double y, double r, double dir,
+                         const glColour *col, RadarBlipShape shape )
+{
+   static const GLfloat corners[6][2] = {
+      { -1., -1. }, { 1., -1. }, { -1., 1. },
+      { -1., 1. },  { 1., -1. }, { 1., 1. } };
+   double   c = cos( dir ) * r;
+   double   s = sin( dir ) * r;
+   int      n = array_size( gui_blip_data );
+   GLfloat *v;
+
+   array_resize( &gui_blip_data, n + 6 * RADAR_BLIP_VERTEX_SIZE );
+   v = &gui_blip_data[n];
+   for ( int i = 0; i < 6; i++ ) {
+      GLfloat u = corners[i][0];
+      GLfloat t = corners[i][1];
+      v[0]      = x + c * u - s * t;
+      v[1]      = y + s * u + c * t;
+      v[2]      = u;
+      v[3]      = t;
+      v[4]      = col->r;
+      v[5]      = col->g;
+      v[6]      = col->b;
+      v[7]      = col->a;
+      v[8]      = r;
+      v[9]      = shape;
+      v += RADAR_BLIP_VERTEX_SIZE;
+   }
+}
+
+/**
+ * @brief Gets where a pilot shows up on the radar.
+ *
+ *    @param p Pilot to get position of.
+ *    @param shape Shape of the radar (RADAR_RECT or RADAR_CIRCLE).
+ *    @param w Width.
+ *    @param h Height.
+ *    @param res Radar resolution.
+ *    @param overlay Whether to get the position on the overlay.
+ *    @param[out] x X position of the pilot on the radar.
+ *    @param[out] y Y position of the pilot on the radar.
+ *    @param[out] scale Size of the pilot marker, including outline.
+ *    @return 1 if the pilot is within the radar, 0 otherwise.
+ */
+static int gui_pilotRadarPos( const Pilot *p, RadarShape shape, double w,
+                              double h, double res, int overlay, double *x,
+                              double *y, double *scale )
+{
+   double ssize;
+
+   /* Get position. */
+   if ( overlay ) {
+      *x = ( p->solid.pos.x / res );
+      *y = ( p->solid.pos.y / res );
+   } else {
+      *x = ( ( p->solid.pos.x - player.p->solid.pos.x ) / res );
+      *y = ( ( p->solid.pos.y - player.p->solid.pos.y ) / res );
+   }
+   /* Get size. */
+   ssize  = sqrt( (double)ship_size( p->ship ) );
+   *scale = ( ssize + 1. ) / 2. * ( 1. + RADAR_RES_REF / res );
+
+   /* Check if pilot in range. */
+   if ( ( ( shape == RADAR_RECT ) &&
+          ( ( ABS( *x ) > ( w + *scale ) / 2. ) ||
+            ( ABS( *y ) > ( h + *scale ) / 2. ) ) ) ||
+        ( ( shape == RADAR_CIRCLE ) &&
+          ( ( pow2( *x ) + pow2( *y ) ) > pow2( w ) ) ) )
+      return 0;
+
+   /* Transform coordinates into the 0,0 -> SCREEN_W, SCREEN_H range. */
+   if ( overlay ) {
+      double ox, oy;
+      ovr_center( &ox, &oy );
+      *x += ox;
+      *y += oy;
+   }
+
+   *scale = MAX( *scale + 2.0, 3.5 + ssize ); /* Compensate for outline. */
+   return 1;
+}
+
 /**
  * @brief Renders a pilot in the GUI radar.
  *
@@ -1171,7 +1370,7 @@ static const glColour *gui_getPilotColour( const Pilot *p )
 void gui_renderPilot( const Pilot *p, RadarShape shape, double w, double h,
                       double res, int overlay )
 {
-   double          x, y, scale, ssize;
+   double          x, y, scale;
    const glColour *col;
    int             scanning;
 
@@ -1179,44 +1378,19 @@ void gui_renderPilot( const Pilot *p, RadarShape shape, double w, double h,
    if ( !pilot_validTarget( player.p, p ) )
       return;
 
-   /* Get position. */
-   if ( overlay ) {
-      x = ( p->solid.pos.x / res );
-      y = ( p->solid.pos.y / res );
-   } else {
-      x = ( ( p->solid.pos.x - player.p->solid.pos.x ) / res );
-      y = ( ( p->solid.pos.y - player.p->solid.pos.y ) / res );
-   }
-   /* Get size. */
-   ssize = sqrt( (double)ship_size( p->ship ) );
-   scale = ( ssize + 1. ) / 2. * ( 1. + RADAR_RES_REF / res );
-
    /* Check if pilot in range. */
-   if ( ( ( shape == RADAR_RECT ) && ( ( ABS( x ) > ( w + scale ) / 2. ) ||
-                                       ( ABS( y ) > ( h + scale ) / 2. ) ) ) ||
-        ( ( shape == RADAR_CIRCLE ) &&
-          ( ( pow2( x ) + pow2( y ) ) > pow2( w ) ) ) ) {
-
+   if ( !gui_pilotRadarPos( p, shape, w, h, res, overlay, &x, &y, &scale ) ) {
       /* Draw little targeted symbol. */
       if ( p->id == player.p->target && !overlay )
          gui_renderRadarOutOfRange( shape, w, h, x, y, &cRadar_tPilot );
       return;
    }
 
-   /* Transform coordinates into the 0,0 -> SCREEN_W, SCREEN_H range. */
-   if ( overlay ) {
-      double ox, oy;
-      ovr_center( &ox, &oy );
-      x += ox;
-      y += oy;
-   }
-
    if ( p->id == player.p->target )
       col = &cRadar_hilight;
    else
       col = gui_getPilotColour( p );
 
-   scale = MAX( scale + 2.0, 3.5 + ssize ); /* Compensate for outline. */
    scanning =
       ( pilot_isFlag( p, PILOT_SCANNING ) && ( p->target == PLAYER_ID ) );
 
@@ -1229,9 +1403,13 @@ void gui_renderPilot( const Pilot *p, RadarShape shape, double w, double h,
                        &highlighted, 1 );
    }
 
-   glUseProgram( shaders.pilotmarker.program );
-   gl_renderShader( x, y, scale, scale, p->solid.dir, &shaders.pilotmarker, col,
-                    1 );
+   if ( gui_blip_batch )
+      gui_blipAdd( x, y, scale, p->solid.dir, col, RADAR_BLIP_PILOT );
+   else {
+      glUseProgram( shaders.pilotmarker.program );
+      gl_renderShader( x, y, scale, scale, p->solid.dir, &shaders.pilotmarker,
+                       col, 1 );
+   }
 
    /* Draw selection if targeted. */
    if ( p->id == player.p->target )
@@ -1326,8 +1504,12 @@ void gui_renderAsteroid( const Asteroid *a, double w, double h, double res,
 
    // gl_renderRect( px, py, MIN( 2*sx, w-px ), MIN( 2*sy, h-py ), col );
    r = ( sx + sy ) / 2.0 + 1.5;
-   glUseProgram( shaders.asteroidmarker.program );
-   gl_renderShader( px, py, r, r, 0., &shaders.asteroidmarker, col, 1 );
+   if ( gui_blip_batch )
+      gui_blipAdd( px, py, r, 0., col, RADAR_BLIP_ASTEROID );
+   else {
+      glUseProgram( shaders.asteroidmarker.program );
+      gl_renderShader( px, py, r, r, 0., &shaders.asteroidmarker, col, 1 );
+   }
 
    if ( targeted )
       gui_blink( px, py, MAX( 7., 2.0 * r ), col, RADAR_BLINK_PILOT,
@@ -2106,6 +2288,10 @@ void gui_free( void )
 
    gl_vboDestroy( gui_radar_select_vbo );
    gui_radar_select_vbo = NULL;
+   gl_vboDestroy( gui_blip_vbo );
+   gui_blip_vbo = NULL;
+   array_free( gui_blip_data );
+   gui_blip_data = NULL;
 
    osd_exit();
 
@@ -78,6 +78,8 @@ void gui_renderPilot( const Pilot *p, RadarShape shape, double w, double h,
 void gui_renderAsteroid( const Asteroid *a, double w, double h, double res,
                          int overlay );
 void gui_renderPlayer( double res, int overlay );
+void gui_blipsBegin( void );
+void gui_blipsEnd( void );
 
 /*
  * Targeting.
@@ -43,6 +43,8 @@
    750 /**< Time of a mission marker's animation cycle in milliseconds. */
 #define MAP_MOVE_THRESHOLD 20.         /**< Mouse movement distance threshold */
 #define EASE_ALPHA ease_QuadraticInOut /**< Ease function for alpha. */
+#define MAP_TILE_MARGIN                                                        \
+   0.25 /**< Fraction of the view cached past each edge of a layer tile. */
 
 static const int RCOL_X = -10; /**< Position of text in the right column. */
 static const int RCOL_TEXT_W =
@@ -64,26 +66,58 @@ typedef struct FactionPresence_ {
    int         known; /**< Whether or not the faction is known. */
 } FactionPresence;
 
+/**
+ * @brief Static map layers that get cached in framebuffers.
+ */
+typedef enum MapLayerType_ {
+   MAP_LAYER_FACTION, /**< Decorators and faction disks. */
+   MAP_LAYER_JUMPS,   /**< Jump lanes. */
+   MAP_LAYER_SYSTEMS, /**< System circles. */
+   MAP_LAYER_MAX,     /**< Number of layers. */
+} MapLayerType;
+
+/**
+ * @brief A cached map layer.
+ *
+ * The layer holds a tile of the map rendered at a single zoom level in zoomed
+ * map coordinates (system position times zoom), slightly larger than the
+ * view so that small pans don't need to re-render it.
+ */
+typedef struct MapLayer_ {
+   GLuint   fbo;   /**< Framebuffer of the layer. */
+   GLuint   tex;   /**< Texture of the layer. */
+   GLsizei  fw;    /**< Framebuffer width in real pixels. */
+   GLsizei  fh;    /**< Framebuffer height in real pixels. */
+   double   u;     /**< Left edge of the tile in zoomed map coordinates. */
+   double   v;     /**< Bottom edge of the tile in zoomed map coordinates. */
+   double   w;     /**< Width of the tile. */
+   double   h;     /**< Height of the tile. */
+   double   zoom;  /**< Zoom the tile was rendered at. */
+   MapMode  mode;  /**< Map mode the tile was rendered with. */
+   uint64_t sig;   /**< Signature of the galaxy state when rendered. */
+   int      valid; /**< Whether or not the tile has been rendered. */
+} MapLayer;
+
 /**
  * @brief Map widget data.
  */
 typedef struct CstMapWidget_ {
-   double  xoff;             /**< X offset for centering. */
-   double  yoff;             /**< Y offset for centering. */
-   double  zoom;             /**< Level of zoom. */
-   double  xpos;             /**< Centered x position. */
-   double  ypos;             /**< Centered y position. */
-   double  xtarget;          /**< Target X position. */
-   double  ytarget;          /**< Target Y position. */
-   int     drag;             /**< Is the user dragging the map? */
-   double  alpha_decorators; /**< Alpha for decorators. */
-   double  alpha_faction;    /**< Alpha for factions. */
-   double  alpha_env;        /**< Alpha for environmental stuff. */
-   double  alpha_path;       /**< Alpha for path stuff. */
-   double  alpha_names;      /**< Alpha for system names. */
-   double  alpha_commod;     /**< Alpha for commodity prices. */
-   double  alpha_markers;    /**< Alpha for system markers. */
-   MapMode mode;             /**< Default map mode. */
+   double   xoff;                  /**< X offset for centering. */
+   double   yoff;                  /**< Y offset for centering. */
+   double   zoom;                  /**< Level of zoom. */
+   double   xpos;                  /**< Centered x position. */
+   double   ypos;                  /**< Centered y position. */
+   double   xtarget;               /**< Target X position. */
+   double   ytarget;               /**< Target Y position. */
+   int      drag;                  /**< Is the user dragging the map? */
+   double   alpha_faction;         /**< Alpha for decorators and factions. */
+   double   alpha_env;             /**< Alpha for environmental stuff. */
+   double   alpha_path;            /**< Alpha for path stuff. */
+   double   alpha_names;           /**< Alpha for system names. */
+   double   alpha_commod;          /**< Alpha for commodity prices. */
+   double   alpha_markers;         /**< Alpha for system markers. */
+   MapMode  mode;                  /**< Default map mode. */
+   MapLayer layers[MAP_LAYER_MAX]; /**< Cached static map layers. */
 } CstMapWidget;
 
 /* map decorator stack */
@@ -129,6 +163,13 @@ static void map_update_status( unsigned int wid, const char *buf );
 static void map_update( unsigned int wid );
 /* Render. */
 static void map_render( double bx, double by, double w, double h, void *data );
+static uint64_t map_layerSignature( void );
+static void     map_layerRender( MapLayerType type, CstMapWidget *cst,
+                                 double bx, double by, double x, double y,
+                                 double w, double h, double r, uint64_t sig,
+                                 double alpha );
+static void     map_layerFree( CstMapWidget *cst );
+static void     map_free( void *data );
 static void map_renderPath( double x, double y, double zoom, double radius,
                             double alpha );
 static void map_renderMarkers( double x, double y, double zoom, double r,
@@ -1053,6 +1094,7 @@ static void map_render( double bx, double by, double w, double h, void *data )
    CstMapWidget *cst = data;
    double        x, y, z, r;
    double        dt = naev_getrealdt();
+   uint64_t      sig;
 
    /* Update timer. */
    map_dt += dt;
@@ -1066,26 +1108,27 @@ static void map_render( double bx, double by, double w, double h, void *data )
    /* background */
    gl_renderRect( bx, by, w, h, &cBlack );
 
-   if ( cst->alpha_decorators > 0. )
-      map_renderDecorators( x, y, z, 0, EASE_ALPHA( cst->alpha_decorators ) );
+   /* Static layers get re-rendered only when the galaxy state changes. */
+   sig = map_layerSignature();
 
-   /* Render faction disks. */
+   /* Render decorators and faction disks. They always fade together. */
    if ( cst->alpha_faction > 0. )
-      map_renderFactionDisks( x, y, z, r, 0, EASE_ALPHA( cst->alpha_faction ) );
+      map_layerRender( MAP_LAYER_FACTION, cst, bx, by, x, y, w, h, r, sig,
+                       EASE_ALPHA( cst->alpha_faction ) );
 
-   /* Render environmental features. */
+   /* Render environmental features. These are animated. */
    if ( cst->alpha_env > 0. )
       map_renderSystemEnvironment( x, y, z, 0, EASE_ALPHA( cst->alpha_env ) );
 
    /* Render jump routes. */
-   map_renderJumps( x, y, z, r, 0 );
+   map_layerRender( MAP_LAYER_JUMPS, cst, bx, by, x, y, w, h, r, sig, 1. );
 
    /* Render the player's jump route. */
    if ( cst->alpha_path > 0. )
       map_renderPath( x, y, z, r, EASE_ALPHA( cst->alpha_path ) );
 
    /* Render systems. */
-   map_renderSystems( bx, by, x, y, z, w, h, r, cst->mode );
+   map_layerRender( MAP_LAYER_SYSTEMS, cst, bx, by, x, y, w, h, r, sig, 1. );
 
    /* Render system markers and notes. */
    if ( cst->alpha_markers > 0. )
@@ -1122,6 +1165,188 @@ static void map_render( double bx, double by, double w, double h, void *data )
    glClear( GL_DEPTH_BUFFER_BIT );
 }
 
+/**
+ * @brief Computes a signature of everything the static map layers depend on.
+ *
+ * This is cheap compared to rendering the layers, and catches discovering
+ * systems and jumps, universe diffs and standing changes without having to
+ * hook into any of them.
+ *
+ *    @return Signature of the current galaxy state.
+ */
+static uint64_t map_layerSignature( void )
+{
+   uint64_t h = 14695981039346656037ULL; /* FNV-1a. */
+#define MAP_SIG( val )                                                         \
+   do {                                                                        \
+      uint64_t _v = (uint64_t)( val );                                         \
+      for ( int _b = 0; _b < 8; _b++ ) {                                       \
+         h ^= ( _v >> ( 8 * _b ) ) & 0xff;                                     \
+         h *= 1099511628211ULL;                                                \
+      }                                                                        \
+   } while ( 0 )
+   MAP_SIG( array_size( systems_stack ) );
+   for ( int i = 0; i < array_size( systems_stack ); i++ ) {
+      const StarSystem *sys = &systems_stack[i];
+      MAP_SIG( sys->flags );
+      MAP_SIG( (int64_t)sys->faction );
+      if ( sys->faction >= 0 )
+         MAP_SIG( areEnemies( FACTION_PLAYER, sys->faction ) |
+                  ( areAllies( FACTION_PLAYER, sys->faction ) << 1 ) );
+      MAP_SIG( (int64_t)round( sys->pos.x ) );
+      MAP_SIG( (int64_t)round( sys->pos.y ) );
+      MAP_SIG( (int64_t)round( sys->ownerpresence * 1000. ) );
+      MAP_SIG( array_size( sys->jumps ) );
+      for ( int j = 0; j < array_size( sys->jumps ); j++ ) {
+         const JumpPoint *jp = &sys->jumps[j];
+         MAP_SIG( jp->targetid );
+         MAP_SIG( jp->flags );
+         MAP_SIG( jp->hide > 0. );
+      }
+   }
+#undef MAP_SIG
+   return h;
+}
+
+/**
+ * @brief Renders a static map layer, re-rendering its cached tile if needed.
+ *
+ *    @param type Layer to render.
+ *    @param cst Map widget being rendered.
+ *    @param bx Base X position of the widget.
+ *    @param by Base Y position of the widget.
+ *    @param x X position of the map origin.
+ *    @param y Y position of the map origin.
+ *    @param w Width of the widget.
+ *    @param h Height of the widget.
+ *    @param r Radius of the systems.
+ *    @param sig Signature of the galaxy state.
+ *    @param alpha Opacity to composite the layer with.
+ */
+static void map_layerRender( MapLayerType type, CstMapWidget *cst, double bx,
+                             double by, double x, double y, double w, double h,
+                             double r, uint64_t sig, double alpha )
+{
+   MapLayer *l = &cst->layers[type];
+   double    z = cst->zoom;
+   double    u = bx - x; /* View in zoomed map coordinates. */
+   double    v = by - y;
+   GLint     blend[4];
+   glColour  col;
+
+   /* Re-render the tile when the view leaves it or the galaxy changed. */
+   if ( !l->valid || ( l->zoom != z ) || ( l->mode != cst->mode ) ||
+        ( l->sig != sig ) || ( u < l->u ) || ( v < l->v ) ||
+        ( u + w > l->u + l->w ) || ( v + h > l->v + l->h ) ) {
+      GLint   fbo, viewport[4];
+      GLsizei fw, fh;
+      int     scissor;
+      mat4    view;
+
+      l->w = round( w * ( 1. + 2. * MAP_TILE_MARGIN ) );
+      l->h = round( h * ( 1. + 2. * MAP_TILE_MARGIN ) );
+      l->u = round( u - w * MAP_TILE_MARGIN );
+      l->v = round( v - h * MAP_TILE_MARGIN );
+      fw   = ceil( l->w / gl_screen.scale );
+      fh   = ceil( l->h / gl_screen.scale );
+
+      glGetIntegerv( GL_FRAMEBUFFER_BINDING, &fbo );
+      glGetIntegerv( GL_VIEWPORT, viewport );
+      scissor = glIsEnabled( GL_SCISSOR_TEST );
+
+      /* Resize the framebuffer if necessary. */
+      if ( ( l->fbo == 0 ) || ( l->fw != fw ) || ( l->fh != fh ) ) {
+         if ( l->fbo != 0 ) {
+            glDeleteFramebuffers( 1, &l->fbo );
+            glDeleteTextures( 1, &l->tex );
+         }
+         gl_fboCreate( &l->fbo, &l->tex, fw, fh );
+         l->fw = fw;
+         l->fh = fh;
+      }
+
+      /* Render the layer into the tile with the map origin at 0,0. */
+      glBindFramebuffer( GL_FRAMEBUFFER, l->fbo );
+      glViewport( 0, 0, fw, fh );
+      glDisable( GL_SCISSOR_TEST );
+      glClearColor( 0., 0., 0., 0. );
+      glClear( GL_COLOR_BUFFER_BIT );
+      glClearColor( 0., 0., 0., 1. );
+      glBlendFuncSeparate( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE,
+                           GL_ONE_MINUS_SRC_ALPHA );
+      view           = gl_view_matrix;
+      gl_view_matrix = mat4_ortho( l->u, l->u + l->w, l->v, l->v + l->h, -1.,
+                                   1. );
+      switch ( type ) {
+      case MAP_LAYER_FACTION:
+         map_renderDecorators( 0., 0., z, 0, 1. );
+         map_renderFactionDisks( 0., 0., z, r, 0, 1. );
+         break;
+      case MAP_LAYER_JUMPS:
+         map_renderJumps( 0., 0., z, r, 0 );
+         break;
+      case MAP_LAYER_SYSTEMS:
+         map_renderSystems( l->u, l->v, 0., 0., z, l->w, l->h, r, cst->mode );
+         break;
+      default:
+         break;
+      }
+      gl_view_matrix = view;
+
+      /* Restore state. */
+      glBindFramebuffer( GL_FRAMEBUFFER, fbo );
+      glViewport( viewport[0], viewport[1], viewport[2], viewport[3] );
+      if ( scissor )
+         glEnable( GL_SCISSOR_TEST );
+      gl_checkErr();
+
+      l->zoom  = z;
+      l->mode  = cst->mode;
+      l->sig   = sig;
+      l->valid = 1;
+   }
+
+   /* The tile is premultiplied, so the whole layer fades as a group. */
+   glGetIntegerv( GL_BLEND_SRC_RGB, &blend[0] );
+   glGetIntegerv( GL_BLEND_DST_RGB, &blend[1] );
+   glGetIntegerv( GL_BLEND_SRC_ALPHA, &blend[2] );
+   glGetIntegerv( GL_BLEND_DST_ALPHA, &blend[3] );
+   glBlendFuncSeparate( GL_ONE, GL_ONE_MINUS_SRC_ALPHA, GL_ONE,
+                        GL_ONE_MINUS_SRC_ALPHA );
+   col.r = col.g = col.b = col.a = alpha;
+   gl_renderTextureRaw( l->tex, 0, x + l->u, y + l->v, l->w, l->h, 0., 0., 1.,
+                        1., &col, 0. );
+   glBlendFuncSeparate( blend[0], blend[1], blend[2], blend[3] );
+}
+
+/**
+ * @brief Frees the cached map layers of a map widget.
+ *
+ *    @param cst Map widget to free layers of.
+ */
+static void map_layerFree( CstMapWidget *cst )
+{
+   for ( int i = 0; i < MAP_LAYER_MAX; i++ ) {
+      MapLayer *l = &cst->layers[i];
+      if ( l->fbo != 0 ) {
+         glDeleteFramebuffers( 1, &l->fbo );
+         glDeleteTextures( 1, &l->tex );
+      }
+      memset( l, 0, sizeof( MapLayer ) );
+   }
+}
+
+/**
+ * @brief Frees the data of a map widget.
+ *
+ *    @param data Map widget data to free.
+ */
+static void map_free( void *data )
+{
+   map_layerFree( data );
+   free( data );
+}
+
 /**
  * @brief Gets the render parameters.
  */
@@ -1258,6 +1483,11 @@ void map_renderSystemEnvironment( double x, double y, double zoom, int editor,
          sw = ( 50. + sys->nebu_density * 50. / 1000. ) * zoom;
          sh = sw;
 
+         /* Skip if off-screen. */
+         if ( !rectOverlap( tx - sw / 2., ty - sh / 2., sw, sh, 0., 0.,
+                            SCREEN_W, SCREEN_H ) )
+            continue;
+
          /* Set the vertex. */
          projection = gl_view_matrix;
          mat4_translate_scale_xy( &projection, tx - sw / 2., ty - sh / 2., sw,
@@ -1290,6 +1520,11 @@ void map_renderSystemEnvironment( double x, double y, double zoom, int editor,
          sw = 100. * zoom;
          sh = sw;
 
+         /* Skip if off-screen. */
+         if ( !rectOverlap( tx - sw / 2., ty - sh / 2., sw, sh, 0., 0.,
+                            SCREEN_W, SCREEN_H ) )
+            continue;
+
          /* Set the vertex. */
          projection = gl_view_matrix;
          mat4_translate_scale_xy( &projection, tx - sw / 2., ty - sh / 2., sw,
@@ -1603,11 +1838,13 @@ void map_renderNames( double bx, double by, double x, double y, double zoom,
 
       font = ( zoom >= 1.5 ) ? &gl_defFont : &gl_smallFont;
 
-      textw = gl_printWidthRaw( font, _( sys->name ) );
-      tx    = x + ( sys->pos.x + 12. ) * zoom;
-      ty    = y + ( sys->pos.y ) * zoom - font->h * 0.5;
+      tx = x + ( sys->pos.x + 12. ) * zoom;
+      ty = y + ( sys->pos.y ) * zoom - font->h * 0.5;
 
-      /* Skip if out of bounds. */
+      /* Skip if out of bounds, cheap checks first. */
+      if ( ( tx > bx + w ) || ( ty > by + h ) || ( ty + font->h < by ) )
+         continue;
+      textw = gl_printWidthRaw( font, _( sys->name ) );
       if ( !rectOverlap( tx, ty, textw, font->h, bx, by, w, h ) )
          continue;
 
@@ -2481,7 +2718,6 @@ static void map_updateInternal( CstMapWidget *cst, double dt )
    switch ( cst->mode ) {
    case MAPMODE_EDITOR: /* fall through */
    case MAPMODE_TRAVEL:
-      ATAR( cst->alpha_decorators, mapmin );
       ATAR( cst->alpha_faction, mapmin );
       ATAR( cst->alpha_env, mapmin );
       AMAX( cst->alpha_path );
@@ -2491,7 +2727,6 @@ static void map_updateInternal( CstMapWidget *cst, double dt )
       break;
 
    case MAPMODE_DISCOVER:
-      ATAR( cst->alpha_decorators, 0.5 * mapmin );
       ATAR( cst->alpha_faction, 0.5 * mapmin );
       ATAR( cst->alpha_env, mapmin );
       ATAR( cst->alpha_path, 0.5 );
@@ -2501,7 +2736,6 @@ static void map_updateInternal( CstMapWidget *cst, double dt )
       break;
 
    case MAPMODE_TRADE:
-      AMIN( cst->alpha_decorators );
       AMIN( cst->alpha_faction );
       AMIN( cst->alpha_env );
       ATAR( cst->alpha_path, 0.5 );
@@ -3238,7 +3472,7 @@ void map_show( int wid, int x, int y, int w, int h, double zoom, double xoff,
    window_addCust( wid, x, y, w, h, "cstMap", 1, map_render, map_mouse, NULL,
                    map_focusLose, cst );
    window_custSetDynamic( wid, "cstMap", 1 );
-   window_custAutoFreeData( wid, "cstMap" );
+   window_custSetFreeData( wid, "cstMap", map_free );
 
    /* Set up stuff. */
    map_setup();
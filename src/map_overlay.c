@@ -853,6 +853,7 @@ void ovr_render( double dt )
          cur_system->jumps[player.p->nav_hyperspace].map_alpha, 1 );
 
    /* Render the asteroids */
+   gui_blipsBegin();
    for ( int i = 0; i < array_size( cur_system->asteroids ); i++ ) {
       AsteroidAnchor *ast   = &cur_system->asteroids[i];
       double          range = EW_ASTEROID_DIST *
@@ -868,10 +869,12 @@ void ovr_render( double dt )
          gui_renderAsteroid( a, w, h, res, 1 );
       }
    }
+   gui_blipsEnd();
 
    /* Render pilots. */
    Pilot *const *pstk = pilot_getAll();
    int           t    = 0;
+   gui_blipsBegin();
    for ( int i = 0; i < array_size( pstk ); i++ ) {
       if ( pstk[i]->id == PLAYER_ID ) /* Skip player. */
          continue;
@@ -880,6 +883,7 @@ void ovr_render( double dt )
       else
          gui_renderPilot( pstk[i], RADAR_RECT, w, h, res, 1 );
    }
+   gui_blipsEnd();
 
    /* Stealth rendering. */
    if ( pilot_isFlag( player.p, PILOT_STEALTH ) ) {
@@ -0,0 +1,483 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+/**
+ * @file metrics.c
+ *
+ * @brief Lightweight always-available performance metrics.
+ *
+ * Named timers, counters and values get accumulated every frame into ring
+ * buffers. They are fed by the NTracing macros, so every traced zone and plot
+ * also shows up here, with or without Tracy. Only the main thread is measured,
+ * work done in the thread pool is ignored.
+ *
+ * The metrics can be displayed as an overlay below the FPS counter, streamed
+ * to a CSV file every frame, or have their history dumped to CSV on demand.
+ */
+/** @cond */
+#include <stdarg.h>
+#include <stdlib.h>
+
+#include "physfs.h"
+
+#include "naev.h"
+/** @endcond */
+
+#include "metrics.h"
+
+#include "array.h"
+#include "conf.h"
+#include "font.h"
+#include "log.h"
+#include "nlua.h"
+#include "opengl.h"
+
+#define METRICS_OVERLAY_TIMERS 12 /**< Timers shown in the overlay. */
+#define METRICS_OVERLAY_VALUES 8  /**< Counters and values shown. */
+#define METRICS_CSV_BUFFER                                                     \
+   ( 64 * 1024 ) /**< Buffer size for the streamed CSV file. */
+
+/**
+ * @brief A single metric.
+ */
+typedef struct Metric_ {
+   char      *name; /**< Name of the metric. */
+   MetricType type; /**< Type of the metric. */
+   double     cur;  /**< Value being accumulated this frame. */
+   double     hist[METRICS_HISTORY]; /**< Ring buffer of past frames. */
+} Metric;
+
+int metrics_enabled = 0; /**< Whether or not metrics are being gathered. */
+
+static Metric *metrics_stack = NULL; /**< Array (array.h): All the metrics. */
+static int     metrics_pos   = 0;    /**< Next slot in the ring buffers. */
+static int     metrics_nhist = 0;    /**< Frames stored in the ring buffers. */
+static unsigned int metrics_frameid = 0;  /**< Frames gathered so far. */
+static SDL_threadID metrics_thread;       /**< Thread being measured. */
+static double       metrics_tick_ms = 0.; /**< Milliseconds per counter tick. */
+static uint64_t     metrics_last    = 0;  /**< Counter at the last frame. */
+static PHYSFS_File *metrics_csv = NULL; /**< CSV file being streamed to. */
+static int metrics_csv_cols     = -1;   /**< Columns of the last CSV header. */
+
+/* Draw call counting. */
+static unsigned int metrics_draws = 0; /**< Draw calls this frame. */
+static PFNGLDRAWARRAYSPROC            metrics_glDrawArrays            = NULL;
+static PFNGLDRAWELEMENTSPROC          metrics_glDrawElements          = NULL;
+static PFNGLDRAWARRAYSINSTANCEDPROC   metrics_glDrawArraysInstanced   = NULL;
+static PFNGLDRAWELEMENTSINSTANCEDPROC metrics_glDrawElementsInstanced = NULL;
+
+/*
+ * Prototypes.
+ */
+static void APIENTRY metrics_drawArrays( GLenum mode, GLint first,
+                                         GLsizei count );
+static void APIENTRY metrics_drawElements( GLenum mode, GLsizei count,
+                                           GLenum type, const void *indices );
+static void APIENTRY metrics_drawArraysInstanced( GLenum mode, GLint first,
+                                                  GLsizei count,
+                                                  GLsizei instancecount );
+static void APIENTRY metrics_drawElementsInstanced( GLenum mode, GLsizei count,
+                                                    GLenum      type,
+                                                    const void *indices,
+                                                    GLsizei instancecount );
+static void metrics_writef( PHYSFS_File *f, const char *fmt, ... );
+static void metrics_writeHeader( PHYSFS_File *f );
+static void metrics_writeRow( PHYSFS_File *f, unsigned int frame, int slot );
+static int  metrics_cmpTimers( const void *p1, const void *p2 );
+
+/**
+ * @brief Initializes the metrics.
+ *
+ * Has to be called after OpenGL is set up, as it hooks the draw calls.
+ *
+ *    @return 0 on success.
+ */
+int metrics_init( void )
+{
+   metrics_thread  = SDL_ThreadID();
+   metrics_tick_ms = 1000. / (double)SDL_GetPerformanceFrequency();
+   metrics_stack   = array_create( Metric );
+
+   /* Count draw calls by wrapping the loaded entry points. */
+   metrics_glDrawArrays            = glad_glDrawArrays;
+   metrics_glDrawElements          = glad_glDrawElements;
+   metrics_glDrawArraysInstanced   = glad_glDrawArraysInstanced;
+   metrics_glDrawElementsInstanced = glad_glDrawElementsInstanced;
+   glad_glDrawArrays               = metrics_drawArrays;
+   glad_glDrawElements             = metrics_drawElements;
+   if ( metrics_glDrawArraysInstanced != NULL )
+      glad_glDrawArraysInstanced = metrics_drawArraysInstanced;
+   if ( metrics_glDrawElementsInstanced != NULL )
+      glad_glDrawElementsInstanced = metrics_drawElementsInstanced;
+
+   metrics_update();
+   return 0;
+}
+
+/**
+ * @brief Cleans up the metrics.
+ */
+void metrics_exit( void )
+{
+   if ( metrics_csv != NULL ) {
+      PHYSFS_close( metrics_csv );
+      metrics_csv = NULL;
+   }
+   metrics_enabled = 0;
+
+   if ( metrics_glDrawArrays != NULL ) {
+      glad_glDrawArrays            = metrics_glDrawArrays;
+      glad_glDrawElements          = metrics_glDrawElements;
+      glad_glDrawArraysInstanced   = metrics_glDrawArraysInstanced;
+      glad_glDrawElementsInstanced = metrics_glDrawElementsInstanced;
+      metrics_glDrawArrays         = NULL;
+   }
+
+   for ( int i = 0; i < array_size( metrics_stack ); i++ )
+      free( metrics_stack[i].name );
+   array_free( metrics_stack );
+   metrics_stack = NULL;
+}
+
+/**
+ * @brief Updates whether metrics are gathered from the configuration.
+ *
+ * Metrics are gathered while the overlay is shown (conf.metrics_show) or while
+ * streaming to a CSV file (conf.metrics_csv).
+ */
+void metrics_update( void )
+{
+   int csv = ( conf.metrics_csv != NULL ) && ( conf.metrics_csv[0] != '\0' );
+
+   if ( csv && ( metrics_csv == NULL ) ) {
+      metrics_csv = PHYSFS_openWrite( conf.metrics_csv );
+      if ( metrics_csv == NULL )
+         WARN( _( "Unable to open '%s' for writing metrics: %s" ),
+               conf.metrics_csv,
+               PHYSFS_getErrorByCode( PHYSFS_getLastErrorCode() ) );
+      else {
+         PHYSFS_setBuffer( metrics_csv, METRICS_CSV_BUFFER );
+         metrics_csv_cols = -1;
+      }
+   } else if ( !csv && ( metrics_csv != NULL ) ) {
+      PHYSFS_close( metrics_csv );
+      metrics_csv = NULL;
+   }
+
+   metrics_enabled = conf.metrics_show || ( metrics_csv != NULL );
+   metrics_last    = 0;
+}
+
+/**
+ * @brief Gets a metric, creating it if necessary.
+ *
+ *    @param name Name of the metric.
+ *    @param type Type of the metric if it has to be created.
+ *    @return ID of the metric.
+ */
+int metrics_register( const char *name, MetricType type )
+{
+   Metric *m;
+
+   for ( int i = 0; i < array_size( metrics_stack ); i++ )
+      if ( strcmp( metrics_stack[i].name, name ) == 0 )
+         return i;
+
+   m = &array_grow( &metrics_stack );
+   memset( m, 0, sizeof( Metric ) );
+   m->name = strdup( name );
+   m->type = type;
+   return array_size( metrics_stack ) - 1;
+}
+
+/**
+ * @brief Starts timing a zone.
+ *
+ *    @param[in,out] id ID of the metric, registered if negative.
+ *    @param name Name of the metric.
+ *    @return Counter at the start, or 0 if not being measured.
+ */
+uint64_t metrics_zoneStart( int *id, const char *name )
+{
+   if ( SDL_ThreadID() != metrics_thread )
+      return 0;
+   if ( *id < 0 )
+      *id = metrics_register( name, METRIC_TIMER );
+   return SDL_GetPerformanceCounter();
+}
+
+/**
+ * @brief Stops timing a zone.
+ *
+ *    @param id ID of the metric.
+ *    @param start Counter when the zone started.
+ */
+void metrics_zoneEnd( int id, uint64_t start )
+{
+   if ( ( id < 0 ) || ( id >= array_size( metrics_stack ) ) )
+      return;
+   metrics_stack[id].cur +=
+      (double)( SDL_GetPerformanceCounter() - start ) * metrics_tick_ms;
+}
+
+/**
+ * @brief Adds to or sets a counter or value.
+ *
+ *    @param[in,out] id ID of the metric, registered if negative.
+ *    @param name Name of the metric.
+ *    @param type Type of the metric.
+ *    @param val Value to add to a counter or set a value to.
+ */
+void metrics_add( int *id, const char *name, MetricType type, double val )
+{
+   Metric *m;
+
+   if ( SDL_ThreadID() != metrics_thread )
+      return;
+   if ( *id < 0 )
+      *id = metrics_register( name, type );
+
+   m = &metrics_stack[*id];
+   if ( m->type == METRIC_VALUE )
+      m->cur = val;
+   else
+      m->cur += val;
+}
+
+/**
+ * @brief Ends a frame, storing the metrics in their ring buffers.
+ */
+void metrics_frame( void )
+{
+   static int id_frame = -1, id_draws = -1, id_lua = -1;
+   uint64_t   t;
+
+   /* The overlay may have been toggled from the options. */
+   if ( !metrics_enabled ) {
+      metrics_draws = 0;
+      if ( conf.metrics_show )
+         metrics_update();
+      return;
+   }
+   metrics_enabled = conf.metrics_show || ( metrics_csv != NULL );
+
+   /* Built-in metrics. */
+   t = SDL_GetPerformanceCounter();
+   if ( metrics_last != 0 )
+      metrics_add( &id_frame, "frame", METRIC_VALUE,
+                   (double)( t - metrics_last ) * metrics_tick_ms );
+   metrics_last = t;
+   metrics_add( &id_draws, "draw calls", METRIC_VALUE, metrics_draws );
+   metrics_draws = 0;
+   if ( naevL != NULL )
+      metrics_add( &id_lua, "Lua memory KiB", METRIC_VALUE,
+                   lua_gc( naevL, LUA_GCCOUNT, 0 ) );
+
+   /* Push into the ring buffers. */
+   for ( int i = 0; i < array_size( metrics_stack ); i++ ) {
+      Metric *m            = &metrics_stack[i];
+      m->hist[metrics_pos] = m->cur;
+      if ( m->type != METRIC_VALUE )
+         m->cur = 0.;
+   }
+
+   if ( metrics_csv != NULL ) {
+      if ( metrics_csv_cols != array_size( metrics_stack ) ) {
+         metrics_writeHeader( metrics_csv );
+         metrics_csv_cols = array_size( metrics_stack );
+      }
+      metrics_writeRow( metrics_csv, metrics_frameid, metrics_pos );
+   }
+
+   metrics_pos   = ( metrics_pos + 1 ) % METRICS_HISTORY;
+   metrics_nhist = MIN( metrics_nhist + 1, METRICS_HISTORY );
+   metrics_frameid++;
+}
+
+/**
+ * @brief Compares timers by decreasing average.
+ */
+static int metrics_cmpTimers( const void *p1, const void *p2 )
+{
+   const double *a = p1;
+   const double *b = p2;
+   if ( a[0] > b[0] )
+      return -1;
+   else if ( a[0] < b[0] )
+      return 1;
+   return 0;
+}
+
+/**
+ * @brief Renders the metrics overlay.
+ *
+ * Shows the slowest timers by average over the history, and the most recent
+ * values of the counters.
+ *
+ *    @param x X position of the top left corner.
+ *    @param y Y position of the top left corner.
+ */
+void metrics_render( double x, double y )
+{
+   const glColour bg = { 0., 0., 0., 0.6 };
+   const glFont  *font;
+   double        *timers;
+   int            ntimers, nvalues, nlines;
+   double         h;
+
+   if ( !metrics_enabled || ( metrics_nhist == 0 ) )
+      return;
+
+   /* Sort timers by average, storing average, maximum and ID. */
+   timers  = malloc( 3 * sizeof( double ) * array_size( metrics_stack ) );
+   ntimers = 0;
+   nvalues = 0;
+   for ( int i = 0; i < array_size( metrics_stack ); i++ ) {
+      const Metric *m = &metrics_stack[i];
+      double        sum, max;
+      if ( m->type != METRIC_TIMER ) {
+         nvalues++;
+         continue;
+      }
+      sum = max = 0.;
+      for ( int j = 0; j < metrics_nhist; j++ ) {
+         sum += m->hist[j];
+         max = MAX( max, m->hist[j] );
+      }
+      timers[3 * ntimers + 0] = sum / metrics_nhist;
+      timers[3 * ntimers + 1] = max;
+      timers[3 * ntimers + 2] = i;
+      ntimers++;
+   }
+   qsort( timers, ntimers, 3 * sizeof( double ), metrics_cmpTimers );
+   ntimers = MIN( ntimers, METRICS_OVERLAY_TIMERS );
+   nvalues = MIN( nvalues, METRICS_OVERLAY_VALUES );
+
+   /* Background. */
+   font   = &gl_defFontMono;
+   h      = font->h + 3.;
+   nlines = 1 + ntimers + nvalues;
+   gl_renderRect( x - 5., y - ( nlines - 1 ) * h - 5., 44. * font->h * 0.6,
+                  nlines * h + 5., &bg );
+
+   gl_print( font, x, y, &cFontGrey, "%-24s %7s %7s", _( "ms/frame" ),
+             _( "avg" ), _( "max" ) );
+   y -= h;
+   for ( int i = 0; i < ntimers; i++ ) {
+      const Metric *m = &metrics_stack[(int)timers[3 * i + 2]];
+      gl_print( font, x, y, &cFontWhite, "%-24.24s %7.2f %7.2f", m->name,
+                timers[3 * i + 0], timers[3 * i + 1] );
+      y -= h;
+   }
+   for ( int i = 0, n = 0; ( i < array_size( metrics_stack ) ) &&
+                           ( n < nvalues );
+         i++ ) {
+      const Metric *m    = &metrics_stack[i];
+      int           last = ( metrics_pos + METRICS_HISTORY - 1 ) %
+                 METRICS_HISTORY;
+      if ( m->type == METRIC_TIMER )
+         continue;
+      gl_print( font, x, y, &cFontGreen, "%-24.24s %7.6g", m->name,
+                m->hist[last] );
+      y -= h;
+      n++;
+   }
+
+   free( timers );
+}
+
+/**
+ * @brief Writes formatted text to a file.
+ */
+static void metrics_writef( PHYSFS_File *f, const char *fmt, ... )
+{
+   char    buf[STRMAX_SHORT];
+   va_list ap;
+   int     len;
+
+   va_start( ap, fmt );
+   len = vsnprintf( buf, sizeof( buf ), fmt, ap );
+   va_end( ap );
+   if ( len > 0 )
+      PHYSFS_writeBytes( f, buf, MIN( len, (int)sizeof( buf ) - 1 ) );
+}
+
+/**
+ * @brief Writes the CSV header with all the current metrics.
+ */
+static void metrics_writeHeader( PHYSFS_File *f )
+{
+   metrics_writef( f, "frame" );
+   for ( int i = 0; i < array_size( metrics_stack ); i++ )
+      metrics_writef( f, ",\"%s\"", metrics_stack[i].name );
+   metrics_writef( f, "\n" );
+}
+
+/**
+ * @brief Writes a CSV row from a slot of the ring buffers.
+ */
+static void metrics_writeRow( PHYSFS_File *f, unsigned int frame, int slot )
+{
+   metrics_writef( f, "%u", frame );
+   for ( int i = 0; i < array_size( metrics_stack ); i++ )
+      metrics_writef( f, ",%.6g", metrics_stack[i].hist[slot] );
+   metrics_writef( f, "\n" );
+}
+
+/**
+ * @brief Dumps the history of all the metrics to a CSV file.
+ *
+ *    @param path Path of the file relative to the write directory.
+ *    @return 0 on success.
+ */
+int metrics_dump( const char *path )
+{
+   PHYSFS_File *f = PHYSFS_openWrite( path );
+   if ( f == NULL ) {
+      WARN( _( "Unable to open '%s' for writing metrics: %s" ), path,
+            PHYSFS_getErrorByCode( PHYSFS_getLastErrorCode() ) );
+      return -1;
+   }
+
+   /* Oldest frame first. */
+   metrics_writeHeader( f );
+   for ( int i = 0; i < metrics_nhist; i++ ) {
+      int slot = ( metrics_pos - metrics_nhist + i + METRICS_HISTORY ) %
+                 METRICS_HISTORY;
+      metrics_writeRow( f, metrics_frameid - metrics_nhist + i, slot );
+   }
+
+   PHYSFS_close( f );
+   return 0;
+}
+
+/*
+ * Draw call wrappers.
+ */
+static void APIENTRY metrics_drawArrays( GLenum mode, GLint first,
+                                         GLsizei count )
+{
+   metrics_draws++;
+   metrics_glDrawArrays( mode, first, count );
+}
+static void APIENTRY metrics_drawElements( GLenum mode, GLsizei count,
+                                           GLenum type, const void *indices )
+{
+   metrics_draws++;
+   metrics_glDrawElements( mode, count, type, indices );
+}
+static void APIENTRY metrics_drawArraysInstanced( GLenum mode, GLint first,
+                                                  GLsizei count,
+                                                  GLsizei instancecount )
+{
+   metrics_draws++;
+   metrics_glDrawArraysInstanced( mode, first, count, instancecount );
+}
+static void APIENTRY metrics_drawElementsInstanced( GLenum mode, GLsizei count,
+                                                    GLenum      type,
+                                                    const void *indices,
+                                                    GLsizei instancecount )
+{
+   metrics_draws++;
+   metrics_glDrawElementsInstanced( mode, count, type, indices, instancecount );
+}
@@ -0,0 +1,55 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+#pragma once
+
+#include <stdint.h>
+
+#define METRICS_HISTORY 256 /**< Frames of history kept for each metric. */
+
+/**
+ * @brief Types of metrics.
+ */
+typedef enum MetricType_ {
+   METRIC_TIMER,   /**< Milliseconds spent per frame. */
+   METRIC_COUNTER, /**< Sum of the values added during a frame. */
+   METRIC_VALUE,   /**< Last value set. */
+} MetricType;
+
+extern int metrics_enabled;
+
+/* Init. */
+int  metrics_init( void );
+void metrics_exit( void );
+void metrics_update( void );
+
+/* Gathering. */
+int      metrics_register( const char *name, MetricType type );
+uint64_t metrics_zoneStart( int *id, const char *name );
+void     metrics_zoneEnd( int id, uint64_t start );
+void     metrics_add( int *id, const char *name, MetricType type, double val );
+void     metrics_frame( void );
+
+/* Output. */
+void metrics_render( double x, double y );
+int  metrics_dump( const char *path );
+
+/*
+ * Call sites register themselves the first time they are reached with
+ * metrics enabled, so the hot path is a branch and a timer read.
+ */
+#define NMetricsZone( ctx, name )                                              \
+   static int ctx##_metric = -1;                                               \
+   uint64_t   ctx##_mstart =                                                   \
+      metrics_enabled ? metrics_zoneStart( &ctx##_metric, name ) : 0
+#define NMetricsZoneEnd( ctx )                                                 \
+   do {                                                                        \
+      if ( ctx##_mstart != 0 )                                                 \
+         metrics_zoneEnd( ctx##_metric, ctx##_mstart );                        \
+   } while ( 0 )
+#define NMetricsAdd( name, type, val )                                         \
+   do {                                                                        \
+      static int _metric = -1;                                                 \
+      if ( metrics_enabled )                                                   \
+         metrics_add( &_metric, name, type, val );                             \
+   } while ( 0 )
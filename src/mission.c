@@ -17,6 +17,7 @@
 #include "mission.h"
 
 #include "array.h"
+#include "candidate.h"
 #include "cond.h"
 #include "faction.h"
 #include "gui_osd.h"
@@ -31,13 +32,24 @@
 #include "ntracing.h"
 #include "nxml.h"
 #include "nxml_lua.h"
+#include "opengl_tex.h"
 #include "player.h"
 #include "player_fleet.h"
 #include "rng.h"
 #include "space.h"
+#include "threadpool.h"
 
 #define XML_MISSION_TAG "mission" /**< XML mission tag. */
 
+/**
+ * @brief For threaded loading of missions.
+ */
+typedef struct MissionThreadData_ {
+   char       *filename;
+   MissionData misn;
+   int         ret;
+} MissionThreadData;
+
 /*
  * current player missions
  */
@@ -50,6 +62,8 @@ static char       **player_missions_failed =
  * mission stack
  */
 static MissionData *mission_stack = NULL; /**< Unmutable after creation */
+static CandidateIndex *mission_index = NULL; /**< Missions by location. */
+static char *mission_chapter = NULL; /**< Chapter the matches are for. */
 
 /*
  * prototypes
@@ -61,16 +75,21 @@ static int  mission_init( Mission *mission, const MissionData *misn, int genid,
                           int create, unsigned int *id );
 static void mission_freeData( MissionData *mission );
 /* Matching. */
-static int mission_meetConditionals( const MissionData *misn );
+static void missions_buildIndex( void );
+static void missions_updateChapter( void );
+static int  mission_meetConditionals( const MissionData *misn );
 static int mission_meetReq( const MissionData *misn, int faction,
                             const Spob *pnt, const StarSystem *sys );
 static int mission_matchFaction( const MissionData *misn, int faction );
 static int mission_location( const char *loc );
 /* Loading. */
-static int missions_cmp( const void *a, const void *b );
-static int mission_parseFile( const char *file, MissionData *temp );
-static int mission_parseXML( MissionData *temp, const xmlNodePtr parent );
-static int missions_parseActive( xmlNodePtr parent );
+static int  missions_cmp( const void *a, const void *b );
+static int  mission_parseFile( const char *file, MissionData *temp );
+static int  mission_parseFileData( const char *file, MissionData *temp );
+static void mission_parseFileLua( MissionData *temp, const char *file );
+static int  mission_parseThread( void *ptr );
+static int  mission_parseXML( MissionData *temp, const xmlNodePtr parent );
+static int  missions_parseActive( xmlNodePtr parent );
 /* Misc. */
 static const char *mission_markerTarget( const MissionMarker *m );
 static int         mission_markerLoad( Mission *misn, xmlNodePtr node );
@@ -234,26 +253,85 @@ int mission_alreadyRunning( const MissionData *misn )
    return n;
 }
 
-static int mission_meetConditionals( const MissionData *misn )
+/**
+ * @brief Builds the index of missions by location.
+ *
+ * Missions are bucketed by the most specific of their spob, system or
+ * factions. Has to be rebuilt whenever the mission data changes, as it points
+ * to the names in it.
+ */
+static void missions_buildIndex( void )
 {
-   /* If chapter, must match chapter. */
-   if ( misn->avail.chapter_re != NULL ) {
-      pcre2_match_data *match_data =
+   candidate_free( mission_index );
+   mission_index = candidate_create();
+   for ( int i = 0; i < array_size( mission_stack ); i++ ) {
+      const MissionData *misn = &mission_stack[i];
+      if ( misn->avail.spob != NULL )
+         candidate_addName( mission_index, misn->avail.loc, CANDIDATE_SPOB,
+                            misn->avail.spob, i );
+      else if ( misn->avail.system != NULL )
+         candidate_addName( mission_index, misn->avail.loc, CANDIDATE_SYSTEM,
+                            misn->avail.system, i );
+      else if ( array_size( misn->avail.factions ) > 0 ) {
+         for ( int j = 0; j < array_size( misn->avail.factions ); j++ )
+            candidate_addFaction( mission_index, misn->avail.loc,
+                                  misn->avail.factions[j], i );
+      } else
+         candidate_addAny( mission_index, misn->avail.loc, i );
+   }
+   candidate_finalize( mission_index );
+
+   /* Chapter matches have to be redone. */
+   free( mission_chapter );
+   mission_chapter = NULL;
+}
+
+/**
+ * @brief Matches the chapter regexes of all the missions against the current
+ * chapter, only doing work when the chapter changed.
+ */
+static void missions_updateChapter( void )
+{
+   if ( ( mission_chapter != NULL ) &&
+        ( strcmp( mission_chapter, player.chapter ) == 0 ) )
+      return;
+   free( mission_chapter );
+   mission_chapter = strdup( player.chapter );
+
+   for ( int i = 0; i < array_size( mission_stack ); i++ ) {
+      MissionData      *misn = &mission_stack[i];
+      pcre2_match_data *match_data;
+      int               rc;
+
+      misn->avail.chapter_match = 0;
+      if ( misn->avail.chapter_re == NULL )
+         continue;
+
+      match_data =
          pcre2_match_data_create_from_pattern( misn->avail.chapter_re, NULL );
-      int rc = pcre2_match( misn->avail.chapter_re, (PCRE2_SPTR)player.chapter,
-                            strlen( player.chapter ), 0, 0, match_data, NULL );
+      rc = pcre2_match( misn->avail.chapter_re, (PCRE2_SPTR)mission_chapter,
+                        strlen( mission_chapter ), 0, 0, match_data, NULL );
       pcre2_match_data_free( match_data );
       if ( rc < 0 ) {
          switch ( rc ) {
          case PCRE2_ERROR_NOMATCH:
-            return -1;
+            misn->avail.chapter_match = -1;
+            break;
          default:
             WARN( _( "Matching error %d" ), rc );
             break;
          }
       } else if ( rc == 0 )
-         return 1;
+         misn->avail.chapter_match = 1;
    }
+}
+
+static int mission_meetConditionals( const MissionData *misn )
+{
+   /* If chapter, must match chapter. */
+   missions_updateChapter();
+   if ( misn->avail.chapter_match != 0 )
+      return misn->avail.chapter_match;
 
    /* Must not be already done or running if unique. */
    if ( mis_isFlag( misn, MISSION_UNIQUE ) &&
@@ -325,13 +403,20 @@ static int mission_meetReq( const MissionData *misn, int faction,
 void missions_run( MissionAvailability loc, int faction, const Spob *pnt,
                    const StarSystem *sys )
 {
-   for ( int i = 0; i < array_size( mission_stack ); i++ ) {
+   int *candidates = array_create( int );
+
+   /* Only look at the missions that can appear here. */
+   candidate_query( mission_index, &candidates, loc,
+                    ( pnt != NULL ) ? pnt->name : NULL,
+                    ( sys != NULL ) ? sys->name : NULL, faction );
+
+   for ( int c = 0; c < array_size( candidates ); c++ ) {
       Mission      mission;
       double       chance;
-      MissionData *misn = &mission_stack[i];
+      MissionData *misn = &mission_stack[candidates[c]];
 
       if ( naev_isQuit() )
-         return;
+         break;
 
       if ( misn->avail.loc != loc )
          continue;
@@ -349,6 +434,8 @@ void missions_run( MissionAvailability loc, int faction, const Spob *pnt,
             &mission ); /* it better clean up for itself or we do it */
       }
    }
+
+   array_free( candidates );
 }
 
 /**
@@ -931,14 +1018,20 @@ Mission *missions_genList( int faction, const Spob *pnt, const StarSystem *sys,
                            MissionAvailability loc )
 {
    int      rep;
-   Mission *tmp = array_create( Mission );
+   Mission *tmp        = array_create( Mission );
+   int     *candidates = array_create( int );
 
    NTracingZone( _ctx, 1 );
 
+   /* Only look at the missions that can appear here. */
+   candidate_query( mission_index, &candidates, loc,
+                    ( pnt != NULL ) ? pnt->name : NULL,
+                    ( sys != NULL ) ? sys->name : NULL, faction );
+
    /* Find available missions. */
-   for ( int i = 0; i < array_size( mission_stack ); i++ ) {
+   for ( int c = 0; c < array_size( candidates ); c++ ) {
       double       chance;
-      MissionData *misn = &mission_stack[i];
+      MissionData *misn = &mission_stack[candidates[c]];
       if ( misn->avail.loc != loc )
          continue;
 
@@ -966,6 +1059,8 @@ Mission *missions_genList( int faction, const Spob *pnt, const StarSystem *sys,
       }
    }
 
+   array_free( candidates );
+
    /* Sort. */
    if ( array_size( tmp ) > 0 )
       qsort( tmp, array_size( tmp ), sizeof( Mission ), mission_compare );
@@ -1077,15 +1172,6 @@ static int mission_parseXML( MissionData *temp, const xmlNodePtr parent )
       WARN( _( "Unknown node '%s' in mission '%s'" ), node->name, temp->name );
    } while ( xml_nextNode( node ) );
 
-   /* Compile conditional chunk. */
-   if ( temp->avail.cond != NULL ) {
-      temp->avail.cond_chunk = cond_compile( temp->avail.cond );
-      if ( temp->avail.cond_chunk == LUA_NOREF ||
-           temp->avail.cond_chunk == LUA_REFNIL )
-         WARN( _( "Mission '%s' failed to compile Lua conditional!" ),
-               temp->name );
-   }
-
    /* Compile regex for chapter matching. */
    if ( temp->avail.chapter != NULL ) {
       int        errornumber;
@@ -1145,17 +1231,40 @@ int missions_load( void )
 #if DEBUGGING
    Uint32 time = SDL_GetTicks();
 #endif /* DEBUGGING */
-   char **mission_files;
+   ThreadQueue       *tq = vpool_create();
+   MissionThreadData *mdata;
+   char             **mission_files;
 
    /* Run over missions. */
    mission_files = ndata_listRecursive( MISSION_DATA_PATH );
-   mission_stack =
-      array_create_size( MissionData, array_size( mission_files ) );
+   mdata = array_create_size( MissionThreadData, array_size( mission_files ) );
    for ( int i = 0; i < array_size( mission_files ); i++ ) {
-      mission_parseFile( mission_files[i], NULL );
-      free( mission_files[i] );
+      MissionThreadData *md = &array_grow( &mdata );
+      md->filename          = mission_files[i];
    }
    array_free( mission_files );
+
+   /* Read and parse the files in parallel, this also compiles the Lua into
+    * the bytecode cache. Enqueue the jobs after the data array is done. */
+   SDL_GL_MakeCurrent( gl_screen.window, NULL );
+   for ( int i = 0; i < array_size( mdata ); i++ )
+      vpool_enqueue( tq, mission_parseThread, &mdata[i] );
+   vpool_wait( tq );
+   vpool_cleanup( tq );
+   SDL_GL_MakeCurrent( gl_screen.window, gl_screen.context );
+
+   /* Loading into naevL has to be done serially. */
+   mission_stack = array_create_size( MissionData, array_size( mdata ) );
+   for ( int i = 0; i < array_size( mdata ); i++ ) {
+      MissionThreadData *md = &mdata[i];
+      if ( !md->ret ) {
+         MissionData *misn = &array_grow( &mission_stack );
+         *misn             = md->misn;
+         mission_parseFileLua( misn, md->filename );
+      }
+      free( md->filename );
+   }
+   array_free( mdata );
    array_shrink( &mission_stack );
 
 #ifdef DEBUGGING
@@ -1171,6 +1280,7 @@ int missions_load( void )
     * first. */
    qsort( mission_stack, array_size( mission_stack ), sizeof( MissionData ),
           missions_cmp );
+   missions_buildIndex();
 
 #if DEBUGGING
    if ( conf.devmode ) {
@@ -1191,9 +1301,44 @@ int missions_load( void )
  * @brief Parses a single mission.
  *
  *    @param file Source file path.
- *    @param temp Data to load into, or NULL for initial load.
+ *    @param temp Data to load into.
+ *    @return 0 on success.
  */
 static int mission_parseFile( const char *file, MissionData *temp )
+{
+   int ret = mission_parseFileData( file, temp );
+   if ( ret == 0 )
+      mission_parseFileLua( temp, file );
+   return ret;
+}
+
+/**
+ * @brief Parses a single mission in a thread.
+ */
+static int mission_parseThread( void *ptr )
+{
+   MissionThreadData *data = ptr;
+   data->ret = mission_parseFileData( data->filename, &data->misn );
+   /* Render if necessary. */
+   if ( naev_shouldRenderLoadscreen() ) {
+      gl_contextSet();
+      naev_renderLoadscreen();
+      gl_contextUnset();
+   }
+   return data->ret;
+}
+
+/**
+ * @brief Reads and parses the header of a mission, without touching naevL.
+ *
+ * The Lua is only compiled into the bytecode cache, mission_parseFileLua()
+ * has to be called afterwards from the main thread to load it.
+ *
+ *    @param file Source file path.
+ *    @param temp Data to load into, only modified on success.
+ *    @return 0 on success.
+ */
+static int mission_parseFileData( const char *file, MissionData *temp )
 {
    xmlDocPtr   doc;
    xmlNodePtr  node;
@@ -1246,31 +1391,47 @@ static int mission_parseFile( const char *file, MissionData *temp )
       return -1;
    }
 
-   if ( temp == NULL )
-      temp = &array_grow( &mission_stack );
    mission_parseXML( temp, node );
    temp->lua        = filebuf;
    temp->sourcefile = strdup( file );
 
-   /* Clear chunk if already loaded. */
-   if ( temp->chunk != LUA_NOREF ) {
-      luaL_unref( naevL, LUA_REGISTRYINDEX, temp->chunk );
-      temp->chunk = LUA_NOREF;
+   /* Clean up. */
+   xmlFreeDoc( doc );
+
+   /* Warm up the bytecode cache, errors get reported when loading. */
+   nlua_precompile( temp->lua, strlen( temp->lua ), temp->name );
+   if ( temp->avail.cond != NULL )
+      cond_precompile( temp->avail.cond );
+
+   return 0;
+}
+
+/**
+ * @brief Compiles the conditional and loads the Lua of a parsed mission.
+ *
+ *    @param temp Mission to load the Lua of.
+ *    @param file Source file path.
+ */
+static void mission_parseFileLua( MissionData *temp, const char *file )
+{
+   int ret;
+
+   /* Compile conditional chunk. */
+   if ( temp->avail.cond != NULL ) {
+      temp->avail.cond_chunk = cond_compile( temp->avail.cond );
+      if ( temp->avail.cond_chunk == LUA_NOREF ||
+           temp->avail.cond_chunk == LUA_REFNIL )
+         WARN( _( "Mission '%s' failed to compile Lua conditional!" ),
+               temp->name );
    }
 
    /* Load the chunk. */
-   int ret =
-      luaL_loadbuffer( naevL, temp->lua, strlen( temp->lua ), temp->name );
+   ret = nlua_loadbuffer( naevL, temp->lua, strlen( temp->lua ), temp->name );
    if ( ret == LUA_ERRSYNTAX )
       WARN( _( "Mission Lua '%s' syntax error: %s" ), file,
             lua_tostring( naevL, -1 ) );
    else
       temp->chunk = luaL_ref( naevL, LUA_REGISTRYINDEX );
-
-   /* Clean up. */
-   xmlFreeDoc( doc );
-
-   return 0;
 }
 
 /**
@@ -1286,6 +1447,10 @@ void missions_free( void )
       mission_freeData( &mission_stack[i] );
    array_free( mission_stack );
    mission_stack = NULL;
+   candidate_free( mission_index );
+   mission_index = NULL;
+   free( mission_chapter );
+   mission_chapter = NULL;
 
    /* Free the player mission stack. */
    array_free( player_missions );
@@ -1695,9 +1860,10 @@ int mission_reload( const char *name )
       return -1;
    save = *temp;
    res  = mission_parseFile( save.sourcefile, temp );
-   if ( res == 0 )
+   if ( res == 0 ) {
       mission_freeData( &save );
-   else
+      missions_buildIndex();
+   } else
       *temp = save;
    return res;
 }
@@ -40,10 +40,11 @@ typedef struct MissionAvail_s {
                   once). */
 
    /* For specific cases */
-   char       *spob;       /**< Spob name. */
-   char       *system;     /**< System name. */
-   char       *chapter;    /**< Chapter name. */
-   pcre2_code *chapter_re; /**< Compiled regex chapter if applicable. */
+   char       *spob;          /**< Spob name. */
+   char       *system;        /**< System name. */
+   char       *chapter;       /**< Chapter name. */
+   pcre2_code *chapter_re;    /**< Compiled regex chapter if applicable. */
+   int         chapter_match; /**< Cached match against current chapter. */
 
    /* For generic cases */
    int *factions; /**< Array (array.h): To certain factions. */
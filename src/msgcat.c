@@ -171,6 +171,44 @@ uint32_t msgcat_nstringsFromHeader( const char buf[12] )
 }
 
 
+/**
+ * @brief Return the number of strings in a message catalog.
+ */
+uint32_t msgcat_nstrings( const msgcat_t* p )
+{
+   if (p->map_size < 12)
+      return 0;
+   return msgcat_nstringsFromHeader( (const char *)p->map );
+}
+
+
+/**
+ * @brief Return the i-th translation stored in a message catalog.
+ *
+ * @param p The message catalog.
+ * @param i Index of the string, less than msgcat_nstrings().
+ * @param[out] len Length of the translation, including all the NUL-separated plural forms.
+ * @return The translation, or NULL if the catalog is malformed.
+ */
+const char* msgcat_translation( const msgcat_t* p, uint32_t i, size_t *len )
+{
+   const uint32_t *mo = p->map;
+   size_t size = p->map_size;
+   int sw = *mo - 0x950412de;
+   uint32_t n = swapc(mo[2], sw);
+   uint32_t t = swapc(mo[4], sw);
+   if (i>=n || n>=size/4 || t>=size-4*n || t%4)
+      return NULL;
+   t/=4;
+   uint32_t tl = swapc(mo[t+2*i], sw);
+   uint32_t ts = swapc(mo[t+2*i+1], sw);
+   if (ts >= size || tl >= size-ts || ((char *)p->map)[ts+tl])
+      return NULL;
+   *len = tl;
+   return (const char *)p->map + ts;
+}
+
+
 /* ===================== https://git.musl-libc.org/cgit/musl/tree/src/locale/pleval.c ======================== */
 /*
 grammar:
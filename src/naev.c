@@ -27,6 +27,7 @@
 /** @endcond */
 
 #include "ai.h"
+#include "array.h"
 #include "background.h"
 #include "camera.h"
 #include "cond.h"
@@ -52,6 +53,7 @@
 #include "map_overlay.h"
 #include "map_system.h"
 #include "menu.h"
+#include "metrics.h"
 #include "mission.h"
 #include "music.h"
 #include "ndata.h"
@@ -62,6 +64,7 @@
 #include "nlua_data.h"
 #include "nlua_file.h"
 #include "nlua_gfx.h"
+#include "nlua_linopt.h"
 #include "nlua_naev.h"
 #include "nlua_rnd.h"
 #include "nlua_tex.h"
@@ -94,6 +97,11 @@
 #include "weapon.h"
 
 #define VERSION_FILE "VERSION" /**< Version file by default. */
+#define UPDATE_DANGER_RANGE                                                    \
+   5000. /**< Range around the player in which danger calls for finer time    \
+            compression steps. */
+#define UPDATE_DANGER_DIV                                                      \
+   2. /**< How many times smaller than fps_min steps are with danger. */
 
 static int          quit         = 0; /**< For primary loop */
 Uint32              SDL_LOOPDONE = 0; /**< For custom event to exit loops. */
@@ -137,6 +145,7 @@ static void   fps_init( void );
 static double fps_elapsed( void );
 static void   fps_control( void );
 static void   update_all( int dohooks );
+static int    update_isDangerous( void );
 /* Misc. */
 static void loadscreen_update( double done, const char *msg );
 void        main_loop( int nested ); /* externed in dialogue.c */
@@ -299,6 +308,7 @@ int main( int argc, char **argv )
       exit( EXIT_FAILURE );
    }
    window_caption();
+   metrics_init();
 
    /* Have to set up fonts before rendering anything. */
    // DEBUG("Using '%s' as main font and '%s' as monospace font.",
@@ -309,6 +319,8 @@ int main( int argc, char **argv )
                 FONT_PATH_PREFIX, 0 ); /* small font */
    gl_fontInit( &gl_defFontMono, _( FONT_MONOSPACE_PATH ), conf.font_size_def,
                 FONT_PATH_PREFIX, 0 );
+   /* Generate the glyphs of the active language in the background. */
+   gl_fontPrewarm();
 
    /* Detect size changes that occurred after window creation. */
    naev_resize();
@@ -495,7 +507,9 @@ int main( int argc, char **argv )
    difficulty_free(); /* Clean up difficulties. */
    music_exit();      /* Kills Lua state. */
    lua_exit();        /* Closes Lua state, and invalidates all Lua. */
+   linoptL_exit();    /* Saves the linear program solution cache. */
    sound_exit();      /* Kills the sound */
+   metrics_exit();    /* Restores the draw calls. */
    gl_exit();         /* Kills video output */
 
    /* Has to be run last or it will mess up sound settings. */
@@ -647,81 +661,307 @@ static void loadscreen_unload( void )
 }
 
 /**
- * @brief Loads all the data, makes main() simpler.
+ * @brief Loading stages, in an order that respects their dependencies.
  */
-#define LOADING_STAGES 17. /**< Amount of loading stages. */
-void load_all( void )
-{
-   NTracingFrameMarkStart( "load_all" );
+typedef enum LoadStageID_ {
+   LOAD_SLOTS,
+   LOAD_COMMODITIES,
+   LOAD_SPFX,
+   LOAD_EFFECTS,
+   LOAD_DTYPES,
+   LOAD_OUTFITS,
+   LOAD_SHIPS,
+   LOAD_FACTIONS,
+   LOAD_OUTFITS_POST,
+   LOAD_AI,
+   LOAD_TECH,
+   LOAD_SPACE,
+   LOAD_EVENTS,
+   LOAD_MISSIONS,
+   LOAD_UNIDIFFS,
+   LOAD_MAPS,
+   LOAD_SAFELANES,
+   LOAD_DETAILS,
+   LOAD_NSTAGES, /**< Number of stages, not a stage. */
+} LoadStageID;
+
+#define LOAD_DEP( s ) ( 1U << ( s ) ) /**< Dependency on a stage. */
+#define LOAD_DEP_ALL ( LOAD_DEP( LOAD_DETAILS ) - 1 ) /**< All but details. */
 
-   int stage = 0;
-   /* We can do fast stuff here. */
-   sp_load();
+/**
+ * @brief Where a loading stage can run.
+ */
+typedef enum LoadLane_ {
+   LOAD_LANE_MAIN,   /**< Main thread, anything touching Lua or OpenGL. */
+   LOAD_LANE_WORKER, /**< Threadpool, only plain data parsing. */
+} LoadLane;
 
-   /* order is very important as they're interdependent */
-   loadscreen_update( ++stage / LOADING_STAGES, _( "Loading Commodities…" ) );
-   commodity_load(); /* dep for space */
+/**
+ * @brief A loading stage.
+ */
+typedef struct LoadStage_ {
+   const char *name;      /**< Name for the timing report. */
+   const char *msg;       /**< Loading screen message, NULL for workers. */
+   int ( *load )( void ); /**< Function doing the loading. */
+   LoadLane    lane;      /**< Where the stage runs. */
+   uint32_t    deps;      /**< Stages that have to be done first. */
+   double      weight;    /**< Rough relative cost, for the progress. */
+} LoadStage;
 
-   loadscreen_update( ++stage / LOADING_STAGES,
-                      _( "Loading Special Effects…" ) );
-   spfx_load(); /* no dep */
+/**
+ * @brief Continues loading the outfits once ships and factions are there.
+ */
+static int load_outfitsPost( void )
+{
+   return outfit_loadPost();
+}
 
-   loadscreen_update( ++stage / LOADING_STAGES, _( "Loading Effects…" ) );
-   effect_load(); /* no dep */
+/**
+ * @brief Initializes the safe lanes, the computation itself is deferred.
+ */
+static int load_safelanes( void )
+{
+   safelanes_init();
+   return 0;
+}
 
-   loadscreen_update( ++stage / LOADING_STAGES, _( "Loading Damage Types…" ) );
-   dtype_load(); /* dep for outfits */
+/**
+ * @brief Initializes everything that needs all the data to be loaded.
+ */
+static int load_details( void )
+{
+   difficulty_load();
+   background_init();
+   map_load();
+   map_system_load();
+   space_loadLua();
+   pilots_init();
+   weapon_init();
+   player_init(); /* Initialize player stuff. */
+   return 0;
+}
 
-   loadscreen_update( ++stage / LOADING_STAGES, _( "Loading Outfits…" ) );
-   outfit_load(); /* dep for ships, factions */
+/**
+ * @brief The loading stages. The dependencies are what used to be documented
+ * as comments when everything was loaded in sequence.
+ */
+static const LoadStage load_stages[LOAD_NSTAGES] = {
+   [LOAD_SLOTS]        = { "slots", N_( "Loading Slots…" ), sp_load,
+                           LOAD_LANE_MAIN, 0, 0.2 },
+   [LOAD_COMMODITIES]  = { "commodities", N_( "Loading Commodities…" ),
+                           commodity_load, LOAD_LANE_MAIN, 0, 1. },
+   [LOAD_SPFX]         = { "spfx", N_( "Loading Special Effects…" ),
+                           spfx_load, LOAD_LANE_MAIN, 0, 1. },
+   [LOAD_EFFECTS]      = { "effects", N_( "Loading Effects…" ), effect_load,
+                           LOAD_LANE_MAIN, 0, 1. },
+   [LOAD_DTYPES]       = { "dtypes", NULL, dtype_load, LOAD_LANE_WORKER, 0,
+                           0.2 },
+   [LOAD_OUTFITS]      = { "outfits", N_( "Loading Outfits…" ), outfit_load,
+                           LOAD_LANE_MAIN,
+                           LOAD_DEP( LOAD_SLOTS ) | LOAD_DEP( LOAD_SPFX ) |
+                              LOAD_DEP( LOAD_EFFECTS ) |
+                              LOAD_DEP( LOAD_DTYPES ),
+                           3. },
+   [LOAD_SHIPS]        = { "ships", N_( "Loading Ships…" ), ships_load,
+                           LOAD_LANE_MAIN, LOAD_DEP( LOAD_OUTFITS ), 3. },
+   [LOAD_FACTIONS]     = { "factions", N_( "Loading Factions…" ),
+                           factions_load, LOAD_LANE_MAIN,
+                           LOAD_DEP( LOAD_SHIPS ), 1. },
+   [LOAD_OUTFITS_POST] = { "outfits_post", N_( "Loading Outfits…" ),
+                           load_outfitsPost, LOAD_LANE_MAIN,
+                           LOAD_DEP( LOAD_SHIPS ) | LOAD_DEP( LOAD_FACTIONS ),
+                           0.5 },
+   [LOAD_AI]           = { "ai", N_( "Loading AI…" ), ai_load, LOAD_LANE_MAIN,
+                           LOAD_DEP( LOAD_FACTIONS ) |
+                              LOAD_DEP( LOAD_OUTFITS_POST ),
+                           1. },
+   [LOAD_TECH]         = { "tech", NULL, tech_load, LOAD_LANE_WORKER,
+                           LOAD_DEP( LOAD_COMMODITIES ) |
+                              LOAD_DEP( LOAD_OUTFITS ) | LOAD_DEP( LOAD_SHIPS ),
+                           0.5 },
+   [LOAD_SPACE]        = { "space", N_( "Loading the Universe…" ), space_load,
+                           LOAD_LANE_MAIN,
+                           LOAD_DEP( LOAD_COMMODITIES ) |
+                              LOAD_DEP( LOAD_FACTIONS ) | LOAD_DEP( LOAD_AI ) |
+                              LOAD_DEP( LOAD_TECH ),
+                           4. },
+   [LOAD_EVENTS]       = { "events", N_( "Loading Events…" ), events_load,
+                           LOAD_LANE_MAIN, LOAD_DEP( LOAD_SPACE ), 1. },
+   [LOAD_MISSIONS]     = { "missions", N_( "Loading Missions…" ),
+                           missions_load, LOAD_LANE_MAIN,
+                           LOAD_DEP( LOAD_SPACE ), 2. },
+   [LOAD_UNIDIFFS]     = { "unidiffs", NULL, diff_loadAvailable,
+                           LOAD_LANE_WORKER, 0, 0.5 },
+   [LOAD_MAPS]         = { "maps", NULL, outfit_mapParse, LOAD_LANE_WORKER,
+                           LOAD_DEP( LOAD_OUTFITS ) | LOAD_DEP( LOAD_SPACE ),
+                           0.5 },
+   [LOAD_SAFELANES]    = { "safelanes", NULL, load_safelanes,
+                           LOAD_LANE_WORKER, 0, 0.1 },
+   [LOAD_DETAILS]      = { "details", N_( "Initializing Details…" ),
+                           load_details, LOAD_LANE_MAIN, LOAD_DEP_ALL, 2. },
+};
 
-   loadscreen_update( ++stage / LOADING_STAGES, _( "Loading Ships…" ) );
-   ships_load(); /* dep for fleet */
+/**
+ * @brief State of the loading stages while running load_all().
+ */
+static struct {
+   SDL_mutex *lock;                /**< Guards the state. */
+   SDL_cond  *cond;                /**< Signalled when a stage finishes. */
+   uint32_t   started;             /**< Stages that were started. */
+   uint32_t   done;                /**< Stages that are done. */
+   int        running;             /**< Worker stages running. */
+   double     done_weight;         /**< Weight of the stages done. */
+   Uint64     start;               /**< Performance counter at the start. */
+   Uint64     begin[LOAD_NSTAGES]; /**< When each stage began. */
+   Uint64     end[LOAD_NSTAGES];   /**< When each stage ended. */
+   int        prev[LOAD_NSTAGES];  /**< Previous stage on the main lane. */
+} load_state;
 
-   loadscreen_update( ++stage / LOADING_STAGES, _( "Loading Factions…" ) );
-   factions_load(); /* dep for fleet, space, missions, AI */
+/**
+ * @brief Runs a loading stage and marks it as done.
+ */
+static void load_stageRun( LoadStageID id )
+{
+   NTracingZone( _ctx, 1 );
+   load_state.begin[id] = SDL_GetPerformanceCounter();
+   load_stages[id].load();
+   load_state.end[id] = SDL_GetPerformanceCounter();
+   NTracingZoneEnd( _ctx );
 
-   /* Handle outfit loading part that may use ships and factions. */
-   outfit_loadPost();
+   SDL_mutexP( load_state.lock );
+   load_state.done |= LOAD_DEP( id );
+   load_state.done_weight += load_stages[id].weight;
+   if ( load_stages[id].lane == LOAD_LANE_WORKER )
+      load_state.running--;
+   SDL_CondSignal( load_state.cond );
+   SDL_mutexV( load_state.lock );
+}
 
-   loadscreen_update( ++stage / LOADING_STAGES, _( "Loading AI…" ) );
-   ai_load(); /* dep for fleets */
+/**
+ * @brief Threadpool job running a worker stage.
+ */
+static int load_stageThread( void *data )
+{
+   load_stageRun( (LoadStageID)(intptr_t)data );
+   return 0;
+}
 
-   loadscreen_update( ++stage / LOADING_STAGES, _( "Loading Techs…" ) );
-   tech_load(); /* dep for space */
+#if DEBUGGING
+/**
+ * @brief Prints how long loading took and the stages that it waited on.
+ *
+ * Walks back from the last stage to finish, each time going to whichever
+ * dependency (or previous stage on the main lane) finished last.
+ */
+static void load_report( void )
+{
+   double freq = (double)SDL_GetPerformanceFrequency();
+   double work = 0.;
+   int    cur  = 0;
+
+   for ( int i = 0; i < LOAD_NSTAGES; i++ ) {
+      work += ( load_state.end[i] - load_state.begin[i] ) / freq;
+      if ( load_state.end[i] > load_state.end[cur] )
+         cur = i;
+   }
+   DEBUG( _( "Loaded data in %.3f s (%.3f s of work), critical path:" ),
+          ( load_state.end[cur] - load_state.start ) / freq, work );
 
-   loadscreen_update( ++stage / LOADING_STAGES, _( "Loading the Universe…" ) );
-   space_load(); /* dep for events/missions */
+   while ( cur >= 0 ) {
+      int next = load_state.prev[cur];
+      for ( int i = 0; i < LOAD_NSTAGES; i++ ) {
+         if ( !( load_stages[cur].deps & LOAD_DEP( i ) ) )
+            continue;
+         if ( ( next < 0 ) || ( load_state.end[i] > load_state.end[next] ) )
+            next = i;
+      }
+      DEBUG( "   %-13s %7.3f s (started at %.3f s)", load_stages[cur].name,
+             ( load_state.end[cur] - load_state.begin[cur] ) / freq,
+             ( load_state.begin[cur] - load_state.start ) / freq );
+      cur = next;
+   }
+}
+#endif /* DEBUGGING */
 
-   loadscreen_update( ++stage / LOADING_STAGES, _( "Loading Events…" ) );
-   events_load();
+/**
+ * @brief Loads all the data, makes main() simpler.
+ *
+ * The stages run as soon as their dependencies are done. Worker stages go to
+ * the threadpool, while the rest run one after another on the main thread,
+ * which also keeps the loading screen updated.
+ */
+void load_all( void )
+{
+   NTracingFrameMarkStart( "load_all" );
 
-   loadscreen_update( ++stage / LOADING_STAGES, _( "Loading Missions…" ) );
-   missions_load();
+   double total = 0.;
+   int    last  = -1;
 
-   loadscreen_update( ++stage / LOADING_STAGES, _( "Loading the UniDiffs…" ) );
-   diff_loadAvailable();
+   memset( &load_state, 0, sizeof( load_state ) );
+   load_state.lock  = SDL_CreateMutex();
+   load_state.cond  = SDL_CreateCond();
+   load_state.start = SDL_GetPerformanceCounter();
+   for ( int i = 0; i < LOAD_NSTAGES; i++ ) {
+      load_state.prev[i] = -1;
+      total += load_stages[i].weight;
+#if DEBUGGING
+      if ( load_stages[i].deps & ~( LOAD_DEP( i ) - 1 ) )
+         WARN( _( "Loading stage '%s' depends on a later stage!" ),
+               load_stages[i].name );
+#endif /* DEBUGGING */
+   }
 
-   loadscreen_update( ++stage / LOADING_STAGES, _( "Populating Maps…" ) );
-   outfit_mapParse();
+   while ( load_state.done != LOAD_DEP( LOAD_NSTAGES ) - 1 ) {
+      uint32_t launch = 0;
+      int      next   = -1;
+      double   progress;
 
-   loadscreen_update( ++stage / LOADING_STAGES, _( "Calculating Patrols…" ) );
-   safelanes_init();
+      /* Find what can run. */
+      SDL_mutexP( load_state.lock );
+      for ( int i = 0; i < LOAD_NSTAGES; i++ ) {
+         if ( ( load_state.started & LOAD_DEP( i ) ) ||
+              ( load_stages[i].deps & ~load_state.done ) )
+            continue;
+         if ( load_stages[i].lane == LOAD_LANE_WORKER ) {
+            launch |= LOAD_DEP( i );
+            load_state.started |= LOAD_DEP( i );
+            load_state.running++;
+         } else if ( next < 0 )
+            next = i;
+      }
+      if ( next >= 0 )
+         load_state.started |= LOAD_DEP( next );
+      else if ( ( launch == 0 ) && ( load_state.running > 0 ) )
+         SDL_CondWait( load_state.cond, load_state.lock );
+      else if ( launch == 0 ) {
+         SDL_mutexV( load_state.lock );
+         ERR( _( "Loading stages can not make progress!" ) );
+      }
+      progress = load_state.done_weight / total;
+      SDL_mutexV( load_state.lock );
+
+      /* Start worker stages outside of the lock, the threadpool may run them
+       * right away. */
+      for ( int i = 0; i < LOAD_NSTAGES; i++ )
+         if ( launch & LOAD_DEP( i ) )
+            threadpool_newJob( load_stageThread, (void *)(intptr_t)i );
+
+      if ( next < 0 )
+         continue;
+      loadscreen_update( progress, _( load_stages[next].msg ) );
+      load_state.prev[next] = last;
+      load_stageRun( next );
+      last = next;
+   }
+
+   loadscreen_update( 1., _( "Loading Completed!" ) );
 
-   loadscreen_update( ++stage / LOADING_STAGES, _( "Initializing Details…" ) );
 #if DEBUGGING
-   if ( stage > LOADING_STAGES )
-      WARN( _( "Too many loading stages, please increase LOADING_STAGES" ) );
+   if ( conf.devmode )
+      load_report();
 #endif /* DEBUGGING */
-   difficulty_load();
-   background_init();
-   map_load();
-   map_system_load();
-   space_loadLua();
-   pilots_init();
-   weapon_init();
-   player_init(); /* Initialize player stuff. */
-   loadscreen_update( 1., _( "Loading Completed!" ) );
+   SDL_DestroyCond( load_state.cond );
+   SDL_DestroyMutex( load_state.lock );
 
    NTracingFrameMarkEnd( "load_all" );
 }
@@ -777,6 +1017,7 @@ void main_loop( int nested )
    sound_update( real_dt ); /* Update sounds. */
    toolkit_update(); /* to simulate key repetition and get rid of windows */
    if ( !paused ) {
+      ai_budgetReset(); /* AI control ticks get a budget per rendered frame. */
       update_all( !nested ); /* update game */
    } else if ( !nested ) {
       /* We run the exclusion end here to handle any hooks that are potentially
@@ -789,6 +1030,10 @@ void main_loop( int nested )
    if ( !nested )
       hooks_run( "safe" );
 
+   /* Finished asynchronous linear programs, also while landed or paused. */
+   if ( !nested )
+      linoptL_update();
+
    /* Checks to see if we want to land. */
    space_checkLand();
 
@@ -798,6 +1043,9 @@ void main_loop( int nested )
    if ( !quit ) { /* So if update sets up a nested main loop, we can end up in a
                      state where things are corrupted when trying to exit the
                      game. Avoid rendering when quitting just in case. */
+      /* Feed textures loaded in the background. */
+      gl_texUpload( TEX_UPLOAD_BUDGET );
+      ship_gfxUpdate();
       /* Clear buffer. */
       render_all( game_dt, real_dt );
       /* Draw buffer. */
@@ -960,9 +1208,14 @@ void fps_display( double dt )
         !player_isFlag( PLAYER_CREATING ) ) {
       dt_mod_base = player_dt_default();
    }
-   if ( dt_mod != dt_mod_base )
+   if ( dt_mod != dt_mod_base ) {
       gl_print( &gl_defFontMono, x, y, &cFontWhite, "%3.1fx",
                 dt_mod / dt_mod_base );
+      y -= gl_defFontMono.h + 5.;
+   }
+
+   if ( conf.metrics_show )
+      metrics_render( x, y );
 
    if ( !paused || !player_paused || !conf.pause_show )
       return;
@@ -982,6 +1235,52 @@ double fps_current( void )
    return fps;
 }
 
+/**
+ * @brief Checks to see if something around the player needs fine physics
+ * steps.
+ *
+ *    @return 1 if the player is in combat or hostiles or weapons are nearby.
+ */
+static int update_isDangerous( void )
+{
+   Pilot *const  *pilots;
+   const IntList *il;
+   const vec2    *pos;
+   int            x, y, r;
+
+   if ( ( player.p == NULL ) || pilot_isFlag( player.p, PILOT_DEAD ) )
+      return 0;
+
+   /* Combat. */
+   if ( ( player.p->stimer > 0. ) || ( player.p->lockons > 0 ) ||
+        ( player.p->projectiles > 0 ) )
+      return 1;
+
+   /* Hostiles nearby. */
+   pos    = &player.p->solid.pos;
+   pilots = pilot_getAll();
+   for ( int i = 0; i < array_size( pilots ); i++ ) {
+      const Pilot *p = pilots[i];
+      if ( pilot_isFlag( p, PILOT_DELETE ) || pilot_isFlag( p, PILOT_DEAD ) ||
+           pilot_isFlag( p, PILOT_HIDE ) || pilot_isDisabled( p ) )
+         continue;
+      if ( !pilot_isHostile( p ) )
+         continue;
+      if ( vec2_dist2( &p->solid.pos, pos ) < pow2( UPDATE_DANGER_RANGE ) )
+         return 1;
+   }
+
+   /* Weapons nearby. */
+   x  = round( pos->x );
+   y  = round( pos->y );
+   r  = UPDATE_DANGER_RANGE;
+   il = weapon_collideQuery( x - r, y - r, x + r, y + r );
+   if ( il_size( il ) > 0 )
+      return 1;
+
+   return 0;
+}
+
 /**
  * @brief Updates the game itself (player flying around and friends).
  *
@@ -999,17 +1298,21 @@ static void update_all( int dohooks )
    } else if ( game_dt > fps_min ) { /* We'll force a minimum FPS for physics to
                                         work alright. */
       int    n;
-      double nf, microdt, accumdt;
-
-      /* Number of frames. */
-      nf      = ceil( game_dt / fps_min );
-      microdt = game_dt / nf;
-      n       = (int)nf;
-
-      /* Update as much as needed, evenly. */
+      double maxdt, accumdt;
+
+      /* Update as much as needed, evenly. Steps are never larger than
+       * fps_min, but they get finer when something dangerous is around the
+       * player. This is only checked once per frame. */
+      maxdt = fps_min;
+      if ( update_isDangerous() )
+         maxdt /= UPDATE_DANGER_DIV;
       accumdt = 0.;
-      for ( int i = 0; i < n; i++ ) {
+      n       = 0;
+      while ( game_dt - accumdt > DOUBLE_TOL ) {
+         double left    = game_dt - accumdt;
+         double microdt = left / ceil( left / maxdt );
          update_routine( microdt, dohooks );
+         n++;
          /* OK, so we need a bit of hackish logic here in case we are chopping
           * up a very large dt and it turns out time compression changes so
           * we're now updating in "normal time compression" zone. This amounts
@@ -1021,6 +1324,7 @@ static void update_all( int dohooks )
          if ( accumdt > dt_mod * real_dt )
             break;
       }
+      NTracingPlotI( "update steps", n );
 
       /* Note we don't touch game_dt so that fps_display works well */
    } else /* Standard, just update with the last dt */
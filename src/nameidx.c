@@ -0,0 +1,136 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+/**
+ * @file nameidx.c
+ *
+ * @brief Hash index to look up data by name.
+ *
+ * The names are not copied, so they have to outlive the index, and the index
+ * has to be rebuilt if they change. The full hash is stored with each name so
+ * that a successful lookup only has to compare the string once.
+ */
+/** @cond */
+#include <stdlib.h>
+#include <string.h>
+
+#include "naev.h"
+/** @endcond */
+
+#include "nameidx.h"
+
+#define NAMEIDX_MIN 16 /**< Minimum amount of slots. */
+
+static void nameidx_insert( NameIdx *ni, const char *name, uint32_t hash,
+                            int idx );
+
+/**
+ * @brief Hashes a name (32-bit FNV-1a).
+ */
+uint32_t nameidx_hash( const char *name )
+{
+   uint32_t h = 2166136261U;
+   for ( const unsigned char *c = (const unsigned char *)name; *c != '\0';
+         c++ )
+      h = ( h ^ *c ) * 16777619U;
+   return h;
+}
+
+/**
+ * @brief Initializes an empty index with room for n names.
+ *
+ *    @param ni Index to initialize.
+ *    @param n Amount of names expected.
+ */
+void nameidx_init( NameIdx *ni, int n )
+{
+   uint32_t size = NAMEIDX_MIN;
+   /* Keep the load factor under a half. */
+   while ( size < 2 * (uint32_t)n )
+      size *= 2;
+   ni->slots = calloc( size, sizeof( NameIdxSlot ) );
+   ni->mask  = size - 1;
+   ni->n     = 0;
+}
+
+/**
+ * @brief Frees an index, leaving it empty.
+ */
+void nameidx_free( NameIdx *ni )
+{
+   free( ni->slots );
+   ni->slots = NULL;
+   ni->mask  = 0;
+   ni->n     = 0;
+}
+
+/**
+ * @brief Inserts a name that is known to not be in the index.
+ */
+static void nameidx_insert( NameIdx *ni, const char *name, uint32_t hash,
+                            int idx )
+{
+   uint32_t i = hash & ni->mask;
+   while ( ni->slots[i].name != NULL )
+      i = ( i + 1 ) & ni->mask;
+   ni->slots[i].name = name;
+   ni->slots[i].hash = hash;
+   ni->slots[i].idx  = idx;
+   ni->n++;
+}
+
+/**
+ * @brief Adds a name to the index.
+ *
+ *    @param ni Index to add to.
+ *    @param name Name to add, must outlive the index.
+ *    @param idx Index the name maps to.
+ *    @return 0 on success, -1 if the name was already in the index, in which
+ *            case the old mapping is kept.
+ */
+int nameidx_add( NameIdx *ni, const char *name, int idx )
+{
+   uint32_t hash;
+
+   if ( nameidx_get( ni, name ) >= 0 )
+      return -1;
+
+   /* Grow as necessary. */
+   if ( ( ni->slots == NULL ) || ( 2 * (uint32_t)( ni->n + 1 ) > ni->mask ) ) {
+      NameIdx old = *ni;
+      nameidx_init( ni, 2 * ( old.n + 1 ) );
+      for ( uint32_t i = 0; ( old.slots != NULL ) && ( i <= old.mask ); i++ )
+         if ( old.slots[i].name != NULL )
+            nameidx_insert( ni, old.slots[i].name, old.slots[i].hash,
+                            old.slots[i].idx );
+      free( old.slots );
+   }
+
+   hash = nameidx_hash( name );
+   nameidx_insert( ni, name, hash, idx );
+   return 0;
+}
+
+/**
+ * @brief Looks up a name in the index.
+ *
+ *    @param ni Index to look in.
+ *    @param name Name to look up.
+ *    @return The index the name maps to or -1 if not found.
+ */
+int nameidx_get( const NameIdx *ni, const char *name )
+{
+   uint32_t hash, i;
+
+   if ( ( ni->slots == NULL ) || ( name == NULL ) )
+      return -1;
+
+   hash = nameidx_hash( name );
+   for ( i = hash & ni->mask; ni->slots[i].name != NULL;
+         i = ( i + 1 ) & ni->mask ) {
+      const NameIdxSlot *s = &ni->slots[i];
+      if ( ( s->hash == hash ) && ( strcmp( s->name, name ) == 0 ) )
+         return s->idx;
+   }
+   return -1;
+}
@@ -0,0 +1,32 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+#pragma once
+
+#include <stdint.h>
+
+/**
+ * @brief A slot of a name index.
+ */
+typedef struct NameIdxSlot_ {
+   const char *name; /**< Name, not owned. NULL if the slot is empty. */
+   uint32_t    hash; /**< Hash of the name. */
+   int         idx;  /**< Index the name maps to. */
+} NameIdxSlot;
+
+/**
+ * @brief Maps names to indices with an open addressing hash table.
+ *
+ * A zeroed NameIdx is a valid empty index.
+ */
+typedef struct NameIdx_ {
+   NameIdxSlot *slots; /**< Slots, the size is a power of two. */
+   uint32_t     mask;  /**< Number of slots minus one. */
+   int          n;     /**< Number of names in the index. */
+} NameIdx;
+
+uint32_t nameidx_hash( const char *name );
+void     nameidx_init( NameIdx *ni, int n );
+void     nameidx_free( NameIdx *ni );
+int      nameidx_add( NameIdx *ni, const char *name, int idx );
+int      nameidx_get( const NameIdx *ni, const char *name );
@@ -583,6 +583,46 @@ int nfile_writeFile( const char *data, size_t len, const char *path )
    return 0;
 }
 
+/**
+ * @brief Writes a file through a temporary file, so an interrupted write
+ * never leaves a broken file behind.
+ *
+ *    @param data Pointer to the data to write.
+ *    @param len The size of data.
+ *    @param path Path of the file.
+ *    @return 0 on success, -1 on error.
+ */
+int nfile_writeFileAtomic( const char *data, size_t len, const char *path )
+{
+   char *tmppath;
+   int   ret;
+
+   if ( path == NULL )
+      return -1;
+
+   SDL_asprintf( &tmppath, "%s.tmp", path );
+   ret = nfile_writeFile( data, len, tmppath );
+   if ( ret == 0 ) {
+#if __WIN32__
+      /* rename() fails on Windows if the destination exists. */
+      if ( !MoveFileExA( tmppath, path, MOVEFILE_REPLACE_EXISTING ) ) {
+         WARN( _( "Unable to rename '%s' to '%s'" ), tmppath, path );
+         ret = -1;
+      }
+#else  /* __WIN32__ */
+      if ( rename( tmppath, path ) ) {
+         WARN( _( "Unable to rename '%s' to '%s': %s" ), tmppath, path,
+               strerror( errno ) );
+         ret = -1;
+      }
+#endif /* __WIN32__ */
+      if ( ret != 0 )
+         remove( tmppath );
+   }
+   free( tmppath );
+   return ret;
+}
+
 /**
  * @brief Checks to see if a character is used to separate files in a path.
  *
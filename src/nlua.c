@@ -8,7 +8,11 @@
  */
 
 /** @cond */
+#include "SDL_mutex.h"
 #include "physfs.h"
+#if HAVE_LUAJIT
+#include <luajit.h>
+#endif /* HAVE_LUAJIT */
 
 #include "naev.h"
 /** @endcond */
@@ -22,6 +26,7 @@
 #include "lua_enet.h"
 #include "lutf8lib.h"
 #include "ndata.h"
+#include "nfile.h"
 #include "nlua_audio.h"
 #include "nlua_cli.h"
 #include "nlua_commodity.h"
@@ -64,6 +69,42 @@ typedef struct LuaCache_ {
 } LuaCache_t;
 static LuaCache_t *lua_cache = NULL;
 
+#define LUA_BC_MAGIC "NLUABC01" /**< Identifies bytecode caches. */
+#define LUA_BC_FILE "luabc.cache" /**< Name of the bytecode cache file. */
+#define LUA_BC_MAXAGE                                                          \
+   8 /**< Times the cache can be written without using a chunk before it is    \
+        dropped. */
+#if HAVE_LUAJIT
+#define LUA_BC_VERSION LUAJIT_VERSION /**< Bytecode format version. */
+#else /* HAVE_LUAJIT */
+#define LUA_BC_VERSION LUA_RELEASE /**< Bytecode format version. */
+#endif /* HAVE_LUAJIT */
+
+/**
+ * @brief Header of the bytecode cache file.
+ */
+typedef struct LuaBCHeader_ {
+   char     magic[8]; /**< Should be LUA_BC_MAGIC. */
+   uint64_t version;  /**< Hash of the Lua version and pointer size. */
+   uint32_t nentries; /**< Number of chunks that follow. */
+} LuaBCHeader;
+
+/**
+ * @brief Precompiled chunk in the persistent bytecode cache.
+ */
+typedef struct LuaBC_ {
+   uint64_t key;  /**< Hash of the chunk name and source. */
+   uint32_t age;  /**< Cache writes since last used. */
+   uint32_t size; /**< Size of the bytecode. */
+   char    *data; /**< Bytecode as written by lua_dump(). */
+} LuaBC;
+static LuaBC     *lua_bc        = NULL; /**< Chunks sorted by key. */
+static int        lua_bc_loaded = 0;    /**< Whether the file was read. */
+static int        lua_bc_dirty  = 0;    /**< Whether chunks were added. */
+static SDL_mutex *lua_bc_lock   = NULL; /**< Guards lua_bc. */
+static char     **lua_bc_stale =
+   NULL; /**< Array (array.h): Replaced bytecode, freed on exit. */
+
 /*
  * prototypes
  */
@@ -75,6 +116,13 @@ static lua_State *nlua_newState( void ); /* creates a new state */
 static int        nlua_loadBasic( lua_State *L );
 static int        luaB_loadstring( lua_State *L );
 static int        lua_cache_cmp( const void *p1, const void *p2 );
+static uint64_t   lua_bcHash( const char *buf, size_t sz, const char *name );
+static uint64_t   lua_bcVersion( void );
+static int        lua_bcFind( uint64_t key );
+static int        lua_bcWriter( lua_State *L, const void *p, size_t sz,
+                                void *ud );
+static void       lua_bcLoad( void );
+static void       lua_bcSave( void );
 /* gettext */
 static int            nlua_gettext( lua_State *L );
 static int            nlua_ngettext( lua_State *L );
@@ -203,7 +251,8 @@ void lua_init( void )
    lua_atpanic( naevL, nlua_panic );
 
    /* Initialize the caches. */
-   lua_cache = array_create( LuaCache_t );
+   lua_cache   = array_create( LuaCache_t );
+   lua_bc_lock = SDL_CreateMutex();
 }
 
 /**
@@ -233,6 +282,20 @@ void lua_exit( void )
    array_free( lua_cache );
    lua_cache = NULL;
 
+   /* Persist the bytecode for the next start. */
+   lua_bcSave();
+   for ( int i = 0; i < array_size( lua_bc ); i++ )
+      free( lua_bc[i].data );
+   array_free( lua_bc );
+   lua_bc        = NULL;
+   lua_bc_loaded = 0;
+   for ( int i = 0; i < array_size( lua_bc_stale ); i++ )
+      free( lua_bc_stale[i] );
+   array_free( lua_bc_stale );
+   lua_bc_stale = NULL;
+   SDL_DestroyMutex( lua_bc_lock );
+   lua_bc_lock = NULL;
+
    free( common_script );
    lua_close( naevL );
    naevL = NULL;
@@ -252,6 +315,320 @@ void lua_clearCache( void )
    array_erase( &lua_cache, array_begin( lua_cache ), array_end( lua_cache ) );
 }
 
+/**
+ * @brief Hashes a chunk for the bytecode cache.
+ */
+static uint64_t lua_bcHash( const char *buf, size_t sz, const char *name )
+{
+   uint64_t h = 14695981039346656037ULL; /* FNV-1a. */
+   for ( const char *c = name; *c != '\0'; c++ )
+      h = ( h ^ (unsigned char)*c ) * 1099511628211ULL;
+   h = ( h ^ 0 ) * 1099511628211ULL; /* Separate name from source. */
+   for ( size_t i = 0; i < sz; i++ )
+      h = ( h ^ (unsigned char)buf[i] ) * 1099511628211ULL;
+   return h;
+}
+
+/**
+ * @brief Gets the version the bytecode cache has to match.
+ *
+ * Besides the version, the header lua_dump() writes for an empty chunk is
+ * hashed, since it has the format flags of the build (such as GC64 and FR2
+ * for LuaJIT) that the version alone doesn't tell apart.
+ */
+static uint64_t lua_bcVersion( void )
+{
+   LuaBC      bc;
+   uint64_t   h;
+   size_t     ptrsize = sizeof( void * );
+   lua_State *L       = luaL_newstate();
+
+   memset( &bc, 0, sizeof( bc ) );
+   if ( L != NULL ) {
+      if ( luaL_loadbuffer( L, "", 0, "=version" ) == 0 )
+         lua_dump( L, lua_bcWriter, &bc );
+      lua_close( L );
+   }
+   h = lua_bcHash( bc.data, bc.size, LUA_BC_VERSION );
+   h = ( h ^ ptrsize ) * 1099511628211ULL;
+   free( bc.data );
+   return h;
+}
+
+/**
+ * @brief Finds where a key is or should be inserted in the bytecode cache.
+ */
+static int lua_bcFind( uint64_t key )
+{
+   int lo = 0, hi = array_size( lua_bc );
+   while ( lo < hi ) {
+      int mid = ( lo + hi ) / 2;
+      if ( lua_bc[mid].key < key )
+         lo = mid + 1;
+      else
+         hi = mid;
+   }
+   return lo;
+}
+
+/**
+ * @brief lua_dump() writer that appends to a LuaBC.
+ */
+static int lua_bcWriter( lua_State *L, const void *p, size_t sz, void *ud )
+{
+   (void)L;
+   LuaBC *bc   = ud;
+   char  *data = realloc( bc->data, bc->size + sz );
+   if ( data == NULL )
+      return 1;
+   memcpy( &data[bc->size], p, sz );
+   bc->data = data;
+   bc->size += sz;
+   return 0;
+}
+
+/**
+ * @brief Loads a chunk like luaL_loadbuffer(), but goes through the
+ * persistent bytecode cache.
+ *
+ * Chunks are keyed by their name and a hash of their source, so changes to
+ * ndata or plugins are picked up without having to clear the cache.
+ *
+ *    @param L State to load the chunk into.
+ *    @param buf Source of the chunk.
+ *    @param sz Size of the source.
+ *    @param name Name of the chunk.
+ *    @return 0 on success, or the luaL_loadbuffer() error code.
+ */
+int nlua_loadbuffer( lua_State *L, const char *buf, size_t sz,
+                     const char *name )
+{
+   uint64_t    key;
+   const char *data = NULL;
+   size_t      size = 0;
+   int         ret, pos, stale;
+   LuaBC       bc;
+
+   /* Already bytecode. */
+   if ( ( sz > 0 ) && ( buf[0] == LUA_SIGNATURE[0] ) )
+      return luaL_loadbuffer( L, buf, sz, name );
+
+   key = lua_bcHash( buf, sz, name );
+   SDL_mutexP( lua_bc_lock );
+   if ( !lua_bc_loaded )
+      lua_bcLoad();
+   pos = lua_bcFind( key );
+   if ( ( pos < array_size( lua_bc ) ) && ( lua_bc[pos].key == key ) ) {
+      lua_bc[pos].age = 0;
+      /* Data is never freed while running, so it can be used unlocked. */
+      data = lua_bc[pos].data;
+      size = lua_bc[pos].size;
+   }
+   SDL_mutexV( lua_bc_lock );
+
+   stale = 0;
+   if ( data != NULL ) {
+      if ( luaL_loadbuffer( L, data, size, name ) == 0 )
+         return 0;
+      lua_pop( L, 1 ); /* Fall back to the source. */
+      stale = 1;
+   }
+
+   ret = luaL_loadbuffer( L, buf, sz, name );
+   if ( ret != 0 )
+      return ret;
+
+   /* Store the bytecode. */
+   memset( &bc, 0, sizeof( bc ) );
+   bc.key = key;
+   if ( lua_dump( L, lua_bcWriter, &bc ) != 0 ) {
+      free( bc.data );
+      return 0;
+   }
+   SDL_mutexP( lua_bc_lock );
+   pos = lua_bcFind( key );
+   if ( ( pos < array_size( lua_bc ) ) && ( lua_bc[pos].key == key ) ) {
+      if ( stale && ( lua_bc[pos].data == data ) ) {
+         /* Replace the bytecode that failed to load. Other threads may still
+          * be reading the old data, so it is only freed on exit. */
+         if ( lua_bc_stale == NULL )
+            lua_bc_stale = array_create( char * );
+         array_push_back( &lua_bc_stale, lua_bc[pos].data );
+         lua_bc[pos].data = bc.data;
+         lua_bc[pos].size = bc.size;
+         lua_bc_dirty     = 1;
+      } else
+         free( bc.data ); /* Another thread got here first. */
+   } else {
+      (void)array_grow( &lua_bc );
+      memmove( &lua_bc[pos + 1], &lua_bc[pos],
+               ( array_size( lua_bc ) - pos - 1 ) * sizeof( LuaBC ) );
+      lua_bc[pos]  = bc;
+      lua_bc_dirty = 1;
+   }
+   SDL_mutexV( lua_bc_lock );
+   return 0;
+}
+
+/**
+ * @brief Compiles a chunk into the bytecode cache without loading it.
+ *
+ * Uses a private state so it does not touch naevL and can run from any
+ * thread. A later nlua_loadbuffer() of the same chunk only has to load the
+ * bytecode.
+ *
+ *    @param buf Source of the chunk.
+ *    @param sz Size of the source.
+ *    @param name Name of the chunk.
+ *    @return 0 on success, or the luaL_loadbuffer() error code.
+ */
+int nlua_precompile( const char *buf, size_t sz, const char *name )
+{
+   uint64_t   key;
+   lua_State *L;
+   int        ret, pos, found;
+
+   if ( ( sz > 0 ) && ( buf[0] == LUA_SIGNATURE[0] ) )
+      return 0;
+
+   /* Nothing to do if already cached. */
+   key = lua_bcHash( buf, sz, name );
+   SDL_mutexP( lua_bc_lock );
+   if ( !lua_bc_loaded )
+      lua_bcLoad();
+   pos   = lua_bcFind( key );
+   found = ( pos < array_size( lua_bc ) ) && ( lua_bc[pos].key == key );
+   SDL_mutexV( lua_bc_lock );
+   if ( found )
+      return 0;
+
+   L = luaL_newstate();
+   if ( L == NULL )
+      return LUA_ERRMEM;
+   ret = nlua_loadbuffer( L, buf, sz, name );
+   lua_close( L );
+   return ret;
+}
+
+/**
+ * @brief Loads the bytecode cache from the user cache directory.
+ */
+static void lua_bcLoad( void )
+{
+   LuaBCHeader hdr;
+   char       *path, *buf;
+   size_t      size, pos;
+
+   lua_bc_loaded = 1;
+   if ( lua_bc == NULL )
+      lua_bc = array_create( LuaBC );
+
+   SDL_asprintf( &path, "%s%s", nfile_cachePath(), LUA_BC_FILE );
+   if ( !nfile_fileExists( path ) ) {
+      free( path );
+      return;
+   }
+   buf = nfile_readFile( &size, path );
+   if ( buf == NULL ) {
+      free( path );
+      return;
+   }
+
+   pos = sizeof( hdr );
+   if ( size < sizeof( hdr ) )
+      goto invalid;
+   memcpy( &hdr, buf, sizeof( hdr ) );
+   if ( memcmp( hdr.magic, LUA_BC_MAGIC, sizeof( hdr.magic ) ) != 0 )
+      goto invalid;
+   /* Lua was updated, just start over. */
+   if ( hdr.version != lua_bcVersion() ) {
+      free( buf );
+      free( path );
+      return;
+   }
+   for ( uint32_t i = 0; i < hdr.nentries; i++ ) {
+      LuaBC bc;
+      if ( pos + sizeof( bc.key ) + 2 * sizeof( uint32_t ) > size )
+         goto invalid;
+      memcpy( &bc.key, &buf[pos], sizeof( bc.key ) );
+      pos += sizeof( bc.key );
+      memcpy( &bc.age, &buf[pos], sizeof( bc.age ) );
+      pos += sizeof( bc.age );
+      memcpy( &bc.size, &buf[pos], sizeof( bc.size ) );
+      pos += sizeof( bc.size );
+      if ( pos + bc.size > size )
+         goto invalid;
+      if ( ( array_size( lua_bc ) > 0 ) &&
+           ( lua_bc[array_size( lua_bc ) - 1].key >= bc.key ) )
+         goto invalid;
+      bc.data = malloc( bc.size );
+      memcpy( bc.data, &buf[pos], bc.size );
+      pos += bc.size;
+      bc.age++;
+      array_push_back( &lua_bc, bc );
+   }
+   free( buf );
+   free( path );
+   return;
+
+invalid:
+   WARN( _( "Ignoring invalid Lua bytecode cache '%s'." ), path );
+   for ( int i = 0; i < array_size( lua_bc ); i++ )
+      free( lua_bc[i].data );
+   array_resize( &lua_bc, 0 );
+   free( buf );
+   free( path );
+}
+
+/**
+ * @brief Writes the bytecode cache to the user cache directory if chunks were
+ * added, dropping the ones that have not been used for a while.
+ */
+static void lua_bcSave( void )
+{
+   LuaBCHeader hdr;
+   char       *buf, *path;
+   size_t      size, pos;
+
+   if ( !lua_bc_dirty )
+      return;
+
+   memset( &hdr, 0, sizeof( hdr ) );
+   memcpy( hdr.magic, LUA_BC_MAGIC, sizeof( hdr.magic ) );
+   hdr.version = lua_bcVersion();
+   size        = sizeof( hdr );
+   for ( int i = 0; i < array_size( lua_bc ); i++ ) {
+      if ( lua_bc[i].age > LUA_BC_MAXAGE )
+         continue;
+      size += sizeof( uint64_t ) + 2 * sizeof( uint32_t ) + lua_bc[i].size;
+      hdr.nentries++;
+   }
+
+   buf = malloc( size );
+   memcpy( buf, &hdr, sizeof( hdr ) );
+   pos = sizeof( hdr );
+   for ( int i = 0; i < array_size( lua_bc ); i++ ) {
+      const LuaBC *bc = &lua_bc[i];
+      if ( bc->age > LUA_BC_MAXAGE )
+         continue;
+      memcpy( &buf[pos], &bc->key, sizeof( bc->key ) );
+      pos += sizeof( bc->key );
+      memcpy( &buf[pos], &bc->age, sizeof( bc->age ) );
+      pos += sizeof( bc->age );
+      memcpy( &buf[pos], &bc->size, sizeof( bc->size ) );
+      pos += sizeof( bc->size );
+      memcpy( &buf[pos], bc->data, bc->size );
+      pos += bc->size;
+   }
+
+   nfile_dirMakeExist( nfile_cachePath() );
+   SDL_asprintf( &path, "%s%s", nfile_cachePath(), LUA_BC_FILE );
+   nfile_writeFileAtomic( buf, size, path );
+   lua_bc_dirty = 0;
+   free( path );
+   free( buf );
+}
+
 /*
  * @brief Run code from buffer in Lua environment.
  *
@@ -271,7 +648,7 @@ int nlua_dobufenv( nlua_env env, const char *buff, size_t sz, const char *name )
    if ( conf.fpu_except )
       debug_disableFPUExcept();
 #endif /* DEBUGGING */
-   ret = luaL_loadbuffer( naevL, buff, sz, name );
+   ret = nlua_loadbuffer( naevL, buff, sz, name );
    if ( ret != 0 )
       return ret;
 #if DEBUGGING
@@ -407,7 +784,7 @@ nlua_env nlua_newEnv( void )
          WARN( _( "Unable to load common script '%s'!" ), LUA_COMMON_PATH );
    }
    if ( common_script != NULL ) {
-      if ( luaL_loadbuffer( naevL, common_script, common_sz,
+      if ( nlua_loadbuffer( naevL, common_script, common_sz,
                             LUA_COMMON_PATH ) == 0 ) {
          if ( nlua_pcall( ref, 0, 0 ) != 0 ) {
             WARN( _( "Failed to run '%s':\n%s" ), LUA_COMMON_PATH,
@@ -697,7 +1074,7 @@ static int nlua_package_loader_lua( lua_State *L )
 
    /* Try to process the Lua. It will leave a function or message on the stack,
     * as required. */
-   luaL_loadbuffer( L, buf, bufsize, path_filename );
+   nlua_loadbuffer( L, buf, bufsize, path_filename );
    free( buf );
 
    /* Cache the result. */
@@ -9,6 +9,8 @@
  */
 
 /** @cond */
+#include "SDL_atomic.h"
+#include "SDL_mutex.h"
 #include "SDL_timer.h"
 #include "physfs.h"
 #include <glpk.h>
@@ -19,22 +21,134 @@
 
 #include "nlua_linopt.h"
 
+#include "array.h"
 #include "log.h"
+#include "nfile.h"
 #include "nluadef.h"
+#include "rng.h"
+#include "threadpool.h"
 
 #define LINOPT_MAX_TM                                                          \
    1000 /**< Maximum time to optimize (in ms). Applied to linear relaxation    \
            and MIP independently. */
 
+#define LINOPT_CACHE_MAX 512    /**< Maximum number of cached problems. */
+#define LINOPT_CACHE_VARIANTS 4 /**< Solutions kept per cached problem. */
+#define LINOPT_CACHE_MAGIC                                                     \
+   "NLPCACH2" /**< Identifies solution cache files, and their version. */
+#define LINOPT_CACHE_FILE "linopt.cache" /**< Name of the cache file. */
+
+struct LinOptJob_s;
+typedef struct LinOptJob_s LinOptJob;
+
 /**
  * @brief Our cute little linear program wrapper.
  */
 typedef struct LuaLinOpt_s {
-   int       ncols; /**< Number of structural variables. */
-   int       nrows; /**< Number of auxiliary variables (constraints). */
-   glp_prob *prob;  /**< Problem structure itself. */
+   int        ncols; /**< Number of structural variables. */
+   int        nrows; /**< Number of auxiliary variables (constraints). */
+   glp_prob  *prob;  /**< Problem structure itself. */
+   LinOptJob *job;   /**< Asynchronous solve, if any. */
 } LuaLinOpt_t;
 
+/**
+ * @brief A solve of a linear program, possibly running on a worker thread.
+ *
+ * The worker only writes the results and then sets done, everything else is
+ * owned by the main thread.
+ */
+struct LinOptJob_s {
+   LuaLinOpt_t *lp;        /**< Linear program being solved. */
+   glp_prob    *src;       /**< Problem to solve, not modified while running. */
+   int          ncols;     /**< Number of columns. */
+   int          nrows;     /**< Number of rows. */
+   int          ismip;     /**< Whether it is a mixed integer program. */
+   glp_smcp     parm_smcp; /**< Simplex parameters. */
+   glp_iocp     parm_iocp; /**< Integer optimization parameters. */
+   int          cache;     /**< Whether to use the solution cache. */
+   uint64_t     key[2];    /**< Hashes of the problem for the cache. */
+   int          hit;       /**< Whether the solution came from the cache. */
+   double      *coef;      /**< Original objective coefficients or NULL. */
+   double      *noise;     /**< Objective multipliers for a new variant. */
+   int          func;      /**< Callback to run when done. */
+   int          ref;       /**< Keeps the linear program alive. */
+   nlua_env     env;       /**< Environment of the callback. */
+   SDL_atomic_t done;      /**< Set by the worker when done. */
+   const char  *err;       /**< Error message if failed. */
+   double       z;         /**< Objective value. */
+   double      *vals;      /**< Column values followed by the row values. */
+   double       ms;        /**< Time spent solving in milliseconds. */
+};
+
+/**
+ * @brief Statistics about the linear programs solved.
+ */
+typedef struct LinOptStats_s {
+   int    solves;     /**< Number of solves run. */
+   int    hits;       /**< Number of solves answered from the cache. */
+   int    async;      /**< Number of solves run on worker threads. */
+   int    failed;     /**< Number of solves that failed. */
+   double time_total; /**< Total time spent solving in milliseconds. */
+   double time_max;   /**< Longest solve in milliseconds. */
+} LinOptStats;
+
+/**
+ * @brief Cached solutions of a linear program.
+ *
+ * Problems are identified by two independent hashes of everything that goes
+ * into them, so a ship with the same cores, candidate outfits, objective and
+ * constraints maps to the same entry, while a collision would need both to
+ * collide. Each solution stores the column values followed by the row values.
+ */
+typedef struct LinOptCache_s {
+   uint64_t key[2]; /**< Hashes of the problem. */
+   int      ncols;  /**< Number of columns of the problem. */
+   int      nrows;  /**< Number of rows of the problem. */
+   int      nsol;   /**< Number of solutions stored. */
+   double   z[LINOPT_CACHE_VARIANTS];    /**< Objective values. */
+   double  *vals[LINOPT_CACHE_VARIANTS]; /**< Column and row values. */
+} LinOptCache;
+
+/**
+ * @brief Header of a solution cache file. Followed by the entries, each being
+ * the two keys, ncols, nrows and nsol, and then for each solution the objective
+ * value and ncols+nrows values.
+ */
+typedef struct LinOptCacheHeader_s {
+   char     magic[8]; /**< Should be LINOPT_CACHE_MAGIC. */
+   uint32_t nentries; /**< Number of cached problems. */
+} LinOptCacheHeader;
+
+static LinOptCache *linopt_cache = NULL; /**< Solution cache (array.h). */
+static int linopt_cache_next     = 0; /**< Next entry to evict when full. */
+static int linopt_cache_loaded   = 0; /**< Whether the cache file was read. */
+static int linopt_cache_dirty    = 0; /**< Whether the cache needs saving. */
+
+static SDL_mutex  *linopt_lock = NULL; /**< Protects the job completion. */
+static SDL_cond   *linopt_cond = NULL; /**< Signalled when a job is done. */
+static LinOptJob **linopt_jobs = NULL; /**< Tracked async jobs (array.h). */
+static LinOptStats linopt_stats;       /**< Solve statistics. */
+
+/* Solution cache. */
+static void         linopt_cacheLoad( void );
+static void         linopt_cacheSave( void );
+static void         linopt_hash( glp_prob *prob, uint64_t key[2] );
+static LinOptCache *linopt_cacheFind( const uint64_t key[2], int ncols,
+                                      int nrows );
+static void linopt_cacheAdd( const uint64_t key[2], int ncols, int nrows,
+                             double z, const double *vals );
+static void linopt_pushSolution( lua_State *L, double z, const double *vals,
+                                 int ncols, int nrows );
+
+/* Solving. */
+static int  linopt_jobInit( lua_State *L, LuaLinOpt_t *lp, LinOptJob *job );
+static void linopt_jobRun( LinOptJob *job, glp_prob *prob );
+static int  linopt_jobPush( lua_State *L, LinOptJob *job );
+static void linopt_jobFree( LinOptJob *job );
+static int  linopt_jobWait( const LuaLinOpt_t *lp, int timeout );
+static void linopt_jobUntrack( LinOptJob *job, int unref );
+static int  linopt_thread( void *data );
+
 /* Optim metatable methods. */
 static int linoptL_gc( lua_State *L );
 static int linoptL_eq( lua_State *L );
@@ -46,6 +160,10 @@ static int linoptL_setcol( lua_State *L );
 static int linoptL_setrow( lua_State *L );
 static int linoptL_loadmatrix( lua_State *L );
 static int linoptL_solve( lua_State *L );
+static int linoptL_solveAsync( lua_State *L );
+static int linoptL_ready( lua_State *L );
+static int linoptL_wait( lua_State *L );
+static int linoptL_stats( lua_State *L );
 static int linoptL_readProblem( lua_State *L );
 static int linoptL_writeProblem( lua_State *L );
 
@@ -60,6 +178,10 @@ static const luaL_Reg linoptL_methods[] = {
    { "set_row", linoptL_setrow },
    { "load_matrix", linoptL_loadmatrix },
    { "solve", linoptL_solve },
+   { "solve_async", linoptL_solveAsync },
+   { "ready", linoptL_ready },
+   { "wait", linoptL_wait },
+   { "stats", linoptL_stats },
    { "read_problem", linoptL_readProblem },
    { "write_problem", linoptL_writeProblem },
    { 0, 0 } }; /**< Optim metatable methods. */
@@ -156,6 +278,14 @@ int lua_islinopt( lua_State *L, int ind )
 static int linoptL_gc( lua_State *L )
 {
    LuaLinOpt_t *lp = luaL_checklinopt( L, 1 );
+   if ( lp->job != NULL ) {
+      /* Only happens with a running job when the Lua state is closing. */
+      linopt_jobWait( lp, -1 );
+      linopt_jobUntrack( lp->job, 0 );
+      linopt_jobFree( lp->job );
+      free( lp->job );
+      lp->job = NULL;
+   }
    glp_delete_prob( lp->prob );
    return 0;
 }
@@ -207,6 +337,7 @@ static int linoptL_new( lua_State *L )
 #endif /* DEBUGGING */
 
    /* Initialize and create. */
+   lp.job  = NULL;
    lp.prob = glp_create_prob();
    glp_set_prob_name( lp.prob, name );
    glp_add_cols( lp.prob, lp.ncols );
@@ -245,6 +376,7 @@ static int linoptL_addcols( lua_State *L )
 {
    LuaLinOpt_t *lp    = luaL_checklinopt( L, 1 );
    int          toadd = luaL_checkinteger( L, 2 );
+   linopt_jobWait( lp, -1 );
    glp_add_cols( lp->prob, toadd );
    lp->ncols += toadd;
    return 0;
@@ -261,6 +393,7 @@ static int linoptL_addrows( lua_State *L )
 {
    LuaLinOpt_t *lp    = luaL_checklinopt( L, 1 );
    int          toadd = luaL_checkinteger( L, 2 );
+   linopt_jobWait( lp, -1 );
    glp_add_rows( lp->prob, toadd );
    lp->nrows += toadd;
    return 0;
@@ -294,6 +427,7 @@ static int linoptL_setcol( lua_State *L )
    int          type = GLP_FR, kind = GLP_CV;
 
    /* glpk stuff */
+   linopt_jobWait( lp, -1 );
    glp_set_col_name( lp->prob, idx, name );
    glp_set_obj_coef( lp->prob, idx, coef );
 
@@ -344,6 +478,7 @@ static int linoptL_setrow( lua_State *L )
    double       lb, ub;
 
    /* glpk stuff */
+   linopt_jobWait( lp, -1 );
    glp_set_row_name( lp->prob, idx, name );
 
    /* Determine bounds. */
@@ -414,6 +549,7 @@ static int linoptL_loadmatrix( lua_State *L )
    }
 
    /* Set up the matrix. */
+   linopt_jobWait( lp, -1 );
    glp_load_matrix( lp->prob, n, ia, ja, ar );
 
    /* Clean up. */
@@ -423,6 +559,308 @@ static int linoptL_loadmatrix( lua_State *L )
    return 0;
 }
 
+/**
+ * @brief Hashes a linear program.
+ *
+ * Covers the objective, the bounds and kinds of all the columns and rows,
+ * their names and the constraint matrix. This is linear in the number of
+ * non-zeros, so it is much cheaper than solving.
+ *
+ *    @param prob Problem to hash.
+ *    @param[out] key FNV-1a and sdbm hashes of the problem.
+ */
+static void linopt_hash( glp_prob *prob, uint64_t key[2] )
+{
+   uint64_t h     = 14695981039346656037ULL; /* FNV-1a. */
+   uint64_t h2    = 0;                       /* sdbm. */
+   int      ncols = glp_get_num_cols( prob );
+   int      nrows = glp_get_num_rows( prob );
+   int     *ind   = malloc( ( nrows + 1 ) * sizeof( int ) );
+   double  *val   = malloc( ( nrows + 1 ) * sizeof( double ) );
+#define HASH( p, n )                                                           \
+   do {                                                                        \
+      const unsigned char *_b = (const unsigned char *)( p );                  \
+      for ( size_t _i = 0; _i < (size_t)( n ); _i++ ) {                        \
+         h ^= _b[_i];                                                          \
+         h *= 1099511628211ULL;                                                \
+         h2 = _b[_i] + ( h2 << 6 ) + ( h2 << 16 ) - h2;                        \
+      }                                                                        \
+   } while ( 0 )
+#define HASH_VAL( v )                                                          \
+   do {                                                                        \
+      __typeof__( v ) _v = ( v );                                              \
+      HASH( &_v, sizeof( _v ) );                                               \
+   } while ( 0 )
+#define HASH_STR( str )                                                        \
+   do {                                                                        \
+      const char *_s = ( str );                                                \
+      if ( _s != NULL )                                                        \
+         HASH( _s, strlen( _s ) + 1 );                                         \
+   } while ( 0 )
+
+   HASH_VAL( glp_get_obj_dir( prob ) );
+   HASH_VAL( glp_get_obj_coef( prob, 0 ) );
+   HASH_VAL( ncols );
+   HASH_VAL( nrows );
+   for ( int i = 1; i <= nrows; i++ ) {
+      HASH_STR( glp_get_row_name( prob, i ) );
+      HASH_VAL( glp_get_row_type( prob, i ) );
+      HASH_VAL( glp_get_row_lb( prob, i ) );
+      HASH_VAL( glp_get_row_ub( prob, i ) );
+   }
+   for ( int j = 1; j <= ncols; j++ ) {
+      int len;
+      HASH_STR( glp_get_col_name( prob, j ) );
+      HASH_VAL( glp_get_col_kind( prob, j ) );
+      HASH_VAL( glp_get_col_type( prob, j ) );
+      HASH_VAL( glp_get_col_lb( prob, j ) );
+      HASH_VAL( glp_get_col_ub( prob, j ) );
+      HASH_VAL( glp_get_obj_coef( prob, j ) );
+      len = glp_get_mat_col( prob, j, ind, val );
+      HASH_VAL( len );
+      HASH( &ind[1], len * sizeof( int ) );
+      HASH( &val[1], len * sizeof( double ) );
+   }
+#undef HASH_STR
+#undef HASH_VAL
+#undef HASH
+
+   free( ind );
+   free( val );
+   key[0] = h;
+   key[1] = h2;
+}
+
+/**
+ * @brief Finds the cached solutions of a problem.
+ *
+ *    @return The cache entry or NULL if not found.
+ */
+static LinOptCache *linopt_cacheFind( const uint64_t key[2], int ncols,
+                                      int nrows )
+{
+   if ( !linopt_cache_loaded )
+      linopt_cacheLoad();
+   for ( int i = 0; i < array_size( linopt_cache ); i++ ) {
+      LinOptCache *e = &linopt_cache[i];
+      if ( ( e->key[0] == key[0] ) && ( e->key[1] == key[1] ) &&
+           ( e->ncols == ncols ) && ( e->nrows == nrows ) )
+         return e;
+   }
+   return NULL;
+}
+
+/**
+ * @brief Adds a solution to the cache, evicting the oldest problem if full.
+ */
+static void linopt_cacheAdd( const uint64_t key[2], int ncols, int nrows,
+                             double z, const double *vals )
+{
+   LinOptCache *e = linopt_cacheFind( key, ncols, nrows );
+   size_t       n = ( ncols + nrows ) * sizeof( double );
+
+   if ( e == NULL ) {
+      if ( array_size( linopt_cache ) < LINOPT_CACHE_MAX )
+         e = &array_grow( &linopt_cache );
+      else {
+         e = &linopt_cache[linopt_cache_next];
+         for ( int i = 0; i < e->nsol; i++ )
+            free( e->vals[i] );
+         linopt_cache_next = ( linopt_cache_next + 1 ) % LINOPT_CACHE_MAX;
+      }
+      memset( e, 0, sizeof( LinOptCache ) );
+      e->key[0] = key[0];
+      e->key[1] = key[1];
+      e->ncols  = ncols;
+      e->nrows  = nrows;
+   }
+   if ( e->nsol >= LINOPT_CACHE_VARIANTS )
+      return;
+
+   e->z[e->nsol]    = z;
+   e->vals[e->nsol] = malloc( n );
+   memcpy( e->vals[e->nsol], vals, n );
+   e->nsol++;
+   linopt_cache_dirty = 1;
+}
+
+/**
+ * @brief Loads the solution cache from the user cache directory.
+ */
+static void linopt_cacheLoad( void )
+{
+   LinOptCacheHeader hdr;
+   char             *path, *buf;
+   size_t            size, pos;
+
+   linopt_cache_loaded = 1;
+   if ( linopt_cache == NULL )
+      linopt_cache = array_create( LinOptCache );
+
+   SDL_asprintf( &path, "%s%s", nfile_cachePath(), LINOPT_CACHE_FILE );
+   if ( !nfile_fileExists( path ) ) {
+      free( path );
+      return;
+   }
+   buf = nfile_readFile( &size, path );
+   if ( buf == NULL ) {
+      free( path );
+      return;
+   }
+
+   pos = sizeof( hdr );
+   if ( size < sizeof( hdr ) )
+      goto invalid;
+   memcpy( &hdr, buf, sizeof( hdr ) );
+   if ( memcmp( hdr.magic, LINOPT_CACHE_MAGIC, sizeof( hdr.magic ) ) != 0 )
+      goto invalid;
+   for ( uint32_t i = 0; i < MIN( hdr.nentries, LINOPT_CACHE_MAX ); i++ ) {
+      LinOptCache e;
+      int32_t     dims[3];
+      size_t      n;
+      memset( &e, 0, sizeof( e ) );
+      if ( pos + sizeof( e.key ) + sizeof( dims ) > size )
+         goto invalid;
+      memcpy( e.key, &buf[pos], sizeof( e.key ) );
+      pos += sizeof( e.key );
+      memcpy( dims, &buf[pos], sizeof( dims ) );
+      pos += sizeof( dims );
+      if ( ( dims[0] < 0 ) || ( dims[1] < 0 ) || ( dims[2] < 0 ) ||
+           ( dims[2] > LINOPT_CACHE_VARIANTS ) )
+         goto invalid;
+      e.ncols = dims[0];
+      e.nrows = dims[1];
+      n       = ( (size_t)e.ncols + e.nrows ) * sizeof( double );
+      if ( pos + dims[2] * ( sizeof( double ) + n ) > size )
+         goto invalid;
+      for ( int j = 0; j < dims[2]; j++ ) {
+         memcpy( &e.z[j], &buf[pos], sizeof( double ) );
+         pos += sizeof( double );
+         e.vals[j] = malloc( n );
+         memcpy( e.vals[j], &buf[pos], n );
+         pos += n;
+      }
+      e.nsol = dims[2];
+      array_push_back( &linopt_cache, e );
+   }
+   free( buf );
+   free( path );
+   return;
+
+invalid:
+   WARN( _( "Ignoring invalid linear program cache '%s'." ), path );
+   for ( int i = 0; i < array_size( linopt_cache ); i++ )
+      for ( int j = 0; j < linopt_cache[i].nsol; j++ )
+         free( linopt_cache[i].vals[j] );
+   array_resize( &linopt_cache, 0 );
+   free( buf );
+   free( path );
+}
+
+/**
+ * @brief Writes the solution cache to the user cache directory.
+ */
+static void linopt_cacheSave( void )
+{
+   LinOptCacheHeader hdr;
+   char             *buf, *path;
+   size_t            size, pos;
+
+   if ( !linopt_cache_dirty )
+      return;
+
+   memcpy( hdr.magic, LINOPT_CACHE_MAGIC, sizeof( hdr.magic ) );
+   hdr.nentries = array_size( linopt_cache );
+   size         = sizeof( hdr );
+   for ( int i = 0; i < array_size( linopt_cache ); i++ ) {
+      const LinOptCache *e = &linopt_cache[i];
+      size += sizeof( e->key ) + 3 * sizeof( int32_t ) +
+              e->nsol * ( ( (size_t)e->ncols + e->nrows + 1 ) *
+                          sizeof( double ) );
+   }
+
+   buf = malloc( size );
+   memcpy( buf, &hdr, sizeof( hdr ) );
+   pos = sizeof( hdr );
+   for ( int i = 0; i < array_size( linopt_cache ); i++ ) {
+      const LinOptCache *e       = &linopt_cache[i];
+      int32_t            dims[3] = { e->ncols, e->nrows, e->nsol };
+      size_t n = ( (size_t)e->ncols + e->nrows ) * sizeof( double );
+      memcpy( &buf[pos], e->key, sizeof( e->key ) );
+      pos += sizeof( e->key );
+      memcpy( &buf[pos], dims, sizeof( dims ) );
+      pos += sizeof( dims );
+      for ( int j = 0; j < e->nsol; j++ ) {
+         memcpy( &buf[pos], &e->z[j], sizeof( double ) );
+         pos += sizeof( double );
+         memcpy( &buf[pos], e->vals[j], n );
+         pos += n;
+      }
+   }
+
+   nfile_dirMakeExist( nfile_cachePath() );
+   SDL_asprintf( &path, "%s%s", nfile_cachePath(), LINOPT_CACHE_FILE );
+   nfile_writeFileAtomic( buf, size, path );
+   linopt_cache_dirty = 0;
+   free( path );
+   free( buf );
+}
+
+/**
+ * @brief Saves and frees the linear program solution cache.
+ */
+void linoptL_exit( void )
+{
+   /* The jobs were finished when the Lua state was closed. */
+   array_free( linopt_jobs );
+   linopt_jobs = NULL;
+   if ( linopt_lock != NULL ) {
+      SDL_DestroyMutex( linopt_lock );
+      SDL_DestroyCond( linopt_cond );
+      linopt_lock = NULL;
+      linopt_cond = NULL;
+   }
+
+   linopt_cacheSave();
+   for ( int i = 0; i < array_size( linopt_cache ); i++ )
+      for ( int j = 0; j < linopt_cache[i].nsol; j++ )
+         free( linopt_cache[i].vals[j] );
+   array_free( linopt_cache );
+   linopt_cache        = NULL;
+   linopt_cache_next   = 0;
+   linopt_cache_loaded = 0;
+}
+
+/**
+ * @brief Pushes a solution as returned by solve.
+ *
+ *    @param L Lua state to push to.
+ *    @param z Objective value.
+ *    @param vals Column values followed by row values.
+ *    @param ncols Number of columns.
+ *    @param nrows Number of rows.
+ */
+static void linopt_pushSolution( lua_State *L, double z, const double *vals,
+                                 int ncols, int nrows )
+{
+   /* Output function value. */
+   lua_pushnumber( L, z );
+
+   /* Go over variables and store them. */
+   lua_newtable( L ); /* t */
+   for ( int i = 1; i <= ncols; i++ ) {
+      lua_pushnumber( L, vals[i - 1] ); /* t, z */
+      lua_rawseti( L, -2, i );          /* t */
+   }
+
+   /* Go over constraints and store them. */
+   lua_newtable( L ); /* t */
+   for ( int i = 1; i <= nrows; i++ ) {
+      lua_pushnumber( L, vals[ncols + i - 1] ); /* t, z */
+      lua_rawseti( L, -2, i );                  /* t */
+   }
+}
+
 static const char *linopt_status( int retval )
 {
    switch ( retval ) {
@@ -620,43 +1058,48 @@ static int opt_onoff( const char *str, int def )
 #define GETOPT_IOCP( name, func, def )                                         \
    do {                                                                        \
       lua_getfield( L, 2, #name );                                             \
-      parm_iocp.name = func( luaL_optstring( L, -1, NULL ), def );             \
+      job->parm_iocp.name = func( luaL_optstring( L, -1, NULL ), def );        \
       lua_pop( L, 1 );                                                         \
    } while ( 0 )
 #define GETOPT_SMCP( name, func, def )                                         \
    do {                                                                        \
       lua_getfield( L, 2, #name );                                             \
-      parm_smcp.name = func( luaL_optstring( L, -1, NULL ), def );             \
+      job->parm_smcp.name = func( luaL_optstring( L, -1, NULL ), def );        \
       lua_pop( L, 1 );                                                         \
    } while ( 0 )
 /**
- * @brief Solves the linear optimization problem.
+ * @brief Sets up a solve from the Lua arguments of solve or solve_async.
  *
- *    @luatparam LinOpt lp Linear program to modify.
- *    @luatreturn number The value of the primal funcation.
- *    @luatreturn table Table of column values.
- * @luafunc solve
+ * Looks up the solution cache, and if the problem is not there, picks the
+ * objective noise for the next variant on the main thread, as the random
+ * number generator is not thread safe.
+ *
+ *    @param L Lua state with the linear program, parameters and cache table.
+ *    @param lp Linear program being solved.
+ *    @param[out] job Job to set up.
+ *    @return 1 if the solution was found in the cache, 0 if it has to be
+ * solved.
  */
-static int linoptL_solve( lua_State *L )
+static int linopt_jobInit( lua_State *L, LuaLinOpt_t *lp, LinOptJob *job )
 {
-   LuaLinOpt_t *lp = luaL_checklinopt( L, 1 );
-   double       z;
-   int          ret, ismip;
-   glp_iocp     parm_iocp;
-   glp_smcp     parm_smcp;
-#if DEBUGGING
-   Uint64 starttime = SDL_GetTicks64();
-#endif /* DEBUGGING */
+   memset( job, 0, sizeof( LinOptJob ) );
+   job->lp    = lp;
+   job->src   = lp->prob;
+   job->ncols = lp->ncols;
+   job->nrows = lp->nrows;
+   job->func  = LUA_NOREF;
+   job->ref   = LUA_NOREF;
+   job->vals  = malloc( ( lp->ncols + lp->nrows ) * sizeof( double ) );
 
    /* Parameters. */
-   ismip = ( glp_get_num_int( lp->prob ) > 0 );
-   glp_init_smcp( &parm_smcp );
-   parm_smcp.msg_lev = GLP_MSG_ERR;
-   parm_smcp.tm_lim  = LINOPT_MAX_TM;
-   if ( ismip ) {
-      glp_init_iocp( &parm_iocp );
-      parm_iocp.msg_lev = GLP_MSG_ERR;
-      parm_iocp.tm_lim  = LINOPT_MAX_TM;
+   job->ismip = ( glp_get_num_int( lp->prob ) > 0 );
+   glp_init_smcp( &job->parm_smcp );
+   job->parm_smcp.msg_lev = GLP_MSG_ERR;
+   job->parm_smcp.tm_lim  = LINOPT_MAX_TM;
+   if ( job->ismip ) {
+      glp_init_iocp( &job->parm_iocp );
+      job->parm_iocp.msg_lev = GLP_MSG_ERR;
+      job->parm_iocp.tm_lim  = LINOPT_MAX_TM;
    }
 
    /* Load parameters. */
@@ -665,7 +1108,7 @@ static int linoptL_solve( lua_State *L )
       GETOPT_SMCP( pricing, opt_pricing, PRICING_DEF );
       GETOPT_SMCP( r_test, opt_r_test, R_TEST_DEF );
       GETOPT_SMCP( presolve, opt_onoff, PRESOLVE_DEF );
-      if ( ismip ) {
+      if ( job->ismip ) {
          GETOPT_IOCP( br_tech, opt_br_tech, BR_TECH_DEF );
          GETOPT_IOCP( bt_tech, opt_bt_tech, BT_TECH_DEF );
          GETOPT_IOCP( pp_tech, opt_pp_tech, PP_TECH_DEF );
@@ -699,73 +1142,449 @@ static int linoptL_solve( lua_State *L )
    }
 #endif
 
-   /* Optimization. */
-   if ( !ismip || !parm_iocp.presolve ) {
-      ret = glp_simplex( lp->prob, &parm_smcp );
-      if ( ( ret != 0 ) && ( ret != GLP_ETMLIM ) ) {
-         lua_pushnil( L );
-         lua_pushstring( L, linopt_error( ret ) );
-         return 2;
+   /* Use cached solutions when all the variants are there. */
+   job->cache = !lua_isnoneornil( L, 3 );
+   if ( job->cache ) {
+      const LinOptCache *e;
+      double             rnd;
+      lua_getfield( L, 3, "rnd" );
+      rnd = luaL_optnumber( L, -1, 0. );
+      lua_pop( L, 1 );
+      linopt_hash( lp->prob, job->key );
+      e = linopt_cacheFind( job->key, lp->ncols, lp->nrows );
+      if ( ( e != NULL ) && ( ( e->nsol >= LINOPT_CACHE_VARIANTS ) ||
+                              ( ( rnd <= 0. ) && ( e->nsol > 0 ) ) ) ) {
+         int s  = MIN( RNG( 0, e->nsol - 1 ), e->nsol - 1 );
+         job->z = e->z[s];
+         memcpy( job->vals, e->vals[s],
+                 ( lp->ncols + lp->nrows ) * sizeof( double ) );
+         job->hit = 1;
+         return 1;
       }
-      /* Check for optimality of continuous problem. */
-      ret = glp_get_status( lp->prob );
-      if ( ( ret != GLP_OPT ) && ( ret != GLP_FEAS ) ) {
-         lua_pushnil( L );
-         lua_pushstring( L, linopt_status( ret ) );
-         return 2;
+
+      /* Perturb the objective to get a different variant. */
+      if ( rnd > 0. ) {
+         job->coef  = malloc( ( lp->ncols + 1 ) * sizeof( double ) );
+         job->noise = malloc( ( lp->ncols + 1 ) * sizeof( double ) );
+         for ( int i = 1; i <= lp->ncols; i++ ) {
+            job->coef[i]  = glp_get_obj_coef( lp->prob, i );
+            job->noise[i] = 1. + rnd * RNG_1SIGMA();
+         }
       }
    }
-   if ( ismip ) {
-      ret = glp_intopt( lp->prob, &parm_iocp );
-      if ( ( ret != 0 ) && ( ret != GLP_ETMLIM ) ) {
-         lua_pushnil( L );
-         lua_pushstring( L, linopt_error( ret ) );
-         return 2;
+   return 0;
+}
+#undef GETOPT_SMCP
+#undef GETOPT_IOCP
+
+/**
+ * @brief Solves a linear program, storing the results in the job.
+ *
+ * Only touches the problem passed and the job, so it can be run from a worker
+ * thread on a copy of the problem.
+ *
+ *    @param job Job to run.
+ *    @param prob Problem to solve, restored to its original objective after.
+ */
+static void linopt_jobRun( LinOptJob *job, glp_prob *prob )
+{
+   Uint64 start = SDL_GetPerformanceCounter();
+   int    ret;
+
+   if ( job->coef != NULL )
+      for ( int i = 1; i <= job->ncols; i++ )
+         glp_set_obj_coef( prob, i, job->noise[i] * job->coef[i] );
+
+   /* Optimization. */
+   job->err = NULL;
+   if ( !job->ismip || !job->parm_iocp.presolve ) {
+      ret = glp_simplex( prob, &job->parm_smcp );
+      if ( ( ret != 0 ) && ( ret != GLP_ETMLIM ) )
+         job->err = linopt_error( ret );
+      else {
+         /* Check for optimality of continuous problem. */
+         ret = glp_get_status( prob );
+         if ( ( ret != GLP_OPT ) && ( ret != GLP_FEAS ) )
+            job->err = linopt_status( ret );
       }
-      /* Check for optimality of discrete problem. */
-      ret = glp_mip_status( lp->prob );
-      if ( ( ret != GLP_OPT ) && ( ret != GLP_FEAS ) ) {
-         lua_pushnil( L );
-         lua_pushstring( L, linopt_status( ret ) );
-         return 2;
+   }
+   if ( job->ismip && ( job->err == NULL ) ) {
+      ret = glp_intopt( prob, &job->parm_iocp );
+      if ( ( ret != 0 ) && ( ret != GLP_ETMLIM ) )
+         job->err = linopt_error( ret );
+      else {
+         /* Check for optimality of discrete problem. */
+         ret = glp_mip_status( prob );
+         if ( ( ret != GLP_OPT ) && ( ret != GLP_FEAS ) )
+            job->err = linopt_status( ret );
       }
    }
-   z = glp_get_obj_val( lp->prob );
 
-   /* Output function value. */
-   lua_pushnumber( L, z );
+   /* Gather the column and row values. */
+   if ( job->err == NULL ) {
+      for ( int i = 1; i <= job->ncols; i++ )
+         job->vals[i - 1] = job->ismip ? glp_mip_col_val( prob, i )
+                                       : glp_get_col_prim( prob, i );
+      for ( int i = 1; i <= job->nrows; i++ )
+         job->vals[job->ncols + i - 1] = job->ismip
+                                            ? glp_mip_row_val( prob, i )
+                                            : glp_get_row_prim( prob, i );
+      job->z = glp_get_obj_val( prob );
+   }
 
-   /* Go over variables and store them. */
-   lua_newtable( L ); /* t */
-   for ( int i = 1; i <= lp->ncols; i++ ) {
-      if ( ismip )
-         z = glp_mip_col_val( lp->prob, i );
-      else
-         z = glp_get_col_prim( lp->prob, i );
-      lua_pushnumber( L, z );  /* t, z */
-      lua_rawseti( L, -2, i ); /* t */
+   /* Restore the objective and evaluate the solution with it. */
+   if ( job->coef != NULL ) {
+      if ( job->err == NULL ) {
+         job->z = glp_get_obj_coef( prob, 0 );
+         for ( int i = 1; i <= job->ncols; i++ )
+            job->z += job->coef[i] * job->vals[i - 1];
+      }
+      for ( int i = 1; i <= job->ncols; i++ )
+         glp_set_obj_coef( prob, i, job->coef[i] );
    }
 
-   /* Go over constraints and store them. */
-   lua_newtable( L ); /* t */
-   for ( int i = 1; i <= lp->nrows; i++ ) {
-      if ( ismip )
-         z = glp_mip_row_val( lp->prob, i );
-      else
-         z = glp_get_row_prim( lp->prob, i );
-      lua_pushnumber( L, z );  /* t, z */
-      lua_rawseti( L, -2, i ); /* t */
+   job->ms = (double)( SDL_GetPerformanceCounter() - start ) * 1000. /
+             (double)SDL_GetPerformanceFrequency();
+}
+
+/**
+ * @brief Pushes the results of a finished job, updating the cache and the
+ * statistics.
+ *
+ *    @param L Lua state to push to.
+ *    @param job Finished job.
+ *    @return Number of values pushed.
+ */
+static int linopt_jobPush( lua_State *L, LinOptJob *job )
+{
+   if ( job->hit ) {
+      linopt_stats.hits++;
+      linopt_pushSolution( L, job->z, job->vals, job->ncols, job->nrows );
+      return 3;
    }
 
-   /* Complain about time. */
+   linopt_stats.solves++;
+   linopt_stats.time_total += job->ms;
+   linopt_stats.time_max = MAX( linopt_stats.time_max, job->ms );
 #if DEBUGGING
-   if ( SDL_GetTicks64() - starttime > LINOPT_MAX_TM )
+   /* Complain about time. */
+   if ( job->ms > LINOPT_MAX_TM )
       WARN( _( "glpk: too over 1 second to optimize!" ) );
 #endif /* DEBUGGING */
 
+   if ( job->err != NULL ) {
+      linopt_stats.failed++;
+      lua_pushnil( L );
+      lua_pushstring( L, job->err );
+      return 2;
+   }
+   if ( job->cache )
+      linopt_cacheAdd( job->key, job->ncols, job->nrows, job->z, job->vals );
+   linopt_pushSolution( L, job->z, job->vals, job->ncols, job->nrows );
    return 3;
 }
-#undef GETOPT_IOCP
+
+/**
+ * @brief Frees the memory of a job.
+ */
+static void linopt_jobFree( LinOptJob *job )
+{
+   free( job->vals );
+   free( job->coef );
+   free( job->noise );
+}
+
+/**
+ * @brief Solves an asynchronous job on a worker thread.
+ *
+ * GLPK keeps its memory per thread, so the problem is copied and freed here
+ * instead of being shared with the main thread, which must not modify it in
+ * the meantime.
+ */
+static int linopt_thread( void *data )
+{
+   LinOptJob *job  = data;
+   glp_prob  *prob = glp_create_prob();
+   glp_copy_prob( prob, job->src, GLP_ON );
+   linopt_jobRun( job, prob );
+   glp_delete_prob( prob );
+   glp_free_env(); /* Pool threads are reused, don't leave GLPK memory. */
+
+   SDL_mutexP( linopt_lock );
+   SDL_AtomicSet( &job->done, 1 );
+   SDL_CondBroadcast( linopt_cond );
+   SDL_mutexV( linopt_lock );
+   return 0;
+}
+
+/**
+ * @brief Waits for the asynchronous job of a linear program to finish.
+ *
+ *    @param lp Linear program to wait for.
+ *    @param timeout Maximum time to wait in milliseconds, negative is forever.
+ *    @return 1 if there is no job running.
+ */
+static int linopt_jobWait( const LuaLinOpt_t *lp, int timeout )
+{
+   Uint64 end;
+   if ( ( lp->job == NULL ) || SDL_AtomicGet( &lp->job->done ) )
+      return 1;
+
+   end = SDL_GetTicks64() + MAX( timeout, 0 );
+   SDL_mutexP( linopt_lock );
+   while ( !SDL_AtomicGet( &lp->job->done ) ) {
+      if ( timeout < 0 )
+         SDL_CondWait( linopt_cond, linopt_lock );
+      else {
+         Uint64 now = SDL_GetTicks64();
+         if ( now >= end )
+            break;
+         SDL_CondWaitTimeout( linopt_cond, linopt_lock, end - now );
+      }
+   }
+   SDL_mutexV( linopt_lock );
+   return SDL_AtomicGet( &lp->job->done );
+}
+
+/**
+ * @brief Stops tracking a job, releasing its references.
+ *
+ *    @param job Job to stop tracking.
+ *    @param unref Whether the Lua references should be released.
+ */
+static void linopt_jobUntrack( LinOptJob *job, int unref )
+{
+   for ( int i = 0; i < array_size( linopt_jobs ); i++ ) {
+      if ( linopt_jobs[i] != job )
+         continue;
+      array_erase( &linopt_jobs, &linopt_jobs[i], &linopt_jobs[i + 1] );
+      break;
+   }
+   if ( unref ) {
+      luaL_unref( naevL, LUA_REGISTRYINDEX, job->ref );
+      luaL_unref( naevL, LUA_REGISTRYINDEX, job->func );
+   }
+   job->ref  = LUA_NOREF;
+   job->func = LUA_NOREF;
+}
+
+/**
+ * @brief Solves the linear optimization problem.
+ *
+ * When a cache table is passed, solutions are memoized by two hashes of the
+ * whole problem and persisted in the user cache directory. Up to a few
+ * variants are kept per problem, each solved with the objective coefficients
+ * multiplied by (1+rnd*sigma), and once they are all there one is returned at
+ * random without solving.
+ *
+ * @usage z, x, r = lp:solve( nil, { rnd=0.1 } )
+ *
+ *    @luatparam LinOpt lp Linear program to modify.
+ *    @luatparam[opt=nil] table params Solver parameters.
+ *    @luatparam[opt=nil] table cache Enables the solution cache if set. Its
+ * "rnd" field sets the objective noise used to generate variants.
+ *    @luatreturn number The value of the primal funcation.
+ *    @luatreturn table Table of column values.
+ *    @luatreturn table Table of row values.
+ * @luafunc solve
+ */
+static int linoptL_solve( lua_State *L )
+{
+   LuaLinOpt_t *lp = luaL_checklinopt( L, 1 );
+   LinOptJob    job;
+   int          ret;
+
+   if ( lp->job != NULL )
+      return NLUA_ERROR( L, _( "Linear program is already being solved!" ) );
+
+   if ( !linopt_jobInit( L, lp, &job ) )
+      linopt_jobRun( &job, lp->prob );
+   ret = linopt_jobPush( L, &job );
+   linopt_jobFree( &job );
+   return ret;
+}
+
+/**
+ * @brief Starts solving the linear optimization problem on a worker thread.
+ *
+ * The linear program acts as the handle of the solve: it must not be modified
+ * until the results are collected with wait, or passed to the callback, which
+ * is run from the main loop once the solve is done. Modifying the program
+ * while it is being solved waits for the solve to finish first.
+ *
+ * @usage lp:solve_async( nil, { rnd=0.1 }, function( z, x, r ) ... end )
+ *
+ *    @luatparam LinOpt lp Linear program to solve.
+ *    @luatparam[opt=nil] table params Solver parameters, as in solve.
+ *    @luatparam[opt=nil] table cache Cache parameters, as in solve.
+ *    @luatparam[opt=nil] function callback Function to call with the results
+ * of solve when done.
+ *    @luatreturn LinOpt The linear program being solved.
+ * @luafunc solve_async
+ */
+static int linoptL_solveAsync( lua_State *L )
+{
+   LuaLinOpt_t *lp = luaL_checklinopt( L, 1 );
+   LinOptJob   *job;
+
+   if ( lp->job != NULL )
+      return NLUA_ERROR( L, _( "Linear program is already being solved!" ) );
+   if ( !lua_isnoneornil( L, 4 ) )
+      luaL_checktype( L, 4, LUA_TFUNCTION );
+
+   if ( linopt_lock == NULL ) {
+      linopt_lock = SDL_CreateMutex();
+      linopt_cond = SDL_CreateCond();
+      linopt_jobs = array_create( LinOptJob * );
+   }
+
+   job     = malloc( sizeof( LinOptJob ) );
+   lp->job = job;
+   if ( linopt_jobInit( L, lp, job ) )
+      SDL_AtomicSet( &job->done, 1 );
+   else
+      linopt_stats.async++;
+
+   /* Keep the program alive while it is being solved. */
+   lua_pushvalue( L, 1 );
+   job->ref = luaL_ref( L, LUA_REGISTRYINDEX );
+   if ( !lua_isnoneornil( L, 4 ) ) {
+      lua_pushvalue( L, 4 );
+      job->func = luaL_ref( L, LUA_REGISTRYINDEX );
+      job->env  = __NLUA_CURENV;
+   }
+   array_push_back( &linopt_jobs, job );
+
+   if ( !job->hit )
+      threadpool_newJob( linopt_thread, job );
+
+   lua_pushvalue( L, 1 );
+   return 1;
+}
+
+/**
+ * @brief Checks to see if an asynchronous solve is done.
+ *
+ *    @luatparam LinOpt lp Linear program being solved.
+ *    @luatreturn boolean Whether or not the results are ready.
+ * @luafunc ready
+ */
+static int linoptL_ready( lua_State *L )
+{
+   const LuaLinOpt_t *lp = luaL_checklinopt( L, 1 );
+   lua_pushboolean( L, ( lp->job != NULL ) && SDL_AtomicGet( &lp->job->done ) );
+   return 1;
+}
+
+/**
+ * @brief Waits for an asynchronous solve and gets its results.
+ *
+ * The results are only returned once, and the callback of the solve is not
+ * run if they are collected here.
+ *
+ * @usage z, x, r = lp:wait( 0.005 ) -- Wait at most 5 ms
+ *
+ *    @luatparam LinOpt lp Linear program being solved.
+ *    @luatparam[opt=nil] number timeout Maximum time to wait in seconds, or
+ * forever if nil.
+ *    @luatreturn number|boolean The value of the primal function, nil on
+ * failure or false if the solve is not done yet.
+ *    @luatreturn table Table of column values or error message.
+ *    @luatreturn table Table of row values.
+ * @luafunc wait
+ */
+static int linoptL_wait( lua_State *L )
+{
+   LuaLinOpt_t *lp = luaL_checklinopt( L, 1 );
+   int          timeout, ret;
+   LinOptJob   *job;
+
+   if ( lp->job == NULL )
+      return NLUA_ERROR( L, _( "Linear program is not being solved!" ) );
+
+   timeout =
+      lua_isnoneornil( L, 2 ) ? -1 : (int)( 1000. * luaL_checknumber( L, 2 ) );
+   if ( !linopt_jobWait( lp, timeout ) ) {
+      lua_pushboolean( L, 0 );
+      return 1;
+   }
+
+   job     = lp->job;
+   lp->job = NULL;
+   linopt_jobUntrack( job, 1 );
+   ret = linopt_jobPush( L, job );
+   linopt_jobFree( job );
+   free( job );
+   return ret;
+}
+
+/**
+ * @brief Gets statistics about the linear programs solved so far.
+ *
+ *    @luatreturn table Table with the number of "solves", cache "hits",
+ * "async" solves, "failed" solves and "pending" asynchronous solves, along with
+ * the "time_total" and "time_max" spent solving in milliseconds.
+ * @luafunc stats
+ */
+static int linoptL_stats( lua_State *L )
+{
+   lua_newtable( L );
+   lua_pushinteger( L, linopt_stats.solves );
+   lua_setfield( L, -2, "solves" );
+   lua_pushinteger( L, linopt_stats.hits );
+   lua_setfield( L, -2, "hits" );
+   lua_pushinteger( L, linopt_stats.async );
+   lua_setfield( L, -2, "async" );
+   lua_pushinteger( L, linopt_stats.failed );
+   lua_setfield( L, -2, "failed" );
+   lua_pushinteger( L, array_size( linopt_jobs ) );
+   lua_setfield( L, -2, "pending" );
+   lua_pushnumber( L, linopt_stats.time_total );
+   lua_setfield( L, -2, "time_total" );
+   lua_pushnumber( L, linopt_stats.time_max );
+   lua_setfield( L, -2, "time_max" );
+   return 1;
+}
+
+/**
+ * @brief Runs the callbacks of the finished asynchronous solves.
+ *
+ * Solves without a callback stay attached to their linear program until they
+ * are collected with wait, but no longer keep it alive.
+ */
+void linoptL_update( void )
+{
+   for ( int i = array_size( linopt_jobs ) - 1; i >= 0; i-- ) {
+      LinOptJob *job;
+      nlua_env   env;
+      int        n;
+
+      /* Callbacks may have collected other jobs. */
+      if ( i >= array_size( linopt_jobs ) )
+         continue;
+      job = linopt_jobs[i];
+      if ( !SDL_AtomicGet( &job->done ) )
+         continue;
+
+      if ( job->func == LUA_NOREF ) {
+         linopt_jobUntrack( job, 1 );
+         continue;
+      }
+
+      lua_rawgeti( naevL, LUA_REGISTRYINDEX, job->func );
+      env          = job->env;
+      job->lp->job = NULL;
+      linopt_jobUntrack( job, 1 );
+      n = linopt_jobPush( naevL, job );
+      linopt_jobFree( job );
+      free( job );
+      if ( nlua_pcall( env, n, 0 ) ) {
+         WARN( _( "Linear program callback error: %s" ),
+               lua_tostring( naevL, -1 ) );
+         lua_pop( naevL, 1 );
+      }
+   }
+}
 
 /**
  * @brief Reads an optimization problem from a file for debugging purposes.
@@ -790,6 +1609,7 @@ static int linoptL_readProblem( lua_State *L )
    if ( dirname == NULL )
       return NLUA_ERROR( L, _( "Failed to read LP problem \"%s\"!" ), fname );
    SDL_asprintf( &fpath, "%s/%s", dirname, fname );
+   lp.job  = NULL;
    lp.prob = glp_create_prob();
    ret     = glpk_format ? glp_read_prob( lp.prob, 0, fpath )
                          : glp_read_mps( lp.prob, GLP_MPS_FILE, NULL, fpath );
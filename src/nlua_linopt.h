@@ -13,7 +13,9 @@ typedef struct LuaLinOpt_s LuaLinOpt_t;
 /*
  * Library loading
  */
-int nlua_loadLinOpt( nlua_env env );
+int  nlua_loadLinOpt( nlua_env env );
+void linoptL_update( void );
+void linoptL_exit( void );
 
 /* Basic operations. */
 LuaLinOpt_t *lua_tolinopt( lua_State *L, int ind );
@@ -17,6 +17,7 @@
 #include "nlua_naev.h"
 
 #include "array.h"
+#include "conf.h"
 #include "console.h"
 #include "debug.h"
 #include "event.h"
@@ -26,6 +27,7 @@
 #include "land.h"
 #include "log.h"
 #include "menu.h"
+#include "metrics.h"
 #include "nlua_misn.h"
 #include "nlua_system.h"
 #include "nluadef.h"
@@ -45,6 +47,8 @@ static int naevL_ticks( lua_State *L );
 static int naevL_ticksGame( lua_State *L );
 static int naevL_clock( lua_State *L );
 static int naevL_fps( lua_State *L );
+static int naevL_metricsShow( lua_State *L );
+static int naevL_metricsDump( lua_State *L );
 static int naevL_keyGet( lua_State *L );
 static int naevL_keyEnable( lua_State *L );
 static int naevL_keyEnableAll( lua_State *L );
@@ -87,6 +91,8 @@ static const luaL_Reg naev_methods[] = {
    { "ticksGame", naevL_ticksGame },
    { "clock", naevL_clock },
    { "fps", naevL_fps },
+   { "metricsShow", naevL_metricsShow },
+   { "metricsDump", naevL_metricsDump },
    { "keyGet", naevL_keyGet },
    { "keyEnable", naevL_keyEnable },
    { "keyEnableAll", naevL_keyEnableAll },
@@ -279,6 +285,40 @@ static int naevL_fps( lua_State *L )
    return 1;
 }
 
+/**
+ * @brief Shows or hides the per-frame metrics overlay.
+ *
+ * Metrics are only gathered while the overlay is shown or being streamed to a
+ * file, so enable it a while before calling naev.metricsDump.
+ *
+ * @usage naev.metricsShow( true )
+ *
+ *    @luatparam boolean show Whether or not to show the metrics.
+ * @luafunc metricsShow
+ */
+static int naevL_metricsShow( lua_State *L )
+{
+   conf.metrics_show = lua_toboolean( L, 1 );
+   metrics_update();
+   return 0;
+}
+
+/**
+ * @brief Dumps the recent history of the per-frame metrics to a CSV file.
+ *
+ * @usage naev.metricsDump( "metrics.csv" )
+ *
+ *    @luatparam string filename Name of the file in the write directory.
+ *    @luatreturn boolean Whether or not the file was written.
+ * @luafunc metricsDump
+ */
+static int naevL_metricsDump( lua_State *L )
+{
+   const char *filename = luaL_checkstring( L, 1 );
+   lua_pushboolean( L, metrics_dump( filename ) == 0 );
+   return 1;
+}
+
 /**
  * @brief Gets a human-readable name for the key bound to a function.
  *
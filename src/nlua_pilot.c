@@ -51,6 +51,9 @@
  */
 extern Pilot *cur_pilot;
 
+static int pilot_mt      = LUA_NOREF; /**< Cached reference to the metatable. */
+static int pilot_handles = LUA_NOREF; /**< Weak table of pushed handles. */
+
 /*
  * Prototypes.
  */
@@ -469,6 +472,20 @@ int nlua_loadPilot( nlua_env env )
 {
    nlua_register( env, PILOT_METATABLE, pilotL_methods, 1 );
 
+   /* Metatable and handles are shared by all environments. */
+   if ( pilot_mt == LUA_NOREF ) {
+      luaL_getmetatable( naevL, PILOT_METATABLE );
+      pilot_mt = luaL_ref( naevL, LUA_REGISTRYINDEX );
+
+      /* Weak values so handles get collected when no longer used. */
+      lua_newtable( naevL );                                /* t */
+      lua_newtable( naevL );                                /* t, m */
+      lua_pushstring( naevL, "v" );                         /* t, m, s */
+      lua_setfield( naevL, -2, "__mode" );                  /* t, m */
+      lua_setmetatable( naevL, -2 );                        /* t */
+      pilot_handles = luaL_ref( naevL, LUA_REGISTRYINDEX ); /* */
+   }
+
    /* Pilot always loads ship and asteroid. */
    nlua_loadShip( env );
    nlua_loadAsteroid( env );
@@ -510,6 +527,16 @@ static int pilotL_setFlagWrapper( lua_State *L, int flag )
  * p:setFriendly() -- Make it friendly
  * @endcode
  *
+ * Pilot handles only hold the pilot's ID. Getting the same pilot again
+ * returns the same handle as long as the old one is still referenced
+ * somewhere, otherwise a new handle is created. Handles for the same pilot
+ * always compare equal with ==, but whether they are the same object
+ * (rawequal, table keys) depends on the garbage collector, so use p:id() for
+ * table keys:
+ * @code
+ * seen[ p:id() ] = true -- Not seen[ p ]
+ * @endcode
+ *
  * @luamod pilot
  */
 /**
@@ -556,16 +583,42 @@ Pilot *luaL_validpilot( lua_State *L, int ind )
 /**
  * @brief Pushes a pilot on the stack.
  *
+ * A handle to the same pilot that is still alive gets reused instead of
+ * creating a new one.
+ *
  *    @param L Lua state to push pilot into.
  *    @param pilot Pilot to push.
- *    @return Newly pushed pilot.
+ *    @return Pushed pilot.
  */
 LuaPilot *lua_pushpilot( lua_State *L, LuaPilot pilot )
 {
-   LuaPilot *p = (LuaPilot *)lua_newuserdata( L, sizeof( LuaPilot ) );
-   *p          = pilot;
-   luaL_getmetatable( L, PILOT_METATABLE );
-   lua_setmetatable( L, -2 );
+   LuaPilot *p;
+
+   /* Pilot library not loaded yet, so nothing to reuse. */
+   if ( pilot_handles == LUA_NOREF ) {
+      p  = (LuaPilot *)lua_newuserdata( L, sizeof( LuaPilot ) );
+      *p = pilot;
+      luaL_getmetatable( L, PILOT_METATABLE );
+      lua_setmetatable( L, -2 );
+      return p;
+   }
+
+   /* Handles can't be modified, so reuse one if it is still alive. */
+   lua_rawgeti( L, LUA_REGISTRYINDEX, pilot_handles ); /* t */
+   lua_rawgeti( L, -1, pilot );                        /* t, p */
+   if ( !lua_isnil( L, -1 ) ) {
+      lua_remove( L, -2 ); /* p */
+      return (LuaPilot *)lua_touserdata( L, -1 );
+   }
+   lua_pop( L, 1 ); /* t */
+
+   p  = (LuaPilot *)lua_newuserdata( L, sizeof( LuaPilot ) ); /* t, p */
+   *p = pilot;
+   lua_rawgeti( L, LUA_REGISTRYINDEX, pilot_mt ); /* t, p, m */
+   lua_setmetatable( L, -2 );                     /* t, p */
+   lua_pushvalue( L, -1 );                        /* t, p, p */
+   lua_rawseti( L, -3, pilot );                   /* t, p */
+   lua_remove( L, -2 );                           /* p */
    return p;
 }
 /**
@@ -581,7 +634,10 @@ int lua_ispilot( lua_State *L, int ind )
 
    if ( lua_getmetatable( L, ind ) == 0 )
       return 0;
-   lua_getfield( L, LUA_REGISTRYINDEX, PILOT_METATABLE );
+   if ( pilot_mt == LUA_NOREF )
+      luaL_getmetatable( L, PILOT_METATABLE );
+   else
+      lua_rawgeti( L, LUA_REGISTRYINDEX, pilot_mt );
 
    ret = 0;
    if ( lua_rawequal( L, -1, -2 ) ) /* does it have the correct mt? */
@@ -663,7 +719,9 @@ static int pilotL_choosePoint( lua_State *L )
  * Supported arguments: "ai" (string): AI to give the pilot. Defaults to the
  * faction's AI. "naked" (boolean): Whether or not to have the pilot spawn
  * without outfits. Defaults to false. "stealth" (boolean): Whether or not to
- * have the pilot spawn in stealth mode. Defaults to false.
+ * have the pilot spawn in stealth mode. Defaults to false. "async_equip"
+ * (boolean): Whether or not the equip script may finish equipping the pilot
+ * after it spawns, leaving it with only cores until then. Defaults to false.
  *    @luatreturn Pilot The created pilot.
  * @luafunc add
  */
@@ -780,6 +838,11 @@ static int pilotL_add( lua_State *L )
       if ( lua_toboolean( L, -1 ) )
          pilot_setFlagRaw( flags, PILOT_STEALTH );
       lua_pop( L, 1 );
+
+      lua_getfield( L, 5, "async_equip" );
+      if ( lua_toboolean( L, -1 ) )
+         pilot_setFlagRaw( flags, PILOT_EQUIP_ASYNC );
+      lua_pop( L, 1 );
    }
 
    /* Set up velocities and such. */
@@ -5337,6 +5400,7 @@ static const struct pL_flag pL_flags[] = {
    { .name = "friendly", .id = PILOT_FRIENDLY },
    { .name = "hostile", .id = PILOT_HOSTILE },
    { .name = "combat", .id = PILOT_COMBAT },
+   { .name = "async_equip", .id = PILOT_EQUIP_ASYNC },
    { NULL, -1 } }; /**< Flags to get. */
 /**
  * @brief Gets the pilot's flags.
@@ -5366,6 +5430,7 @@ static const struct pL_flag pL_flags[] = {
  *  <li> manualcontrol: pilot is under manual control.</li>
  *  <li> combat: pilot is engaged in combat.</li>
  *  <li> carried: pilot came from a fighter bay.</li>
+ *  <li> async_equip: pilot may get equipped after spawning.</li>
  * </ul>
  *    @luatparam Pilot p Pilot to get flags of.
  *    @luatparam[opt] string name If provided, return only the individual flag.
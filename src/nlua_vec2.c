@@ -17,20 +17,33 @@
 #include "nlua_vec2.h"
 
 #include "collision.h"
+#include "nlua.h"
 #include "nluadef.h"
 
+static int vector_mt = LUA_NOREF; /**< Cached reference to the metatable. */
+
+/* In-place operations. */
+static vec2 *vector_addSelf( lua_State *L );
+static vec2 *vector_subSelf( lua_State *L );
+static vec2 *vector_mulSelf( lua_State *L );
+static vec2 *vector_divSelf( lua_State *L );
+
 /* Vector metatable methods */
 static int vectorL_new( lua_State *L );
 static int vectorL_newP( lua_State *L );
 static int vectorL_copy( lua_State *L );
 static int vectorL_tostring( lua_State *L );
 static int vectorL_add__( lua_State *L );
+static int vectorL_add_( lua_State *L );
 static int vectorL_add( lua_State *L );
 static int vectorL_sub__( lua_State *L );
+static int vectorL_sub_( lua_State *L );
 static int vectorL_sub( lua_State *L );
 static int vectorL_mul__( lua_State *L );
+static int vectorL_mul_( lua_State *L );
 static int vectorL_mul( lua_State *L );
 static int vectorL_div__( lua_State *L );
+static int vectorL_div_( lua_State *L );
 static int vectorL_div( lua_State *L );
 static int vectorL_unm( lua_State *L );
 static int vectorL_dot( lua_State *L );
@@ -54,12 +67,16 @@ static const luaL_Reg vector_methods[] = {
    { "__tostring", vectorL_tostring },
    { "__add", vectorL_add },
    { "add", vectorL_add__ },
+   { "add_", vectorL_add_ },
    { "__sub", vectorL_sub },
    { "sub", vectorL_sub__ },
+   { "sub_", vectorL_sub_ },
    { "__mul", vectorL_mul },
    { "mul", vectorL_mul__ },
+   { "mul_", vectorL_mul_ },
    { "__div", vectorL_div },
    { "div", vectorL_div__ },
+   { "div_", vectorL_div_ },
    { "__unm", vectorL_unm },
    { "dot", vectorL_dot },
    { "cross", vectorL_cross },
@@ -85,6 +102,12 @@ static const luaL_Reg vector_methods[] = {
 int nlua_loadVector( nlua_env env )
 {
    nlua_register( env, VECTOR_METATABLE, vector_methods, 1 );
+
+   /* Metatable is shared by all environments, so only look it up once. */
+   if ( vector_mt == LUA_NOREF ) {
+      luaL_getmetatable( naevL, VECTOR_METATABLE );
+      vector_mt = luaL_ref( naevL, LUA_REGISTRYINDEX );
+   }
    return 0;
 }
 
@@ -102,6 +125,15 @@ int nlua_loadVector( nlua_env env )
  * my_vec = my_vec - your_vec -- my_vec is now (19,13)
  * @endcode
  *
+ * Every arithmetic operator creates a new vector that has to be garbage
+ * collected. Code that runs often, like the AI, should prefer the in-place
+ * variants that modify the vector and return it without allocating:
+ *
+ * @code
+ * my_vec:add_( your_vec ):mul_( 0.5 ) -- my_vec is now the midpoint
+ * my_vec:set( your_vec ) -- my_vec is now a copy of your_vec
+ * @endcode
+ *
  * To call members of the metatable always use:
  * @code
  * vector:function( param )
@@ -146,7 +178,10 @@ vec2 *lua_pushvector( lua_State *L, vec2 vec )
 {
    vec2 *v = (vec2 *)lua_newuserdata( L, sizeof( vec2 ) );
    *v      = vec;
-   luaL_getmetatable( L, VECTOR_METATABLE );
+   if ( vector_mt == LUA_NOREF ) /* Not loaded yet. */
+      luaL_getmetatable( L, VECTOR_METATABLE );
+   else
+      lua_rawgeti( L, LUA_REGISTRYINDEX, vector_mt );
    lua_setmetatable( L, -2 );
    return v;
 }
@@ -164,7 +199,10 @@ int lua_isvector( lua_State *L, int ind )
 
    if ( lua_getmetatable( L, ind ) == 0 )
       return 0;
-   lua_getfield( L, LUA_REGISTRYINDEX, VECTOR_METATABLE );
+   if ( vector_mt == LUA_NOREF )
+      luaL_getmetatable( L, VECTOR_METATABLE );
+   else
+      lua_rawgeti( L, LUA_REGISTRYINDEX, vector_mt );
 
    ret = 0;
    if ( lua_rawequal( L, -1, -2 ) ) /* does it have the correct mt? */
@@ -316,6 +354,31 @@ static int vectorL_add( lua_State *L )
    return 1;
 }
 static int vectorL_add__( lua_State *L )
+{
+   const vec2 *v1 = vector_addSelf( L );
+   lua_pushvector( L, *v1 );
+   return 1;
+}
+/**
+ * @brief Adds to a vector in place, returning the same vector.
+ *
+ * Unlike add, this does not create a new vector.
+ *
+ * @usage my_vec:add_( your_vec ):add_( 5, 3 )
+ *
+ *    @luatparam Vec2 v Vector getting stuff added to.
+ *    @luatparam number|Vec2 x X coordinate or vector to add to.
+ *    @luatparam number|nil y Y coordinate or nil to add to.
+ *    @luatreturn Vec2 The vector v.
+ * @luafunc add_
+ */
+static int vectorL_add_( lua_State *L )
+{
+   vector_addSelf( L );
+   lua_settop( L, 1 );
+   return 1;
+}
+static vec2 *vector_addSelf( lua_State *L )
 {
    vec2  *v1;
    double x, y;
@@ -338,9 +401,7 @@ static int vectorL_add__( lua_State *L )
 
    /* Actually add it */
    vec2_cset( v1, v1->x + x, v1->y + y );
-   lua_pushvector( L, *v1 );
-
-   return 1;
+   return v1;
 }
 
 /**
@@ -387,6 +448,31 @@ static int vectorL_sub( lua_State *L )
    return 1;
 }
 static int vectorL_sub__( lua_State *L )
+{
+   const vec2 *v1 = vector_subSelf( L );
+   lua_pushvector( L, *v1 );
+   return 1;
+}
+/**
+ * @brief Subtracts from a vector in place, returning the same vector.
+ *
+ * Unlike sub, this does not create a new vector.
+ *
+ * @usage my_vec:sub_( your_vec )
+ *
+ *    @luatparam Vec2 v Vector getting stuff subtracted from.
+ *    @luatparam number|Vec2 x X coordinate or vector to subtract.
+ *    @luatparam number|nil y Y coordinate or nil to subtract.
+ *    @luatreturn Vec2 The vector v.
+ * @luafunc sub_
+ */
+static int vectorL_sub_( lua_State *L )
+{
+   vector_subSelf( L );
+   lua_settop( L, 1 );
+   return 1;
+}
+static vec2 *vector_subSelf( lua_State *L )
 {
    vec2  *v1;
    double x, y;
@@ -409,8 +495,7 @@ static int vectorL_sub__( lua_State *L )
 
    /* Actually add it */
    vec2_cset( v1, v1->x - x, v1->y - y );
-   lua_pushvector( L, *v1 );
-   return 1;
+   return v1;
 }
 
 /**
@@ -449,6 +534,30 @@ static int vectorL_mul( lua_State *L )
    return 1;
 }
 static int vectorL_mul__( lua_State *L )
+{
+   const vec2 *v1 = vector_mulSelf( L );
+   lua_pushvector( L, *v1 );
+   return 1;
+}
+/**
+ * @brief Multiplies a vector in place, returning the same vector.
+ *
+ * Unlike mul, this does not create a new vector.
+ *
+ * @usage my_vec:mul_( 3 )
+ *
+ *    @luatparam Vec2 v Vector to multiply.
+ *    @luatparam number|Vec2 mod Amount to multiply by.
+ *    @luatreturn Vec2 The vector v.
+ * @luafunc mul_
+ */
+static int vectorL_mul_( lua_State *L )
+{
+   vector_mulSelf( L );
+   lua_settop( L, 1 );
+   return 1;
+}
+static vec2 *vector_mulSelf( lua_State *L )
 {
    vec2 *v1 = luaL_checkvector( L, 1 );
    if ( lua_isnumber( L, 2 ) ) {
@@ -458,10 +567,7 @@ static int vectorL_mul__( lua_State *L )
       const vec2 *v2 = luaL_checkvector( L, 2 );
       vec2_cset( v1, v1->x * v2->x, v1->y * v2->y );
    }
-
-   /* Actually add it */
-   lua_pushvector( L, *v1 );
-   return 1;
+   return v1;
 }
 
 /**
@@ -491,6 +597,30 @@ static int vectorL_div( lua_State *L )
    return 1;
 }
 static int vectorL_div__( lua_State *L )
+{
+   const vec2 *v1 = vector_divSelf( L );
+   lua_pushvector( L, *v1 );
+   return 1;
+}
+/**
+ * @brief Divides a vector in place, returning the same vector.
+ *
+ * Unlike div, this does not create a new vector.
+ *
+ * @usage my_vec:div_( 3 )
+ *
+ *    @luatparam Vec2 v Vector to divide.
+ *    @luatparam number|Vec2 mod Amount to divide by.
+ *    @luatreturn Vec2 The vector v.
+ * @luafunc div_
+ */
+static int vectorL_div_( lua_State *L )
+{
+   vector_divSelf( L );
+   lua_settop( L, 1 );
+   return 1;
+}
+static vec2 *vector_divSelf( lua_State *L )
 {
    vec2 *v1 = luaL_checkvector( L, 1 );
    if ( lua_isnumber( L, 2 ) ) {
@@ -500,9 +630,7 @@ static int vectorL_div__( lua_State *L )
       const vec2 *v2 = luaL_checkvector( L, 2 );
       vec2_cset( v1, v1->x / v2->x, v1->y / v2->y );
    }
-
-   lua_pushvector( L, *v1 );
-   return 1;
+   return v1;
 }
 static int vectorL_unm( lua_State *L )
 {
@@ -588,10 +716,11 @@ static int vectorL_polar( lua_State *L )
  * @brief Sets the vector by cartesian coordinates.
  *
  * @usage my_vec:set(5, 3) -- my_vec is now (5,3)
+ * @usage my_vec:set( your_vec ) -- my_vec is now a copy of your_vec
  *
  *    @luatparam Vec2 v Vector to set coordinates of.
- *    @luatparam number x X coordinate to set.
- *    @luatparam number y Y coordinate to set.
+ *    @luatparam number|Vec2 x X coordinate or vector to set.
+ *    @luatparam number|nil y Y coordinate to set or nil if x is a vector.
  * @luafunc set
  */
 static int vectorL_set( lua_State *L )
@@ -601,8 +730,14 @@ static int vectorL_set( lua_State *L )
 
    /* Get parameters. */
    v1 = luaL_checkvector( L, 1 );
-   x  = luaL_checknumber( L, 2 );
-   y  = luaL_checknumber( L, 3 );
+   if ( lua_isvector( L, 2 ) ) {
+      const vec2 *v2 = lua_tovector( L, 2 );
+      x              = v2->x;
+      y              = v2->y;
+   } else {
+      x = luaL_checknumber( L, 2 );
+      y = luaL_checknumber( L, 3 );
+   }
 
    vec2_cset( v1, x, y );
    return 0;
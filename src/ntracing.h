@@ -3,17 +3,31 @@
  */
 #pragma once
 
+#include "metrics.h"
+
 #if HAVE_TRACY
 #include "attributes.h"
 #include "tracy/TracyC.h"
 #include <stdlib.h>
 #define _uninitialized_var( x ) x = *( &( x ) )
-#define NTracingFrameMark TracyCFrameMark
+#define NTracingFrameMark                                                      \
+   do {                                                                        \
+      TracyCFrameMark;                                                         \
+      metrics_frame();                                                         \
+   } while ( 0 )
 #define NTracingFrameMarkStart( name ) TracyCFrameMarkStart( name )
 #define NTracingFrameMarkEnd( name ) TracyCFrameMarkEnd( name )
-#define NTracingZone( ctx, active ) TracyCZone( ctx, active )
-#define NTracingZoneName( ctx, name, active ) TracyCZoneN( ctx, name, active )
-#define NTracingZoneEnd( ctx ) TracyCZoneEnd( ctx )
+#define NTracingZone( ctx, active )                                            \
+   TracyCZone( ctx, active );                                                  \
+   NMetricsZone( ctx, __func__ )
+#define NTracingZoneName( ctx, name, active )                                  \
+   TracyCZoneN( ctx, name, active );                                           \
+   NMetricsZone( ctx, name )
+#define NTracingZoneEnd( ctx )                                                 \
+   do {                                                                        \
+      TracyCZoneEnd( ctx );                                                    \
+      NMetricsZoneEnd( ctx );                                                  \
+   } while ( 0 )
 #define NTracingAlloc( ptr, size )                                             \
    do {                                                                        \
       _uninitialized_var( ptr );                                               \
@@ -51,16 +65,28 @@ ALWAYS_INLINE static inline void *nrealloc( void *ptr, size_t size )
 }
 #define NTracingMessage( txt, size ) TracyCMessage( txt, size )
 #define NTracingMessageL( txt ) TracyCMessageL( txt )
-#define NTracingPlot( name, val ) TracyCPlot( name, val )
-#define NTracingPlotF( name, val ) TracyCPlotF( name, val )
-#define NTracingPlotI( name, val ) TracyCPlotI( name, val )
+#define NTracingPlot( name, val )                                              \
+   do {                                                                        \
+      TracyCPlot( name, val );                                                 \
+      NMetricsAdd( name, METRIC_VALUE, val );                                  \
+   } while ( 0 )
+#define NTracingPlotF( name, val )                                             \
+   do {                                                                        \
+      TracyCPlotF( name, val );                                                \
+      NMetricsAdd( name, METRIC_VALUE, val );                                  \
+   } while ( 0 )
+#define NTracingPlotI( name, val )                                             \
+   do {                                                                        \
+      TracyCPlotI( name, val );                                                \
+      NMetricsAdd( name, METRIC_VALUE, val );                                  \
+   } while ( 0 )
 #else /* HAVE_TRACY */
-#define NTracingFrameMark
+#define NTracingFrameMark metrics_frame()
 #define NTracingFrameMarkStart( name )
 #define NTracingFrameMarkEnd( name )
-#define NTracingZone( ctx, active )
-#define NTracingZoneName( ctx, name, active )
-#define NTracingZoneEnd( ctx )
+#define NTracingZone( ctx, active ) NMetricsZone( ctx, __func__ )
+#define NTracingZoneName( ctx, name, active ) NMetricsZone( ctx, name )
+#define NTracingZoneEnd( ctx ) NMetricsZoneEnd( ctx )
 #define NTracingAlloc( ptr, size )
 #define NTracingFree( ptr )
 #define nmalloc( size ) malloc( size )
@@ -68,7 +94,7 @@ ALWAYS_INLINE static inline void *nrealloc( void *ptr, size_t size )
 #define nfree( ptr ) free( ptr )
 #define nrealloc( ptr, size ) realloc( ptr, size )
 #define NTracingMessageL( msg )
-#define NTracingPlot( name, val )
-#define NTracingPlotF( name, val )
-#define NTracingPlotI( name, val )
+#define NTracingPlot( name, val ) NMetricsAdd( name, METRIC_VALUE, val )
+#define NTracingPlotF( name, val ) NMetricsAdd( name, METRIC_VALUE, val )
+#define NTracingPlotI( name, val ) NMetricsAdd( name, METRIC_VALUE, val )
 #endif /* HAVE_TRACY */
@@ -20,7 +20,9 @@
 #include "log.h"
 #include "md5.h"
 #include "nfile.h"
+#include "ntracing.h"
 #include "opengl.h"
+#include "threadpool.h"
 
 /*
  * graphic list
@@ -45,6 +47,53 @@ static SDL_threadID tex_mainthread;
 static SDL_mutex   *gl_lock  = NULL; /**< Lock for OpenGL functions. */
 static SDL_mutex   *tex_lock = NULL; /**< Lock for texture list manipulation. */
 
+/*
+ * upload queue
+ */
+/**
+ * @brief Image data that is ready to be uploaded to OpenGL.
+ */
+typedef struct glTexUpload_ {
+   glTexture   *tex;       /**< Texture to upload to. */
+   SDL_Surface *rgba;      /**< RGBA data, NULL for SDF textures. */
+   GLfloat     *sdf;       /**< Distance field for SDF textures. */
+   int          w;         /**< Width of the image. */
+   int          h;         /**< Height of the image. */
+   int          has_alpha; /**< Whether the source image had alpha. */
+   unsigned int flags;     /**< Flags to use. */
+   size_t       bytes;     /**< Size of the data to upload. */
+   /* Only used by streamed textures. */
+   int      stream; /**< Whether the texture is being streamed in. */
+   int      sx;     /**< X sprites. */
+   int      sy;     /**< Y sprites. */
+   double   vmax;   /**< Maximum value for SDF textures. */
+   uint8_t *trans;  /**< Transparency map if requested. */
+} glTexUpload;
+static glTexUpload *tex_uploads = NULL; /**< Array (array.h): Queued uploads. */
+static glTexUpload *tex_upload_batch =
+   NULL; /**< Array (array.h): Uploads taken off the queue, main thread only. */
+static SDL_mutex   *tex_upload_lock = NULL; /**< Lock for the upload queue. */
+static SDL_cond    *tex_upload_cond =
+   NULL; /**< Signalled when uploads get queued or streams finish. */
+static SDL_atomic_t tex_defer; /**< Whether uploads from workers are queued. */
+
+/*
+ * streaming
+ */
+/**
+ * @brief Image being decoded in the background.
+ */
+typedef struct glTexStream_ {
+   glTexture   *tex;   /**< Texture to load into, holds a reference. */
+   char        *path;  /**< Path to load from. */
+   int          sx;    /**< X sprites. */
+   int          sy;    /**< Y sprites. */
+   unsigned int flags; /**< Flags to use. */
+} glTexStream;
+static SDL_atomic_t tex_streams; /**< Number of images being decoded. */
+static size_t       tex_stream_bytes =
+   0; /**< Bytes of streamed textures, guarded by tex_upload_lock. */
+
 /*
  * prototypes
  */
@@ -55,9 +104,11 @@ static USE_RESULT uint8_t *SDL_MapAlpha( SDL_Surface *s, int tight );
 static size_t              gl_transSize( const int w, const int h );
 /* glTexture */
 static USE_RESULT GLuint gl_texParameters( unsigned int flags );
-static USE_RESULT GLuint gl_loadSurface( SDL_Surface *surface,
-                                         unsigned int flags, int freesur,
-                                         double *vmax );
+static void gl_prepareSurface( glTexUpload *up, SDL_Surface *surface,
+                               unsigned int flags, int freesur, double *vmax );
+static void gl_uploadSurface( glTexUpload *up );
+static void gl_loadSurface( glTexture *tex, SDL_Surface *surface,
+                            unsigned int flags, int freesur );
 static int gl_loadNewImage( glTexture *tex, const char *path, int sx, int sy,
                             unsigned int flags );
 static int gl_loadNewImageRWops( glTexture *tex, const char *path,
@@ -70,6 +121,12 @@ static glTexture *gl_texCreate( const char *path, int sx, int sy,
                                 unsigned int flags );
 static int gl_texAdd( glTexture *tex, int sx, int sy, unsigned int flags );
 static int tex_cmp( const void *p1, const void *p2 );
+static void gl_texUploadCancel( const glTexture *tex );
+static uint8_t *gl_loadTrans( SDL_RWops *rw, SDL_Surface *surface );
+static int      gl_streamThread( void *data );
+static void     gl_streamFinish( glTexUpload *up );
+static size_t   gl_texBytes( const glTexture *tex );
+static glTexture *gl_texSync( glTexture *tex );
 
 static void tex_ctxSet( void )
 {
@@ -389,63 +446,99 @@ glTexture *gl_loadImageData( float *data, int w, int h, int sx, int sy,
 }
 
 /**
- * @brief Loads a surface into an opengl texture.
+ * @brief Does the CPU side of loading a surface into a texture.
+ *
+ * This does not touch OpenGL, so it can run on any thread without holding the
+ * context.
  *
+ *    @param[out] up Upload to fill out.
  *    @param surface Surface to load into a texture.
  *    @param flags Flags to use.
  *    @param freesur Whether or not to free the surface.
  *    @param[out] vmax The maximum value in the case of an SDF texture.
- *    @return The opengl texture id.
  */
-static GLuint gl_loadSurface( SDL_Surface *surface, unsigned int flags,
-                              int freesur, double *vmax )
+static void gl_prepareSurface( glTexUpload *up, SDL_Surface *surface,
+                               unsigned int flags, int freesur, double *vmax )
 {
    const SDL_PixelFormatEnum fmt = SDL_PIXELFORMAT_ABGR8888;
-   GLuint                    texture;
    SDL_Surface              *rgba;
-   int                       has_alpha = surface->format->Amask;
-
-   gl_contextSet();
 
-   /* Get texture. */
-   texture = gl_texParameters( flags );
+   memset( up, 0, sizeof( glTexUpload ) );
+   up->w         = surface->w;
+   up->h         = surface->h;
+   up->has_alpha = surface->format->Amask;
+   up->flags     = flags;
 
-   /* Now load the texture data up
-    * It doesn't work with indexed ones, so I guess converting is best bet. */
+   /* It doesn't work with indexed ones, so I guess converting is best bet. */
    if ( surface->format->format != fmt )
       rgba = SDL_ConvertSurfaceFormat( surface, fmt, 0 );
-   else
-      rgba = surface;
+   else if ( freesur ) {
+      rgba    = surface;
+      freesur = 0; /* We keep it. */
+   } else
+      rgba = SDL_DuplicateSurface( surface );
+   if ( freesur )
+      SDL_FreeSurface( surface );
 
-   SDL_LockSurface( rgba );
    if ( flags & OPENGL_TEX_SDF ) {
-      const float border[] = { 0., 0., 0., 0. };
-      uint8_t    *trans    = SDL_MapAlpha( rgba, 0 );
-      GLfloat    *dataf = make_distance_mapbf( trans, rgba->w, rgba->h, vmax );
+      uint8_t *trans;
+      SDL_LockSurface( rgba );
+      trans = SDL_MapAlpha( rgba, 0 );
+      SDL_UnlockSurface( rgba );
+      up->sdf   = make_distance_mapbf( trans, rgba->w, rgba->h,
+                                       SDF_QUALITY_HIGH, vmax );
+      up->bytes = sizeof( GLfloat ) * rgba->w * rgba->h;
       free( trans );
+      SDL_FreeSurface( rgba );
+   } else {
+      *vmax     = 1.;
+      up->rgba  = rgba;
+      up->bytes = (size_t)rgba->pitch * rgba->h;
+   }
+}
+
+/**
+ * @brief Uploads prepared image data into an opengl texture.
+ *
+ * Must be called with the context set.
+ *
+ *    @param up Upload to do, data gets freed.
+ */
+static void gl_uploadSurface( glTexUpload *up )
+{
+   GLuint texture;
+
+   /* Get texture. */
+   texture = gl_texParameters( up->flags );
+
+   /* Now load the texture data up. */
+   if ( up->flags & OPENGL_TEX_SDF ) {
+      const float border[] = { 0., 0., 0., 0. };
       glTexParameterfv( GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, border );
       glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER );
       glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER );
       glPixelStorei( GL_UNPACK_ALIGNMENT, 1 );
-      glTexImage2D( GL_TEXTURE_2D, 0, GL_RED, rgba->w, rgba->h, 0, GL_RED,
-                    GL_FLOAT, dataf );
+      glTexImage2D( GL_TEXTURE_2D, 0, GL_RED, up->w, up->h, 0, GL_RED,
+                    GL_FLOAT, up->sdf );
       glPixelStorei( GL_UNPACK_ALIGNMENT, 4 );
-      free( dataf );
+      free( up->sdf );
    } else {
-      *vmax = 1.;
+      SDL_Surface *rgba = up->rgba;
+      SDL_LockSurface( rgba );
       glPixelStorei( GL_UNPACK_ALIGNMENT,
                      MIN( rgba->pitch & -rgba->pitch, 8 ) );
-      glTexImage2D( GL_TEXTURE_2D, 0, has_alpha ? GL_SRGB_ALPHA : GL_SRGB,
+      glTexImage2D( GL_TEXTURE_2D, 0, up->has_alpha ? GL_SRGB_ALPHA : GL_SRGB,
                     rgba->w, rgba->h, 0, GL_RGBA, GL_UNSIGNED_BYTE,
                     rgba->pixels );
       glPixelStorei( GL_UNPACK_ALIGNMENT, 4 );
-   }
-   SDL_UnlockSurface( rgba );
-   if ( rgba != surface )
+      SDL_UnlockSurface( rgba );
       SDL_FreeSurface( rgba );
+   }
+   up->sdf  = NULL;
+   up->rgba = NULL;
 
    /* Create mipmaps. */
-   if ( flags & OPENGL_TEX_MIPMAPS ) {
+   if ( up->flags & OPENGL_TEX_MIPMAPS ) {
       /* Do fancy stuff. */
       if ( GLAD_GL_ARB_texture_filter_anisotropic ) {
          GLfloat param;
@@ -459,15 +552,133 @@ static GLuint gl_loadSurface( SDL_Surface *surface, unsigned int flags,
 
    /* Unbind the texture. */
    glBindTexture( GL_TEXTURE_2D, 0 );
-
-   /* cleanup */
-   if ( freesur )
-      SDL_FreeSurface( surface );
    gl_checkErr();
 
+   up->tex->texture = texture;
+}
+
+/**
+ * @brief Loads a surface into an opengl texture.
+ *
+ * When called from a worker while uploads are deferred, only the CPU side is
+ * done here and the upload is queued for the main thread.
+ *
+ *    @param tex Texture to load into.
+ *    @param surface Surface to load into a texture.
+ *    @param flags Flags to use.
+ *    @param freesur Whether or not to free the surface.
+ */
+static void gl_loadSurface( glTexture *tex, SDL_Surface *surface,
+                            unsigned int flags, int freesur )
+{
+   glTexUpload up;
+
+   gl_prepareSurface( &up, surface, flags, freesur, &tex->vmax );
+   up.tex = tex;
+
+   /* Leave it to the main thread. */
+   if ( ( SDL_ThreadID() != tex_mainthread ) &&
+        ( SDL_AtomicGet( &tex_defer ) > 0 ) ) {
+      tex->texture = 0;
+      SDL_mutexP( tex_upload_lock );
+      array_push_back( &tex_uploads, up );
+      SDL_CondBroadcast( tex_upload_cond );
+      SDL_mutexV( tex_upload_lock );
+      return;
+   }
+
+   gl_contextSet();
+   gl_uploadSurface( &up );
    gl_contextUnset();
+}
 
-   return texture;
+/**
+ * @brief Sets whether textures loaded on worker threads get their uploads
+ * queued for the main thread instead of taking the OpenGL context.
+ *
+ * Calls can be nested. The queue has to be processed with gl_texUpload().
+ *
+ *    @param enable Whether to start or stop deferring.
+ */
+void gl_texDeferUploads( int enable )
+{
+   SDL_AtomicAdd( &tex_defer, enable ? 1 : -1 );
+}
+
+/**
+ * @brief Uploads queued textures. Must be called from the main thread.
+ *
+ *    @param budget Maximum amount of bytes to upload, at least one texture
+ * is always uploaded. Use 0 to upload everything.
+ *    @return Amount of bytes uploaded.
+ */
+size_t gl_texUpload( size_t budget )
+{
+   size_t done = 0;
+
+   if ( gl_texUploadPending() <= 0 )
+      return 0;
+
+   NTracingZone( _ctx, 1 );
+
+   /* Take everything that fits in the budget off the queue at once, so the
+    * queue is only shifted once. */
+   if ( tex_upload_batch == NULL )
+      tex_upload_batch = array_create( glTexUpload );
+   SDL_mutexP( tex_upload_lock );
+   for ( int i = 0; i < array_size( tex_uploads ); i++ ) {
+      if ( ( budget > 0 ) && ( done >= budget ) )
+         break;
+      array_push_back( &tex_upload_batch, tex_uploads[i] );
+      done += tex_uploads[i].bytes;
+   }
+   array_erase( &tex_uploads, &tex_uploads[0],
+                &tex_uploads[array_size( tex_upload_batch )] );
+   SDL_mutexV( tex_upload_lock );
+
+   gl_contextSet();
+   for ( int i = 0; i < array_size( tex_upload_batch ); i++ ) {
+      glTexUpload *up = &tex_upload_batch[i];
+      if ( up->stream )
+         gl_streamFinish( up );
+      else
+         gl_uploadSurface( up );
+   }
+   gl_contextUnset();
+   array_resize( &tex_upload_batch, 0 );
+   NTracingPlotI( "texture upload bytes", done );
+   NTracingZoneEnd( _ctx );
+   return done;
+}
+
+/**
+ * @brief Gets the number of textures waiting to be uploaded.
+ */
+int gl_texUploadPending( void )
+{
+   int n;
+   SDL_mutexP( tex_upload_lock );
+   n = array_size( tex_uploads );
+   SDL_mutexV( tex_upload_lock );
+   return n;
+}
+
+/**
+ * @brief Drops a queued upload for a texture that is being freed.
+ */
+static void gl_texUploadCancel( const glTexture *tex )
+{
+   SDL_mutexP( tex_upload_lock );
+   for ( int i = array_size( tex_uploads ) - 1; i >= 0; i-- ) {
+      glTexUpload *up = &tex_uploads[i];
+      if ( up->tex != tex )
+         continue;
+      SDL_FreeSurface( up->rgba );
+      free( up->sdf );
+      free( up->trans );
+      array_erase( &tex_uploads, &up[0], &up[1] );
+   }
+   SDL_mutexV( tex_upload_lock );
 }
 
 /**
@@ -580,7 +791,7 @@ glTexture *gl_newImage( const char *path, const unsigned int flags )
    int        created;
    glTexture *t = gl_texExistsOrCreate( path, flags, 1, 1, &created );
    if ( !created )
-      return t;
+      return gl_texSync( t );
 
    /* Load the image */
    gl_loadNewImage( t, path, 1, 1, flags );
@@ -605,7 +816,7 @@ glTexture *gl_newImageRWops( const char *path, SDL_RWops *rw,
    int        created;
    glTexture *t = gl_texExistsOrCreate( path, flags, 1, 1, &created );
    if ( !created )
-      return t;
+      return gl_texSync( t );
 
    /* Load the image */
    gl_loadNewImageRWops( t, path, rw, 1, 1, flags );
@@ -644,6 +855,82 @@ static int gl_loadNewImage( glTexture *tex, const char *path, int sx, int sy,
    return 0;
 }
 
+/**
+ * @brief Gets the transparency map of an image, using the cache if possible.
+ *
+ *    @param rw Image file the surface was loaded from.
+ *    @param surface Surface to map.
+ *    @return Newly allocated transparency map.
+ */
+static uint8_t *gl_loadTrans( SDL_RWops *rw, SDL_Surface *surface )
+{
+   size_t      pngsize, filesize, cachesize;
+   md5_state_t md5;
+   char       *data;
+   char       *cachefile = NULL;
+   uint8_t    *trans     = NULL;
+   md5_byte_t *md5val    = malloc( 16 );
+   md5_init( &md5 );
+   char digest[33];
+
+   /* Appropriate size for the transparency map, see SDL_MapAlpha */
+   cachesize = gl_transSize( surface->w, surface->h );
+
+   /* Go to the start of the file. */
+   pngsize = SDL_RWseek( rw, 0, SEEK_END );
+   SDL_RWseek( rw, 0, SEEK_SET );
+
+   data = malloc( pngsize );
+   if ( data == NULL )
+      WARN( _( "Out of Memory" ) );
+   else {
+      SDL_RWread( rw, data, pngsize, 1 );
+      md5_append( &md5, (md5_byte_t *)data, pngsize );
+      free( data );
+   }
+   md5_finish( &md5, md5val );
+
+   for ( int i = 0; i < 16; i++ )
+      snprintf( &digest[i * 2], 3, "%02x", md5val[i] );
+   free( md5val );
+
+   SDL_asprintf( &cachefile, "%scollisions/%s", nfile_cachePath(), digest );
+
+   /* Attempt to find a cached transparency map. */
+   if ( nfile_fileExists( cachefile ) ) {
+      trans = (uint8_t *)nfile_readFile( &filesize, cachefile );
+
+      /* Consider cached data invalid if the length doesn't match. */
+      if ( trans != NULL && cachesize != (unsigned int)filesize ) {
+         free( trans );
+         trans = NULL;
+      }
+      /* Cached data matches, no need to overwrite. */
+      else {
+         free( cachefile );
+         cachefile = NULL;
+      }
+   }
+
+   if ( trans == NULL ) {
+      SDL_LockSurface( surface );
+      trans = SDL_MapAlpha( surface, 1 );
+      SDL_UnlockSurface( surface );
+
+      if ( cachefile != NULL ) {
+         /* Cache newly-generated transparency map. */
+         char dirpath[PATH_MAX];
+         snprintf( dirpath, sizeof( dirpath ), "%s/%s", nfile_cachePath(),
+                   "collisions/" );
+         nfile_dirMakeExist( dirpath );
+         nfile_writeFile( (char *)trans, cachesize, cachefile );
+         free( cachefile );
+      }
+   }
+
+   return trans;
+}
+
 /**
  * @brief The heavy loading image backend image function. It loads images and
  * does transparency mapping if necessary.
@@ -677,73 +964,8 @@ static int gl_loadNewImageRWops( glTexture *tex, const char *path,
    }
 
    /* Create a transparency map if necessary. */
-   if ( flags & OPENGL_TEX_MAPTRANS ) {
-      size_t      pngsize, filesize, cachesize;
-      md5_state_t md5;
-      char       *data;
-      char       *cachefile = NULL;
-      uint8_t    *trans     = NULL;
-      md5_byte_t *md5val    = malloc( 16 );
-      md5_init( &md5 );
-      char digest[33];
-
-      /* Appropriate size for the transparency map, see SDL_MapAlpha */
-      cachesize = gl_transSize( surface->w, surface->h );
-
-      /* Go to the start of the file. */
-      pngsize = SDL_RWseek( rw, 0, SEEK_END );
-      SDL_RWseek( rw, 0, SEEK_SET );
-
-      data = malloc( pngsize );
-      if ( data == NULL )
-         WARN( _( "Out of Memory" ) );
-      else {
-         SDL_RWread( rw, data, pngsize, 1 );
-         md5_append( &md5, (md5_byte_t *)data, pngsize );
-         free( data );
-      }
-      md5_finish( &md5, md5val );
-
-      for ( int i = 0; i < 16; i++ )
-         snprintf( &digest[i * 2], 3, "%02x", md5val[i] );
-      free( md5val );
-
-      SDL_asprintf( &cachefile, "%scollisions/%s", nfile_cachePath(), digest );
-
-      /* Attempt to find a cached transparency map. */
-      if ( nfile_fileExists( cachefile ) ) {
-         trans = (uint8_t *)nfile_readFile( &filesize, cachefile );
-
-         /* Consider cached data invalid if the length doesn't match. */
-         if ( trans != NULL && cachesize != (unsigned int)filesize ) {
-            free( trans );
-            trans = NULL;
-         }
-         /* Cached data matches, no need to overwrite. */
-         else {
-            free( cachefile );
-            cachefile = NULL;
-         }
-      }
-
-      if ( trans == NULL ) {
-         SDL_LockSurface( surface );
-         trans = SDL_MapAlpha( surface, 1 );
-         SDL_UnlockSurface( surface );
-
-         if ( cachefile != NULL ) {
-            /* Cache newly-generated transparency map. */
-            char dirpath[PATH_MAX];
-            snprintf( dirpath, sizeof( dirpath ), "%s/%s", nfile_cachePath(),
-                      "collisions/" );
-            nfile_dirMakeExist( dirpath );
-            nfile_writeFile( (char *)trans, cachesize, cachefile );
-            free( cachefile );
-         }
-      }
-
-      tex->trans = trans;
-   }
+   if ( flags & OPENGL_TEX_MAPTRANS )
+      tex->trans = gl_loadTrans( rw, surface );
 
    /* Load image if necessary. */
    tex->w  = (double)surface->w;
@@ -751,16 +973,14 @@ static int gl_loadNewImageRWops( glTexture *tex, const char *path,
    tex->sx = (double)sx;
    tex->sy = (double)sy;
 
-   tex->texture = gl_loadSurface( surface, flags, 0, &tex->vmax );
-
    tex->sw    = tex->w / tex->sx;
    tex->sh    = tex->h / tex->sy;
    tex->srw   = tex->sw / tex->w;
    tex->srh   = tex->sh / tex->h;
    tex->flags = flags;
 
-   /* Clean up. */
-   SDL_FreeSurface( surface );
+   /* Takes care of freeing the surface. */
+   gl_loadSurface( tex, surface, flags, 1 );
    return 0;
 }
 
@@ -779,7 +999,7 @@ glTexture *gl_newSprite( const char *path, const int sx, const int sy,
    int        created;
    glTexture *t = gl_texExistsOrCreate( path, flags, sx, sy, &created );
    if ( !created )
-      return t;
+      return gl_texSync( t );
 
    /* Create new image. */
    gl_loadNewImage( t, path, sx, sy, flags );
@@ -802,7 +1022,7 @@ glTexture *gl_newSpriteRWops( const char *path, SDL_RWops *rw, const int sx,
    int        created;
    glTexture *t = gl_texExistsOrCreate( path, flags, sx, sy, &created );
    if ( !created )
-      return t;
+      return gl_texSync( t );
 
    /* Create new image. */
    gl_loadNewImageRWops( t, path, rw, sx, sy, flags | OPENGL_TEX_SKIPCACHE );
@@ -818,6 +1038,218 @@ glTexture *gl_newSpriteRWops( const char *path, SDL_RWops *rw, const int sx,
    return t;
 }
 
+/**
+ * @brief Starts loading an image as a sprite in the background.
+ *
+ * The texture is returned right away, but it will not have any dimensions or
+ * image data until the main thread uploads it with gl_texUpload(). Use
+ * gl_texIsStreaming() to check whether it is usable. Must be called from the
+ * main thread.
+ *
+ *    @param path Image to load.
+ *    @param sx Number of X sprites in image.
+ *    @param sy Number of Y sprites in image.
+ *    @param flags Flags to control image parameters.
+ *    @return Texture being loaded.
+ */
+glTexture *gl_newSpriteAsync( const char *path, const int sx, const int sy,
+                              const unsigned int flags )
+{
+   int          created;
+   glTexture   *t;
+   glTexStream *ts;
+
+   /* Nothing to stream, let the normal path complain. */
+   if ( path == NULL )
+      return gl_newSprite( path, sx, sy, flags );
+
+   t = gl_texExistsOrCreate( path, flags, sx, sy, &created );
+   if ( !created )
+      return t;
+
+   /* The job keeps a reference until the main thread is done with it. */
+   t->flags |= OPENGL_TEX_STREAMING;
+   ts        = malloc( sizeof( glTexStream ) );
+   ts->tex   = gl_dupTexture( t );
+   ts->path  = strdup( path );
+   ts->sx    = sx;
+   ts->sy    = sy;
+   ts->flags = flags;
+   SDL_AtomicAdd( &tex_streams, 1 );
+   threadpool_newJob( gl_streamThread, ts );
+   return t;
+}
+
+/**
+ * @brief Starts loading an image in the background.
+ *
+ * @sa gl_newSpriteAsync
+ *
+ *    @param path Image to load.
+ *    @param flags Flags to control image parameters.
+ *    @return Texture being loaded.
+ */
+glTexture *gl_newImageAsync( const char *path, const unsigned int flags )
+{
+   return gl_newSpriteAsync( path, 1, 1, flags );
+}
+
+/**
+ * @brief Decodes a streamed image and queues it for uploading.
+ */
+static int gl_streamThread( void *data )
+{
+   glTexStream *ts      = data;
+   SDL_Surface *surface = NULL;
+   uint8_t     *trans   = NULL;
+   SDL_RWops   *rw;
+   glTexUpload  up;
+
+   memset( &up, 0, sizeof( glTexUpload ) );
+   rw = PHYSFSRWOPS_openRead( ts->path );
+   if ( rw == NULL )
+      WARN( _( "Failed to load surface '%s' from ndata." ), ts->path );
+   else {
+      surface = IMG_Load_RW( rw, 0 );
+      if ( surface == NULL )
+         WARN( _( "'%s' could not be opened" ), ts->path );
+      else if ( ts->flags & OPENGL_TEX_MAPTRANS )
+         trans = gl_loadTrans( rw, surface );
+      SDL_RWclose( rw );
+   }
+
+   /* Failed loads still get queued so the main thread drops the reference. */
+   if ( surface != NULL )
+      gl_prepareSurface( &up, surface, ts->flags | OPENGL_TEX_VFLIP, 1,
+                         &up.vmax );
+   up.tex    = ts->tex;
+   up.stream = 1;
+   up.sx     = ts->sx;
+   up.sy     = ts->sy;
+   up.trans  = trans;
+
+   SDL_mutexP( tex_upload_lock );
+   array_push_back( &tex_uploads, up );
+   SDL_AtomicAdd( &tex_streams, -1 );
+   SDL_CondBroadcast( tex_upload_cond );
+   SDL_mutexV( tex_upload_lock );
+
+   free( ts->path );
+   free( ts );
+   return 0;
+}
+
+/**
+ * @brief Fills out and uploads a streamed texture. Must be called with the
+ * context set.
+ */
+static void gl_streamFinish( glTexUpload *up )
+{
+   glTexture *tex = up->tex;
+
+   if ( ( up->rgba != NULL ) || ( up->sdf != NULL ) ) {
+      tex->w     = (double)up->w;
+      tex->h     = (double)up->h;
+      tex->sx    = (double)up->sx;
+      tex->sy    = (double)up->sy;
+      tex->sw    = tex->w / tex->sx;
+      tex->sh    = tex->h / tex->sy;
+      tex->srw   = tex->sw / tex->w;
+      tex->srh   = tex->sh / tex->h;
+      tex->vmax  = up->vmax;
+      tex->trans = up->trans;
+      tex->flags = up->flags | OPENGL_TEX_STREAMED;
+      gl_uploadSurface( up );
+      SDL_mutexP( tex_upload_lock );
+      tex_stream_bytes += gl_texBytes( tex );
+      SDL_mutexV( tex_upload_lock );
+   } else
+      tex->flags &= ~OPENGL_TEX_STREAMING;
+   up->trans = NULL;
+
+   /* Drop the reference held by the stream. */
+   gl_freeTexture( tex );
+}
+
+/**
+ * @brief Checks to see if a texture is still being streamed in.
+ *
+ *    @param tex Texture to check.
+ *    @return 1 if the texture is not usable yet.
+ */
+int gl_texIsStreaming( const glTexture *tex )
+{
+   return ( ( tex != NULL ) && ( tex->flags & OPENGL_TEX_STREAMING ) );
+}
+
+/**
+ * @brief Blocks until a streamed texture is usable. Must be called from the
+ * main thread.
+ *
+ *    @param tex Texture to wait for.
+ */
+void gl_texWait( const glTexture *tex )
+{
+   while ( gl_texIsStreaming( tex ) ) {
+      /* Sleep until a worker queues something to upload. */
+      SDL_mutexP( tex_upload_lock );
+      while ( array_size( tex_uploads ) <= 0 )
+         SDL_CondWait( tex_upload_cond, tex_upload_lock );
+      SDL_mutexV( tex_upload_lock );
+      gl_texUpload( 0 );
+   }
+}
+
+/**
+ * @brief Makes sure a texture found by a synchronous loader is usable.
+ *
+ * Workers can't upload textures, so they are left to check
+ * gl_texIsStreaming() themselves.
+ *
+ *    @param tex Texture found in the cache.
+ *    @return The texture.
+ */
+static glTexture *gl_texSync( glTexture *tex )
+{
+   if ( gl_texIsStreaming( tex ) && ( SDL_ThreadID() == tex_mainthread ) )
+      gl_texWait( tex );
+   return tex;
+}
+
+/**
+ * @brief Gets the number of streamed textures that are not usable yet.
+ */
+int gl_texStreamPending( void )
+{
+   int n = SDL_AtomicGet( &tex_streams );
+   SDL_mutexP( tex_upload_lock );
+   for ( int i = 0; i < array_size( tex_uploads ); i++ )
+      n += tex_uploads[i].stream;
+   SDL_mutexV( tex_upload_lock );
+   return n;
+}
+
+/**
+ * @brief Gets the amount of texture memory used by streamed textures.
+ */
+size_t gl_texStreamBytes( void )
+{
+   size_t bytes;
+   SDL_mutexP( tex_upload_lock );
+   bytes = tex_stream_bytes;
+   SDL_mutexV( tex_upload_lock );
+   return bytes;
+}
+
+/**
+ * @brief Estimates the amount of texture memory used by a texture.
+ */
+static size_t gl_texBytes( const glTexture *tex )
+{
+   size_t bpp = ( tex->flags & OPENGL_TEX_SDF ) ? sizeof( GLfloat ) : 4;
+   return (size_t)tex->w * (size_t)tex->h * bpp;
+}
+
 /**
  * @brief Frees a texture.
  *
@@ -841,6 +1273,12 @@ void gl_freeTexture( glTexture *texture )
       cur->used--;
       if ( cur->used <= 0 ) { /* not used anymore */
          /* free the texture */
+         if ( texture->flags & OPENGL_TEX_STREAMED ) {
+            SDL_mutexP( tex_upload_lock );
+            tex_stream_bytes -= gl_texBytes( texture );
+            SDL_mutexV( tex_upload_lock );
+         }
+         gl_texUploadCancel( texture );
          glDeleteTextures( 1, &texture->texture );
          free( texture->trans );
          free( texture->name );
@@ -862,6 +1300,7 @@ void gl_freeTexture( glTexture *texture )
    tex_ctxSet();
 
    /* Free anyways */
+   gl_texUploadCancel( texture );
    glDeleteTextures( 1, &texture->texture );
    free( texture->trans );
    free( texture->name );
@@ -1002,9 +1441,15 @@ void gl_getSpriteFromDir( int *x, int *y, int sx, int sy, double dir )
  */
 int gl_initTextures( void )
 {
-   gl_lock        = SDL_CreateMutex();
-   tex_lock       = SDL_CreateMutex();
-   tex_mainthread = SDL_ThreadID();
+   gl_lock         = SDL_CreateMutex();
+   tex_lock        = SDL_CreateMutex();
+   tex_upload_lock = SDL_CreateMutex();
+   tex_upload_cond = SDL_CreateCond();
+   tex_mainthread  = SDL_ThreadID();
+   tex_uploads     = array_create( glTexUpload );
+   SDL_AtomicSet( &tex_defer, 0 );
+   SDL_AtomicSet( &tex_streams, 0 );
+   tex_stream_bytes = 0;
    return 0;
 }
 
@@ -1013,8 +1458,21 @@ int gl_initTextures( void )
  */
 void gl_exitTextures( void )
 {
+   /* Let streams finish so their references get dropped. */
+   SDL_mutexP( tex_upload_lock );
+   while ( SDL_AtomicGet( &tex_streams ) > 0 )
+      SDL_CondWait( tex_upload_cond, tex_upload_lock );
+   SDL_mutexV( tex_upload_lock );
+   gl_texUpload( 0 );
+
+   SDL_DestroyCond( tex_upload_cond );
+   SDL_DestroyMutex( tex_upload_lock );
    SDL_DestroyMutex( tex_lock );
    SDL_DestroyMutex( gl_lock );
+   array_free( tex_uploads );
+   tex_uploads = NULL;
+   array_free( tex_upload_batch );
+   tex_upload_batch = NULL;
 
    if ( array_size( texture_list ) <= 0 ) {
       array_free( texture_list );
@@ -19,6 +19,9 @@
 #define AMASK SDL_SwapLE32( 0xff000000 ) /**< Alpha bit mask. */
 #define RGBAMASK RMASK, GMASK, BMASK, AMASK
 
+#define TEX_UPLOAD_BUDGET                                                      \
+   ( 16 << 20 ) /**< Bytes of queued textures to upload per frame. */
+
 /*
  * Texture flags.
  */
@@ -33,6 +36,10 @@
    ( 1 << 4 ) /**< Convert to an SDF. Only the alpha channel gets used. */
 #define OPENGL_TEX_CLAMP_ALPHA                                                 \
    ( 1 << 5 ) /**< Clamp image border to transparency. */
+#define OPENGL_TEX_STREAMING                                                   \
+   ( 1 << 6 ) /**< Texture is still being loaded in the background. */
+#define OPENGL_TEX_STREAMED                                                    \
+   ( 1 << 7 ) /**< Texture was loaded in the background. */
 
 /**
  * @brief Abstraction for rendering sprite sheets.
@@ -83,6 +90,11 @@ USE_RESULT glTexture *gl_newSprite( const char *path, const int sx,
 USE_RESULT glTexture *gl_newSpriteRWops( const char *path, SDL_RWops *rw,
                                          const int sx, const int sy,
                                          const unsigned int flags );
+USE_RESULT glTexture *gl_newImageAsync( const char        *path,
+                                        const unsigned int flags );
+USE_RESULT glTexture *gl_newSpriteAsync( const char *path, const int sx,
+                                         const int          sy,
+                                         const unsigned int flags );
 USE_RESULT glTexture *gl_dupTexture( const glTexture *texture );
 USE_RESULT glTexture *gl_rawTexture( const char *name, GLuint tex, double w,
                                      double h );
@@ -103,6 +115,13 @@ int gl_fboAddDepth( GLuint fbo, GLuint *tex, GLsizei width, GLsizei height );
  */
 void        gl_contextSet( void );
 void        gl_contextUnset( void );
+void        gl_texDeferUploads( int enable );
+size_t      gl_texUpload( size_t budget );
+int         gl_texUploadPending( void );
+int         gl_texIsStreaming( const glTexture *tex );
+void        gl_texWait( const glTexture *tex );
+int         gl_texStreamPending( void );
+size_t      gl_texStreamBytes( void );
 int         gl_isTrans( const glTexture *t, const int x, const int y );
 void        gl_getSpriteFromDir( int *x, int *y, int sx, int sy, double dir );
 glTexture **gl_copyTexArray( glTexture **tex );
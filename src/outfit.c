@@ -26,6 +26,7 @@
 #include "damagetype.h"
 #include "log.h"
 #include "mapData.h"
+#include "nameidx.h"
 #include "ndata.h"
 #include "nlua.h"
 #include "nlua_camera.h"
@@ -65,6 +66,8 @@ typedef struct OutfitThreadData_ {
 static Outfit *outfit_stack  = NULL; /**< Stack of outfits. */
 static char  **license_stack = NULL; /**< Stack of available licenses. */
 
+static NameIdx outfit_idx; /**< Outfits indexed by name. */
+
 /*
  * Helper stuff for setting up short descriptions for outfits.
  */
@@ -175,45 +178,69 @@ int outfit_gfxStoreLoaded( const Outfit *o )
    return ( o->gfx_store != NULL );
 }
 
+/**
+ * @brief Starts streaming in the store graphics of all the outfits flagged
+ * with OUTFIT_PROP_NEEDSGFX. Does not block, the images show up once they
+ * have been uploaded.
+ */
 int outfit_gfxStoreLoadNeeded( void )
 {
-   ThreadQueue *tq = vpool_create();
-   SDL_GL_MakeCurrent( gl_screen.window, NULL );
    for ( int i = 0; i < array_size( outfit_stack ); i++ ) {
       Outfit *o = &outfit_stack[i];
       if ( !outfit_isProp( o, OUTFIT_PROP_NEEDSGFX ) )
          continue;
-      vpool_enqueue( tq, (int ( * )( void * ))outfit_gfxStoreLoad, o );
+      outfit_gfxStoreRequest( o );
       outfit_rmProp( o, OUTFIT_PROP_NEEDSGFX );
    }
-   vpool_wait( tq );
-   vpool_cleanup( tq );
-   SDL_GL_MakeCurrent( gl_screen.window, gl_screen.context );
    return 0;
 }
 
 /**
- * @brief Loads the store graphics for the outfit.
+ * @brief Gets the path of the store graphics of an outfit.
+ */
+static void outfit_gfxStorePath( const Outfit *o, char *filename, size_t len )
+{
+   /* Check for absolute pathe. */
+   if ( o->gfx_store_path[0] == '/' )
+      snprintf( filename, len, "%s", o->gfx_store_path );
+   else
+      snprintf( filename, len, OUTFIT_GFX_PATH "store/%s", o->gfx_store_path );
+}
+
+/**
+ * @brief Loads the store graphics for the outfit, blocking until they are
+ * usable. Must be called from the main thread.
  */
 int outfit_gfxStoreLoad( Outfit *o )
 {
    char filename[PATH_MAX];
 
-   if ( outfit_gfxStoreLoaded( o ) )
+   /* May still be streaming in. */
+   if ( outfit_gfxStoreLoaded( o ) ) {
+      gl_texWait( o->gfx_store );
       return 0;
-
-   /* Check for absolute pathe. */
-   if ( o->gfx_store_path[0] == '/' )
-      snprintf( filename, sizeof( filename ), "%s", o->gfx_store_path );
-   else
-      snprintf( filename, sizeof( filename ), OUTFIT_GFX_PATH "store/%s",
-                o->gfx_store_path );
+   }
 
    /* Load the graphic. */
+   outfit_gfxStorePath( o, filename, sizeof( filename ) );
    o->gfx_store = gl_newImage( filename, OPENGL_TEX_MIPMAPS );
    return 0;
 }
 
+/**
+ * @brief Starts loading the store graphics for the outfit in the background.
+ */
+void outfit_gfxStoreRequest( Outfit *o )
+{
+   char filename[PATH_MAX];
+
+   if ( outfit_gfxStoreLoaded( o ) )
+      return;
+
+   outfit_gfxStorePath( o, filename, sizeof( filename ) );
+   o->gfx_store = gl_newImageAsync( filename, OPENGL_TEX_MIPMAPS );
+}
+
 /**
  * @brief Gets an outfit by name.
  *
@@ -236,9 +263,8 @@ const Outfit *outfit_get( const char *name )
  */
 const Outfit *outfit_getW( const char *name )
 {
-   const Outfit s = { .name = (char *)name };
-   return bsearch( &s, outfit_stack, array_size( outfit_stack ),
-                   sizeof( Outfit ), outfit_cmp );
+   int i = nameidx_get( &outfit_idx, name );
+   return ( i < 0 ) ? NULL : &outfit_stack[i];
 }
 
 /**
@@ -3050,6 +3076,9 @@ int outfit_load( void )
    if ( license_stack != NULL )
       qsort( license_stack, array_size( license_stack ), sizeof( char * ),
              strsort );
+   nameidx_init( &outfit_idx, noutfits );
+   for ( int i = 0; i < noutfits; i++ )
+      nameidx_add( &outfit_idx, outfit_stack[i].name, i );
 
 #if DEBUGGING
    for ( int i = 1; i < noutfits; i++ )
@@ -3416,6 +3445,7 @@ void outfit_free( void )
       array_free( o->tags );
    }
 
+   nameidx_free( &outfit_idx );
    array_free( outfit_stack );
    array_free( license_stack );
 }
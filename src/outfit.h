@@ -466,6 +466,7 @@ typedef struct Outfit_ {
 int           outfit_gfxStoreLoaded( const Outfit *o );
 int           outfit_gfxStoreLoadNeeded( void );
 int           outfit_gfxStoreLoad( Outfit *o );
+void          outfit_gfxStoreRequest( Outfit *o );
 const Outfit *outfit_get( const char *name );
 const Outfit *outfit_getW( const char *name );
 const Outfit *outfit_getAll( void );
@@ -40,6 +40,8 @@
 #include "rng.h"
 
 #define PILOT_SIZE_MIN 128 /**< Minimum chunks to increment pilot_stack by */
+#define PILOT_LOD_PERIOD                                                       \
+   0.1 /**< Base time between steps of pilots simulated at a reduced rate. */
 
 /* ID Generators. */
 static unsigned int pilot_id =
@@ -51,6 +53,15 @@ static Pilot **pilot_stack =
             e.g. backup ships.) */
 static Quadtree pilot_quadtree; /**< Quadtree for the pilots. */
 static IntList  pilot_qtquery;  /**< Quadtree query. */
+static IntList  pilot_lodquery; /**< Quadtree query for the LOD scheduling. */
+static const Pilot **pilot_lod_combat =
+   NULL; /**< Array (array.h): Where the action is, scratch for the LOD. */
+static char *pilot_lod_near =
+   NULL; /**< Array (array.h): Pilots near the action, scratch for the LOD. */
+static int *pilot_think_first =
+   NULL; /**< Array (array.h): Pilots that think first, scratch. */
+static int *pilot_think_rest =
+   NULL; /**< Array (array.h): Pilots that think afterwards, scratch. */
 static int      qt_init = 0;
 /* A simple grid search procedure was used to determine the following
  * parameters. */
@@ -75,6 +86,9 @@ static void pilot_init( Pilot *dest, const Ship *ship, const char *name,
 static void pilot_hyperspace( Pilot *pilot, double dt );
 static void pilot_refuel( Pilot *p, double dt );
 static void pilot_updateSolid( Pilot *p, double dt );
+static int  pilot_lodInCombat( const Pilot *p );
+static int  pilot_lodIsActive( const Pilot *p );
+static void pilot_lodSchedule( double dt );
 /* Clean up. */
 static void pilot_erase( Pilot *p );
 /* Misc. */
@@ -1977,8 +1991,15 @@ void pilot_render( Pilot *p )
       if ( !pilot_isPlayer( p ) && pilot_isFlag( p, PILOT_STEALTH ) )
          c.a = 0.5;
 
+      /* Graphics are still streaming in, draw a cheap stand-in. */
+      if ( !ship_gfxLoaded( p->ship ) ) {
+         glColour pc = *pilot_getColour( p );
+         pc.a *= c.a;
+         gl_renderTriangleEmpty( x + z * w * 0.5, y + z * h * 0.5,
+                                 p->solid.dir, z * w * 0.25 * scale, 2., &pc );
+      }
       /* Render normally. */
-      if ( e == NULL ) {
+      else if ( e == NULL ) {
          if ( p->ship->gfx_3d != NULL ) {
             /* Render to framebuffer first. */
             pilot_renderFramebufferBase( p, gl_screen.fbo[2], gl_screen.nw,
@@ -3488,8 +3509,11 @@ Pilot *pilot_create( const Ship *ship, const char *name, int faction,
    /* Set the pilot in the stack -- must be there before initializing */
    array_push_back( &pilot_stack, p );
 
-   /* Load ship graphics. */
-   ship_gfxLoad( (Ship *)ship ); /* TODO no casting. */
+   /* Load ship graphics, only the player has to wait for them. */
+   if ( pilot_isFlagRaw( flags, PILOT_PLAYER ) )
+      ship_gfxLoad( (Ship *)ship ); /* TODO no casting. */
+   else
+      ship_gfxRequest( (Ship *)ship );
 
    /* Initialize the pilot. */
    pilot_init( p, ship, name, faction, dir, pos, vel, flags, dockpilot,
@@ -3600,8 +3624,8 @@ unsigned int pilot_addStack( Pilot *p )
 
    array_push_back( &pilot_stack, p );
 
-   /* Load ship graphics. */
-   ship_gfxLoad( (Ship *)p->ship ); /* TODO no casting. */
+   /* Stream in ship graphics. */
+   ship_gfxRequest( (Ship *)p->ship ); /* TODO no casting. */
 
    /* Have to reset after adding to stack, as some Lua functions will run code
     * on the pilot. */
@@ -3912,6 +3936,7 @@ void pilots_init( void )
 {
    pilot_stack = array_create_size( Pilot *, PILOT_SIZE_MIN );
    il_create( &pilot_qtquery, 1 );
+   il_create( &pilot_lodquery, 1 );
 }
 
 /**
@@ -3943,6 +3968,15 @@ void pilots_free( void )
    /* Clean up quadtree. */
    qt_destroy( &pilot_quadtree );
    il_destroy( &pilot_qtquery );
+   il_destroy( &pilot_lodquery );
+   array_free( pilot_lod_combat );
+   pilot_lod_combat = NULL;
+   array_free( pilot_lod_near );
+   pilot_lod_near = NULL;
+   array_free( pilot_think_first );
+   pilot_think_first = NULL;
+   array_free( pilot_think_rest );
+   pilot_think_rest = NULL;
 }
 
 /**
@@ -4105,65 +4139,259 @@ void pilots_updatePurge( void )
 }
 
 /**
- * @brief Updates all the pilots.
+ * @brief Checks to see if a pilot is fighting.
  *
- *    @param dt Delta tick for the update.
+ *    @param p Pilot to check.
+ *    @return 1 if the pilot was hit recently, is being shot at or is targeting
+ *            an enemy.
  */
-void pilots_update( double dt )
+static int pilot_lodInCombat( const Pilot *p )
 {
-   NTracingZone( _ctx, 1 );
-   NTracingPlotI( "pilots", array_size( pilot_stack ) );
+   const Pilot *target;
 
-   /* Have all the pilots think. */
-   for ( int i = 0; i < array_size( pilot_stack ); i++ ) {
-      Pilot *p = pilot_stack[i];
+   if ( ( p->stimer > 0. ) || ( p->projectiles > 0 ) || ( p->lockons > 0 ) )
+      return 1;
 
-      /* Invisible, not doing anything. */
-      if ( pilot_isFlag( p, PILOT_HIDE ) )
-         continue;
+   target = pilot_getTarget( (Pilot *)p );
+   return ( ( target != NULL ) && pilot_areEnemies( p, target ) );
+}
 
-      /* See if should think. */
-      if ( pilot_isDisabled( p ) )
-         continue;
-      if ( pilot_isFlag( p, PILOT_DEAD ) || pilot_isFlag( p, PILOT_DELETE ) )
-         continue;
+/**
+ * @brief Checks to see if a pilot must be simulated at the full rate
+ * regardless of where it is.
+ *
+ *    @param p Pilot to check.
+ *    @return 1 if the pilot must be simulated every frame.
+ */
+static int pilot_lodIsActive( const Pilot *p )
+{
+   /* Directly controlled or related to the player. */
+   if ( pilot_isPlayer( p ) || pilot_isFlag( p, PILOT_MANUAL_CONTROL ) ||
+        pilot_isWithPlayer( p ) )
+      return 1;
+   if ( ( player.p != NULL ) && ( player.p->target == p->id ) )
+      return 1;
+
+   /* Missions and events care about what happens to it. */
+   if ( array_size( p->hooks ) > 0 )
+      return 1;
+
+   /* Timed events have to happen at the same time as at the full rate. */
+   if ( pilot_isFlag( p, PILOT_HYP_PREP ) ||
+        pilot_isFlag( p, PILOT_HYP_BEGIN ) ||
+        pilot_isFlag( p, PILOT_HYPERSPACE ) ||
+        pilot_isFlag( p, PILOT_HYP_END ) || pilot_isFlag( p, PILOT_LANDING ) ||
+        pilot_isFlag( p, PILOT_TAKEOFF ) || pilot_isFlag( p, PILOT_BOARDING ) ||
+        pilot_isFlag( p, PILOT_REFUELING ) ||
+        pilot_isFlag( p, PILOT_REFUELBOARDING ) ||
+        pilot_isFlag( p, PILOT_DEAD ) || pilot_isFlag( p, PILOT_COOLDOWN ) )
+      return 1;
+
+   return pilot_lodInCombat( p );
+}
 
-      /* Ignore persisting pilots during simulation since they don't get
-       * cleared. */
-      if ( space_isSimulation() && ( pilot_isFlag( p, PILOT_PERSIST ) ) )
+/**
+ * @brief Decides how much time each pilot gets simulated this frame.
+ *
+ * Pilots far away from both the player and any fighting only get stepped
+ * every PILOT_LOD_PERIOD or so, with the time accumulated in the meantime.
+ * Their AI only thinks on those steps, which defers their control ticks too.
+ * Pilots get promoted back to the full rate as soon as they get close to the
+ * action, are targeted by the player or get hooks, and catch up with all the
+ * time they accumulated.
+ *
+ * Pilots near the action are found with the quadtree, which is up to date
+ * since pilots_updatePurge() runs first.
+ *
+ *    @param dt Current delta tick.
+ */
+static void pilot_lodSchedule( double dt )
+{
+   double r, r2;
+   int    nlod;
+
+   /* Disabled, everyone runs at the full rate. */
+   if ( conf.sim_lod_range <= 0. ) {
+      for ( int i = 0; i < array_size( pilot_stack ); i++ ) {
+         Pilot *p = pilot_stack[i];
+         if ( pilot_isFlag( p, PILOT_SIMLOD ) ) {
+            pilot_rmFlag( p, PILOT_SIMLOD );
+            p->lod_step  = dt + p->lod_accum;
+            p->lod_accum = 0.;
+         } else
+            p->lod_step = dt;
+      }
+      return;
+   }
+
+   /* Gather the places where the action is. */
+   if ( pilot_lod_combat == NULL ) {
+      pilot_lod_combat = array_create( const Pilot * );
+      pilot_lod_near   = array_create( char );
+   }
+   array_resize( &pilot_lod_combat, 0 );
+   if ( player.p != NULL )
+      array_push_back( &pilot_lod_combat, player.p );
+   for ( int i = 0; i < array_size( pilot_stack ); i++ ) {
+      const Pilot *p = pilot_stack[i];
+      if ( pilot_isFlag( p, PILOT_HIDE ) || pilot_isFlag( p, PILOT_DELETE ) ||
+           pilot_isPlayer( p ) )
          continue;
+      if ( pilot_lodInCombat( p ) )
+         array_push_back( &pilot_lod_combat, p );
+   }
 
-      /* Hyperspace gets special treatment */
-      if ( pilot_isFlag( p, PILOT_HYP_PREP ) ) {
-         if ( !pilot_isFlag( p, PILOT_HYPERSPACE ) )
-            ai_think( p, dt, 0 );
-         pilot_hyperspace( p, dt );
+   /* Mark the pilots around each of them. */
+   r  = conf.sim_lod_range;
+   r2 = pow2( r );
+   array_resize( &pilot_lod_near, array_size( pilot_stack ) );
+   memset( pilot_lod_near, 0, array_size( pilot_stack ) );
+   for ( int j = 0; j < array_size( pilot_lod_combat ); j++ ) {
+      const Pilot *c = pilot_lod_combat[j];
+      int          x = round( c->solid.pos.x );
+      int          y = round( c->solid.pos.y );
+      pilot_collideQueryIL( &pilot_lodquery, x - r, y - r, x + r, y + r );
+      for ( int k = 0; k < il_size( &pilot_lodquery ); k++ ) {
+         int i = il_get( &pilot_lodquery, k, 0 );
+         if ( vec2_dist2( &pilot_stack[i]->solid.pos, &c->solid.pos ) < r2 )
+            pilot_lod_near[i] = 1;
       }
-      /* Entering hyperspace. */
-      else if ( pilot_isFlag( p, PILOT_HYP_END ) ) {
-         if ( ( VMOD( p->solid.vel ) <
-                2 * solid_maxspeed( &p->solid, p->speed, p->accel ) ) &&
-              ( p->ptimer < 0. ) )
-            pilot_rmFlag( p, PILOT_HYP_END );
+   }
+
+   nlod = 0;
+   for ( int i = 0; i < array_size( pilot_stack ); i++ ) {
+      Pilot *p   = pilot_stack[i];
+      int    lod = !pilot_lod_near[i] && !pilot_lodIsActive( p );
+
+      if ( !lod ) {
+         /* Promoted back, catch up with the accumulated time. */
+         p->lod_step  = dt + p->lod_accum;
+         p->lod_accum = 0.;
+         pilot_rmFlag( p, PILOT_SIMLOD );
+         continue;
+      }
+
+      /* Periods depend on the ID so the steps don't all end up in the same
+       * frame, while staying deterministic. */
+      pilot_setFlag( p, PILOT_SIMLOD );
+      p->lod_accum += dt;
+      if ( p->lod_accum >= PILOT_LOD_PERIOD * ( 1. + 0.25 * ( p->id % 4 ) ) ) {
+         p->lod_step  = p->lod_accum;
+         p->lod_accum = 0.;
+      } else
+         p->lod_step = -1.;
+      nlod++;
+   }
+
+   NTracingPlotI( "pilots reduced rate", nlod );
+}
+
+/**
+ * @brief Has a pilot think.
+ *
+ *    @param p Pilot to think.
+ *    @param dt Delta tick for the update.
+ */
+static void pilot_think( Pilot *p, double dt )
+{
+   double pdt;
+
+   /* Invisible, not doing anything. */
+   if ( pilot_isFlag( p, PILOT_HIDE ) )
+      return;
+
+   /* Waiting for its next reduced rate step. Pilots created this frame
+    * haven't been scheduled yet. */
+   if ( p->lod_step < 0. )
+      return;
+   pdt = ( p->lod_step > 0. ) ? p->lod_step : dt;
+
+   /* See if should think. */
+   if ( pilot_isDisabled( p ) )
+      return;
+   if ( pilot_isFlag( p, PILOT_DEAD ) || pilot_isFlag( p, PILOT_DELETE ) )
+      return;
+
+   /* Ignore persisting pilots during simulation since they don't get
+    * cleared. */
+   if ( space_isSimulation() && ( pilot_isFlag( p, PILOT_PERSIST ) ) )
+      return;
+
+   /* Hyperspace gets special treatment */
+   if ( pilot_isFlag( p, PILOT_HYP_PREP ) ) {
+      if ( !pilot_isFlag( p, PILOT_HYPERSPACE ) )
+         ai_think( p, pdt, 0 );
+      pilot_hyperspace( p, pdt );
+   }
+   /* Entering hyperspace. */
+   else if ( pilot_isFlag( p, PILOT_HYP_END ) ) {
+      if ( ( VMOD( p->solid.vel ) <
+             2 * solid_maxspeed( &p->solid, p->speed, p->accel ) ) &&
+           ( p->ptimer < 0. ) )
+         pilot_rmFlag( p, PILOT_HYP_END );
+   }
+   /* Must not be boarding to think. */
+   else if ( !pilot_isFlag( p, PILOT_BOARDING ) &&
+             !pilot_isFlag( p, PILOT_REFUELBOARDING ) &&
+             /* Must not be landing nor taking off. */
+             !pilot_isFlag( p, PILOT_LANDING ) &&
+             !pilot_isFlag( p, PILOT_TAKEOFF ) &&
+             /* Must not be jumping in. */
+             !pilot_isFlag( p, PILOT_HYP_END ) ) {
+      if ( pilot_isFlag( p, PILOT_PLAYER ) )
+         player_think( p, pdt );
+      else
+         ai_think( p, pdt, 1 );
+   }
+}
+
+/**
+ * @brief Updates all the pilots.
+ *
+ *    @param dt Delta tick for the update.
+ */
+void pilots_update( double dt )
+{
+   NTracingZone( _ctx, 1 );
+   NTracingPlotI( "pilots", array_size( pilot_stack ) );
+
+   /* Figure out which pilots get simulated at a reduced rate. */
+   pilot_lodSchedule( dt );
+
+   /* Have all the pilots think, spreading control ticks over frames. With
+    * a budget, the pilots the player would notice go first so the budget
+    * goes to them before the rest. The budget itself is reset once per
+    * rendered frame by main_loop(). */
+   if ( conf.ai_budget > 0. ) {
+      int n = array_size( pilot_stack );
+      if ( pilot_think_first == NULL ) {
+         pilot_think_first = array_create( int );
+         pilot_think_rest  = array_create( int );
       }
-      /* Must not be boarding to think. */
-      else if ( !pilot_isFlag( p, PILOT_BOARDING ) &&
-                !pilot_isFlag( p, PILOT_REFUELBOARDING ) &&
-                /* Must not be landing nor taking off. */
-                !pilot_isFlag( p, PILOT_LANDING ) &&
-                !pilot_isFlag( p, PILOT_TAKEOFF ) &&
-                /* Must not be jumping in. */
-                !pilot_isFlag( p, PILOT_HYP_END ) ) {
-         if ( pilot_isFlag( p, PILOT_PLAYER ) )
-            player_think( p, dt );
+      array_resize( &pilot_think_first, 0 );
+      array_resize( &pilot_think_rest, 0 );
+      for ( int i = 0; i < n; i++ ) {
+         if ( ai_isPriority( pilot_stack[i] ) )
+            array_push_back( &pilot_think_first, i );
          else
-            ai_think( p, dt, 1 );
+            array_push_back( &pilot_think_rest, i );
       }
+      for ( int i = 0; i < array_size( pilot_think_first ); i++ )
+         pilot_think( pilot_stack[pilot_think_first[i]], dt );
+      for ( int i = 0; i < array_size( pilot_think_rest ); i++ )
+         pilot_think( pilot_stack[pilot_think_rest[i]], dt );
+      /* Pilots created while thinking. */
+      for ( int i = n; i < array_size( pilot_stack ); i++ )
+         pilot_think( pilot_stack[i], dt );
+   } else {
+      for ( int i = 0; i < array_size( pilot_stack ); i++ )
+         pilot_think( pilot_stack[i], dt );
    }
 
    /* Now update all the pilots. */
    for ( int i = 0; i < array_size( pilot_stack ); i++ ) {
       Pilot *p = pilot_stack[i];
+      double pdt;
 
       /* Ignore. */
       if ( pilot_isFlag( p, PILOT_DELETE ) )
@@ -4173,11 +4401,17 @@ void pilots_update( double dt )
       if ( pilot_isFlag( p, PILOT_HIDE ) )
          continue;
 
+      /* Waiting for its next reduced rate step. */
+      if ( p->lod_step < 0. )
+         continue;
+      pdt = ( p->lod_step > 0. ) ? p->lod_step : dt;
+      p->lod_step = 0.;
+
       /* Just update the pilot. */
       if ( pilot_isFlag( p, PILOT_PLAYER ) )
-         player_update( p, dt );
+         player_update( p, pdt );
       else
-         pilot_update( p, dt );
+         pilot_update( p, pdt );
    }
 
    NTracingZoneEnd( _ctx );
@@ -432,6 +432,8 @@ typedef struct Pilot_ {
    double     dtimer_accum;  /**< Accumulated disable timer. */
    double     otimer;        /**< Lua outfit timer. */
    double     scantimer;     /**< Electronic warfare scanning timer. */
+   double     lod_accum;     /**< Time accumulated for reduced rate steps. */
+   double     lod_step;      /**< Time to simulate this frame, <0 skips. */
    int        hail_pos;      /**< Hail animation position. */
    int    lockons; /**< Stores how many seeking weapons are targeting pilot */
    int    projectiles;   /**< Stores how many weapons are after the pilot */
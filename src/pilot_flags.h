@@ -27,6 +27,7 @@ enum {
    PILOT_CREATED_AI,   /**< Pilot has already created AI. */
    PILOT_NO_OUTFITS,   /**< Do not create the pilot with outfits. */
    PILOT_NO_EQUIP,     /**< Do not run the equip script on the pilot. */
+   PILOT_EQUIP_ASYNC,  /**< Equip script may finish after the pilot spawns. */
    /*
     * Dynamic flags
     */
@@ -96,6 +97,7 @@ enum {
    PILOT_NOLAND,         /**< Pilot cannot land on spobs. */
    PILOT_HASSPEEDLIMIT,  /**< Speed limiting is activated for Pilot.*/
    PILOT_BRAKING,        /**< Pilot is braking. */
+   PILOT_SIMLOD,         /**< Pilot is simulated at a reduced rate. */
    /* Sentinal. */
    PILOT_FLAGS_MAX /**< Maximum number of flags. */
 };
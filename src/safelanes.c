@@ -7,6 +7,16 @@
  * @brief Handles factions' safe lanes through systems.
  * This implements the algorithm described in utils/lanes-generator (whitepaper
  * and much clearer Python version).
+ *
+ * The inputs (universe topology and presences) are snapshotted on the main
+ * thread and hashed. Results are cached on disk under that hash, so a known
+ * universe doesn't need to run the optimization at all. On a cache miss, the
+ * optimization is run in the background and the previously calculated lanes
+ * remain in use until the new ones are swapped in.
+ *
+ * Within an optimization, the stiffness matrix factorization is updated in
+ * place with low-rank updates as lanes get activated between turns. Every
+ * optimization starts from scratch, so the lanes only depend on the input.
  */
 /** @cond */
 #include <math.h>
@@ -35,6 +45,7 @@
 #define I_LOVE_FORTRAN 1
 #endif
 
+#include "SDL_mutex.h"
 #include "SDL_timer.h"
 
 #include "naev.h"
@@ -45,6 +56,9 @@
 #include "array.h"
 #include "conf.h"
 #include "log.h"
+#include "md5.h"
+#include "nfile.h"
+#include "threadpool.h"
 #include "union_find.h"
 
 /*
@@ -56,6 +70,15 @@ static const double JUMP_CONDUCTIVITY =
    0.001; /**< Conductivity value for inter-system jump-point connections. */
 static const double MIN_ANGLE =
    M_PI / 18.; /**< Path triangles can't be more acute. */
+static const double UPDOWN_MAX_FRACTION =
+   0.05; /**< Refactorize instead of updating the factor when more than this
+            fraction of the vertices had lanes activated in a turn. */
+static const char SAFELANES_CACHE_MAGIC[4] = {
+   'N', 'S', 'L', 'C' }; /**< Identifies safe lane cache files. */
+static const uint32_t SAFELANES_CACHE_VERSION =
+   1; /**< Bump when the algorithm or cache format changes. */
+static const int SAFELANES_CACHE_MAX =
+   16; /**< Number of digests kept in the cache, older ones get deleted. */
 enum {
    STORAGE_MODE_LOWER_TRIANGULAR_PART =
       -1, /**< A CHOLMOD "stype" value: matrix is interpreted as symmetric. */
@@ -96,6 +119,42 @@ typedef struct Faction_ {
    double lane_base_cost;           /**< Base cost of a lane. */
 } Faction;
 
+/** @brief Snapshot of a spob, as far as the lane optimization cares. */
+typedef struct SnapSpob_ {
+   int    id;       /**< Spob ID. */
+   int    faction;  /**< Faction generating the spob's presence. */
+   double presence; /**< Presence of the spob (base + bonus). */
+   vec2   pos;      /**< Position within the system. */
+   int    valid;    /**< Whether it can be a lane endpoint. */
+} SnapSpob;
+
+/** @brief Snapshot of a jump point, as far as the lane optimization cares. */
+typedef struct SnapJump_ {
+   int  targetid; /**< ID of the target system. */
+   int  returnid; /**< Index of the return jump in the target, or -1. */
+   vec2 pos;      /**< Position within the system. */
+   int  valid;    /**< Whether it can be a lane endpoint. */
+} SnapJump;
+
+/** @brief Snapshot of a system, index-aligned with the real one. */
+typedef struct SnapSystem_ {
+   md5_byte_t hash[16]; /**< Hash of everything below and the presences. */
+   int        nolanes;  /**< System has SYSTEM_NOLANES set. */
+   SnapSpob  *spobs;    /**< Array (array.h): Per system spob. */
+   SnapJump  *jumps;    /**< Array (array.h): Per system jump. */
+} SnapSystem;
+
+/** @brief Everything the lane optimization reads from the universe. Owned by
+ * whichever thread computes the lanes, so the universe can keep changing. */
+typedef struct SafeLanesInput_ {
+   SnapSystem *systems;  /**< Array (array.h): Per system. */
+   Faction    *factions; /**< Array (array.h): The lane-building factions. */
+   double    **presence; /**< Array (array.h): Per faction, per system, the
+                            faction's presence. */
+   char     digest[33];  /**< Hash of all the above, used as a cache key. */
+   unsigned gen;         /**< Request generation, to discard stale results. */
+} SafeLanesInput;
+
 /** @brief A set of lane-building factions, represented as a bitfield. */
 typedef uint32_t         FactionMask;
 static const FactionMask MASK_0 = 0, MASK_1 = 1;
@@ -147,15 +206,47 @@ static cholmod_dense
    *utilde; /**< Potentials (bunch of U columns in the KU=F problem). */
 static cholmod_dense **PPl; /**< Array: (array.h): For each builder faction, The
                                (P*)P in: grad_u(phi)=(Q*)Q U~ (P*)P. */
+static cholmod_factor *stiff_f; /**< Factorization of the stiffness matrix,
+                                   kept up to date across turns. */
+static int *activated_edges; /**< Array (array.h): Edges activated since stiff_f
+                                was last brought up to date. */
 static double *cmp_key_ref; /**< To qsort() a list of indices by table value,
                                point this at your table and use cmp_key. */
-static int safelanes_calculated_once =
-   0; /**< Whether or not the safe lanes have been computed once. */
+static const SafeLanesInput
+   *snap; /**< Input of the optimization currently running. */
+
+/*
+ * Results and background computation.
+ */
+static SafeLane **lanes_published; /**< Array (array.h): Per system, Array
+                                      (array.h) of lanes. Guarded by
+                                      lanes_lock. */
+static unsigned lanes_gen; /**< Generation of the published lanes. */
+static SDL_mutex *lanes_lock; /**< Guards swapping the published lanes. */
+static SDL_mutex *job_lock;   /**< Guards the background job state below. */
+static SDL_cond  *job_cond;   /**< Signalled when the worker goes idle. */
+static SafeLanesInput *job_pending; /**< Latest input not yet started. */
+static int             job_working; /**< Whether a worker is running. */
+static int             job_quit;    /**< Tells the worker to stop. */
+static unsigned        job_gen;     /**< Last requested generation. */
+static SDL_mutex *cache_lock; /**< Guards the cache index. */
 
 /*
  * Prototypes.
  */
-static int    safelanes_buildOneTurn( int iters_done );
+static SafeLanesInput *safelanes_snapshot( void );
+static void            safelanes_freeInput( SafeLanesInput *in );
+static void            safelanes_solve( const SafeLanesInput *in );
+static int             safelanes_thread( void *data );
+static SafeLane      **safelanes_export( void );
+static void            safelanes_freeLanes( SafeLane **lanes );
+static void      safelanes_publish( SafeLane **lanes, unsigned gen );
+static char     *safelanes_cachePath( const char *digest );
+static SafeLane **safelanes_cacheLoad( const char *digest );
+static void      safelanes_cacheSave( const char *digest, SafeLane **lanes );
+static void      safelanes_cacheTouch( const char *digest );
+static void      safelanes_updateFactor( void );
+static int       safelanes_buildOneTurn( int iters_done );
 static int    safelanes_activateByGradient( const cholmod_dense *Lambda_tilde,
                                             int                  iters_done );
 static void   safelanes_initStacks( void );
@@ -206,6 +297,12 @@ static inline void array_push_back_edge( Edge **a, int v0, int v1 )
 void safelanes_init( void )
 {
    cholmod_start( &C );
+   lanes_lock  = SDL_CreateMutex();
+   job_lock    = SDL_CreateMutex();
+   cache_lock  = SDL_CreateMutex();
+   job_cond    = SDL_CreateCond();
+   job_quit    = 0;
+   job_working = 0;
    /* Ideally we would want to recalculate here, but since we load the first
     * save and try to use unidiffs there, we instead defer the safe lane
     * computation to only if necessary after loading save unidiffs. */
@@ -217,8 +314,20 @@ void safelanes_init( void )
  */
 void safelanes_destroy( void )
 {
-   safelanes_destroyOptimizer();
-   safelanes_destroyStacks();
+   /* Stop background work, the worker bails out on the next input. */
+   SDL_mutexP( job_lock );
+   job_quit = 1;
+   safelanes_freeInput( job_pending );
+   job_pending = NULL;
+   SDL_mutexV( job_lock );
+   safelanes_wait();
+
+   safelanes_freeLanes( lanes_published );
+   lanes_published = NULL;
+   SDL_DestroyCond( job_cond );
+   SDL_DestroyMutex( job_lock );
+   SDL_DestroyMutex( cache_lock );
+   SDL_DestroyMutex( lanes_lock );
    cholmod_finish( &C );
 }
 
@@ -232,17 +341,20 @@ void safelanes_destroy( void )
  */
 SafeLane *safelanes_get( int faction, int standing, const StarSystem *system )
 {
-   SafeLane *out = array_create( SafeLane );
+   const SafeLane *lanes;
+   SafeLane       *out = array_create( SafeLane );
 
-   for ( int i = sys_to_first_edge[system->id];
-         i < sys_to_first_edge[1 + system->id]; i++ ) {
-      SafeLane     *l;
-      const Vertex *v[2];
-      int           lf = lane_faction[i];
+   SDL_mutexP( lanes_lock );
 
-      /* No lane on edge. */
-      if ( lf <= 0 )
-         continue;
+   /* System may be newer than the lanes we have. */
+   if ( system->id >= array_size( lanes_published ) ) {
+      SDL_mutexV( lanes_lock );
+      return out;
+   }
+
+   lanes = lanes_published[system->id];
+   for ( int i = 0; i < array_size( lanes ); i++ ) {
+      int lf = lanes[i].faction;
 
       /* Filter by standing. */
       if ( faction >= 0 ) {
@@ -266,50 +378,130 @@ SafeLane *safelanes_get( int faction, int standing, const StarSystem *system )
          }
       }
 
-      for ( int j = 0; j < 2; j++ )
-         v[j] = &vertex_stack[edge_stack[i][j]];
-
-      l          = &array_grow( &out );
-      l->faction = lane_faction[i];
-      for ( int j = 0; j < 2; j++ ) {
-         switch ( v[j]->type ) {
-         case VERTEX_SPOB:
-            l->point_type[j] = SAFELANE_LOC_SPOB;
-            l->point_id[j]   = system->spobs[v[j]->index]->id;
-            break;
-         case VERTEX_JUMP:
-            l->point_type[j] = SAFELANE_LOC_DEST_SYS;
-            l->point_id[j]   = system->jumps[v[j]->index].targetid;
-            break;
-         default:
-            ERR( _( "Safe-lane vertex type is invalid." ) );
-         }
-      }
+      array_push_back( &out, lanes[i] );
    }
+
+   SDL_mutexV( lanes_lock );
    return out;
 }
 
 /**
  * @brief Update the safe lane locations in response to the universe changing
  * (e.g., diff applied).
+ *
+ * Uses cached results if available. Otherwise, if lanes were calculated before,
+ * the new lanes are computed in the background and swapped in when done.
  */
 void safelanes_recalculate( void )
 {
-#if DEBUGGING
-   Uint32 time = SDL_GetTicks();
-#endif /* DEBUGGING */
+   SafeLanesInput *in;
+   SafeLane      **lanes;
 
    /* Don't recompute on exit. */
    if ( naev_isQuit() )
       return;
 
+   in      = safelanes_snapshot();
+   in->gen = ++job_gen;
+
+   /* Cached results. */
+   lanes = safelanes_cacheLoad( in->digest );
+   if ( lanes != NULL ) {
+      safelanes_publish( lanes, in->gen );
+      safelanes_freeInput( in );
+      return;
+   }
+
+   /* Nothing to fall back to, so have to block. */
+   if ( !safelanes_calculated() ) {
+      safelanes_wait();
+      safelanes_solve( in );
+      safelanes_freeInput( in );
+      return;
+   }
+
+   /* Hand off to the background worker, superseding any input it hasn't
+    * started on. */
+   SDL_mutexP( job_lock );
+   safelanes_freeInput( job_pending );
+   job_pending = in;
+   if ( !job_working ) {
+      job_working = 1;
+      threadpool_newJob( safelanes_thread, NULL );
+   }
+   SDL_mutexV( job_lock );
+}
+
+/**
+ * @brief Blocks until there are no more safe lanes being computed in the
+ * background.
+ */
+void safelanes_wait( void )
+{
+   SDL_mutexP( job_lock );
+   while ( job_working )
+      SDL_CondWait( job_cond, job_lock );
+   SDL_mutexV( job_lock );
+}
+
+/**
+ * @brief Whether or not the safe lanes have been calculated at least once.
+ */
+int safelanes_calculated( void )
+{
+   int ret;
+   SDL_mutexP( lanes_lock );
+   ret = ( lanes_published != NULL );
+   SDL_mutexV( lanes_lock );
+   return ret;
+}
+
+/**
+ * @brief Background worker: computes lanes until there's no input left.
+ */
+static int safelanes_thread( void *data )
+{
+   (void)data;
+   while ( 1 ) {
+      SafeLanesInput *in;
+
+      SDL_mutexP( job_lock );
+      in          = job_pending;
+      job_pending = NULL;
+      if ( ( in == NULL ) || job_quit ) {
+         safelanes_freeInput( in );
+         job_working = 0;
+         SDL_CondBroadcast( job_cond );
+         SDL_mutexV( job_lock );
+         return 0;
+      }
+      SDL_mutexV( job_lock );
+
+      safelanes_solve( in );
+      safelanes_freeInput( in );
+   }
+}
+
+/**
+ * @brief Runs the full lane optimization on an input, then caches and
+ * publishes the result.
+ *
+ * Only one thread may run this at a time, since the optimizer state is global.
+ */
+static void safelanes_solve( const SafeLanesInput *in )
+{
+   SafeLane **lanes;
+#if DEBUGGING
+   Uint32 time = SDL_GetTicks();
+#endif /* DEBUGGING */
+
+   snap = in;
    safelanes_initStacks();
    safelanes_initOptimizer();
    for ( int iters_done = 0; safelanes_buildOneTurn( iters_done ) > 0;
          iters_done++ )
       ;
    safelanes_destroyOptimizer();
-   /* Stacks remain available for queries. */
 #if DEBUGGING
    if ( conf.devmode )
       DEBUG( n_( "Charted safe lanes for %d object in %.3f s",
@@ -317,16 +509,420 @@ void safelanes_recalculate( void )
                  array_size( vertex_stack ) ),
              array_size( vertex_stack ), ( SDL_GetTicks() - time ) / 1000. );
 #endif /* DEBUGGING */
+   lanes = safelanes_export();
+   safelanes_destroyStacks();
+   snap = NULL;
 
-   safelanes_calculated_once = 1;
+   safelanes_cacheSave( in->digest, lanes );
+   safelanes_publish( lanes, in->gen );
 }
 
 /**
- * @brief Whether or not the safe lanes have been calculated at least once.
+ * @brief Swaps in a new set of lanes, unless newer ones are already in use.
+ *
+ *    @param lanes Lanes to publish, ownership is taken.
+ *    @param gen Generation of the request that produced them.
  */
-int safelanes_calculated( void )
+static void safelanes_publish( SafeLane **lanes, unsigned gen )
+{
+   SDL_mutexP( lanes_lock );
+   if ( ( lanes_published == NULL ) || ( gen >= lanes_gen ) ) {
+      SafeLane **old  = lanes_published;
+      lanes_published = lanes;
+      lanes_gen       = gen;
+      lanes           = old;
+   }
+   SDL_mutexV( lanes_lock );
+   safelanes_freeLanes( lanes );
+}
+
+/**
+ * @brief Converts the lanes in the optimizer stacks to per-system lanes, which
+ * don't depend on the stacks any more.
+ */
+static SafeLane **safelanes_export( void )
+{
+   int        nsys = array_size( sys_to_first_edge ) - 1;
+   SafeLane **out  = array_create_size( SafeLane *, nsys );
+
+   for ( int si = 0; si < nsys; si++ ) {
+      const SnapSystem *sys   = &snap->systems[si];
+      SafeLane         *lanes = array_create( SafeLane );
+      for ( int i = sys_to_first_edge[si]; i < sys_to_first_edge[1 + si];
+            i++ ) {
+         SafeLane *l;
+         if ( lane_faction[i] <= 0 )
+            continue;
+
+         l            = &array_grow( &lanes );
+         l->faction   = lane_faction[i];
+         l->map_alpha = 0.;
+         for ( int j = 0; j < 2; j++ ) {
+            const Vertex *v = &vertex_stack[edge_stack[i][j]];
+            switch ( v->type ) {
+            case VERTEX_SPOB:
+               l->point_type[j] = SAFELANE_LOC_SPOB;
+               l->point_id[j]   = sys->spobs[v->index].id;
+               break;
+            case VERTEX_JUMP:
+               l->point_type[j] = SAFELANE_LOC_DEST_SYS;
+               l->point_id[j]   = sys->jumps[v->index].targetid;
+               break;
+            default:
+               ERR( _( "Safe-lane vertex type is invalid." ) );
+            }
+         }
+      }
+      array_push_back( &out, lanes );
+   }
+   return out;
+}
+
+/**
+ * @brief Frees a set of per-system lanes.
+ */
+static void safelanes_freeLanes( SafeLane **lanes )
+{
+   for ( int i = 0; i < array_size( lanes ); i++ )
+      array_free( lanes[i] );
+   array_free( lanes );
+}
+
+/**
+ * @brief Small helper to feed a value into an MD5 hash.
+ */
+static void safelanes_hash( md5_state_t *md5, const void *data, size_t len )
+{
+   md5_append( md5, (const md5_byte_t *)data, len );
+}
+
+/**
+ * @brief Small helper to feed a string (including terminator) into a hash.
+ */
+static void safelanes_hashStr( md5_state_t *md5, const char *str )
+{
+   if ( str == NULL )
+      str = "";
+   safelanes_hash( md5, str, strlen( str ) + 1 );
+}
+
+/**
+ * @brief Copies everything the optimization needs from the universe, and
+ * computes the hash identifying it.
+ *
+ * The hash covers the topology (systems, spobs, jumps and their positions),
+ * the lane-building factions, and the presences. Applied unidiffs are covered
+ * by the effects they have on those.
+ *
+ *    @return Newly allocated input. Free with safelanes_freeInput.
+ */
+static SafeLanesInput *safelanes_snapshot( void )
+{
+   md5_state_t       md5;
+   md5_byte_t        md5val[16];
+   int              *faction_all;
+   const StarSystem *systems_stack = system_getAll();
+   SafeLanesInput   *in            = calloc( 1, sizeof( SafeLanesInput ) );
+
+   md5_init( &md5 );
+   safelanes_hash( &md5, &SAFELANES_CACHE_VERSION,
+                   sizeof( SAFELANES_CACHE_VERSION ) );
+
+   /* Lane-building factions. */
+   in->factions = array_create( Faction );
+   faction_all  = faction_getAllVisible();
+   for ( int fi = 0; fi < array_size( faction_all ); fi++ ) {
+      int     f   = faction_all[fi];
+      Faction rec = { .id = f,
+                      .lane_length_per_presence =
+                         faction_lane_length_per_presence( f ),
+                      .lane_base_cost = faction_lane_base_cost( f ) };
+      if ( rec.lane_length_per_presence <= 0. )
+         continue;
+      array_push_back( &in->factions, rec );
+      safelanes_hashStr( &md5, faction_name( f ) );
+      safelanes_hash( &md5, &rec.id, sizeof( rec.id ) );
+      safelanes_hash( &md5, &rec.lane_length_per_presence,
+                      sizeof( rec.lane_length_per_presence ) );
+      safelanes_hash( &md5, &rec.lane_base_cost,
+                      sizeof( rec.lane_base_cost ) );
+   }
+   array_free( faction_all );
+
+   /* Presences. */
+   in->presence = array_create_size( double *, array_size( in->factions ) );
+   for ( int fi = 0; fi < array_size( in->factions ); fi++ ) {
+      double *pres = array_create_size( double, array_size( systems_stack ) );
+      for ( int s = 0; s < array_size( systems_stack ); s++ )
+         array_push_back( &pres, system_getPresence( &systems_stack[s],
+                                                     in->factions[fi].id ) );
+      safelanes_hash( &md5, pres, array_size( pres ) * sizeof( double ) );
+      array_push_back( &in->presence, pres );
+   }
+
+   /* Topology. */
+   in->systems = array_create_size( SnapSystem, array_size( systems_stack ) );
+   for ( int s = 0; s < array_size( systems_stack ); s++ ) {
+      md5_state_t       smd5;
+      const StarSystem *sys = &systems_stack[s];
+      SnapSystem       *ss  = &array_grow( &in->systems );
+      md5_init( &smd5 );
+      ss->nolanes = !!sys_isFlag( sys, SYSTEM_NOLANES );
+      ss->spobs   = array_create_size( SnapSpob, array_size( sys->spobs ) );
+      ss->jumps = array_create_size( SnapJump, array_size( sys->jumps ) );
+      safelanes_hashStr( &smd5, sys->name );
+      safelanes_hash( &smd5, &ss->nolanes, sizeof( ss->nolanes ) );
+      for ( int fi = 0; fi < array_size( in->presence ); fi++ )
+         safelanes_hash( &smd5, &in->presence[fi][s], sizeof( double ) );
+
+      for ( int i = 0; i < array_size( sys->spobs ); i++ ) {
+         const Spob *p  = sys->spobs[i];
+         SnapSpob    sp = {
+               .id       = p->id,
+               .faction  = p->presence.faction,
+               .presence = p->presence.base + p->presence.bonus,
+               .pos      = p->pos,
+               .valid    = !spob_isFlag( p, SPOB_NOLANES ) &&
+                        ( p->presence.base != 0. || p->presence.bonus != 0. ),
+         };
+         array_push_back( &ss->spobs, sp );
+         safelanes_hashStr( &smd5, p->name );
+         safelanes_hash( &smd5, &sp.id, sizeof( sp.id ) );
+         safelanes_hash( &smd5, &sp.faction, sizeof( sp.faction ) );
+         safelanes_hash( &smd5, &sp.presence, sizeof( sp.presence ) );
+         safelanes_hash( &smd5, &sp.pos.x, sizeof( sp.pos.x ) );
+         safelanes_hash( &smd5, &sp.pos.y, sizeof( sp.pos.y ) );
+         safelanes_hash( &smd5, &sp.valid, sizeof( sp.valid ) );
+      }
+
+      for ( int i = 0; i < array_size( sys->jumps ); i++ ) {
+         const JumpPoint *jp = &sys->jumps[i];
+         SnapJump         sj = {
+                    .targetid = jp->targetid,
+                    .returnid = ( jp->returnJump != NULL )
+                                   ? jp->returnJump - jp->target->jumps
+                                   : -1,
+                    .pos      = jp->pos,
+                    .valid =
+               !jp_isFlag( jp, JP_HIDDEN | JP_EXITONLY | JP_NOLANES ),
+         };
+         array_push_back( &ss->jumps, sj );
+         safelanes_hash( &smd5, &sj.targetid, sizeof( sj.targetid ) );
+         safelanes_hash( &smd5, &sj.returnid, sizeof( sj.returnid ) );
+         safelanes_hash( &smd5, &sj.pos.x, sizeof( sj.pos.x ) );
+         safelanes_hash( &smd5, &sj.pos.y, sizeof( sj.pos.y ) );
+         safelanes_hash( &smd5, &sj.valid, sizeof( sj.valid ) );
+      }
+
+      /* Per-system hash lets us tell what a diff touched. */
+      md5_finish( &smd5, ss->hash );
+      safelanes_hash( &md5, ss->hash, sizeof( ss->hash ) );
+   }
+
+   md5_finish( &md5, md5val );
+   for ( int i = 0; i < 16; i++ )
+      snprintf( &in->digest[i * 2], 3, "%02x", md5val[i] );
+   return in;
+}
+
+/**
+ * @brief Frees an optimization input.
+ */
+static void safelanes_freeInput( SafeLanesInput *in )
+{
+   if ( in == NULL )
+      return;
+   for ( int i = 0; i < array_size( in->systems ); i++ ) {
+      array_free( in->systems[i].spobs );
+      array_free( in->systems[i].jumps );
+   }
+   array_free( in->systems );
+   for ( int i = 0; i < array_size( in->presence ); i++ )
+      array_free( in->presence[i] );
+   array_free( in->presence );
+   array_free( in->factions );
+   free( in );
+}
+
+/**
+ * @brief Gets the path of the cache file for an input hash.
+ *
+ *    @return Newly allocated path.
+ */
+static char *safelanes_cachePath( const char *digest )
+{
+   char *path;
+   SDL_asprintf( &path, "%ssafelanes/%s", nfile_cachePath(), digest );
+   return path;
+}
+
+/**
+ * @brief Tries to load cached lanes for an input hash.
+ *
+ * The format is the magic, version and number of systems, followed by the
+ * number of lanes and the lanes themselves for each system.
+ *
+ *    @return The cached lanes or NULL if unavailable or invalid.
+ */
+static SafeLane **safelanes_cacheLoad( const char *digest )
+{
+   char      *path, *buf;
+   size_t     len, pos;
+   uint32_t   version, nsys;
+   SafeLane **lanes;
+   int        nspobs   = array_size( spob_getAll() );
+   int        nsystems = array_size( system_getAll() );
+
+   path = safelanes_cachePath( digest );
+   buf  = nfile_fileExists( path ) ? nfile_readFile( &len, path ) : NULL;
+   free( path );
+   if ( buf == NULL )
+      return NULL;
+
+#define CACHE_READ( ptr, size )                                                \
+   do {                                                                        \
+      if ( pos + ( size ) > len )                                              \
+         goto invalid;                                                         \
+      memcpy( ( ptr ), &buf[pos], ( size ) );                                  \
+      pos += ( size );                                                         \
+   } while ( 0 )
+   lanes = NULL;
+   pos   = sizeof( SAFELANES_CACHE_MAGIC );
+   if ( ( len < pos ) ||
+        memcmp( buf, SAFELANES_CACHE_MAGIC, sizeof( SAFELANES_CACHE_MAGIC ) ) )
+      goto invalid;
+   CACHE_READ( &version, sizeof( version ) );
+   CACHE_READ( &nsys, sizeof( nsys ) );
+   if ( ( version != SAFELANES_CACHE_VERSION ) ||
+        ( nsys != (uint32_t)nsystems ) )
+      goto invalid;
+
+   lanes = array_create_size( SafeLane *, nsys );
+   for ( uint32_t si = 0; si < nsys; si++ ) {
+      uint32_t  n;
+      SafeLane *l = array_create( SafeLane );
+      array_push_back( &lanes, l );
+      CACHE_READ( &n, sizeof( n ) );
+      for ( uint32_t i = 0; i < n; i++ ) {
+         int32_t   rec[5];
+         SafeLane *li;
+         CACHE_READ( rec, sizeof( rec ) );
+         li            = &array_grow( &lanes[si] );
+         li->faction   = rec[0];
+         li->map_alpha = 0.;
+         for ( int j = 0; j < 2; j++ ) {
+            li->point_type[j] = rec[1 + 2 * j];
+            li->point_id[j]   = rec[2 + 2 * j];
+            if ( ( li->point_type[j] == SAFELANE_LOC_SPOB )
+                    ? ( li->point_id[j] < 0 || li->point_id[j] >= nspobs )
+                    : ( li->point_id[j] < 0 || li->point_id[j] >= nsystems ) )
+               goto invalid;
+         }
+      }
+   }
+#undef CACHE_READ
+
+   free( buf );
+   safelanes_cacheTouch( digest );
+   return lanes;
+
+invalid:
+   WARN( _( "Safe lane cache '%s' is invalid, ignoring." ), digest );
+   safelanes_freeLanes( lanes );
+   free( buf );
+   return NULL;
+}
+
+/**
+ * @brief Saves lanes to the cache. \see safelanes_cacheLoad for the format.
+ */
+static void safelanes_cacheSave( const char *digest, SafeLane **lanes )
+{
+   char    *path, *buf, dirpath[PATH_MAX];
+   size_t   len, pos;
+   uint32_t nsys = array_size( lanes );
+   int      ret;
+
+   len = sizeof( SAFELANES_CACHE_MAGIC ) + 2 * sizeof( uint32_t );
+   for ( int si = 0; si < array_size( lanes ); si++ )
+      len += sizeof( uint32_t ) +
+             array_size( lanes[si] ) * 5 * sizeof( int32_t );
+   buf = malloc( len );
+
+#define CACHE_WRITE( ptr, size )                                               \
+   do {                                                                        \
+      memcpy( &buf[pos], ( ptr ), ( size ) );                                  \
+      pos += ( size );                                                         \
+   } while ( 0 )
+   pos = 0;
+   CACHE_WRITE( SAFELANES_CACHE_MAGIC, sizeof( SAFELANES_CACHE_MAGIC ) );
+   CACHE_WRITE( &SAFELANES_CACHE_VERSION, sizeof( SAFELANES_CACHE_VERSION ) );
+   CACHE_WRITE( &nsys, sizeof( nsys ) );
+   for ( int si = 0; si < array_size( lanes ); si++ ) {
+      uint32_t n = array_size( lanes[si] );
+      CACHE_WRITE( &n, sizeof( n ) );
+      for ( int i = 0; i < array_size( lanes[si] ); i++ ) {
+         const SafeLane *l      = &lanes[si][i];
+         int32_t         rec[5] = { l->faction, l->point_type[0],
+                                    l->point_id[0], l->point_type[1],
+                                    l->point_id[1] };
+         CACHE_WRITE( rec, sizeof( rec ) );
+      }
+   }
+#undef CACHE_WRITE
+
+   snprintf( dirpath, sizeof( dirpath ), "%ssafelanes/", nfile_cachePath() );
+   nfile_dirMakeExist( dirpath );
+   path = safelanes_cachePath( digest );
+   ret  = nfile_writeFileAtomic( buf, len, path );
+   free( path );
+   free( buf );
+   if ( ret == 0 )
+      safelanes_cacheTouch( digest );
+}
+
+/**
+ * @brief Marks a digest as the most recently used one in the cache.
+ *
+ * The cache index holds one digest per line, most recent first. Digests
+ * falling off the end get their cache file deleted.
+ */
+static void safelanes_cacheTouch( const char *digest )
 {
-   return safelanes_calculated_once;
+   char  *path, *old, *buf;
+   size_t len, dlen;
+   int    n;
+
+   dlen = strlen( digest );
+   SDL_LockMutex( cache_lock );
+   path = safelanes_cachePath( "index" );
+   old  = nfile_fileExists( path ) ? nfile_readFile( &len, path ) : NULL;
+   buf  = malloc( SAFELANES_CACHE_MAX * ( dlen + 1 ) );
+   memcpy( buf, digest, dlen );
+   buf[dlen] = '\n';
+   n         = 1;
+   for ( size_t i = 0; ( old != NULL ) && ( i + dlen < len ); i += dlen + 1 ) {
+      const char *d = &old[i];
+      /* Only accept digests, the name ends up in a path. */
+      if ( ( d[dlen] != '\n' ) || ( strspn( d, "0123456789abcdef" ) != dlen ) ||
+           ( memcmp( d, digest, dlen ) == 0 ) )
+         continue;
+      if ( n < SAFELANES_CACHE_MAX ) {
+         memcpy( &buf[n * ( dlen + 1 )], d, dlen + 1 );
+         n++;
+      } else {
+         char *stale;
+         SDL_asprintf( &stale, "%ssafelanes/%.*s", nfile_cachePath(),
+                       (int)dlen, d );
+         remove( stale );
+         free( stale );
+      }
+   }
+   nfile_writeFileAtomic( buf, n * ( dlen + 1 ), path );
+   SDL_UnlockMutex( cache_lock );
+   free( buf );
+   free( old );
+   free( path );
 }
 
 /**
@@ -334,6 +930,7 @@ int safelanes_calculated( void )
  */
 static void safelanes_initOptimizer( void )
 {
+   activated_edges = array_create( int );
    safelanes_initStiff();
    safelanes_initQtQ();
    safelanes_initFTilde();
@@ -346,6 +943,9 @@ static void safelanes_initOptimizer( void )
  */
 static void safelanes_destroyOptimizer( void )
 {
+   cholmod_free_factor( &stiff_f, &C );
+   array_free( activated_edges );
+   activated_edges = NULL;
    for ( int i = 0; i < array_size( PPl ); i++ )
       cholmod_free_dense( &PPl[i], &C );
    array_free( PPl );
@@ -364,16 +964,12 @@ static void safelanes_destroyOptimizer( void )
  */
 static int safelanes_buildOneTurn( int iters_done )
 {
-   cholmod_sparse *stiff_s;
-   cholmod_factor *stiff_f;
-   cholmod_dense  *_QtQutilde, *Lambda_tilde, *Y_workspace, *E_workspace;
-   int             turns_next_time;
-   double          zero[] = { 0, 0 }, neg_1[] = { -1, 0 };
+   cholmod_dense *_QtQutilde, *Lambda_tilde, *Y_workspace, *E_workspace;
+   int            turns_next_time;
+   double         zero[] = { 0, 0 }, neg_1[] = { -1, 0 };
 
    Y_workspace = E_workspace = Lambda_tilde = NULL;
-   stiff_s = cholmod_triplet_to_sparse( stiff, 0, &C );
-   stiff_f = cholmod_analyze( stiff_s, &C );
-   cholmod_factorize( stiff_s, stiff_f, &C );
+   safelanes_updateFactor();
    cholmod_solve2( CHOLMOD_A, stiff_f, ftilde, NULL, &utilde, NULL,
                    &Y_workspace, &E_workspace, &C );
    _QtQutilde = cholmod_zeros( utilde->nrow, utilde->ncol, CHOLMOD_REAL, &C );
@@ -383,14 +979,69 @@ static int safelanes_buildOneTurn( int iters_done )
    cholmod_free_dense( &_QtQutilde, &C );
    cholmod_free_dense( &Y_workspace, &C );
    cholmod_free_dense( &E_workspace, &C );
-   cholmod_free_factor( &stiff_f, &C );
-   cholmod_free_sparse( &stiff_s, &C );
    turns_next_time = safelanes_activateByGradient( Lambda_tilde, iters_done );
    cholmod_free_dense( &Lambda_tilde, &C );
 
    return turns_next_time;
 }
 
+/**
+ * @brief Brings the factorization of the stiffness matrix up to date.
+ *
+ * The sparsity pattern never changes during an optimization, so the symbolic
+ * analysis is only done once. Activating a lane on an edge is a rank-1 update
+ * of the stiffness matrix, so when few lanes were activated since the last
+ * turn, the factor gets updated in place instead of recomputed.
+ */
+static void safelanes_updateFactor( void )
+{
+   cholmod_sparse *stiff_s;
+   int             n = array_size( activated_edges );
+
+   if ( ( stiff_f != NULL ) && ( n == 0 ) )
+      return;
+
+   if ( ( stiff_f != NULL ) &&
+        ( n <= MAX( 1., UPDOWN_MAX_FRACTION * stiff->nrow ) ) ) {
+      cholmod_sparse *U, *Up;
+      int             ok;
+
+      /* The update is ALPHA * c * (e_i - e_j) (e_i - e_j)* per edge, so U has
+       * a +w and -w per column, with w = sqrt(ALPHA * c). */
+      U = cholmod_allocate_sparse( stiff->nrow, n, 2 * n, SORTED, PACKED,
+                                   STORAGE_MODE_UNSYMMETRIC, CHOLMOD_REAL, &C );
+      ( (int *)U->p )[0] = 0;
+      for ( int k = 0; k < n; k++ ) {
+         int    ei = activated_edges[k];
+         double w  = sqrt( ALPHA * safelanes_initialConductivity( ei ) );
+         ( (int *)U->p )[k + 1] = 2 * ( k + 1 );
+         ( (int *)U->i )[2 * k + 0] =
+            MIN( edge_stack[ei][0], edge_stack[ei][1] );
+         ( (int *)U->i )[2 * k + 1] =
+            MAX( edge_stack[ei][0], edge_stack[ei][1] );
+         ( (double *)U->x )[2 * k + 0] = +w;
+         ( (double *)U->x )[2 * k + 1] = -w;
+      }
+      /* CHOLMOD wants the update with the fill-reducing permutation applied. */
+      Up = cholmod_submatrix( U, stiff_f->Perm, stiff_f->n, NULL, -1, 1, SORTED,
+                              &C );
+      ok = cholmod_updown( 1, Up, stiff_f, &C );
+      cholmod_free_sparse( &Up, &C );
+      cholmod_free_sparse( &U, &C );
+      array_resize( &activated_edges, 0 );
+      if ( ok && ( C.status == CHOLMOD_OK ) )
+         return;
+      /* Fall back to refactorizing. */
+   }
+
+   stiff_s = cholmod_triplet_to_sparse( stiff, 0, &C );
+   if ( stiff_f == NULL )
+      stiff_f = cholmod_analyze( stiff_s, &C );
+   cholmod_factorize( stiff_s, stiff_f, &C );
+   cholmod_free_sparse( &stiff_s, &C );
+   array_resize( &activated_edges, 0 );
+}
+
 /**
  * @brief Sets up the local faction/object stacks.
  */
@@ -408,25 +1059,20 @@ static void safelanes_initStacks( void )
  */
 static void safelanes_initStacks_vertex( void )
 {
-   const StarSystem *systems_stack = system_getAll();
-
    vertex_stack        = array_create( Vertex );
    sys_to_first_vertex = array_create( int );
    array_push_back( &sys_to_first_vertex, 0 );
    tmp_spob_indices = array_create( int );
    tmp_jump_edges   = array_create( Edge );
-   for ( int system = 0; system < array_size( systems_stack ); system++ ) {
-      const StarSystem *sys = &systems_stack[system];
-      if ( sys_isFlag( sys, SYSTEM_NOLANES ) ) {
+   for ( int system = 0; system < array_size( snap->systems ); system++ ) {
+      const SnapSystem *sys = &snap->systems[system];
+      if ( sys->nolanes ) {
          array_push_back( &sys_to_first_vertex, array_size( vertex_stack ) );
          continue;
       }
 
       for ( int i = 0; i < array_size( sys->spobs ); i++ ) {
-         const Spob *p = sys->spobs[i];
-         if ( spob_isFlag( p, SPOB_NOLANES ) )
-            continue;
-         if ( p->presence.base != 0. || p->presence.bonus != 0. ) {
+         if ( sys->spobs[i].valid ) {
             Vertex v = { .system = system, .type = VERTEX_SPOB, .index = i };
             array_push_back( &tmp_spob_indices, array_size( vertex_stack ) );
             array_push_back( &vertex_stack, v );
@@ -434,17 +1080,16 @@ static void safelanes_initStacks_vertex( void )
       }
 
       for ( int i = 0; i < array_size( sys->jumps ); i++ ) {
-         const JumpPoint *jp = &sys->jumps[i];
-         if ( jp_isFlag( jp, JP_HIDDEN | JP_EXITONLY | JP_NOLANES ) )
+         const SnapJump *jp = &sys->jumps[i];
+         if ( !jp->valid )
             continue;
          Vertex v = { .system = system, .type = VERTEX_JUMP, .index = i };
          array_push_back( &vertex_stack, v );
-         if ( jp->targetid < system && jp->returnJump != NULL )
+         if ( jp->targetid < system && jp->returnid >= 0 )
             for ( int j = sys_to_first_vertex[jp->targetid];
                   j < sys_to_first_vertex[1 + jp->targetid]; j++ )
                if ( vertex_stack[j].type == VERTEX_JUMP &&
-                    jp->returnJump ==
-                       &jp->target->jumps[vertex_stack[j].index] ) {
+                    vertex_stack[j].index == jp->returnid ) {
                   array_push_back_edge( &tmp_jump_edges,
                                         array_size( vertex_stack ) - 1, j );
                   break;
@@ -465,14 +1110,12 @@ static void safelanes_initStacks_vertex( void )
  */
 static void safelanes_initStacks_edge( void )
 {
-   const StarSystem *systems_stack = system_getAll();
-
    edge_stack        = array_create( Edge );
    sys_to_first_edge = array_create( int );
    array_push_back( &sys_to_first_edge, 0 );
    lane_fmask       = array_create( FactionMask );
    tmp_edge_conduct = array_create( double );
-   for ( int system = 0; system < array_size( systems_stack ); system++ ) {
+   for ( int system = 0; system < array_size( snap->systems ); system++ ) {
       for ( int i = sys_to_first_vertex[system];
             i < sys_to_first_vertex[1 + system]; i++ ) {
          const vec2 *pi = vertex_pos( i );
@@ -514,37 +1157,14 @@ static void safelanes_initStacks_edge( void )
  */
 static void safelanes_initStacks_faction( void )
 {
-   int              *faction_all;
-   const StarSystem *systems_stack;
-
-   faction_stack = array_create( Faction );
-   faction_all   = faction_getAllVisible();
-   for ( int fi = 0; fi < array_size( faction_all ); fi++ ) {
-      int     f   = faction_all[fi];
-      Faction rec = { .id = f,
-                      .lane_length_per_presence =
-                         faction_lane_length_per_presence( f ),
-                      .lane_base_cost = faction_lane_base_cost( f ) };
-      if ( rec.lane_length_per_presence > 0. )
-         array_push_back( &faction_stack, rec );
-   }
-   array_free( faction_all );
-   array_shrink( &faction_stack );
+   faction_stack = array_copy( Faction, snap->factions );
    assert( "FactionMask size is sufficient" &&
            (size_t)array_size( faction_stack ) <= 8 * sizeof( FactionMask ) );
 
    presence_budget = array_create_size( double *, array_size( faction_stack ) );
-   systems_stack   = system_getAll();
-   for ( int fi = 0; fi < array_size( faction_stack ); fi++ ) {
-      array_push_back(
-         &presence_budget,
-         array_create_size( double, array_size( systems_stack ) ) );
-      for ( int s = 0; s < array_size( systems_stack ); s++ ) {
-         const StarSystem *sys = &systems_stack[s];
-         double budget = system_getPresence( sys, faction_stack[fi].id );
-         array_push_back( &presence_budget[fi], budget );
-      }
-   }
+   for ( int fi = 0; fi < array_size( faction_stack ); fi++ )
+      array_push_back( &presence_budget,
+                       array_copy( double, snap->presence[fi] ) );
 }
 
 /**
@@ -689,6 +1309,7 @@ static void safelanes_updateConductivity( int ei_activated )
    double *sv = stiff->x;
    for ( int i = 3 * ei_activated; i < 3 * ( ei_activated + 1 ); i++ )
       sv[i] *= 1 + ALPHA;
+   array_push_back( &activated_edges, ei_activated );
 }
 
 /**
@@ -763,14 +1384,13 @@ static void safelanes_initPPl( void )
                                      vertex_stack[tmp_spob_indices[i]].system );
 
    for ( int i = 0; i < np; i++ ) {
-      double *Di;
-      int     sys = vertex_stack[tmp_spob_indices[i]].system;
-      Spob   *pnt =
-         system_getIndex( sys )->spobs[vertex_stack[tmp_spob_indices[i]].index];
+      double         *Di;
+      int             sys = vertex_stack[tmp_spob_indices[i]].system;
+      const SnapSpob *pnt =
+         &snap->systems[sys].spobs[vertex_stack[tmp_spob_indices[i]].index];
       double pres =
-         pnt->presence.base +
-         pnt->presence.bonus; /* TODO distinguish between base and bonus? */
-      int fi = FACTION_ID_TO_INDEX( pnt->presence.faction );
+         pnt->presence; /* TODO distinguish between base and bonus? */
+      int fi = FACTION_ID_TO_INDEX( pnt->faction );
       if ( fi < 0 )
          continue;
       Di = PPl[fi]->x;
@@ -825,11 +1445,10 @@ static int safelanes_activateByGradient( const cholmod_dense *Lambda_tilde,
 
    for ( int si = 0; si < array_size( sys_to_first_vertex ) - 1; si++ ) {
       /* Factions with most presence here choose first. */
-      const StarSystem *sys = system_getIndex( si );
       for ( int fi = 0; fi < array_size( faction_stack ); fi++ )
-         facind_vals[fi] = -system_getPresence(
-            sys, faction_stack[fi]
-                    .id ); /* FIXME: Is this better, or presence_budget? */
+         facind_vals[fi] =
+            -snap->presence[fi][si]; /* FIXME: Is this better, or
+                                        presence_budget? */
       cmp_key_ref = facind_vals;
       qsort( facind_opts, array_size( faction_stack ), sizeof( int ), cmp_key );
 
@@ -1007,10 +1626,10 @@ static int safelanes_triangleTooFlat( const vec2 *m, const vec2 *n,
  */
 static int vertex_faction( int vi )
 {
-   const StarSystem *sys = system_getIndex( vertex_stack[vi].system );
+   const SnapSystem *sys = &snap->systems[vertex_stack[vi].system];
    switch ( vertex_stack[vi].type ) {
    case VERTEX_SPOB:
-      return sys->spobs[vertex_stack[vi].index]->presence.faction;
+      return sys->spobs[vertex_stack[vi].index].faction;
    case VERTEX_JUMP:
       return -1;
    default:
@@ -1024,10 +1643,10 @@ static int vertex_faction( int vi )
  */
 static const vec2 *vertex_pos( int vi )
 {
-   const StarSystem *sys = system_getIndex( vertex_stack[vi].system );
+   const SnapSystem *sys = &snap->systems[vertex_stack[vi].system];
    switch ( vertex_stack[vi].type ) {
    case VERTEX_SPOB:
-      return &sys->spobs[vertex_stack[vi].index]->pos;
+      return &sys->spobs[vertex_stack[vi].index].pos;
    case VERTEX_JUMP:
       return &sys->jumps[vertex_stack[vi].index].pos;
    default:
@@ -71,10 +71,10 @@ SHADERS = [
    ),
    Shader(
       name = "trail",
-      vs_path = "project_pos.vert",
+      vs_path = "trail.vert",
       fs_path = "trail.frag",
-      attributes = ["vertex"],
-      uniforms = ["projection", "c1", "c2", "t1", "t2", "dt", "pos1", "pos2", "r", "nebu_col" ],
+      attributes = ["vertex", "vertex_colour", "vertex_tex", "vertex_param"],
+      uniforms = ["projection", "nebu_col" ],
       subroutines = {
         "trail_func" : [
             "trail_default",
@@ -87,6 +87,14 @@ SHADERS = [
         ]
       }
    ),
+   Shader(
+      name = "radarblip",
+      vs_path = "radarblip.vert",
+      fs_path = "radarblip.frag",
+      attributes = ["vertex", "vertex_colour", "vertex_tex", "vertex_param"],
+      uniforms = ["projection"],
+      subroutines = {},
+   ),
    Shader(
       name = "smooth",
       vs_path = "smooth.vert",
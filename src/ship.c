@@ -19,11 +19,13 @@
 #include "colour.h"
 #include "conf.h"
 #include "log.h"
+#include "nameidx.h"
 #include "ndata.h"
 #include "nlua.h"
 #include "nlua_camera.h"
 #include "nlua_gfx.h"
 #include "nstring.h"
+#include "ntracing.h"
 #include "nxml.h"
 #include "opengl_tex.h"
 #include "shipstats.h"
@@ -53,7 +55,27 @@ typedef struct ShipThreadData_ {
    int   ret;      /**< Return status. */
 } ShipThreadData;
 
-static Ship *ship_stack = NULL; /**< Stack of ships available in the game. */
+static Ship   *ship_stack = NULL; /**< Stack of ships available in the game. */
+static NameIdx ship_idx;          /**< Ships indexed by name. */
+
+/**
+ * @brief Ship 3D model waiting to be loaded.
+ */
+typedef struct ShipGfxQueue_ {
+   Ship *ship; /**< Ship to load into. */
+   char *path; /**< Path of the 3D model. */
+} ShipGfxQueue;
+static ShipGfxQueue *ship_gfx_queue =
+   NULL; /**< Array (array.h): Ships waiting on their 3D model. */
+
+/**
+ * @brief Paths of the graphics a ship still has to load.
+ */
+typedef struct ShipGfxPaths_ {
+   char model[PATH_MAX];  /**< 3D model, empty if none. */
+   char space[PATH_MAX];  /**< Space sprite, empty if not needed. */
+   char engine[PATH_MAX]; /**< Engine sprite, empty if not needed. */
+} ShipGfxPaths;
 
 #define SHIP_FBO 3
 static double       max_size            = 0.;
@@ -68,7 +90,10 @@ static double       ship_aa_scale       = -1.;
  * Prototypes
  */
 static int  ship_generateStoreGFX( Ship *temp );
-static int  ship_loadPLG( Ship *temp, const char *buf );
+static int  ship_loadPLG( Ship *temp, const char *buf, int is3d );
+static void ship_gfxPaths( Ship *temp, ShipGfxPaths *paths );
+static void ship_gfxFinish( Ship *temp );
+static void ship_gfxLoadModel( ShipGfxQueue *q );
 static int  ship_parse( Ship *temp, const char *filename );
 static int  ship_parseThread( void *ptr );
 static void ship_freeSlot( ShipOutfitSlot *s );
@@ -105,9 +130,8 @@ const Ship *ship_get( const char *name )
  */
 const Ship *ship_getW( const char *name )
 {
-   const Ship s = { .name = (char *)name };
-   return bsearch( &s, ship_stack, array_size( ship_stack ), sizeof( Ship ),
-                   ship_cmp );
+   int i = nameidx_get( &ship_idx, name );
+   return ( i < 0 ) ? NULL : &ship_stack[i];
 }
 
 /**
@@ -362,14 +386,19 @@ int ship_size( const Ship *s )
  *    @param str Path of the image to use.
  *    @param sx Number of X sprites in image.
  *    @param sy Number of Y sprites in image.
+ *    @param async Whether to stream the image in the background.
  */
-static int ship_loadSpaceImage( Ship *temp, const char *str, int sx, int sy )
+static int ship_loadSpaceImage( Ship *temp, const char *str, int sx, int sy,
+                                int async )
 {
    unsigned int flags = OPENGL_TEX_MIPMAPS | OPENGL_TEX_VFLIP;
    /* If no collision polygon, we use transparency mapping. */
    if ( array_size( temp->polygon.views ) <= 0 )
       flags |= OPENGL_TEX_MAPTRANS;
-   temp->gfx_space = gl_newSprite( str, sx, sy, flags );
+   if ( async )
+      temp->gfx_space = gl_newSpriteAsync( str, sx, sy, flags );
+   else
+      temp->gfx_space = gl_newSprite( str, sx, sy, flags );
    /* Calculate mount angle. */
    temp->mangle = 2. * M_PI / (double)( sx * sy );
    return 0;
@@ -382,27 +411,44 @@ static int ship_loadSpaceImage( Ship *temp, const char *str, int sx, int sy )
  *    @param str Path of the image to use.
  *    @param sx Number of X sprites in image.
  *    @param sy Number of Y sprites in image.
+ *    @param async Whether to stream the image in the background.
  */
-static int ship_loadEngineImage( Ship *temp, const char *str, int sx, int sy )
+static int ship_loadEngineImage( Ship *temp, const char *str, int sx, int sy,
+                                 int async )
 {
-   temp->gfx_engine = gl_newSprite( str, sx, sy, OPENGL_TEX_MIPMAPS );
+   if ( async )
+      temp->gfx_engine = gl_newSpriteAsync( str, sx, sy, OPENGL_TEX_MIPMAPS );
+   else
+      temp->gfx_engine = gl_newSprite( str, sx, sy, OPENGL_TEX_MIPMAPS );
    return ( temp->gfx_engine != NULL );
 }
 
+/**
+ * @brief Checks to see if the graphics of a ship are ready to be used.
+ *
+ *    @param s Ship to check.
+ *    @return 1 if the graphics are loaded and uploaded.
+ */
 int ship_gfxLoaded( const Ship *s )
 {
-   return ( ( s->gfx_3d != NULL ) || ( s->gfx_space != NULL ) );
+   return ( ship_isFlag( s, SHIP_GFXLOADED ) &&
+            !gl_texIsStreaming( s->gfx_space ) &&
+            !gl_texIsStreaming( s->gfx_engine ) );
 }
 
 int ship_gfxLoadNeeded( void )
 {
    ThreadQueue *tq = vpool_create();
    SDL_GL_MakeCurrent( gl_screen.window, NULL );
+   gl_texDeferUploads( 1 );
 
    for ( int i = 0; i < array_size( ship_stack ); i++ ) {
       Ship *s = &ship_stack[i];
       if ( !ship_isFlag( s, SHIP_NEEDSGFX ) )
          continue;
+      /* Ships that are already streaming get finished below. */
+      if ( ship_isFlag( s, SHIP_GFXLOADING | SHIP_GFXLOADED ) )
+         continue;
       vpool_enqueue( tq, (int ( * )( void * ))ship_gfxLoad, s );
       ship_rmFlag( s, SHIP_NEEDSGFX );
    }
@@ -411,48 +457,64 @@ int ship_gfxLoadNeeded( void )
    vpool_cleanup( tq );
 
    SDL_GL_MakeCurrent( gl_screen.window, gl_screen.context );
+   gl_texDeferUploads( 0 );
+   gl_texUpload( 0 );
+
+   for ( int i = 0; i < array_size( ship_stack ); i++ ) {
+      Ship *s = &ship_stack[i];
+      if ( !ship_isFlag( s, SHIP_NEEDSGFX ) )
+         continue;
+      ship_gfxFinish( s );
+      ship_rmFlag( s, SHIP_NEEDSGFX );
+   }
    return 0;
 }
 
 /**
- * @brief Loads the graphics for a ship if necessary.
+ * @brief Works out which graphics a ship needs and loads the cheap parts.
+ *
+ * The collision polygon is loaded here as it has to be available as soon as
+ * the ship is in space, even if the graphics are still streaming in.
  *
  *    @param temp Ship to load into.
+ *    @param[out] paths Paths of the graphics that still have to be loaded.
  */
-int ship_gfxLoad( Ship *temp )
+static void ship_gfxPaths( Ship *temp, ShipGfxPaths *paths )
 {
-   char        str[PATH_MAX], *base, *delim, *base_path;
-   const char *ext    = ".webp";
-   const char *buf    = temp->gfx_path;
-   int         sx     = temp->sx;
-   int         sy     = temp->sy;
-   int         engine = !temp->noengine;
-
-   /* If already loaded, just ignore. */
-   if ( ship_gfxLoaded( temp ) )
-      return 0;
+   char       *base, *delim, *base_path;
+   const char *ext = ".webp";
+   const char *buf = temp->gfx_path;
+   int         has3d;
+
+   paths->model[0]  = '\0';
+   paths->space[0]  = '\0';
+   paths->engine[0] = '\0';
 
    /* Get base path. */
    delim     = strchr( buf, '_' );
    base      = delim == NULL ? strdup( buf ) : strndup( buf, delim - buf );
    base_path = ( temp->base_path != NULL ) ? temp->base_path : temp->base_type;
 
-   /* Load the 3d model */
-   snprintf( str, sizeof( str ), SHIP_3DGFX_PATH "%s/%s.gltf", base_path, buf );
-   if ( PHYSFS_exists( str ) ) {
-      DEBUG( "Found 3D graphics for '%s' at '%s'!", temp->name, str );
-      temp->gfx_3d = gltf_loadFromFile( str );
-   }
+   /* Look for a 3d model. */
+   snprintf( paths->model, sizeof( paths->model ),
+             SHIP_3DGFX_PATH "%s/%s.gltf", base_path, buf );
+   has3d = PHYSFS_exists( paths->model );
+   if ( has3d )
+      DEBUG( "Found 3D graphics for '%s' at '%s'!", temp->name,
+             paths->model );
+   else
+      paths->model[0] = '\0';
 
    /* Determine extension path. */
    if ( buf[0] == '/' ) /* absolute path. */
-      snprintf( str, sizeof( str ), "%s", buf );
+      snprintf( paths->space, sizeof( paths->space ), "%s", buf );
    else {
-      snprintf( str, sizeof( str ), SHIP_GFX_PATH "%s/%s%s", base, buf, ext );
-      if ( !PHYSFS_exists( str ) ) {
+      snprintf( paths->space, sizeof( paths->space ),
+                SHIP_GFX_PATH "%s/%s%s", base, buf, ext );
+      if ( !PHYSFS_exists( paths->space ) ) {
          ext = ".png";
-         snprintf( str, sizeof( str ), SHIP_GFX_PATH "%s/%s%s", base, buf,
-                   ext );
+         snprintf( paths->space, sizeof( paths->space ),
+                   SHIP_GFX_PATH "%s/%s%s", base, buf, ext );
       }
    }
 
@@ -462,29 +524,56 @@ int ship_gfxLoad( Ship *temp )
                     buf, ext );
 
    /* Load the polygon. */
-   ship_loadPLG( temp, ( temp->polygon_path != NULL ) ? temp->polygon_path
-                                                      : temp->gfx_path );
+   ship_loadPLG( temp,
+                 ( temp->polygon_path != NULL ) ? temp->polygon_path
+                                                : temp->gfx_path,
+                 has3d );
 
    /* If we have 3D and polygons, we'll ignore the 2D stuff. */
-   if ( ( temp->gfx_3d != NULL ) &&
-        ( array_size( temp->polygon.views ) > 0 ) ) {
-      free( base );
+   if ( has3d && ( array_size( temp->polygon.views ) > 0 ) )
+      paths->space[0] = '\0';
+   else if ( !temp->noengine )
+      snprintf( paths->engine, sizeof( paths->engine ),
+                SHIP_GFX_PATH "%s/%s" SHIP_ENGINE "%s", base, buf, ext );
+   free( base );
+}
+
+/**
+ * @brief Loads the graphics for a ship if necessary.
+ *
+ * Blocks until the graphics are usable, finishing them off if they were
+ * already requested with ship_gfxRequest().
+ *
+ *    @param temp Ship to load into.
+ */
+int ship_gfxLoad( Ship *temp )
+{
+   ShipGfxPaths paths;
+
+   /* Already requested, just have to wait for it. */
+   if ( ship_isFlag( temp, SHIP_GFXLOADING | SHIP_GFXLOADED ) ) {
+      ship_gfxFinish( temp );
       return 0;
    }
 
+   ship_gfxPaths( temp, &paths );
+
+   /* Load the 3d model */
+   if ( paths.model[0] != '\0' )
+      temp->gfx_3d = gltf_loadFromFile( paths.model );
+
    /* Load the space sprite. */
-   ship_loadSpaceImage( temp, str, sx, sy );
+   if ( paths.space[0] != '\0' )
+      ship_loadSpaceImage( temp, paths.space, temp->sx, temp->sy, 0 );
 
    /* Load the engine sprite .*/
-   if ( engine ) {
-      snprintf( str, sizeof( str ), SHIP_GFX_PATH "%s/%s" SHIP_ENGINE "%s",
-                base, buf, ext );
-      ship_loadEngineImage( temp, str, sx, sy );
+   if ( paths.engine[0] != '\0' ) {
+      ship_loadEngineImage( temp, paths.engine, temp->sx, temp->sy, 0 );
       if ( temp->gfx_engine == NULL )
          WARN( _( "Ship '%s' does not have an engine sprite (%s)." ),
-               temp->name, str );
+               temp->name, paths.engine );
    }
-   free( base );
+   ship_setFlag( temp, SHIP_GFXLOADED );
 
 #if DEBUGGING
    if ( ( temp->gfx_space != NULL ) &&
@@ -497,6 +586,102 @@ int ship_gfxLoad( Ship *temp )
    return 0;
 }
 
+/**
+ * @brief Starts loading the graphics for a ship without blocking.
+ *
+ * Sprites get decoded in the background and uploaded a bit every frame,
+ * while 3D models are loaded one per frame by ship_gfxUpdate(). Use
+ * ship_gfxLoaded() to check when they can be rendered. Must be called from
+ * the main thread.
+ *
+ *    @param temp Ship to load into.
+ */
+void ship_gfxRequest( Ship *temp )
+{
+   ShipGfxPaths paths;
+
+   if ( ship_isFlag( temp, SHIP_GFXLOADING | SHIP_GFXLOADED ) )
+      return;
+
+   ship_gfxPaths( temp, &paths );
+   if ( paths.space[0] != '\0' )
+      ship_loadSpaceImage( temp, paths.space, temp->sx, temp->sy, 1 );
+   if ( paths.engine[0] != '\0' )
+      ship_loadEngineImage( temp, paths.engine, temp->sx, temp->sy, 1 );
+
+   if ( paths.model[0] != '\0' ) {
+      ShipGfxQueue *q = &array_grow( &ship_gfx_queue );
+      q->ship         = temp;
+      q->path         = strdup( paths.model );
+      ship_setFlag( temp, SHIP_GFXLOADING );
+   } else
+      ship_setFlag( temp, SHIP_GFXLOADED );
+}
+
+/**
+ * @brief Loads a queued 3D model.
+ */
+static void ship_gfxLoadModel( ShipGfxQueue *q )
+{
+   Ship *temp   = q->ship;
+   temp->gfx_3d = gltf_loadFromFile( q->path );
+   free( q->path );
+   ship_rmFlag( temp, SHIP_GFXLOADING );
+   ship_setFlag( temp, SHIP_GFXLOADED );
+}
+
+/**
+ * @brief Blocks until the requested graphics of a ship are usable. Must be
+ * called from the main thread.
+ */
+static void ship_gfxFinish( Ship *temp )
+{
+   for ( int i = 0; i < array_size( ship_gfx_queue ); i++ ) {
+      ShipGfxQueue *q = &ship_gfx_queue[i];
+      if ( q->ship != temp )
+         continue;
+      ship_gfxLoadModel( q );
+      array_erase( &ship_gfx_queue, &q[0], &q[1] );
+      break;
+   }
+   gl_texWait( temp->gfx_space );
+   gl_texWait( temp->gfx_engine );
+}
+
+/**
+ * @brief Makes progress on the ship graphics requested with ship_gfxRequest().
+ *
+ * 3D models need the OpenGL context while loading, so they are loaded here on
+ * the main thread one per frame.
+ */
+void ship_gfxUpdate( void )
+{
+   if ( array_size( ship_gfx_queue ) > 0 ) {
+      NTracingZone( _ctx, 1 );
+      ship_gfxLoadModel( &ship_gfx_queue[0] );
+      array_erase( &ship_gfx_queue, &ship_gfx_queue[0], &ship_gfx_queue[1] );
+      NTracingZoneEnd( _ctx );
+   }
+   NTracingPlotI( "ship gfx pending", ship_gfxPending() );
+   NTracingPlotI( "texture stream bytes", gl_texStreamBytes() );
+}
+
+/**
+ * @brief Gets the number of ships that had their graphics requested, but can
+ * not be rendered yet.
+ */
+int ship_gfxPending( void )
+{
+   int n = 0;
+   for ( int i = 0; i < array_size( ship_stack ); i++ ) {
+      const Ship *s = &ship_stack[i];
+      if ( ship_isFlag( s, SHIP_GFXLOADING | SHIP_GFXLOADED ) &&
+           !ship_gfxLoaded( s ) )
+         n++;
+   }
+   return n;
+}
+
 /**
  * @brief Generates the store image for the ship.
  *
@@ -541,13 +726,13 @@ static int ship_generateStoreGFX( Ship *temp )
  *    @param temp Ship to load into.
  *    @param buf Name of the file.
  */
-static int ship_loadPLG( Ship *temp, const char *buf )
+static int ship_loadPLG( Ship *temp, const char *buf, int is3d )
 {
    char       file[PATH_MAX];
    xmlDocPtr  doc;
    xmlNodePtr node;
 
-   if ( temp->gfx_3d != NULL )
+   if ( is3d )
       snprintf( file, sizeof( file ), "%s%s.xml", SHIP_POLYGON_PATH3D, buf );
    else
       snprintf( file, sizeof( file ), "%s%s.xml", SHIP_POLYGON_PATH, buf );
@@ -1053,6 +1238,15 @@ void ship_renderFramebuffer( const Ship *s, GLuint fbo, double fw, double fh,
 
    glClearColor( 0., 0., 0., 0. );
 
+   /* Still streaming in, leave it empty. */
+   if ( !ship_gfxLoaded( s ) ) {
+      glBindFramebuffer( GL_FRAMEBUFFER, fbo );
+      glClear( GL_COLOR_BUFFER_BIT );
+      glBindFramebuffer( GL_FRAMEBUFFER, gl_screen.current_fbo );
+      glClearColor( 0., 0., 0., 1. );
+      return;
+   }
+
    if ( s->gfx_3d != NULL ) {
       double            scale = ship_aa_scale * s->size;
       const GltfObject *obj   = s->gfx_3d;
@@ -1243,6 +1437,8 @@ int ships_load( void )
    /* Initialize stack if needed. */
    if ( ship_stack == NULL )
       ship_stack = array_create_size( Ship, nfiles );
+   if ( ship_gfx_queue == NULL )
+      ship_gfx_queue = array_create( ShipGfxQueue );
 
    /* First pass to find what ships we have to load. */
    for ( int i = 0; i < nfiles; i++ ) {
@@ -1285,6 +1481,11 @@ int ships_load( void )
    /* Shrink stack. */
    array_shrink( &ship_stack );
 
+   /* Index by name. */
+   nameidx_init( &ship_idx, array_size( ship_stack ) );
+   for ( int i = 0; i < array_size( ship_stack ); i++ )
+      nameidx_add( &ship_idx, ship_stack[i].name, i );
+
    /* Second pass to load Lua. */
    for ( int i = 0; i < array_size( ship_stack ); i++ ) {
       Ship *s = &ship_stack[i];
@@ -1380,6 +1581,12 @@ void ships_free( void )
       glDeleteTextures( 1, &ship_texd[i] );
    }
 
+   /* Drop pending 3D models. */
+   for ( int i = 0; i < array_size( ship_gfx_queue ); i++ )
+      free( ship_gfx_queue[i].path );
+   array_free( ship_gfx_queue );
+   ship_gfx_queue = NULL;
+
    /* Now ships. */
    for ( int i = 0; i < array_size( ship_stack ); i++ ) {
       Ship *s = &ship_stack[i];
@@ -1440,6 +1647,7 @@ void ships_free( void )
       free( s->lua_file );
    }
 
+   nameidx_free( &ship_idx );
    array_free( ship_stack );
    ship_stack = NULL;
 }
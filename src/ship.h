@@ -21,6 +21,10 @@
 #define SHIP_UNIQUE                                                            \
    ( 1 << 2 ) /**< Ship is unique and player can only have one. */
 #define SHIP_NEEDSGFX ( 1 << 3 ) /**< Ship needs to load graphics. */
+#define SHIP_GFXLOADING                                                        \
+   ( 1 << 4 ) /**< Ship graphics are waiting on the 3D model. */
+#define SHIP_GFXLOADED                                                         \
+   ( 1 << 5 ) /**< Ship graphics have been loaded or requested. */
 #define ship_isFlag( s, f ) ( ( s )->flags & ( f ) )   /**< Checks ship flag. */
 #define ship_setFlag( s, f ) ( ( s )->flags |= ( f ) ) /**< Sets ship flag. */
 #define ship_rmFlag( s, f )                                                    \
@@ -226,6 +230,9 @@ void   ships_resize( void );
 int    ship_gfxLoaded( const Ship *s );
 int    ship_gfxLoadNeeded( void );
 int    ship_gfxLoad( Ship *temp );
+void   ship_gfxRequest( Ship *temp );
+void   ship_gfxUpdate( void );
+int    ship_gfxPending( void );
 int    ship_compareTech( const void *arg1, const void *arg2 );
 void   ship_renderFramebuffer( const Ship *s, GLuint fbo, double fw, double fh,
                                double dir, double engine_glow, double tilt,
@@ -32,6 +32,7 @@
 #include "menu.h"
 #include "mission.h"
 #include "music.h"
+#include "nameidx.h"
 #include "ndata.h"
 #include "nebula.h"
 #include "nlua.h"
@@ -99,6 +100,9 @@ static int spobstack_changed =
    0; /**< Whether or not the spob_stack was changed after loading. */
 static MapShader **mapshaders = NULL; /**< Map shaders. */
 
+static NameIdx system_idx; /**< Systems indexed by name, as loaded. */
+static NameIdx spob_idx;   /**< Spobs indexed by name, as loaded. */
+
 /*
  * Misc.
  */
@@ -1009,11 +1013,9 @@ StarSystem *system_get( const char *sysname )
       return NULL;
    }
 
-   const StarSystem s = { .name = (char *)sysname };
-   StarSystem *found  = bsearch( &s, systems_stack, array_size( systems_stack ),
-                                 sizeof( StarSystem ), system_cmp );
-   if ( found != NULL )
-      return found;
+   int i = nameidx_get( &system_idx, sysname );
+   if ( i >= 0 )
+      return &systems_stack[i];
 
    WARN( _( "System '%s' not found in stack" ), sysname );
    return NULL;
@@ -1103,11 +1105,9 @@ Spob *spob_get( const char *spobname )
       return NULL;
    }
 
-   const Spob p     = { .name = (char *)spobname };
-   Spob      *found = bsearch( &p, spob_stack, array_size( spob_stack ),
-                               sizeof( Spob ), spob_cmp );
-   if ( found != NULL )
-      return found;
+   int i = nameidx_get( &spob_idx, spobname );
+   if ( i >= 0 )
+      return &spob_stack[i];
 
    WARN( _( "Spob '%s' not found in the universe" ), spobname );
    return NULL;
@@ -1858,8 +1858,11 @@ static int spobs_load( void )
       free( spob_files[i] );
    }
    qsort( spob_stack, array_size( spob_stack ), sizeof( Spob ), spob_cmp );
-   for ( int j = 0; j < array_size( spob_stack ); j++ )
+   nameidx_init( &spob_idx, array_size( spob_stack ) );
+   for ( int j = 0; j < array_size( spob_stack ); j++ ) {
       spob_stack[j].id = j;
+      nameidx_add( &spob_idx, spob_stack[j].name, j );
+   }
 
    /* Clean up. */
    array_free( spob_files );
@@ -2778,6 +2781,24 @@ int system_rmJump( StarSystem *sys, const char *jumpname )
    return 0;
 }
 
+/**
+ * @brief Renames a star system.
+ *
+ *    @param sys Star System to rename.
+ *    @param newname New name to give the system, ownership is taken.
+ *    @return 0 on success.
+ */
+int system_rename( StarSystem *sys, char *newname )
+{
+   free( sys->name );
+   sys->name = newname;
+
+   /* The name index points to the old name, so no more lookups from it. */
+   systemstack_changed = 1;
+
+   return 0;
+}
+
 /**
  * @brief Initializes a new star system with null memory.
  */
@@ -3573,9 +3594,11 @@ static int systems_load( void )
    }
    qsort( systems_stack, array_size( systems_stack ), sizeof( StarSystem ),
           system_cmp );
+   nameidx_init( &system_idx, array_size( systems_stack ) );
    for ( int j = 0; j < array_size( systems_stack ); j++ ) {
       systems_stack[j].id   = j;
       systems_stack[j].note = NULL; /* just to be sure */
+      nameidx_add( &system_idx, systems_stack[j].name, j );
    }
 
    /*
@@ -3803,6 +3826,7 @@ void space_exit( void )
       nlua_freeEnv( spb->lua_env );
    }
    array_free( spob_stack );
+   nameidx_free( &spob_idx );
 
    for ( int i = 0; i < array_size( spob_lua_stack ); i++ )
       spob_lua_free( &spob_lua_stack[i] );
@@ -3845,6 +3869,7 @@ void space_exit( void )
    }
    array_free( systems_stack );
    systems_stack = NULL;
+   nameidx_free( &system_idx );
 
    /* Free asteroids stuff. */
    asteroids_free();
@@ -424,6 +424,7 @@ int         system_addVirtualSpob( StarSystem *sys, const char *spobname );
 int         system_rmVirtualSpob( StarSystem *sys, const char *spobname );
 int         system_addJumpDiff( StarSystem *sys, xmlNodePtr node );
 int         system_rmJump( StarSystem *sys, const char *jumpname );
+int         system_rename( StarSystem *sys, char *newname );
 
 /*
  * render
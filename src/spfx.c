@@ -47,8 +47,33 @@
 /* Trail stuff. */
 #define TRAIL_UPDATE_DT                                                        \
    0.05 /**< Rate (in seconds) at which trail is updated. */
+#define TRAIL_VERTEX_SIZE                                                      \
+   12 /**< Floats per trail vertex: position, colour, texture, parameters. */
 static TrailSpec   *trail_spec_stack; /**< Trail specifications. */
 static Trail_spfx **trail_spfx_stack; /**< Active trail effects. */
+static double trail_time = 0.; /**< Trail clock, points store spawn times. */
+
+/**
+ * @brief Per-point scratch data used while building a trail mesh.
+ */
+typedef struct TrailMeshPoint_ {
+   double x;   /**< X position on screen. */
+   double y;   /**< Y position on screen. */
+   double len; /**< Distance along the trail. */
+   int    ok;  /**< Whether the segment ending at this point is drawn. */
+} TrailMeshPoint;
+
+/**
+ * @brief Trails sharing a shader subroutine, drawn with a single call.
+ */
+typedef struct TrailBatch_ {
+   GLuint   type; /**< Shader subroutine to use. */
+   GLfloat *data; /**< Triangle strip vertex data (array.h). */
+} TrailBatch;
+static TrailMeshPoint *trail_meshPoints = NULL; /**< Mesh scratch (array.h). */
+static TrailBatch     *trail_batches    = NULL; /**< Trail batches (array.h). */
+static GLfloat        *trail_meshData   = NULL; /**< Single trail mesh. */
+static gl_vbo         *trail_vbo        = NULL; /**< Streaming trail VBO. */
 
 /*
  * Special hard-coded special effects
@@ -154,6 +179,9 @@ static void spfx_hapticRumble( double mod );
 static void spfx_update_trails( double dt );
 static void spfx_trail_update( Trail_spfx *trail, double dt );
 static void spfx_trail_free( Trail_spfx *trail );
+static void spfx_trail_mesh( GLfloat **data, const Trail_spfx *trail );
+static void spfx_trail_drawMesh( GLuint type, const GLfloat *data );
+static void spfx_trail_renderAll( void );
 
 /**
  * @brief For sorting and stuff.
@@ -471,6 +499,16 @@ void spfx_free( void )
       spfx_trail_free( trail_spfx_stack[i] );
    array_free( trail_spfx_stack );
    trail_spfx_stack = NULL;
+   for ( int i = 0; i < array_size( trail_batches ); i++ )
+      array_free( trail_batches[i].data );
+   array_free( trail_batches );
+   trail_batches = NULL;
+   array_free( trail_meshPoints );
+   trail_meshPoints = NULL;
+   array_free( trail_meshData );
+   trail_meshData = NULL;
+   gl_vboDestroy( trail_vbo );
+   trail_vbo = NULL;
 
    /* Free the trail styles. */
    for ( int i = 0; i < array_size( trail_spec_stack ); i++ ) {
@@ -751,6 +789,7 @@ Trail_spfx *spfx_trail_create( const TrailSpec *spec )
 void spfx_update_trails( double dt )
 {
    int n = array_size( trail_spfx_stack );
+   trail_time += dt;
    for ( int i = 0; i < n; i++ ) {
       Trail_spfx *trail = trail_spfx_stack[i];
       spfx_trail_update( trail, dt );
@@ -771,15 +810,12 @@ void spfx_update_trails( double dt )
  */
 static void spfx_trail_update( Trail_spfx *trail, double dt )
 {
-   GLfloat rel_dt = dt / trail->spec->ttl;
-   /* Remove outdated elements. */
-   while ( trail->iread < trail->iwrite && trail_front( trail ).t < rel_dt )
+   /* Remove outdated elements. Points store their spawn time, so the rest
+    * age on their own. */
+   while ( trail->iread < trail->iwrite &&
+           trail_time - trail_front( trail ).t > trail->spec->ttl )
       trail->iread++;
 
-   /* Update others' timestamps. */
-   for ( size_t i = trail->iread; i < trail->iwrite; i++ )
-      trail_at( trail, i ).t -= rel_dt;
-
    /* Update timer. */
    trail->dt += dt;
 }
@@ -803,7 +839,7 @@ void spfx_trail_sample( Trail_spfx *trail, double x, double y, TrailMode mode,
 
    p.x    = x;
    p.y    = y;
-   p.t    = 1.;
+   p.t    = trail_time;
    p.mode = mode;
 
    /* The "back" of the trail should always reflect our most recent state.  */
@@ -812,7 +848,8 @@ void spfx_trail_sample( Trail_spfx *trail, double x, double y, TrailMode mode,
    /* We may need to insert a control point, but not if our last sample was
     * recent enough. */
    if ( !force && trail_size( trail ) > 1 &&
-        trail_at( trail, trail->iwrite - 2 ).t >= 1. - TRAIL_UPDATE_DT )
+        trail_time - trail_at( trail, trail->iwrite - 2 ).t <=
+           TRAIL_UPDATE_DT * trail->spec->ttl )
       return;
 
    /* If the last time we inserted a control point was recent enough, we don't
@@ -853,89 +890,226 @@ static void spfx_trail_free( Trail_spfx *trail )
 }
 
 /**
- * @brief Draws a trail on screen.
+ * @brief Appends a vertex to a trail mesh.
  */
-void spfx_trail_draw( const Trail_spfx *trail )
+static void spfx_trail_vertex( GLfloat **data, const Trail_spfx *trail,
+                               const TrailMeshPoint *mp, const TrailPoint *tp,
+                               double nx, double ny, int side )
 {
-   const TrailStyle *styles;
-   size_t            n;
-   GLfloat           len;
-   double            z;
+   const TrailStyle *sp    = &trail->spec->style[tp->mode];
+   double            thick = cam_getZoom() * sp->thick;
+   size_t            n     = array_size( *data );
+   GLfloat          *v;
+
+   array_resize( data, n + TRAIL_VERTEX_SIZE );
+   v = &( *data )[n];
+
+   v[0]  = mp->x + side * nx * thick;
+   v[1]  = mp->y + side * ny * thick;
+   v[2]  = sp->col.r;
+   v[3]  = sp->col.g;
+   v[4]  = sp->col.b;
+   v[5]  = sp->col.a;
+   v[6]  = 1. - ( trail_time - tp->t ) / trail->spec->ttl;
+   v[7]  = side;
+   v[8]  = mp->len;
+   v[9]  = ( side > 0 ) ? sp->thick : 0.;
+   v[10] = trail->dt;
+   v[11] = trail->r;
+}
 
-   n = trail_size( trail );
-   if ( n == 0 )
+/**
+ * @brief Appends a trail to a triangle strip mesh.
+ *
+ * Consecutive drawable segments become a single run of the strip, and runs
+ * are joined with degenerate triangles so everything can be drawn at once.
+ *
+ *    @param data Vertex data to append to (array.h).
+ *    @param trail Trail to append.
+ */
+static void spfx_trail_mesh( GLfloat **data, const Trail_spfx *trail )
+{
+   size_t n = trail_size( trail );
+   if ( n < 2 )
       return;
-   styles = trail->spec->style;
 
-   /* Stuff that doesn't change for the entire trail. */
-   glUseProgram( shaders.trail.program );
-   if ( gl_has( OPENGL_SUBROUTINES ) )
-      glUniformSubroutinesuiv( GL_FRAGMENT_SHADER, 1, &trail->spec->type );
-   glEnableVertexAttribArray( shaders.trail.vertex );
-   gl_vboActivateAttribOffset( gl_squareVBO, shaders.trail.vertex, 0, 2,
-                               GL_FLOAT, 0 );
-   glUniform1f( shaders.trail.dt, trail->dt );
-   glUniform1f( shaders.trail.r, trail->r );
-
-   z   = cam_getZoom();
-   len = 0.;
-   for ( size_t i = trail->iread + 1; i < trail->iwrite; i++ ) {
-      mat4              projection;
-      const TrailStyle *sp, *spp;
-      double            x1, y1, x2, y2, s;
-      TrailPoint       *tp  = &trail_at( trail, i );
-      TrailPoint       *tpp = &trail_at( trail, i - 1 );
-
-      /* Ignore none modes. */
-      if ( tp->mode == MODE_NONE || tpp->mode == MODE_NONE )
+   /* Project the points and figure out which segments get drawn. */
+   if ( trail_meshPoints == NULL )
+      trail_meshPoints = array_create( TrailMeshPoint );
+   array_resize( &trail_meshPoints, n );
+   for ( size_t i = 0; i < n; i++ ) {
+      TrailMeshPoint   *mp = &trail_meshPoints[i];
+      const TrailPoint *tp = &trail_at( trail, trail->iread + i );
+      gl_gameToScreenCoords( &mp->x, &mp->y, tp->x, tp->y );
+      mp->ok  = 0;
+      mp->len = 0.;
+      if ( i == 0 )
          continue;
 
-      gl_gameToScreenCoords( &x1, &y1, tp->x, tp->y );
-      gl_gameToScreenCoords( &x2, &y2, tpp->x, tpp->y );
-
-      s = hypot( x2 - x1, y2 - y1 );
-      if ( s <= 0. )
+      const TrailMeshPoint *mpp = &trail_meshPoints[i - 1];
+      const TrailPoint     *tpp = &trail_at( trail, trail->iread + i - 1 );
+      double                s   = hypot( mp->x - mpp->x, mp->y - mpp->y );
+      mp->len                   = mpp->len + s;
+      /* Ignore none modes, degenerate and off-screen segments. */
+      if ( ( tp->mode == MODE_NONE ) || ( tpp->mode == MODE_NONE ) ||
+           ( s <= 0. ) )
+         continue;
+      if ( ( MAX( mp->x, mpp->x ) < 0. ) ||
+           ( MIN( mp->x, mpp->x ) > (double)SCREEN_W ) ||
+           ( MAX( mp->y, mpp->y ) < 0. ) ||
+           ( MIN( mp->y, mpp->y ) > (double)SCREEN_H ) )
          continue;
+      mp->ok = 1;
+   }
 
-      /* Make sure in bounds. */
-      if ( ( MAX( x1, x2 ) < 0. ) || ( MIN( x1, x2 ) > (double)SCREEN_W ) ||
-           ( MAX( y1, y2 ) < 0. ) || ( MIN( y1, y2 ) > (double)SCREEN_H ) ) {
-         len += s;
+   /* Emit two vertices per point, using the mean direction of the drawn
+    * segments around it. */
+   for ( size_t i = 0; i < n; i++ ) {
+      const TrailMeshPoint *mp   = &trail_meshPoints[i];
+      int                   in   = mp->ok;
+      int                   out  = ( i + 1 < n ) && trail_meshPoints[i + 1].ok;
+      double                dx   = 0.;
+      double                dy   = 0.;
+      double                d;
+      const TrailPoint     *tp   = &trail_at( trail, trail->iread + i );
+      const TrailMeshPoint *prev = ( i > 0 ) ? &trail_meshPoints[i - 1] : NULL;
+      const TrailMeshPoint *next =
+         ( i + 1 < n ) ? &trail_meshPoints[i + 1] : NULL;
+
+      if ( !in && !out )
          continue;
+      if ( in ) {
+         d = mp->len - prev->len;
+         dx += ( mp->x - prev->x ) / d;
+         dy += ( mp->y - prev->y ) / d;
       }
-
-      sp  = &styles[tp->mode];
-      spp = &styles[tpp->mode];
-
-      /* Set vertex. */
-      projection = gl_view_matrix;
-      mat4_translate_xy( &projection, x1, y1 );
-      mat4_rotate2dv( &projection, ( x2 - x1 ) / s, ( y2 - y1 ) / s );
-      mat4_scale_xy( &projection, s, z * ( sp->thick + spp->thick ) );
-      mat4_translate_xy( &projection, 0., -0.5 );
-
-      /* Set uniforms. */
-      gl_uniformMat4( shaders.trail.projection, &projection );
-      gl_uniformColour( shaders.trail.c1, &sp->col );
-      gl_uniformColour( shaders.trail.c2, &spp->col );
-      glUniform1f( shaders.trail.t1, tp->t );
-      glUniform1f( shaders.trail.t2, tpp->t );
-      glUniform2f( shaders.trail.pos2, len, sp->thick );
-      len += s;
-      glUniform2f( shaders.trail.pos1, len, spp->thick );
-
-      /* Draw. */
-      glDrawArrays( GL_TRIANGLE_STRIP, 0, 4 );
+      if ( out ) {
+         d = next->len - mp->len;
+         dx += ( next->x - mp->x ) / d;
+         dy += ( next->y - mp->y ) / d;
+      }
+      d = hypot( dx, dy );
+      if ( d <= 0. ) { /* Turned right around, use the incoming segment. */
+         const TrailMeshPoint *a = in ? prev : mp;
+         const TrailMeshPoint *b = in ? mp : next;
+         dx                      = b->x - a->x;
+         dy                      = b->y - a->y;
+         d                       = hypot( dx, dy );
+      }
+      dx /= d;
+      dy /= d;
+
+      /* Starting a new run, so join it to the previous one. */
+      if ( !in && ( array_size( *data ) > 0 ) ) {
+         GLfloat last[TRAIL_VERTEX_SIZE];
+         memcpy( last, &( *data )[array_size( *data ) - TRAIL_VERTEX_SIZE],
+                 sizeof( last ) );
+         for ( int j = 0; j < TRAIL_VERTEX_SIZE; j++ )
+            array_push_back( data, last[j] );
+         spfx_trail_vertex( data, trail, mp, tp, -dy, dx, -1 );
+      }
+      spfx_trail_vertex( data, trail, mp, tp, -dy, dx, -1 );
+      spfx_trail_vertex( data, trail, mp, tp, -dy, dx, +1 );
    }
+}
+
+/**
+ * @brief Draws a trail mesh with a single call.
+ *
+ *    @param type Shader subroutine to use.
+ *    @param data Triangle strip vertex data (array.h).
+ */
+static void spfx_trail_drawMesh( GLuint type, const GLfloat *data )
+{
+   GLsizei n      = array_size( data ) / TRAIL_VERTEX_SIZE;
+   GLsizei stride = TRAIL_VERTEX_SIZE * sizeof( GLfloat );
+   GLsizei size   = array_size( data ) * sizeof( GLfloat );
+   if ( n == 0 )
+      return;
+
+   /* Orphan and refill the streaming buffer. */
+   if ( trail_vbo == NULL )
+      trail_vbo = gl_vboCreateStream( size, data );
+   else
+      gl_vboData( trail_vbo, size, data );
+
+   glUseProgram( shaders.trail.program );
+   if ( gl_has( OPENGL_SUBROUTINES ) )
+      glUniformSubroutinesuiv( GL_FRAGMENT_SHADER, 1, &type );
+   gl_uniformMat4( shaders.trail.projection, &gl_view_matrix );
+   glEnableVertexAttribArray( shaders.trail.vertex );
+   glEnableVertexAttribArray( shaders.trail.vertex_colour );
+   glEnableVertexAttribArray( shaders.trail.vertex_tex );
+   glEnableVertexAttribArray( shaders.trail.vertex_param );
+   gl_vboActivateAttribOffset( trail_vbo, shaders.trail.vertex, 0, 2, GL_FLOAT,
+                               stride );
+   gl_vboActivateAttribOffset( trail_vbo, shaders.trail.vertex_colour,
+                               2 * sizeof( GLfloat ), 4, GL_FLOAT, stride );
+   gl_vboActivateAttribOffset( trail_vbo, shaders.trail.vertex_tex,
+                               6 * sizeof( GLfloat ), 4, GL_FLOAT, stride );
+   gl_vboActivateAttribOffset( trail_vbo, shaders.trail.vertex_param,
+                               10 * sizeof( GLfloat ), 2, GL_FLOAT, stride );
+
+   glDrawArrays( GL_TRIANGLE_STRIP, 0, n );
 
    /* Clear state. */
    glDisableVertexAttribArray( shaders.trail.vertex );
+   glDisableVertexAttribArray( shaders.trail.vertex_colour );
+   glDisableVertexAttribArray( shaders.trail.vertex_tex );
+   glDisableVertexAttribArray( shaders.trail.vertex_param );
    glUseProgram( 0 );
 
    /* Check errors. */
    gl_checkErr();
 }
 
+/**
+ * @brief Draws a trail on screen.
+ */
+void spfx_trail_draw( const Trail_spfx *trail )
+{
+   if ( trail_meshData == NULL )
+      trail_meshData = array_create( GLfloat );
+   array_resize( &trail_meshData, 0 );
+   spfx_trail_mesh( &trail_meshData, trail );
+   spfx_trail_drawMesh( trail->spec->type, trail_meshData );
+}
+
+/**
+ * @brief Draws all the trails that aren't on top of their pilots.
+ *
+ * Trails are batched by shader subroutine, so this is a handful of draw calls
+ * no matter how many trails there are.
+ */
+static void spfx_trail_renderAll( void )
+{
+   if ( trail_batches == NULL )
+      trail_batches = array_create( TrailBatch );
+   for ( int i = 0; i < array_size( trail_batches ); i++ )
+      array_resize( &trail_batches[i].data, 0 );
+
+   for ( int i = 0; i < array_size( trail_spfx_stack ); i++ ) {
+      const Trail_spfx *trail = trail_spfx_stack[i];
+      TrailBatch       *batch = NULL;
+      if ( trail->ontop )
+         continue;
+      for ( int j = 0; j < array_size( trail_batches ); j++ )
+         if ( trail_batches[j].type == trail->spec->type ) {
+            batch = &trail_batches[j];
+            break;
+         }
+      if ( batch == NULL ) {
+         batch       = &array_grow( &trail_batches );
+         batch->type = trail->spec->type;
+         batch->data = array_create( GLfloat );
+      }
+      spfx_trail_mesh( &batch->data, trail );
+   }
+
+   for ( int i = 0; i < array_size( trail_batches ); i++ )
+      spfx_trail_drawMesh( trail_batches[i].type, trail_batches[i].data );
+}
+
 /**
  * @brief Increases the current rumble level.
  *
@@ -1164,11 +1338,7 @@ void spfx_render( int layer, double dt )
 
       NTracingZoneName( _ctx_trails, "spfx_render[trails]", 1 );
       /* Trails are special (for now?). */
-      for ( int i = 0; i < array_size( trail_spfx_stack ); i++ ) {
-         const Trail_spfx *trail = trail_spfx_stack[i];
-         if ( !trail->ontop )
-            spfx_trail_draw( trail );
-      }
+      spfx_trail_renderAll();
       NTracingZoneEnd( _ctx_trails );
       break;
 
@@ -62,10 +62,10 @@ typedef struct TrailSpec_ {
 } TrailSpec;
 
 typedef struct TrailPoint {
-   GLfloat x, y; /**< Control points for the trail. */
-   GLfloat t; /**< Timer, normalized to the time to live of the trail (starts at
-                 1, ends at 0). */
+   GLfloat   x, y; /**< Control points for the trail. */
    TrailMode mode; /**< Type of trail emission at this point. */
+   double t; /**< Spawn time on the trail clock, so points age without being
+                touched. */
 } TrailPoint;
 
 /**
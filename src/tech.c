@@ -17,6 +17,7 @@
 #include "commodity.h"
 #include "conf.h"
 #include "log.h"
+#include "nameidx.h"
 #include "ndata.h"
 #include "nxml.h"
 #include "outfit.h"
@@ -64,6 +65,7 @@ struct tech_group_s {
  * Group list.
  */
 static tech_group_t *tech_groups = NULL;
+static NameIdx       tech_idx; /**< Tech groups indexed by name. */
 
 /*
  * Prototypes.
@@ -131,6 +133,9 @@ int tech_load( void )
    /* Sort. */
    qsort( tech_groups, array_size( tech_groups ), sizeof( tech_group_t ),
           tech_cmp );
+   nameidx_init( &tech_idx, array_size( tech_groups ) );
+   for ( int i = 0; i < array_size( tech_groups ); i++ )
+      nameidx_add( &tech_idx, tech_groups[i].name, i );
 
    /* Now we load the data. */
    s = array_size( tech_groups );
@@ -162,6 +167,7 @@ void tech_free( void )
 
    /* Free the tech array. */
    array_free( tech_groups );
+   nameidx_free( &tech_idx );
 }
 
 /**
@@ -554,12 +560,7 @@ int tech_rmItem( const char *name, const char *value )
  */
 static int tech_getID( const char *name )
 {
-   const tech_group_t  q = { .name = (char *)name };
-   const tech_group_t *t = bsearch( &q, tech_groups, array_size( tech_groups ),
-                                    sizeof( tech_group_t ), tech_cmp );
-   if ( t == NULL )
-      return -1L;
-   return t - tech_groups;
+   return nameidx_get( &tech_idx, name );
 }
 
 /**
@@ -110,6 +110,14 @@ struct vpoolThreadData_ {
 };
 typedef struct vpoolThreadData_ vpoolThreadData;
 
+/**
+ * @brief Data for a standalone job that nobody waits on.
+ */
+typedef struct ThreadJobData_ {
+   ThreadQueueData node;    /**< The job to be done */
+   ThreadQueueData wrapper; /**< Wrapper that frees the job when done. */
+} ThreadJobData;
+
 /* The global threadpool queue */
 static ThreadQueue *global_queue = NULL;
 
@@ -123,6 +131,7 @@ static void         tq_destroy( ThreadQueue *q );
 static int          threadpool_worker( void *data );
 static int          threadpool_handler( void *data );
 static int          vpool_worker( void *data );
+static int          threadpool_jobWorker( void *data );
 
 /**
  * @brief Creates a concurrent queue.
@@ -494,6 +503,46 @@ int threadpool_init( void )
    return 0;
 }
 
+/**
+ * @brief Runs a job on the threadpool without waiting for it to finish.
+ *
+ * Useful for long-running background work, such as calculations that can be
+ *  swapped in once done. The job is responsible for synchronizing with
+ *  whatever it touches. If the threadpool is not initialized, the job is run
+ *  directly instead.
+ *
+ *    @param function Function to run.
+ *    @param data Data to pass to the function.
+ */
+void threadpool_newJob( int ( *function )( void * ), void *data )
+{
+   ThreadJobData *job;
+
+   if ( global_queue == NULL ) {
+      WARN( _( "Threadpool has not been initialized yet!" ) );
+      function( data );
+      return;
+   }
+
+   job                   = malloc( sizeof( ThreadJobData ) );
+   job->node.function    = function;
+   job->node.data        = data;
+   job->wrapper.function = threadpool_jobWorker;
+   job->wrapper.data     = job;
+   tq_enqueue( global_queue, &job->wrapper );
+}
+
+/**
+ * @brief Runs a standalone job and frees its data.
+ */
+static int threadpool_jobWorker( void *data )
+{
+   ThreadJobData *job = (ThreadJobData *)data;
+   job->node.function( job->node.data );
+   free( job );
+   return 0;
+}
+
 /**
  * @brief Creates a new vpool queue.
  *
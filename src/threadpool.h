@@ -20,6 +20,10 @@ typedef struct ThreadQueue_ ThreadQueue;
 /* Initializes the threadpool */
 int threadpool_init( void );
 
+/* Runs a job in the background without waiting for it. The job must not block
+ * waiting on other threadpool jobs. */
+void threadpool_newJob( int ( *function )( void * ), void *data );
+
 /* Creates a new vpool queue. Destroy with vpool_wait. */
 ThreadQueue *vpool_create( void );
 
@@ -72,6 +72,7 @@ void window_addCust(
    wgt->dat.cst.focusLose = focusLose;
    wgt->dat.cst.userdata  = data;
    wgt->dat.cst.autofree  = 0;
+   wgt->dat.cst.freedata  = NULL;
 
    /* position/size */
    wgt->w = (double)w;
@@ -154,7 +155,9 @@ static void cst_renderOverlay( Widget *cst, double bx, double by )
  */
 static void cst_cleanup( Widget *cst )
 {
-   if ( cst->dat.cst.autofree )
+   if ( cst->dat.cst.freedata != NULL )
+      cst->dat.cst.freedata( cst->dat.cst.userdata );
+   else if ( cst->dat.cst.autofree )
       free( cst->dat.cst.userdata );
 }
 
@@ -245,6 +248,22 @@ void window_custAutoFreeData( unsigned int wid, const char *name )
       wgt->dat.cst.autofree = 1;
 }
 
+/**
+ * @brief Sets the function that frees the widget's data upon cleanup, for data
+ * that owns more than its own memory.
+ *
+ *    @param wid Window to which widget belongs.
+ *    @param name Name of the widget.
+ *    @param freedata Function to free the data with, NULL disables.
+ */
+void window_custSetFreeData( unsigned int wid, const char *name,
+                             void ( *freedata )( void *data ) )
+{
+   Widget *wgt = cst_getWidget( wid, name );
+   if ( wgt != NULL )
+      wgt->dat.cst.freedata = freedata;
+}
+
 /**
  * @brief Marks a widget as being rendered dynamically, which forces it to be
  * updated every frame.
@@ -29,6 +29,7 @@ typedef struct WidgetCustData_ {
    void *userdata;
    int   autofree; /**< 1 if widget should free userdata upon cleanup, 0 if it
                       shouldn't. */
+   void ( *freedata )( void *data ); /**< Frees userdata upon cleanup. */
 } WidgetCustData;
 
 /* Required functions. */
@@ -49,4 +50,6 @@ void  window_custSetOverlay( unsigned int wid, const char *name,
                                                      void *data ) );
 void *window_custGetData( unsigned int wid, const char *name );
 void  window_custAutoFreeData( unsigned int wid, const char *name );
+void  window_custSetFreeData( unsigned int wid, const char *name,
+                              void ( *freedata )( void *data ) );
 void  window_custSetDynamic( unsigned int wid, const char *name, int dynamic );
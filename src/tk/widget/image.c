@@ -75,7 +75,8 @@ static void img_render( Widget *img, double bx, double by )
    /*
     * image
     */
-   if ( img->dat.img.image != NULL ) {
+   if ( ( img->dat.img.image != NULL ) &&
+        !gl_texIsStreaming( img->dat.img.image ) ) {
       gl_renderScaleAspect( img->dat.img.image, x, y, w, h,
                             &img->dat.img.colour );
    }
@@ -231,8 +231,8 @@ static void iar_render( Widget *iar, double bx, double by )
          /* Draw background. */
          toolkit_drawRect( xcurs, ycurs, w, h, bgcolour, NULL );
 
-         /* image */
-         if ( cell->image != NULL ) {
+         /* image, left empty while it is streaming in */
+         if ( ( cell->image != NULL ) && !gl_texIsStreaming( cell->image ) ) {
             if ( ( cell->image->sw < iar->dat.iar.iw ) &&
                  ( cell->image->sh < iar->dat.iar.ih ) ) {
                double offx, offy;
@@ -1825,6 +1825,9 @@ int diff_load( xmlNodePtr parent )
    /* Update as necessary. */
    diff_checkUpdateUniverse();
 
+   /* Lanes from before loading don't make sense for the save. */
+   safelanes_wait();
+
    return 0;
 }
 
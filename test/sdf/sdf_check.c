@@ -0,0 +1,133 @@
+/*
+ * Compares the distance field quality modes against analytic distances.
+ *
+ * Shapes are rasterized with anti-aliasing like FreeType glyphs, then the
+ * distance recovered from each mode is compared to the exact distance to the
+ * shape outline near the edge, which is what the font shaders sample.
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "SDL_timer.h"
+
+#include "distance_field.h"
+
+#define SIZE 64        /**< Width and height of the test images. */
+#define SUPERSAMPLE 16 /**< Coverage samples per pixel along each axis. */
+#define BAND 3.        /**< Only pixels this close to the edge are checked. */
+#define ITERATIONS 200 /**< Runs per mode for the timing. */
+
+/**
+ * @brief A test shape, given by its signed distance function.
+ */
+typedef struct Shape_ {
+   const char *name;                       /**< Name to print. */
+   double ( *dist )( double x, double y ); /**< Negative inside. */
+} Shape;
+
+/**
+ * @brief Results of one quality mode.
+ */
+typedef struct Result_ {
+   double mean; /**< Mean absolute error in pixels. */
+   double max;  /**< Maximum absolute error in pixels. */
+   double us;   /**< Microseconds per distance field. */
+} Result;
+
+static double dist_disc( double x, double y )
+{
+   return hypot( x - 31.3, y - 32.7 ) - 17.4;
+}
+
+static double dist_box( double x, double y )
+{
+   /* Square rotated by 30 degrees, so edges don't follow the pixel grid. */
+   double c  = cos( M_PI / 6. ), s = sin( M_PI / 6. );
+   double u  = fabs( c * ( x - 32.2 ) + s * ( y - 31.6 ) ) - 14.;
+   double v  = fabs( -s * ( x - 32.2 ) + c * ( y - 31.6 ) ) - 14.;
+   double ou = fmax( u, 0. ), ov = fmax( v, 0. );
+   return hypot( ou, ov ) + fmin( fmax( u, v ), 0. );
+}
+
+static const Shape shapes[] = {
+   { "disc", dist_disc },
+   { "box", dist_box },
+};
+
+/**
+ * @brief Rasterizes a shape with anti-aliasing.
+ */
+static void rasterize( const Shape *shape, unsigned char *img )
+{
+   for ( int y = 0; y < SIZE; y++ )
+      for ( int x = 0; x < SIZE; x++ ) {
+         int n = 0;
+         for ( int j = 0; j < SUPERSAMPLE; j++ )
+            for ( int i = 0; i < SUPERSAMPLE; i++ )
+               if ( shape->dist( x + ( i + 0.5 ) / SUPERSAMPLE,
+                                 y + ( j + 0.5 ) / SUPERSAMPLE ) < 0. )
+                  n++;
+         img[y * SIZE + x] = ( 255 * n + SUPERSAMPLE * SUPERSAMPLE / 2 ) /
+                             ( SUPERSAMPLE * SUPERSAMPLE );
+      }
+}
+
+/**
+ * @brief Measures the error and speed of a quality mode on a shape.
+ */
+static Result measure( const Shape *shape, const unsigned char *img,
+                       SDFQuality quality )
+{
+   Result r = { 0., 0., 0. };
+   double vmax;
+   float *out;
+   int    n = 0;
+   Uint64 start;
+
+   out = make_distance_mapbf( img, SIZE, SIZE, quality, &vmax );
+   for ( int y = 0; y < SIZE; y++ )
+      for ( int x = 0; x < SIZE; x++ ) {
+         double ref = shape->dist( x + 0.5, y + 0.5 );
+         double d   = ( 0.5 - out[y * SIZE + x] ) * 2. * vmax;
+         double err = fabs( d - ref );
+         if ( fabs( ref ) > BAND )
+            continue;
+         r.mean += err;
+         r.max = fmax( r.max, err );
+         n++;
+      }
+   r.mean /= n;
+   free( out );
+
+   start = SDL_GetPerformanceCounter();
+   for ( int i = 0; i < ITERATIONS; i++ )
+      free( make_distance_mapbf( img, SIZE, SIZE, quality, &vmax ) );
+   r.us = 1e6 * (double)( SDL_GetPerformanceCounter() - start ) /
+          (double)SDL_GetPerformanceFrequency() / ITERATIONS;
+   return r;
+}
+
+int main( void )
+{
+   unsigned char img[SIZE * SIZE];
+   int           ret = EXIT_SUCCESS;
+
+   for ( size_t i = 0; i < sizeof( shapes ) / sizeof( shapes[0] ); i++ ) {
+      Result fast, high;
+      rasterize( &shapes[i], img );
+      fast = measure( &shapes[i], img, SDF_QUALITY_FAST );
+      high = measure( &shapes[i], img, SDF_QUALITY_HIGH );
+      printf( "%s: fast %.3f px mean, %.3f px max, %.1f us\n", shapes[i].name,
+              fast.mean, fast.max, fast.us );
+      printf( "%s: high %.3f px mean, %.3f px max, %.1f us\n", shapes[i].name,
+              high.mean, high.max, high.us );
+      /* The high quality mode is what glyphs and images use. */
+      if ( ( high.mean > fast.mean ) || ( high.max > 0.5 ) ) {
+         printf( "%s: high quality mode is not accurate enough\n",
+                 shapes[i].name );
+         ret = EXIT_FAILURE;
+      }
+   }
+   return ret;
+}